@@ -25,10 +25,6 @@
 
 #include <boost/foreach.hpp> 
 
-#ifdef _OPENMP
-    #include <omp.h>
-#endif
-
 #include "millingcutter.hpp"
 #include "point.hpp"
 #include "triangle.hpp"
@@ -38,11 +34,27 @@
 #include "adaptivewaterline.hpp"
 #include "weave.hpp"
 #include "fiberpushcutter.hpp"
+#include "threadpool.hpp"
 
 
 namespace ocl
 {
 
+/// part 0 samples the x-fibers of an AdaptiveWaterline, part 1 the y-fibers
+class AdaptiveSampleTask : public ParallelTask {
+    public:
+        AdaptiveSampleTask(AdaptiveWaterline* w, const Span* s) : awl(w), span(s) {}
+        void run(unsigned int part) {
+            if ( part == 0 )
+                awl->xfiber_adaptive_sample_run(span);
+            else
+                awl->yfiber_adaptive_sample_run(span);
+        }
+    private:
+        AdaptiveWaterline* awl;
+        const Span* span;
+};
+
 //********   ********************** */
 
 AdaptiveWaterline::AdaptiveWaterline() {
@@ -51,12 +63,8 @@ AdaptiveWaterline::AdaptiveWaterline() {
     subOp.push_back( new FiberPushCutter() );
     subOp[0]->setXDirection();
     subOp[1]->setYDirection();
-    nthreads=1;
-#ifdef _OPENMP
-    nthreads = omp_get_num_procs(); 
-    //omp_set_dynamic(0);
-    omp_set_nested(1);
-#endif
+    shareRunControl();
+    nthreads = ThreadPool::instance().size();
     sampling = 1.0;
     min_sampling = 0.1;
     cosLimit = 0.999;
@@ -68,13 +76,19 @@ AdaptiveWaterline::~AdaptiveWaterline() {
 }
 
 void AdaptiveWaterline::run() {
+    control->begin();
     adaptive_sampling_run();
-    weave_process(); // in base-class Waterline
+    if ( !control->stopped() ) // no loops from incomplete fibers
+        weave_process(); // in base-class Waterline
+    control->end();
 }
 
 void AdaptiveWaterline::run2() {
+    control->begin();
     adaptive_sampling_run();
-    weave_process2(); // in base-class Waterline
+    if ( !control->stopped() )
+        weave_process2(); // in base-class Waterline
+    control->end();
 }
 
 void AdaptiveWaterline::adaptive_sampling_run() {
@@ -85,60 +99,9 @@ void AdaptiveWaterline::adaptive_sampling_run() {
     Line* line = new Line( Point(minx,miny,zh) , Point(maxx,maxy,zh) );
     Span* linespan = new LineSpan(*line);
     
-#ifdef _WIN32 // OpenMP task not supported with the version 2 of VS2013 OpenMP
-	#pragma omp parallel sections
-	{
-		#pragma omp section // Replace OMP Task by Parallel sections
-		{ // first child
-#else
-#pragma omp parallel
-	{
-#pragma omp single nowait
-		{ // initial root task
-#pragma omp task
-			{ // first child task
-#endif // _WIN32
-				xfibers.clear();
-				Point xstart_p1 = Point(minx, linespan->getPoint(0.0).y, zh);
-				Point xstart_p2 = Point(maxx, linespan->getPoint(0.0).y, zh);
-				Point xstop_p1 = Point(minx, linespan->getPoint(1.0).y, zh);
-				Point xstop_p2 = Point(maxx, linespan->getPoint(1.0).y, zh);
-				Fiber xstart_f = Fiber(xstart_p1, xstart_p2);
-				Fiber xstop_f = Fiber(xstop_p1, xstop_p2);
-				subOp[0]->run(xstart_f);
-				subOp[0]->run(xstop_f);
-				xfibers.push_back(xstart_f);
-				std::cout << " XFiber adaptive sample \n";
-				xfiber_adaptive_sample(linespan, 0.0, 1.0, xstart_f, xstop_f);
-#ifdef _WIN32 // OpenMP task not supported with the version 2 of VS2013 OpenMP
-		}
-		#pragma omp section
-		{ // second child
-#else
-		}
-# pragma omp task
-			{ // second child task
-#endif // _WIN32
-				yfibers.clear();
-				Point ystart_p1 = Point(linespan->getPoint(0.0).x, miny, zh);
-				Point ystart_p2 = Point(linespan->getPoint(0.0).x, maxy, zh);
-				Point ystop_p1 = Point(linespan->getPoint(1.0).x, miny, zh);
-				Point ystop_p2 = Point(linespan->getPoint(1.0).x, maxy, zh);
-				Fiber ystart_f = Fiber(ystart_p1, ystart_p2);
-				Fiber ystop_f = Fiber(ystop_p1, ystop_p2);
-				subOp[1]->run(ystart_f);
-				subOp[1]->run(ystop_f);
-				yfibers.push_back(ystart_f);
-				std::cout << " YFiber adaptive sample \n";
-				yfiber_adaptive_sample(linespan, 0.0, 1.0, ystart_f, ystop_f);
-#ifdef _WIN32 // OpenMP task not supported with the version 2 of VS2013 OpenMP
-		}
-	} // end omp parallel
-#else
-            }
-        }
-    } // end omp parallel
-#endif // _WIN32
+    control->stage( 0.0, 0.9, 2.0 ); // each direction samples the t-range [0, 1] of linespan
+    AdaptiveSampleTask task( this, linespan );
+    ThreadPool::instance().run( task, 2 ); // the x- and y-fibers at the same time
 
     delete line;
     delete linespan;
@@ -146,6 +109,36 @@ void AdaptiveWaterline::adaptive_sampling_run() {
 }
 
 
+void AdaptiveWaterline::xfiber_adaptive_sample_run(const Span* linespan) {
+    xfibers.clear();
+    Point xstart_p1 = Point(minx, linespan->getPoint(0.0).y, zh);
+    Point xstart_p2 = Point(maxx, linespan->getPoint(0.0).y, zh);
+    Point xstop_p1 = Point(minx, linespan->getPoint(1.0).y, zh);
+    Point xstop_p2 = Point(maxx, linespan->getPoint(1.0).y, zh);
+    Fiber xstart_f = Fiber(xstart_p1, xstart_p2);
+    Fiber xstop_f = Fiber(xstop_p1, xstop_p2);
+    subOp[0]->run(xstart_f);
+    subOp[0]->run(xstop_f);
+    xfibers.push_back(xstart_f);
+    std::cout << " XFiber adaptive sample \n";
+    xfiber_adaptive_sample(linespan, 0.0, 1.0, xstart_f, xstop_f);
+}
+
+void AdaptiveWaterline::yfiber_adaptive_sample_run(const Span* linespan) {
+    yfibers.clear();
+    Point ystart_p1 = Point(linespan->getPoint(0.0).x, miny, zh);
+    Point ystart_p2 = Point(linespan->getPoint(0.0).x, maxy, zh);
+    Point ystop_p1 = Point(linespan->getPoint(1.0).x, miny, zh);
+    Point ystop_p2 = Point(linespan->getPoint(1.0).x, maxy, zh);
+    Fiber ystart_f = Fiber(ystart_p1, ystart_p2);
+    Fiber ystop_f = Fiber(ystop_p1, ystop_p2);
+    subOp[1]->run(ystart_f);
+    subOp[1]->run(ystop_f);
+    yfibers.push_back(ystart_f);
+    std::cout << " YFiber adaptive sample \n";
+    yfiber_adaptive_sample(linespan, 0.0, 1.0, ystart_f, ystop_f);
+}
+
 void AdaptiveWaterline::xfiber_adaptive_sample(const Span* span, double start_t, double stop_t, Fiber start_f, Fiber stop_f) {
     const double mid_t = start_t + (stop_t-start_t)/2.0; // mid point sample
     assert( mid_t > start_t );  assert( mid_t < stop_t );
@@ -153,6 +146,8 @@ void AdaptiveWaterline::xfiber_adaptive_sample(const Span* span, double start_t,
     Point mid_p1 = Point( minx, span->getPoint( mid_t ).y,  zh );
     Point mid_p2 = Point( maxx, span->getPoint( mid_t ).y,  zh );
     Fiber mid_f = Fiber( mid_p1, mid_p2 );
+    if ( control->stopped() ) // the fibers sampled so far are kept
+        return;
     subOp[0]->run( mid_f );
     double fw_step = fabs( start_f.p1.y - stop_f.p1.y ) ;
     if ( fw_step > sampling ) { // above minimum step-forward, need to sample more
@@ -162,8 +157,11 @@ void AdaptiveWaterline::xfiber_adaptive_sample(const Span* span, double start_t,
         if (fw_step > min_sampling) { // not a flat segment, and we have not reached maximum sampling
             xfiber_adaptive_sample( span, start_t, mid_t , start_f, mid_f  );
             xfiber_adaptive_sample( span, mid_t  , stop_t, mid_f  , stop_f );
+        } else {
+            control->advance( stop_t-start_t );
         }
     } else {
+        control->advance( stop_t-start_t );
         xfibers.push_back(stop_f);
     } 
 }
@@ -175,6 +173,8 @@ void AdaptiveWaterline::yfiber_adaptive_sample(const Span* span, double start_t,
     Point mid_p1 = Point( span->getPoint( mid_t ).x, miny,  zh );
     Point mid_p2 = Point( span->getPoint( mid_t ).x, maxy, zh );
     Fiber mid_f = Fiber( mid_p1, mid_p2 );
+    if ( control->stopped() ) // the fibers sampled so far are kept
+        return;
     subOp[1]->run( mid_f );
     double fw_step = fabs( start_f.p1.x - stop_f.p1.x ) ;
     if ( fw_step > sampling ) { // above minimum step-forward, need to sample more
@@ -184,8 +184,11 @@ void AdaptiveWaterline::yfiber_adaptive_sample(const Span* span, double start_t,
         if (fw_step > min_sampling) { // not a flat segment, and we have not reached maximum sampling
             yfiber_adaptive_sample( span, start_t, mid_t , start_f, mid_f  );
             yfiber_adaptive_sample( span, mid_t  , stop_t, mid_f  , stop_f );
+        } else {
+            control->advance( stop_t-start_t );
         }
     } else {
+        control->advance( stop_t-start_t );
         yfibers.push_back(stop_f); 
     }
 }
@@ -35,6 +35,7 @@ namespace ocl
 {
 
 class Span;
+class AdaptiveSampleTask;
 
 /// \brief a Waterline toolpath follows the shape of the model at a constant z-height in the xy-plane
 
@@ -60,8 +61,13 @@ class AdaptiveWaterline : public Waterline {
         
         
     protected:
+        friend class AdaptiveSampleTask;
         /// adaptive waterline algorithm
         void adaptive_sampling_run();
+        /// the x-fibers along linespan, part 0 of adaptive_sampling_run()
+        void xfiber_adaptive_sample_run(const Span* linespan);
+        /// the y-fibers along linespan, part 1 of adaptive_sampling_run()
+        void yfiber_adaptive_sample_run(const Span* linespan);
         /// x-direction adaptive sampling
         void xfiber_adaptive_sample(const Span* span, double start_t, double stop_t, Fiber start_f, Fiber stop_f);
         /// y-direction adaptive sampling
@@ -19,43 +19,80 @@
  *  along with this program. If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <typeinfo>
+
 #include <boost/foreach.hpp>
 #include <boost/progress.hpp>
 
-#ifdef _OPENMP  
-    #include <omp.h>
-#endif
-
 #include "millingcutter.hpp"
+#include "cutterengine.hpp"
 #include "point.hpp"
 #include "triangle.hpp"
 #include "batchpushcutter.hpp"
+#include "workscheduler.hpp"
+#include "threadpool.hpp"
 
 namespace ocl
 {
 
+/// the fibers of BatchPushCutter::pushFibers(), pushed with a MeshPushCutterVisitor<Cutter>
+template <class Cutter>
+class PushFibersTask : public ScheduledTask {
+    public:
+        /// fibers along x if xdir, along y if ydir
+        PushFibersTask(WorkScheduler& w, boost::progress_display& p, RunControl& rc, const SpatialIndex* si,
+                       const Cutter& cu, std::vector<Fiber>& f, bool xdir, bool ydir)
+            : ScheduledTask(w, p, rc), root(si), c(cu), fiberr(f), x_direction(xdir), y_direction(ydir) {}
+        void run(unsigned int part) {
+            PushMarks marks; // vertices and edges pushed against along the current fiber, one per part
+            unsigned int begin, end;
+            while ( !stopped() && work.next(part, begin, end) ) {
+                for (unsigned int n=begin; n<end; ++n) { // loop through the fibers of the chunk
+                    CLPoint cl; // cl-point on the fiber
+                    if ( x_direction ) {
+                        cl.x=0;
+                        cl.y=fiberr[n].p1.y;
+                        cl.z=fiberr[n].p1.z;
+                    } else if ( y_direction ) {
+                        cl.x=fiberr[n].p1.x;
+                        cl.y=0;
+                        cl.z=fiberr[n].p1.z;
+                    }
+                    // todo: optimization where method-calls are skipped if triangle bbox already in the fiber
+                    MeshPushCutterVisitor<Cutter> v(&c, fiberr[n], root->getPackedSurf(), root->getIndexedMesh(), marks); // pushes the cutter against each found triangle
+                    root->visit_cutter_overlap(&c, &cl, v);
+                    work.addCalls(part, v.calls);
+                }
+                advance( end-begin );
+            }
+        }
+    private:
+        const SpatialIndex* root;
+        const Cutter& c;
+        std::vector<Fiber>& fiberr;
+        const bool x_direction;
+        const bool y_direction;
+};
+
 //********   ********************** */
 
 BatchPushCutter::BatchPushCutter() {
     fibers = new std::vector<Fiber>();
     nCalls = 0;
-    nthreads = 1;
-#ifdef _OPENMP
-    nthreads = omp_get_num_procs(); // figure out how many cores we have
-#endif
+    nthreads = ThreadPool::instance().size();
     cutter = NULL;
     bucketSize = 1;
-    root = new KDTree<Triangle>();
+    createIndex();
 }
 
 BatchPushCutter::~BatchPushCutter() {
     delete fibers;
-    delete root;
 }
 
 void BatchPushCutter::setSTL(const STLSurf &s) {
     surf = &s;
     std::cout << "BPC::setSTL() Building kd-tree... bucketSize=" << bucketSize << "..";
+    createIndex();
     root->setBucketSize( bucketSize );
     if (x_direction)
         root->setYZDimensions(); // we search for triangles in the XY plane, don't care about Z-coordinate
@@ -66,8 +103,8 @@ void BatchPushCutter::setSTL(const STLSurf &s) {
         assert(0);
     }
     std::cout << "BPC::setSTL() root->build()...";
-    root->build(s.tris);
-    std::cout << "done.\n";
+    buildIndex(s);
+    std::cout << "done. " << root->str() << "\n";
 }
 
 void BatchPushCutter::appendFiber(Fiber& f) {
@@ -82,11 +119,11 @@ void BatchPushCutter::reset() {
 /// each fiber is tested against all triangles of surface
 void BatchPushCutter::pushCutter1() {
     std::cout << "BatchPushCutter1 with " << fibers->size() << 
-              " fibers and " << surf->tris.size() << " triangles..." << std::endl;
+              " fibers and " << surf->size() << " triangles..." << std::endl;
     nCalls = 0;
     boost::progress_display show_progress( fibers->size() );
     BOOST_FOREACH(Fiber& f, *fibers) {
-        BOOST_FOREACH( const Triangle& t, surf->tris) {// test against all triangles in s
+        BOOST_FOREACH( const Triangle& t, surf->getTriangles()) {// test against all triangles in s
             Interval i;
             cutter->pushCutter(f,i,t);
             f.addInterval(i);
@@ -102,9 +139,9 @@ void BatchPushCutter::pushCutter1() {
 /// overlapping with the cutter.
 void BatchPushCutter::pushCutter2() {
     std::cout << "BatchPushCutter2 with " << fibers->size() << 
-              " fibers and " << surf->tris.size() << " triangles..." << std::endl;
+              " fibers and " << surf->size() << " triangles..." << std::endl;
     nCalls = 0;
-    std::list<Triangle>* overlap_triangles;
+    std::vector<IndexSpan> spans;
     boost::progress_display show_progress( fibers->size() );
     BOOST_FOREACH(Fiber& f, *fibers) {
         CLPoint cl;
@@ -119,17 +156,17 @@ void BatchPushCutter::pushCutter2() {
         } else {
             assert(0);
         }
-        overlap_triangles = root->search_cutter_overlap(cutter, &cl);
-        assert( overlap_triangles->size() <= surf->size() ); // can't possibly find more triangles than in the STLSurf 
-        BOOST_FOREACH( const Triangle& t, *overlap_triangles) {
-            //if ( bb->overlaps( t.bb ) ) {
+        spans.clear();
+        root->search_cutter_overlap(cutter, &cl, spans);
+        BOOST_FOREACH( const IndexSpan& s, spans) {
+            assert( s.last <= surf->size() ); // can't possibly find more triangles than in the STLSurf 
+            for (unsigned int k=s.first; k<s.last; ++k) {
                 Interval i;
-                cutter->pushCutter(f,i,t);
+                cutter->pushCutter(f,i,root->get(k));
                 f.addInterval(i);
                 ++nCalls;
-            //}
+            }
         }
-        delete( overlap_triangles );
         ++show_progress;
     }
     std::cout << "BatchPushCutter2 done." << std::endl;
@@ -137,68 +174,39 @@ void BatchPushCutter::pushCutter2() {
 }
 
 /// use kd-tree search to find overlapping triangles
-/// use OpenMP for multi-threading
-void BatchPushCutter::pushCutter3() {
+/// use the threads of the ThreadPool, sharing the fibers with a WorkScheduler
+template <class Cutter>
+void BatchPushCutter::pushFibers(const Cutter& c) {
     std::cout << "BatchPushCutter3 with " << fibers->size() << 
-              " fibers and " << surf->tris.size() << " triangles." << std::endl;
+              " fibers and " << surf->size() << " triangles." << std::endl;
     std::cout << " cutter = " << cutter->str() << "\n";
+    updateIndex();
     nCalls = 0;
     boost::progress_display show_progress( fibers->size() );
-#ifdef _OPENMP
-    omp_set_num_threads(nthreads);
-    //omp_set_nested(1);
-#endif
     unsigned int Nmax = fibers->size();         // the number of fibers to process
-    std::list<Triangle>::iterator it,it_end;    // for looping over found triabgles
-    Interval* i;
-    std::list<Triangle>* tris;
-    std::vector<Fiber>& fiberr = *fibers;
-#ifdef _WIN32 // OpenMP version 2 of VS2013 OpenMP need signed loop variable
-	int n; // loop variable
-#else
-    unsigned int n; // loop variable
-#endif
-    unsigned int calls=0;
+    WorkScheduler work( Nmax, nthreads );
+    PushFibersTask<Cutter> task( work, show_progress, *control, root.get(), c, *fibers, x_direction, y_direction );
+    control->stage( 0.0, 1.0, Nmax );
+    ThreadPool::instance().run( task, work.threads() );
     
-    #pragma omp parallel for schedule(dynamic) shared(calls, fiberr) private(n,i,tris,it,it_end)
-    //#pragma omp parallel for shared( calls, fiberr) private(n,i,tris,it,it_end)
-    for (n=0; n<Nmax; ++n) { // loop through all fibers
-#ifdef _OPENMP
-        if ( n== 0 ) { // first iteration
-            if (omp_get_thread_num() == 0 ) 
-                std::cout << "Number of OpenMP threads = "<< omp_get_num_threads() << "\n";
-        }
-#endif  
-        CLPoint cl; // cl-point on the fiber
-        if ( x_direction ) {
-            cl.x=0;
-            cl.y=fiberr[n].p1.y;
-            cl.z=fiberr[n].p1.z;
-        } else if (y_direction ) {
-            cl.x=fiberr[n].p1.x;
-            cl.y=0;
-            cl.z=fiberr[n].p1.z;
-        }
-        tris = root->search_cutter_overlap(cutter, &cl);
-        it_end = tris->end();
-        for ( it=tris->begin() ; it!=it_end ; ++it) { // loop through the found overlapping triangles
-            //if ( bb->overlaps( it->bb ) ) {
-                // todo: optimization where method-calls are skipped if triangle bbox already in the fiber
-                i = new Interval();
-                cutter->pushCutter(fiberr[n],*i,*it);  
-                fiberr[n].addInterval(*i); 
-                ++calls;
-                delete i;
-            //}
-        }
-        delete( tris );
-        ++show_progress;
-    } // OpenMP parallel region ends here
-    
-    this->nCalls = calls;
+    this->nCalls = work.calls();
     std::cout << "\nBatchPushCutter3 done." << std::endl;
     return;
 }
 
+// the one type switch: pushFibers() is compiled once for each cutter type
+void BatchPushCutter::pushCutter3() {
+    if ( typeid(*cutter) == typeid(CylCutter) )
+        pushFibers( static_cast<const CylCutter&>(*cutter) );
+    else if ( typeid(*cutter) == typeid(BallCutter) )
+        pushFibers( static_cast<const BallCutter&>(*cutter) );
+    else if ( typeid(*cutter) == typeid(BullCutter) )
+        pushFibers( static_cast<const BullCutter&>(*cutter) );
+    else if ( typeid(*cutter) == typeid(ConeCutter) )
+        pushFibers( static_cast<const ConeCutter&>(*cutter) );
+    else
+        pushFibers( *cutter ); // CompositeCutter and others, with virtual calls, or per Triangle
+}
+
 }// end namespace
 // end file batchpushcutter.cpp
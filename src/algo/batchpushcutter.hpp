@@ -28,7 +28,7 @@
 
 #include "point.hpp"
 #include "fiber.hpp"
-#include "kdtree.hpp"
+#include "spatialindex.hpp"
 #include "operation.hpp"
 
 namespace ocl
@@ -60,7 +60,11 @@ class BatchPushCutter : public Operation {
 
         
         /// run push-cutter
-        void run() {this->pushCutter3();}
+        void run() {
+            control->begin();
+            this->pushCutter3();
+            control->end();
+        }
         //void run() {this->pushCutter1();}
         
         std::vector<Fiber>* getFibers() const {return fibers;}
@@ -70,8 +74,13 @@ class BatchPushCutter : public Operation {
         void pushCutter1();
         /// 2nd version of algorithm
         void pushCutter2();
-        /// 3rd version of algorithm
+        /// 3rd version of algorithm. CylCutter, BallCutter, BullCutter and ConeCutter are pushed
+        /// by a CutterEngine of their type, other cutters through the MillingCutter interface,
+        /// one Triangle at a time if they have no MillingCutter::hasMeshKernels().
         void pushCutter3();
+        /// pushCutter3() with cutter c, the exact type of *cutter, see CutterEngine.
+        template <class Cutter>
+        void pushFibers(const Cutter& c);
         
         /// pointer to list of Fibers
         std::vector<Fiber>* fibers;
@@ -25,6 +25,7 @@
 #include <boost/python.hpp>
 
 #include "batchpushcutter.hpp"
+#include "operation_py.hpp"
 
 #include "fiber_py.hpp"
 
@@ -34,6 +35,40 @@ namespace ocl
 class BatchPushCutter_py : public BatchPushCutter {
     public:
         BatchPushCutter_py() : BatchPushCutter() {}
+        /// report the progress of run() to the Python callable f, as f(fraction). None removes it.
+        void setProgressCallback_py(boost::python::object f) {
+            setProgressCallback( progress_callback_py(f) );
+        }
+        /// run() without the GIL, so other Python threads can run
+        void run_py() {
+            ScopedGILRelease nogil;
+            run();
+        }
+        /// setSTL() without the GIL, as it may build a spatial index. s must not be modified until it returns.
+        void setSTL_py(const STLSurf& s) {
+            ScopedGILRelease nogil;
+            setSTL(s);
+        }
+        /// setCutter() without the GIL, as it may re-build the spatial index
+        void setCutter_py(const MillingCutter* c) {
+            ScopedGILRelease nogil;
+            setCutter(c);
+        }
+        /// loadIndex() without the GIL, as it reads the file. s must not be used until it returns.
+        bool loadIndex_py(const std::string& filename, STLSurf& s) {
+            ScopedGILRelease nogil;
+            return loadIndex(filename, s);
+        }
+        /// saveIndex() without the GIL, as it writes the file
+        bool saveIndex_py(const std::string& filename) const {
+            ScopedGILRelease nogil;
+            return saveIndex(filename);
+        }
+        /// saveCache() without the GIL, as it writes the file
+        bool saveCache_py(const std::string& filename) const {
+            ScopedGILRelease nogil;
+            return saveCache(filename);
+        }
         /// return CL-points to Python
         boost::python::list getCLPoints() const {
             boost::python::list plist;
@@ -58,7 +93,7 @@ class BatchPushCutter_py : public BatchPushCutter {
         /// more for visualization and demonstration.
         boost::python::list getOverlapTriangles(Fiber& f) {
             boost::python::list trilist;
-            std::list<Triangle> *overlap_triangles = new std::list<Triangle>();
+            std::vector<IndexSpan> spans;
             //int plane = 3; // XY-plane
             //Bbox bb; //FIXME
             //KDNode2::search_kdtree( overlap_triangles, bb,  root, plane);
@@ -74,12 +109,11 @@ class BatchPushCutter_py : public BatchPushCutter {
             } else {
                 assert(0);
             }
-            overlap_triangles = root->search_cutter_overlap(cutter, &cl);
-            
-            BOOST_FOREACH(Triangle t, *overlap_triangles) {
-                trilist.append(t);
+            root->search_cutter_overlap(cutter, &cl, spans);
+            BOOST_FOREACH(const IndexSpan& s, spans) {
+                for (unsigned int k=s.first; k<s.last; ++k)
+                    trilist.append( root->get(k) );
             }
-            delete overlap_triangles;
             return trilist;
         };
         /// return list of Fibers to python
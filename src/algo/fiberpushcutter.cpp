@@ -22,14 +22,11 @@
 #include <boost/foreach.hpp>
 #include <boost/progress.hpp>
 
-#ifdef _OPENMP  
-    #include <omp.h>
-#endif
-
 #include "millingcutter.hpp"
 #include "point.hpp"
 #include "triangle.hpp"
 #include "fiberpushcutter.hpp"
+#include "threadpool.hpp"
 
 namespace ocl
 {
@@ -38,22 +35,19 @@ namespace ocl
 
 FiberPushCutter::FiberPushCutter() {
     nCalls = 0;
-    nthreads = 1;
-#ifdef _OPENMP
-    nthreads = omp_get_num_procs(); // figure out how many cores we have
-#endif
+    nthreads = ThreadPool::instance().size();
     cutter = NULL;
     bucketSize = 1;
-    root = new KDTree<Triangle>();
+    createIndex();
 }
 
 FiberPushCutter::~FiberPushCutter() {
-    delete root;
 }
 
 void FiberPushCutter::setSTL(const STLSurf &s) {
     surf = &s;
     std::cout << "BPC::setSTL() Building kd-tree... bucketSize=" << bucketSize << "..";
+    createIndex();
     root->setBucketSize( bucketSize );
     if (x_direction)
         root->setYZDimensions(); 
@@ -64,13 +58,13 @@ void FiberPushCutter::setSTL(const STLSurf &s) {
         assert(0);
     }
     std::cout << "BPC::setSTL() root->build()";
-    root->build(s.tris);
-    std::cout << " done.\n";
+    buildIndex(s);
+    std::cout << " done. " << root->str() << "\n";
 }
 
 void FiberPushCutter::pushCutter1(Fiber& f) {
     nCalls = 0;
-    BOOST_FOREACH( const Triangle& t, surf->tris) {// test against all triangles in s
+    BOOST_FOREACH( const Triangle& t, surf->getTriangles()) {// test against all triangles in s
         Interval i;
         cutter->pushCutter(f,i,t);
         f.addInterval(i);
@@ -79,9 +73,6 @@ void FiberPushCutter::pushCutter1(Fiber& f) {
 }
 
 void FiberPushCutter::pushCutter2(Fiber& f) {
-    std::list<Triangle>::iterator it,it_end;    // for looping over found triangles
-    Interval* i;
-    std::list<Triangle>* tris;
     CLPoint cl;
     if ( x_direction ) {
         cl.x=0;
@@ -92,16 +83,10 @@ void FiberPushCutter::pushCutter2(Fiber& f) {
         cl.y=0;
         cl.z=f.p1.z;
     }
-    tris = root->search_cutter_overlap(cutter, &cl);
-    it_end = tris->end();
-    for ( it=tris->begin() ; it!=it_end ; ++it) {
-		i = new Interval();
-		cutter->pushCutter(f,*i,*it);
-		f.addInterval(*i); 
-		++nCalls;
-		delete i;
-    }
-    delete( tris );
+    updateIndex();
+    MeshPushCutterVisitor<> v(cutter, f, root->getPackedSurf(), root->getIndexedMesh(), marks);
+    root->visit_cutter_overlap(cutter, &cl, v);
+    nCalls += v.calls;
 }
 
 }// end namespace
@@ -64,6 +64,8 @@ class FiberPushCutter : public Operation {
         bool x_direction;
         /// true if we have y-direction fibers
         bool y_direction;
+        /// vertices and edges pushed against along the current fiber
+        PushMarks marks;
 };
 
 } // end namespace
@@ -28,7 +28,10 @@
 
 #include "point.hpp"
 #include "fiber.hpp"
-#include "kdtree.hpp"
+#include "spatialindex.hpp"
+#include "indexcache.hpp"
+#include "meshcache.hpp"
+#include "runcontrol.hpp"
 
 namespace ocl
 {
@@ -42,7 +45,14 @@ class MillingCutter;
 /// base-class for cam algorithms
 class Operation {
     public:
-        Operation() {}
+        Operation() {
+            sah = false;
+            indexType = KDTreeIndexType;
+            surf = NULL;
+            cutter = NULL;
+            surfRevision = 0;
+            control.reset( new RunControl() );
+        }
         virtual ~Operation() {
             //std::cout << "~Operation()\n";
         }
@@ -56,18 +66,22 @@ class Operation {
         /// set the MillingCutter to use
         virtual void setCutter(const MillingCutter* c) {
             cutter = c;
+            if ( root && surf ) // an index for a fixed cutter size may need a re-build
+                updateIndex();
             BOOST_FOREACH(Operation* op, subOp) {
                 op->setCutter(cutter);
             }
         }
-        /// set number of OpenMP threads. Defaults to OpenMP::omp_get_num_procs()
+        /// \brief set the number of ThreadPool threads to use. Defaults to ThreadPool::size().
+        ///
+        /// More threads than the pool has run as extra parts on the pool threads.
         void setThreads(unsigned int n) {
             nthreads = n;
             BOOST_FOREACH(Operation* op, subOp) {
                 op->setThreads(nthreads);
             }
         }
-        /// return number of OpenMP threads
+        /// return the number of threads to use
         int  getThreads() const {return nthreads;}
         /// return the kd-tree bucket-size
         int getBucketSize() const {return bucketSize;}
@@ -78,8 +92,76 @@ class Operation {
                 op->setBucketSize(bucketSize);
             }
         }
+        /// select the type of spatial index built by setSTL()
+        void setIndexType(SpatialIndexType t) {
+            indexType = t;
+            BOOST_FOREACH(Operation* op, subOp) {
+                op->setIndexType(indexType);
+            }
+        }
+        /// return the type of spatial index
+        SpatialIndexType getIndexType() const {return indexType;}
+        /// use the SAH split rule when building the spatial index. See SpatialIndex::setSAH()
+        void setSAH(bool b) {
+            sah = b;
+            BOOST_FOREACH(Operation* op, subOp) {
+                op->setSAH(sah);
+            }
+        }
+        /// return true if the spatial index uses the SAH split rule
+        bool getSAH() const {return sah;}
+        /// save the spatial index of this operation, with the triangles, to a file. See SpatialIndex::save()
+        bool saveIndex(const std::string& filename) const {
+            if (!root) {
+                std::cout << "ERROR: saveIndex() called before setSTL()\n";
+                return false;
+            }
+            return root->save(filename);
+        }
+        /// save the surface of this operation, with its spatial index, to a mesh cache file. See MeshCache::save()
+        bool saveCache(const std::string& filename) const {
+            if (!root) {
+                std::cout << "ERROR: saveCache() called before setSTL()\n";
+                return false;
+            }
+            if ( surf->getRevision() != surfRevision ) // the index is out of date
+                return MeshCache::save(filename, *surf);
+            return MeshCache::save(filename, *surf, root.get());
+        }
+        /// \brief load a file written by saveIndex(), and add its triangles to the empty surface s.
+        ///
+        /// Takes the index type, bucket-size and split rule from the file, and calls setSTL(s).
+        /// The mapped index is used by this operation, and sub-operations, that search in the same
+        /// plane (and, for SAH and grids, use the same cutter size). Others build their own as usual.
+        bool loadIndex(const std::string& filename, STLSurf& s) {
+            boost::shared_ptr<SpatialIndex> idx( SpatialIndex::load(filename, s) );
+            if (!idx)
+                return false;
+            IndexCache::insert(idx, s);
+            setIndexType( idx->type() );
+            setBucketSize( idx->getBucketSize() );
+            setSAH( idx->getSAH() );
+            setSTL(s);
+            return true;
+        }
         /// return number of low-level calls
         int getCalls() const {return nCalls;}
+        /// \brief report the progress of run() to c, as a fraction from 0 to 1.
+        ///
+        /// c is called on the thread that called run(), at most every setProgressInterval() seconds.
+        void setProgressCallback(boost::shared_ptr<ProgressCallback> c) {control->setCallback(c);}
+        /// call the ProgressCallback at most every s seconds. PROGRESS_INTERVAL by default.
+        void setProgressInterval(double s) {control->setInterval(s);}
+        /// \brief stop run() soon after t is cancelled.
+        ///
+        /// A stopped run() returns the results computed so far, see isStopped().
+        void setCancelToken(boost::shared_ptr<CancelToken> t) {control->setCancelToken(t);}
+        /// stop run() after s seconds of wall-clock time, or never if s is zero, the default
+        void setTimeBudget(double s) {control->setTimeBudget(s);}
+        /// return the time budget in seconds, zero if there is none
+        double getTimeBudget() const {return control->getTimeBudget();}
+        /// true if the last run() was stopped by the CancelToken or the time budget, so its results are incomplete
+        bool isStopped() const {return control->stopped();}
         
         /// set the sampling interval for this Operation and all sub-operations
         virtual void setSampling(double s) {
@@ -125,16 +207,63 @@ class Operation {
         int nCalls;
         /// size of bucket-node in KD-tree
         unsigned int bucketSize;
+        /// true if the spatial index is built with the SAH split rule
+        bool sah;
+        /// the type of spatial index
+        SpatialIndexType indexType;
         /// the MillingCutter used
         const MillingCutter* cutter;
         /// the STLSurf which we test against.
         const STLSurf* surf;
-        /// root of a kd-tree
-        KDTree<Triangle>* root;
+        /// the spatial index used to find triangles under the cutter.
+        /// Shared with other Operations on the same surface, see IndexCache.
+        boost::shared_ptr<SpatialIndex> root;
+        /// revision of surf when root was built
+        unsigned int surfRevision;
+        /// replace root with a new, empty, spatial index of type indexType,
+        /// with the split rule and query size set
+        void createIndex() {
+            root.reset( SpatialIndex::create(indexType) );
+            root->setSAH(sah);
+            if (cutter)
+                root->setCutterSize( cutter->getRadius(), cutter->getLength() );
+        }
+        /// build root over the triangles of s, or re-use an equal index from the IndexCache
+        void buildIndex(const STLSurf& s) {
+            root = IndexCache::build(root, s);
+            surfRevision = s.getRevision();
+        }
+        /// \brief replace root if it was built for another cutter size, see SpatialIndex::fitsCutter(),
+        /// or if the surface was modified after setSTL().
+        ///
+        /// The index refers to the triangles of the surface, which may have moved when
+        /// triangles were added, so it must not be searched after a modification.
+        void updateIndex() {
+            if ( surf->getRevision() != surfRevision ) {
+                root.reset( root->emptyCopy() );
+                buildIndex(*surf);
+                std::cout << "spatial index re-built for the modified surface: " << root->str() << "\n";
+            } else if ( !root->fitsCutter( cutter->getRadius(), cutter->getLength() ) ) {
+                root.reset( root->emptyCopy() ); // root may be shared, so don't re-build it in place
+                root->setCutterSize( cutter->getRadius(), cutter->getLength() );
+                buildIndex(*surf);
+                std::cout << "spatial index re-built for " << cutter->str() << ": " << root->str() << "\n";
+            }
+        }
+        /// give the sub-operations the RunControl of this operation, so they report
+        /// within its stages, and stop with it. Call after adding the sub-operations.
+        void shareRunControl() {
+            BOOST_FOREACH(Operation* op, subOp) {
+                op->control = control;
+                op->shareRunControl();
+            }
+        }
         /// number of threads to use
         unsigned int nthreads;
         /// sub-operations, if any, of this operation
         std::vector<Operation*> subOp;
+        /// progress, cancellation and time budget of run(), shared with the sub-operations
+        boost::shared_ptr<RunControl> control;
 };
 
 } // end namespace
@@ -0,0 +1,97 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010-2011 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPERATION_PY_H
+#define OPERATION_PY_H
+
+#include <boost/python.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "runcontrol.hpp"
+
+namespace ocl
+{
+
+/// \brief releases the Python GIL for its lifetime, so other Python threads run while C++ computes.
+///
+/// The code in its scope must not touch Python objects.
+class ScopedGILRelease {
+    public:
+        ScopedGILRelease() {state = PyEval_SaveThread();}
+        ~ScopedGILRelease() {PyEval_RestoreThread(state);}
+    private:
+        ScopedGILRelease(const ScopedGILRelease&); // not copyable
+        ScopedGILRelease& operator=(const ScopedGILRelease&);
+        /// the thread state saved by the constructor
+        PyThreadState* state;
+};
+
+/// \brief takes the Python GIL for its lifetime, from any thread, also one that already holds it.
+///
+/// For C++ code that calls back into Python while a ScopedGILRelease may be active.
+class ScopedGILAcquire {
+    public:
+        ScopedGILAcquire() {state = PyGILState_Ensure();}
+        ~ScopedGILAcquire() {PyGILState_Release(state);}
+    private:
+        ScopedGILAcquire(const ScopedGILAcquire&); // not copyable
+        ScopedGILAcquire& operator=(const ScopedGILAcquire&);
+        /// the GIL state saved by the constructor
+        PyGILState_STATE state;
+};
+
+/// \brief a ProgressCallback that calls a Python callable with the fraction done
+///
+/// The GIL is taken for each call, as run() releases it.
+/// An exception raised by the callable is printed and ignored, so it can not stop a run
+/// half-way. A callable that wants the run to stop should cancel a CancelToken.
+class ProgressCallback_py : public ProgressCallback {
+    public:
+        /// call f(fraction)
+        explicit ProgressCallback_py(boost::python::object f) : func(f) {}
+        virtual ~ProgressCallback_py() {
+            ScopedGILAcquire gil; // the last reference may be dropped during run()
+            func = boost::python::object();
+        }
+        void progress(double fraction) {
+            ScopedGILAcquire gil;
+            try {
+                func(fraction);
+            } catch (const boost::python::error_already_set&) {
+                PyErr_Print();
+            }
+        }
+    private:
+        /// the Python callable
+        boost::python::object func;
+};
+
+/// a ProgressCallback for the Python callable f, or none if f is None.
+/// For the setProgressCallback() of the Operation wrappers.
+inline boost::shared_ptr<ProgressCallback> progress_callback_py(boost::python::object f) {
+    if ( f.is_none() )
+        return boost::shared_ptr<ProgressCallback>();
+    return boost::shared_ptr<ProgressCallback>( new ProgressCallback_py(f) );
+}
+
+} // end namespace
+
+#endif
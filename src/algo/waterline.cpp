@@ -21,15 +21,12 @@
 
 #include <boost/foreach.hpp> 
 
-#ifdef _OPENMP
-    #include <omp.h>
-#endif
-
 #include "millingcutter.hpp"
 #include "point.hpp"
 #include "triangle.hpp"
 #include "waterline.hpp"
 #include "batchpushcutter.hpp"
+#include "threadpool.hpp"
 // #include "weave.hpp"
 #include "simple_weave.hpp"
 #include "smart_weave.hpp"
@@ -45,13 +42,8 @@ Waterline::Waterline() {
     subOp.push_back( new BatchPushCutter() );
     subOp[0]->setXDirection();
     subOp[1]->setYDirection();
-    nthreads=1;
-#ifdef _OPENMP
-    nthreads = omp_get_num_procs(); 
-    //omp_set_dynamic(0);
-    omp_set_nested(1);
-#endif
-
+    nthreads = ThreadPool::instance().size();
+    shareRunControl();
 }
 
 Waterline::~Waterline() {
@@ -63,25 +55,35 @@ Waterline::~Waterline() {
 // run the batchpuschutter sub-operations to get x- and y-fibers
 // pass the fibers to weave, and process the weave to get waterline-loops
 void Waterline::run2() {
+    control->begin();
     init_fibers();
+    control->stage( 0.0, 0.45, 1.0 );
     subOp[0]->run(); // these two are independent, so could/should run in parallel
+    control->stage( 0.45, 0.9, 1.0 );
     subOp[1]->run();
     
     xfibers = *( subOp[0]->getFibers() );
     yfibers = *( subOp[1]->getFibers() );
     
-    weave_process2();
+    if ( !control->stopped() ) // no loops from incomplete fibers
+        weave_process2();
+    control->end();
 }
 
 void Waterline::run() {
+    control->begin();
     init_fibers();
+    control->stage( 0.0, 0.45, 1.0 );
     subOp[0]->run(); // these two are independent, so could/should run in parallel
+    control->stage( 0.45, 0.9, 1.0 );
     subOp[1]->run();
     
     xfibers = *( subOp[0]->getFibers() );
     yfibers = *( subOp[1]->getFibers() );
     
-    weave_process();
+    if ( !control->stopped() ) // no loops from incomplete fibers
+        weave_process();
+    control->end();
 }
 
 
@@ -26,6 +26,7 @@
 #include <boost/foreach.hpp>
 
 #include "waterline.hpp"
+#include "operation_py.hpp"
 
 namespace ocl
 {
@@ -37,6 +38,35 @@ class Waterline_py : public Waterline {
         ~Waterline_py() {
             std::cout << "~Waterline_py()\n";
         }
+        /// report the progress of run() to the Python callable f, as f(fraction). None removes it.
+        void setProgressCallback_py(boost::python::object f) {
+            setProgressCallback( progress_callback_py(f) );
+        }
+        /// run() without the GIL, so other Python threads can run
+        void run_py() {
+            ScopedGILRelease nogil;
+            run();
+        }
+        /// run2() without the GIL
+        void run2_py() {
+            ScopedGILRelease nogil;
+            run2();
+        }
+        /// setSTL() without the GIL, as it may build a spatial index. s must not be modified until it returns.
+        void setSTL_py(const STLSurf& s) {
+            ScopedGILRelease nogil;
+            setSTL(s);
+        }
+        /// setCutter() without the GIL, as it may re-build the spatial index
+        void setCutter_py(const MillingCutter* c) {
+            ScopedGILRelease nogil;
+            setCutter(c);
+        }
+        /// loadIndex() without the GIL, as it reads the file. s must not be used until it returns.
+        bool loadIndex_py(const std::string& filename, STLSurf& s) {
+            ScopedGILRelease nogil;
+            return loadIndex(filename, s);
+        }
         /// return loop as a list of lists to python
         boost::python::list py_getLoops() const {
             boost::python::list loop_list;
@@ -0,0 +1,423 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010-2011 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cassert>
+#include <sstream>
+#include <algorithm>
+#include <limits>
+
+#include "bvh.hpp"
+#include "numeric.hpp"
+#include "threadpool.hpp"
+
+namespace ocl
+{
+
+/// the two subtrees of a node are built at the same time, on the ThreadPool, if one has at least this many triangles
+#define PARALLEL_BUILD_SIZE 1024
+/// number of bins for the SAH split rule
+#define SAH_BINS 16
+
+/// builds the first child (part 0) and the second child (part 1) of a node,
+/// with BVH::build_node() or BVH::build_morton_node()
+class BVHBuildTask : public ParallelTask {
+    public:
+        BVHBuildTask(BVH* b, bool m, unsigned int f, unsigned int md, unsigned int l, unsigned int n)
+            : bvh(b), morton(m), first(f), mid(md), last(l), node(n) {}
+        void run(unsigned int k) {
+            const unsigned int f = (k == 0) ? first : mid;
+            const unsigned int l = (k == 0) ? mid : last;
+            const unsigned int n = (k == 0) ? node+1 : node + 2*(mid-first);
+            if ( morton )
+                bvh->build_morton_node(f, l, n);
+            else
+                bvh->build_node(f, l, n);
+        }
+    private:
+        /// the tree
+        BVH* bvh;
+        /// split by Morton codes
+        bool morton;
+        /// start of the first child in the index-array
+        unsigned int first;
+        /// start of the second child
+        unsigned int mid;
+        /// end of the second child
+        unsigned int last;
+        /// the parent node
+        unsigned int node;
+};
+
+/// predicate used to partition the index-array by the bin of the triangle centroid
+class CentroidBinPredicate {
+    public:
+        /// triangles with a centroid in bins [0, s) go first.
+        CentroidBinPredicate(const BVH* b, int a, double cmin, double scale, unsigned int nb, unsigned int s)
+            : bvh(b), axis(a), start(cmin), k(scale), nbins(nb), split(s) {}
+        bool operator()(boost::uint32_t i) const {
+            return bin( bvh_centroid(i) ) < split;
+        }
+        /// the bin of centroid value c
+        unsigned int bin(double c) const {
+            double fb = (c-start)*k;
+            if ( fb <= 0 )
+                return 0;
+            unsigned int b = (unsigned int)fb;
+            return (b < nbins) ? b : nbins-1;
+        }
+    private:
+        /// centroid of triangle i
+        double bvh_centroid(boost::uint32_t i) const;
+        const BVH* bvh;
+        int axis;
+        double start;
+        double k;
+        unsigned int nbins;
+        unsigned int split;
+};
+
+void BVH::build(const std::vector<Triangle>& list) {
+    double t_start = wall_time();
+    nodes.clear();
+    if ( !init_index(list) ) {
+        std::cout << "ERROR: BVH::build() called with an empty list! \n";
+        update_views();
+        return;
+    }
+    axes[0] = dimensions[0];
+    axes[1] = dimensions[2];
+    // the Morton order is of the XY-centres, so it is only used for drop-cutter
+    const bool morton = (presorted != NULL) && usesMortonOrder() && (presorted->size() == index.size());
+    if ( morton ) {
+        for (unsigned int k=0; k<index.size(); ++k)
+            index[k] = (boost::uint32_t) (*presorted)[k];
+    }
+    // as in FlatKDTree::build(), each subtree has its own block of nodes,
+    // so subtrees can be built in parallel
+    std::vector<BVHNode> sparse( 2*index.size()-1 );
+    nodes.swap( sparse );
+    if ( morton )
+        build_morton_node(0, index.size(), 0);
+    else
+        build_node(0, index.size(), 0);
+    nodes.swap( sparse );
+    nodes.reserve( sparse.size() );
+    compact_node(sparse, 0, 0);
+    update_views();
+    buildSeconds = wall_time() - t_start;
+}
+
+double BVH::centroid(unsigned int i, int a) const {
+    const Bbox& bb = tris[i]->bb;
+    return 0.5*( bb[ axes[a] ] + bb[ axes[a]+1 ] );
+}
+
+double CentroidBinPredicate::bvh_centroid(boost::uint32_t i) const {
+    return bvh->centroid(i, axis);
+}
+
+void BVH::build_node(unsigned int first, unsigned int last, unsigned int n) {
+    assert( last > first );
+    BVHNode& node = nodes[n];
+    double cmin[2], cmax[2]; // bounds of the centroids
+    for (int a=0;a<2;++a) {
+        node.bmin[a] = tris[ index[first] ]->bb[ axes[a] ];
+        node.bmax[a] = tris[ index[first] ]->bb[ axes[a]+1 ];
+        cmin[a] = cmax[a] = centroid( index[first], a );
+    }
+    for (unsigned int k=first+1; k<last; ++k) {
+        const Bbox& bb = tris[ index[k] ]->bb;
+        for (int a=0;a<2;++a) {
+            node.bmin[a] = std::min( node.bmin[a], bb[ axes[a] ] );
+            node.bmax[a] = std::max( node.bmax[a], bb[ axes[a]+1 ] );
+            double c = centroid( index[k], a );
+            cmin[a] = std::min( cmin[a], c );
+            cmax[a] = std::max( cmax[a], c );
+        }
+    }
+    if ( (last-first) <= bucketSize ) { // a leaf node
+        node.first = first;
+        node.count = last-first;
+        return;
+    }
+    int axis = ( (cmax[1]-cmin[1]) > (cmax[0]-cmin[0]) ) ? 1 : 0;
+    unsigned int nbins = 2; // midpoint split: two bins, and the split between them
+    unsigned int split = 1;
+    if ( sah ) {
+        nbins = SAH_BINS;
+        if ( !calc_sah_split(first, last, cmin, cmax, axis, split) )
+            split = 0;
+    }
+    unsigned int mid = first;
+    if ( (split > 0) && !isZero_tol( cmax[axis]-cmin[axis] ) ) {
+        CentroidBinPredicate pred(this, axis, cmin[axis], nbins/(cmax[axis]-cmin[axis]), nbins, split);
+        mid = std::stable_partition( index.begin()+first, index.begin()+last, pred ) - index.begin();
+    }
+    if ( (mid == first) || (mid == last) ) // centroids can not be separated, split by position instead
+        mid = first + (last-first)/2;
+    // first child is [first, mid) at n+1, and uses nodes n+1 ... n+2*(mid-first)-1
+    node.second = n + 2*(mid-first);
+    build_children(false, first, mid, last, n);
+}
+
+void BVH::build_children(bool morton, unsigned int first, unsigned int mid, unsigned int last, unsigned int n) {
+    if ( std::max(mid-first, last-mid) >= PARALLEL_BUILD_SIZE ) {
+        BVHBuildTask task(this, morton, first, mid, last, n);
+        ThreadPool::instance().run( task, 2 );
+    } else if ( morton ) {
+        build_morton_node(first, mid, n+1);
+        build_morton_node(mid, last, n + 2*(mid-first));
+    } else {
+        build_node(first, mid, n+1);
+        build_node(mid, last, n + 2*(mid-first));
+    }
+}
+
+// The codes in [first, last) share their bits above the highest bit where the first and
+// last code differ. The first child gets the codes with that bit clear.
+void BVH::build_morton_node(unsigned int first, unsigned int last, unsigned int n) {
+    assert( last > first );
+    BVHNode& node = nodes[n];
+    if ( (last-first) <= bucketSize ) { // a leaf node
+        for (int a=0;a<2;++a) {
+            node.bmin[a] = tris[ index[first] ]->bb[ axes[a] ];
+            node.bmax[a] = tris[ index[first] ]->bb[ axes[a]+1 ];
+        }
+        for (unsigned int k=first+1; k<last; ++k) {
+            const Bbox& bb = tris[ index[k] ]->bb;
+            for (int a=0;a<2;++a) {
+                node.bmin[a] = std::min( node.bmin[a], bb[ axes[a] ] );
+                node.bmax[a] = std::max( node.bmax[a], bb[ axes[a]+1 ] );
+            }
+        }
+        node.first = first;
+        node.count = last-first;
+        return;
+    }
+    const std::vector<boost::uint64_t>& order = *presorted;
+    const boost::uint64_t lo = order[first] >> 32;
+    const boost::uint64_t hi = order[last-1] >> 32;
+    unsigned int mid;
+    if ( lo == hi ) { // equal codes, split by position
+        mid = first + (last-first)/2;
+    } else {
+        int bit = 0;
+        while ( (lo ^ hi) >> (bit+1) )
+            ++bit;
+        const boost::uint64_t prefix = (hi >> bit) << bit; // the lowest code with the bit set
+        mid = std::lower_bound( order.begin()+first, order.begin()+last, prefix << 32 ) - order.begin();
+    }
+    node.second = n + 2*(mid-first);
+    build_children(true, first, mid, last, n);
+    // the box is the union of the boxes of the children
+    const BVHNode& c1 = nodes[n+1];
+    const BVHNode& c2 = nodes[node.second];
+    for (int a=0;a<2;++a) {
+        node.bmin[a] = std::min( c1.bmin[a], c2.bmin[a] );
+        node.bmax[a] = std::max( c1.bmax[a], c2.bmax[a] );
+    }
+}
+
+// Binned SAH, with the same cost model as FlatKDTree::calc_sah_cut():
+// the box of each child is grown by the query size before taking its area.
+bool BVH::calc_sah_split(unsigned int first, unsigned int last, const double* cmin, const double* cmax,
+                         int& axis, unsigned int& split) const {
+    const unsigned int nbins = SAH_BINS;
+    const double q0 = queryExtent[ axes[0]/2 ];
+    const double q1 = queryExtent[ axes[1]/2 ];
+    bool found = false;
+    double best_cost = 0;
+    for (int a=0;a<2;++a) {
+        if ( isZero_tol( cmax[a]-cmin[a] ) )
+            continue;
+        CentroidBinPredicate binner(this, a, cmin[a], nbins/(cmax[a]-cmin[a]), nbins, 0);
+        unsigned int count[SAH_BINS];
+        double bmin0[SAH_BINS], bmax0[SAH_BINS], bmin1[SAH_BINS], bmax1[SAH_BINS];
+        for (unsigned int b=0;b<nbins;++b) {
+            count[b] = 0;
+            bmin0[b] = bmin1[b] = std::numeric_limits<double>::max();
+            bmax0[b] = bmax1[b] = -std::numeric_limits<double>::max();
+        }
+        for (unsigned int k=first; k<last; ++k) {
+            const Bbox& bb = tris[ index[k] ]->bb;
+            unsigned int b = binner.bin( centroid( index[k], a ) );
+            ++count[b];
+            bmin0[b] = std::min( bmin0[b], bb[ axes[0] ] );
+            bmax0[b] = std::max( bmax0[b], bb[ axes[0]+1 ] );
+            bmin1[b] = std::min( bmin1[b], bb[ axes[1] ] );
+            bmax1[b] = std::max( bmax1[b], bb[ axes[1]+1 ] );
+        }
+        // sweep from the top, storing the cost of the second child for each split
+        double hi_cost[SAH_BINS];
+        unsigned int n_hi = 0;
+        double min0 = std::numeric_limits<double>::max(), max0 = -min0, min1 = min0, max1 = -min0;
+        for (unsigned int b=nbins-1; b>0; --b) {
+            n_hi += count[b];
+            min0 = std::min(min0, bmin0[b]); max0 = std::max(max0, bmax0[b]);
+            min1 = std::min(min1, bmin1[b]); max1 = std::max(max1, bmax1[b]);
+            hi_cost[b] = n_hi ? n_hi*(max0-min0+q0)*(max1-min1+q1) : 0;
+        }
+        // sweep from the bottom, and evaluate the split below bin b
+        unsigned int n_lo = 0;
+        min0 = std::numeric_limits<double>::max(); max0 = -min0; min1 = min0; max1 = -min0;
+        for (unsigned int b=1; b<nbins; ++b) {
+            n_lo += count[b-1];
+            min0 = std::min(min0, bmin0[b-1]); max0 = std::max(max0, bmax0[b-1]);
+            min1 = std::min(min1, bmin1[b-1]); max1 = std::max(max1, bmax1[b-1]);
+            if ( (n_lo == 0) || (n_lo == (last-first)) )
+                continue;
+            double cost = n_lo*(max0-min0+q0)*(max1-min1+q1) + hi_cost[b];
+            if ( !found || (cost < best_cost) ) {
+                found = true;
+                best_cost = cost;
+                axis = a;
+                split = b;
+            }
+        }
+    }
+    return found;
+}
+
+void BVH::compact_node(const std::vector<BVHNode>& sparse, unsigned int n, unsigned int dep) {
+    unsigned int idx = nodes.size();
+    nodes.push_back( sparse[n] );
+    if ( sparse[n].isLeaf() ) {
+        ++nLeaves;
+        if (dep > maxDepth)
+            maxDepth = dep;
+        const unsigned int last = sparse[n].first + sparse[n].count;
+        double maxz = tris[ index[ sparse[n].first ] ]->bb.maxpt.z;
+        for (unsigned int k=sparse[n].first+1; k<last; ++k)
+            maxz = std::max( maxz, tris[ index[k] ]->bb.maxpt.z );
+        nodes[idx].maxz = maxz;
+        return;
+    }
+    compact_node(sparse, n+1, dep+1);
+    unsigned int second = nodes.size();
+    nodes[idx].second = second;
+    compact_node(sparse, sparse[n].second, dep+1);
+    nodes[idx].maxz = std::max( nodes[idx+1].maxz, nodes[second].maxz );
+}
+
+void BVH::search(const Bbox& bb, std::vector<IndexSpan>& spans) const {
+    assert( !dimensions.empty() );
+    if ( nNodes == 0 )
+        return;
+    search_node(bb, 0, spans);
+}
+
+void BVH::visit(const Bbox& bb, TriangleVisitor& v) const {
+    assert( !dimensions.empty() );
+    if ( nNodes == 0 )
+        return;
+    visit_node(bb, 0, v);
+}
+
+void BVH::search_node(const Bbox& bb, unsigned int n, std::vector<IndexSpan>& spans) const {
+    const BVHNode& node = nodeData[n];
+    if ( !overlaps(bb, node) )
+        return;
+    if ( node.isLeaf() ) {
+        append_span(spans, node.first, node.first+node.count);
+        return;
+    }
+    search_node(bb, n+1, spans);
+    search_node(bb, node.second, spans);
+}
+
+void BVH::visit_node(const Bbox& bb, unsigned int n, TriangleVisitor& v) const {
+    const BVHNode& node = nodeData[n];
+    if ( !overlaps(bb, node) )
+        return;
+    if ( node.isLeaf() ) {
+        const unsigned int last = node.first+node.count;
+        for (unsigned int k=node.first; k<last; ++k)
+            v.visit( *tris[ indexData[k] ], indexData[k] );
+        return;
+    }
+    visit_node(bb, n+1, v);
+    visit_node(bb, node.second, v);
+}
+
+void BVH::update_views() {
+    SpatialIndex::update_views();
+    nodeData = nodes.empty() ? NULL : &nodes[0];
+    nNodes = nodes.size();
+}
+
+void BVH::save_blocks(std::vector<double>& params, std::vector<FileBlock>& blocks) const {
+    blocks.push_back( FileBlock( nodeData, nNodes*sizeof(BVHNode) ) );
+}
+
+bool BVH::map_blocks(const std::vector<double>& params, const std::vector<FileBlock>& blocks) {
+    nodes.clear();
+    if ( (blocks.size() != 1) || (blocks[0].bytes == 0) || (blocks[0].bytes % sizeof(BVHNode) != 0) )
+        return false;
+    nodeData = (const BVHNode*) blocks[0].data;
+    nNodes = blocks[0].bytes / sizeof(BVHNode);
+    axes[0] = dimensions[0];
+    axes[1] = dimensions[2];
+    for (unsigned int n=0; n<nNodes; ++n) {
+        const BVHNode& node = nodeData[n];
+        if ( node.isLeaf() ) {
+            if ( (node.first > indexLength) || (node.count > indexLength-node.first) )
+                return false;
+        } else if ( (n+1 >= nNodes) || (node.second <= n+1) || (node.second >= nNodes) ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void BVH::visit_above(const Bbox& bb, ZBoundVisitor& v) const {
+    assert( !dimensions.empty() );
+    if ( nNodes == 0 )
+        return;
+    visit_above_node(bb, 0, v);
+}
+
+void BVH::visit_above_node(const Bbox& bb, unsigned int n, ZBoundVisitor& v) const {
+    const BVHNode& node = nodeData[n];
+    if ( (node.maxz <= v.bound()) || !overlaps(bb, node) )
+        return;
+    if ( node.isLeaf() ) {
+        const unsigned int last = node.first+node.count;
+        for (unsigned int k=node.first; k<last; ++k)
+            v.visit( *tris[ indexData[k] ], indexData[k] );
+        return;
+    }
+    if ( nodeData[node.second].maxz > nodeData[n+1].maxz ) {
+        visit_above_node(bb, node.second, v);
+        visit_above_node(bb, n+1, v);
+    } else {
+        visit_above_node(bb, n+1, v);
+        visit_above_node(bb, node.second, v);
+    }
+}
+
+std::string BVH::str() const {
+    std::ostringstream o;
+    o << "BVH(" << stats_str() << ")";
+    return o.str();
+}
+
+} // end ocl namespace
+// end file bvh.cpp
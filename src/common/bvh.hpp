@@ -0,0 +1,143 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010-2011 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BVH_H
+#define BVH_H
+
+#include <string>
+#include <vector>
+
+#include "spatialindex.hpp"
+
+namespace ocl
+{
+
+/// \brief node of a BVH.
+///
+/// Holds the 2D axis-aligned bounding-box, in the search plane, of all triangles below it.
+/// Nodes are stored in depth-first order, so the first child of node n is node n+1.
+class BVHNode {
+    public:
+        /// marks a missing child node
+        static const unsigned int NONE = 0xFFFFFFFF;
+        BVHNode() : maxz(0), second(NONE), first(0), count(0) {
+            bmin[0] = bmin[1] = bmax[0] = bmax[1] = 0;
+        }
+        /// return true if this is a leaf node
+        bool isLeaf() const {return count > 0;}
+        /// minimum coordinates of the box, along the two axes of the search plane
+        double bmin[2];
+        /// maximum coordinates of the box
+        double bmax[2];
+        /// highest z-coordinate of the triangles in the subtree
+        double maxz;
+        /// index of the second child-node. The first child is the next node.
+        unsigned int second;
+        /// for leaf nodes, the first position in the index-array
+        unsigned int first;
+        /// for leaf nodes, the number of triangles (zero for internal nodes)
+        unsigned int count;
+};
+
+/// \brief a bounding volume hierarchy over the triangles of an STLSurf.
+///
+/// Each triangle is in exactly one leaf, and nodes store the 2D box around their
+/// triangles in the search plane (XY for drop-cutter, YZ or XZ for fibers).
+/// Unlike the kd-tree, large triangles do not force cuts through their neighbours,
+/// so a query visits fewer nodes on meshes with a wide range of triangle sizes.
+/// Triangles are split by the centroid of their box, either at the middle of the
+/// largest centroid spread, or with a binned SAH (see setSAH()).
+/// Without SAH, an XY-plane BVH built over an STLSurf is built as a linear BVH, see usesMortonOrder():
+/// the triangles sorted by STLSurf::calcMortonOrder() are split where the highest Morton code bit
+/// changes, and boxes are found bottom-up, so the triangles are neither partitioned nor re-scanned per level.
+class BVH : public SpatialIndex {
+    friend class CentroidBinPredicate;
+    friend class BVHBuildTask;
+    public:
+        BVH() : nodeData(NULL), nNodes(0) {}
+        virtual ~BVH() {}
+        /// build the BVH over the triangles in list.
+        virtual void build(const std::vector<Triangle>& list);
+        /// search for overlap with Bbox bb. IndexSpans for overlapping leaves are appended to spans.
+        virtual void search(const Bbox& bb, std::vector<IndexSpan>& spans) const;
+        /// search for overlap with Bbox bb, and call v.visit() on each found triangle.
+        virtual void visit(const Bbox& bb, TriangleVisitor& v) const;
+        /// like visit(), but the higher child first, and only subtrees above v.bound()
+        virtual void visit_above(const Bbox& bb, ZBoundVisitor& v) const;
+        /// number of nodes in the BVH
+        virtual unsigned int nodeCount() const {return nNodes;}
+        /// returns BVHIndexType
+        virtual SpatialIndexType type() const {return BVHIndexType;}
+        /// true for an XY-plane BVH without SAH, which is built as a linear BVH
+        virtual bool usesMortonOrder() const {return !sah && (dimensions[0] == 0) && (dimensions[2] == 2);}
+        /// string repr
+        virtual std::string str() const;
+
+    protected:
+        /// save the nodes
+        virtual void save_blocks(std::vector<double>& params, std::vector<FileBlock>& blocks) const;
+        /// use mapped nodes
+        virtual bool map_blocks(const std::vector<double>& params, const std::vector<FileBlock>& blocks);
+        /// point nodeData at nodes
+        virtual void update_views();
+        /// build node number n for positions [first, last) of the index-array.
+        /// The subtree uses at most the 2*(last-first)-1 nodes starting at n.
+        void build_node(unsigned int first, unsigned int last, unsigned int n);
+        /// as build_node(), for positions [first, last) of the index-array in the Morton order presorted
+        void build_morton_node(unsigned int first, unsigned int last, unsigned int n);
+        /// build the children [first, mid) and [mid, last) of node n, with build_morton_node() if morton,
+        /// else with build_node(). Large children are built at the same time on the ThreadPool.
+        void build_children(bool morton, unsigned int first, unsigned int mid, unsigned int last, unsigned int n);
+        /// centroid of the box of triangle i along axis a (0 or 1) of the search plane
+        double centroid(unsigned int i, int a) const;
+        /// \brief find the SAH split for positions [first, last).
+        ///
+        /// returns the axis, and the bin above the split, or false if the centroids can not be separated.
+        bool calc_sah_split(unsigned int first, unsigned int last, const double* cmin, const double* cmax,
+                            int& axis, unsigned int& split) const;
+        /// copy the subtree at node n of the sparse build array into nodes, in depth-first order,
+        /// and set maxz.
+        void compact_node(const std::vector<BVHNode>& sparse, unsigned int n, unsigned int dep);
+        /// return true if bb overlaps the box of node
+        inline bool overlaps(const Bbox& bb, const BVHNode& node) const {
+            return ( bb[ axes[0] ]   <= node.bmax[0] ) && ( bb[ axes[0]+1 ] >= node.bmin[0] ) &&
+                   ( bb[ axes[1] ]   <= node.bmax[1] ) && ( bb[ axes[1]+1 ] >= node.bmin[1] );
+        }
+        /// search starting at node n, appending found leaves to spans
+        void search_node(const Bbox& bb, unsigned int n, std::vector<IndexSpan>& spans) const;
+        /// search starting at node n, visiting triangles in found leaves
+        void visit_node(const Bbox& bb, unsigned int n, TriangleVisitor& v) const;
+        /// visit_above() starting at node n
+        void visit_above_node(const Bbox& bb, unsigned int n, ZBoundVisitor& v) const;
+    // DATA
+        /// the nodes, nodes[0] is the root
+        std::vector<BVHNode> nodes;
+        /// the nodes searched, either nodes or an array in the mapped file
+        const BVHNode* nodeData;
+        /// number of nodes in nodeData
+        unsigned int nNodes;
+        /// the two axes of the search plane, as the Bbox::operator[] index of their min coordinate
+        int axes[2];
+};
+
+} // end ocl namespace
+#endif
+// end file bvh.hpp
@@ -0,0 +1,316 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010-2011 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cassert>
+#include <cmath>
+#include <sstream>
+#include <algorithm>
+
+#include "fiberindex.hpp"
+#include "numeric.hpp"
+
+namespace ocl
+{
+
+/// maximum number of slabs in a FiberIndex
+#define FIBER_MAX_SLABS 4096
+/// number of slabs a triangle is listed in, on average
+#define FIBER_SLAB_REFS 4
+/// relative tolerance when comparing query sizes to the build size
+#define FIBER_TOLERANCE 1E-9
+
+FiberIndex::FiberIndex() {
+    for (int a=0;a<2;++a) {
+        axes[a] = 0;
+        extent[a] = 0;
+    }
+    slabOrigin = 0;
+    slabHeight = 1;
+    nSlabs = 0;
+    nodeData = NULL;
+    nNodes = 0;
+    keyData = NULL;
+    rootData = NULL;
+    allFirst = 0;
+}
+
+void FiberIndex::build(const std::vector<Triangle>& list) {
+    double t_start = wall_time();
+    nodes.clear();
+    keys.clear();
+    slabRoot.clear();
+    nSlabs = 0;
+    if ( !init_index(list) ) {
+        std::cout << "ERROR: FiberIndex::build() called with an empty list! \n";
+        update_views();
+        return;
+    }
+    const unsigned int N = tris.size();
+    axes[0] = dimensions[0];
+    axes[1] = dimensions[2];
+    for (int a=0;a<2;++a)
+        extent[a] = queryExtent[ axes[a]/2 ];
+    // the grown triangle boxes along the slab axis
+    double zmin = tris[0]->bb[ axes[1] ] - extent[1];
+    double zmax = tris[0]->bb[ axes[1]+1 ];
+    double height = 0;
+    BOOST_FOREACH(const Triangle* t, tris) {
+        zmin = std::min( zmin, t->bb[ axes[1] ] - extent[1] );
+        zmax = std::max( zmax, t->bb[ axes[1]+1 ] );
+        height += t->bb[ axes[1]+1 ] - t->bb[ axes[1] ] + extent[1];
+    }
+    // slabs a fraction of the average grown triangle, so that most triangles
+    // in the slab of a query also contain the query
+    slabOrigin = zmin;
+    slabHeight = std::max( (zmax-zmin)/FIBER_MAX_SLABS, height/N/FIBER_SLAB_REFS );
+    if ( !(slabHeight > 0) )
+        slabHeight = 1.0;
+    nSlabs = std::max( (unsigned int) ceil( (zmax-zmin)/slabHeight ), 1u );
+    nSlabs = std::min( nSlabs, (unsigned int) FIBER_MAX_SLABS );
+    std::vector< std::vector<boost::uint32_t> > slabs( nSlabs );
+    for (unsigned int i=0; i<N; ++i) {
+        double s0 = floor( (tris[i]->bb[ axes[1] ] - extent[1] - slabOrigin)/slabHeight );
+        double s1 = floor( (tris[i]->bb[ axes[1]+1 ] - slabOrigin)/slabHeight );
+        unsigned int last = std::min( (unsigned int) std::max(s1, 0.0), nSlabs-1 );
+        for (unsigned int s = (unsigned int) std::max(s0, 0.0); s<=last; ++s)
+            slabs[s].push_back(i);
+    }
+    // the interval trees use the index-array from the start, so clear the identity
+    // from init_index(). All triangles are listed once at the end, for too wide queries.
+    index.clear();
+    nLeaves = 0;
+    maxDepth = 0;
+    slabRoot.assign( nSlabs, FiberNode::NONE );
+    for (unsigned int s=0; s<nSlabs; ++s) {
+        if ( !slabs[s].empty() ) {
+            slabRoot[s] = build_tree( slabs[s], 0 );
+            ++nLeaves;
+        }
+    }
+    allFirst = index.size();
+    for (unsigned int i=0; i<N; ++i) {
+        index.push_back(i);
+        keys.push_back(0);
+    }
+    update_views();
+    buildSeconds = wall_time() - t_start;
+}
+
+unsigned int FiberIndex::build_tree(std::vector<boost::uint32_t>& ids, unsigned int dep) {
+    if ( ids.empty() )
+        return FiberNode::NONE;
+    if (dep > maxDepth)
+        maxDepth = dep;
+    // center at the median interval midpoint, so the node holds at least that interval
+    std::vector<double> mids;
+    mids.reserve( ids.size() );
+    BOOST_FOREACH(boost::uint32_t i, ids)
+        mids.push_back( 0.5*( low(i) + high(i) ) );
+    std::nth_element( mids.begin(), mids.begin() + mids.size()/2, mids.end() );
+    const double center = mids[ mids.size()/2 ];
+    std::vector< std::pair<double, boost::uint32_t> > byLow, byHigh;
+    std::vector<boost::uint32_t> below, above;
+    BOOST_FOREACH(boost::uint32_t i, ids) {
+        if ( high(i) < center ) {
+            below.push_back(i);
+        } else if ( low(i) > center ) {
+            above.push_back(i);
+        } else {
+            byLow.push_back( std::make_pair( low(i), i ) );
+            byHigh.push_back( std::make_pair( -high(i), i ) );
+        }
+    }
+    std::vector<boost::uint32_t>().swap(ids); // free memory before recursion
+    std::sort( byLow.begin(), byLow.end() );
+    std::sort( byHigh.begin(), byHigh.end() );
+    unsigned int n = nodes.size();
+    nodes.push_back( FiberNode() );
+    nodes[n].center = center;
+    nodes[n].first = index.size();
+    nodes[n].count = byLow.size();
+    for (unsigned int k=0; k<byLow.size(); ++k) {
+        index.push_back( byLow[k].second );
+        keys.push_back( byLow[k].first );
+    }
+    for (unsigned int k=0; k<byHigh.size(); ++k) {
+        index.push_back( byHigh[k].second );
+        keys.push_back( -byHigh[k].first );
+    }
+    unsigned int left = build_tree( below, dep+1 );
+    unsigned int right = build_tree( above, dep+1 );
+    nodes[n].left = left;
+    nodes[n].right = right;
+    return n;
+}
+
+bool FiberIndex::too_wide(const Bbox& bb) const {
+    for (int a=0;a<2;++a) {
+        if ( bb[ axes[a]+1 ] - bb[ axes[a] ] > extent[a] + FIBER_TOLERANCE*std::max(1.0, extent[a]) )
+            return true;
+    }
+    return false;
+}
+
+void FiberIndex::query(const Bbox& bb, std::vector<IndexSpan>* spans, TriangleVisitor* v) const {
+    if ( rootData == NULL )
+        return;
+    if ( too_wide(bb) ) { // test all triangles
+        for (unsigned int k=allFirst; k<indexLength; ++k) {
+            if ( overlaps(bb, indexData[k]) ) {
+                if (v)
+                    v->visit( *tris[ indexData[k] ], indexData[k] );
+                else
+                    append_span(*spans, k, k+1);
+            }
+        }
+        return;
+    }
+    // the low corner of the query is inside the grown box of each triangle it overlaps
+    const double p0 = bb[ axes[0] ];
+    const double p1 = bb[ axes[1] ];
+    double s = floor( (p1 - slabOrigin)/slabHeight );
+    if ( (s < 0) || (p1 > slabOrigin + nSlabs*slabHeight) )
+        return;
+    unsigned int n = rootData[ std::min( (unsigned int) s, nSlabs-1 ) ];
+    while ( n != FiberNode::NONE ) {
+        const FiberNode& node = nodeData[n];
+        unsigned int k, last;
+        if ( p0 < node.center ) { // the intervals of node contain p0 if they start below it
+            last = node.first + node.count;
+            for (k=node.first; (k<last) && (keyData[k] <= p0); ++k) {
+                if ( overlaps(bb, indexData[k]) ) {
+                    if (v)
+                        v->visit( *tris[ indexData[k] ], indexData[k] );
+                    else
+                        append_span(*spans, k, k+1);
+                }
+            }
+            n = node.left;
+        } else { // or if they end above it
+            last = node.first + 2*node.count;
+            for (k=node.first+node.count; (k<last) && (keyData[k] >= p0); ++k) {
+                if ( overlaps(bb, indexData[k]) ) {
+                    if (v)
+                        v->visit( *tris[ indexData[k] ], indexData[k] );
+                    else
+                        append_span(*spans, k, k+1);
+                }
+            }
+            n = node.right;
+        }
+    }
+}
+
+void FiberIndex::search(const Bbox& bb, std::vector<IndexSpan>& spans) const {
+    assert( !dimensions.empty() );
+    query(bb, &spans, NULL);
+}
+
+void FiberIndex::visit(const Bbox& bb, TriangleVisitor& v) const {
+    assert( !dimensions.empty() );
+    query(bb, NULL, &v);
+}
+
+bool FiberIndex::fitsCutter(double radius, double length) const {
+    if ( rootData == NULL )
+        return false;
+    for (int a=0;a<2;++a) {
+        double q = (axes[a] == 4) ? length : 2*radius;
+        if ( fabs( q - extent[a] ) > FIBER_TOLERANCE*std::max(1.0, q) )
+            return false;
+    }
+    return true;
+}
+
+void FiberIndex::update_views() {
+    SpatialIndex::update_views();
+    nodeData = nodes.empty() ? NULL : &nodes[0];
+    nNodes = nodes.size();
+    keyData = keys.empty() ? NULL : &keys[0];
+    rootData = slabRoot.empty() ? NULL : &slabRoot[0];
+}
+
+void FiberIndex::save_blocks(std::vector<double>& params, std::vector<FileBlock>& blocks) const {
+    for (int a=0;a<2;++a) {
+        params.push_back( axes[a] );
+        params.push_back( extent[a] );
+    }
+    params.push_back( slabOrigin );
+    params.push_back( slabHeight );
+    params.push_back( nSlabs );
+    params.push_back( allFirst );
+    blocks.push_back( FileBlock( nodeData, nNodes*sizeof(FiberNode) ) );
+    blocks.push_back( FileBlock( keyData, indexLength*sizeof(double) ) );
+    blocks.push_back( FileBlock( rootData, nSlabs*sizeof(boost::uint32_t) ) );
+}
+
+bool FiberIndex::map_blocks(const std::vector<double>& params, const std::vector<FileBlock>& blocks) {
+    nodes.clear();
+    keys.clear();
+    slabRoot.clear();
+    if ( (params.size() != 8) || (blocks.size() != 3) )
+        return false;
+    for (int a=0;a<2;++a) {
+        axes[a] = (int) params[2*a];
+        extent[a] = params[2*a+1];
+        if ( axes[a] != dimensions[2*a] )
+            return false;
+    }
+    slabOrigin = params[4];
+    slabHeight = params[5];
+    nSlabs = (unsigned int) params[6];
+    allFirst = (unsigned int) params[7];
+    if ( !(slabHeight > 0) || (nSlabs == 0) || (allFirst > indexLength) )
+        return false;
+    if ( (blocks[0].bytes % sizeof(FiberNode) != 0) || (blocks[1].bytes != indexLength*sizeof(double)) ||
+         (blocks[2].bytes != nSlabs*sizeof(boost::uint32_t)) )
+        return false;
+    nodeData = (const FiberNode*) blocks[0].data;
+    nNodes = blocks[0].bytes / sizeof(FiberNode);
+    keyData = (const double*) blocks[1].data;
+    rootData = (const boost::uint32_t*) blocks[2].data;
+    // children are built after their parent
+    for (unsigned int n=0; n<nNodes; ++n) {
+        const FiberNode& node = nodeData[n];
+        if ( (node.first > allFirst) || (node.count > (allFirst-node.first)/2) )
+            return false;
+        if ( (node.left != FiberNode::NONE) && ((node.left <= n) || (node.left >= nNodes)) )
+            return false;
+        if ( (node.right != FiberNode::NONE) && ((node.right <= n) || (node.right >= nNodes)) )
+            return false;
+    }
+    for (unsigned int s=0; s<nSlabs; ++s) {
+        if ( (rootData[s] != FiberNode::NONE) && (rootData[s] >= nNodes) )
+            return false;
+    }
+    return true;
+}
+
+std::string FiberIndex::str() const {
+    std::ostringstream o;
+    o << "FiberIndex(N=" << tris.size() << ", slabs=" << nSlabs << ", slab height=" << slabHeight;
+    o << ", trees=" << nLeaves << ", nodes=" << nNodes << ", refs=" << allFirst/2 << ", depth=" << maxDepth;
+    o << (isMapped() ? ", load time=" : ", build time=") << buildSeconds << " s)";
+    return o.str();
+}
+
+} // end ocl namespace
+// end file fiberindex.cpp
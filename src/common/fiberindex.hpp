@@ -0,0 +1,139 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010-2011 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FIBER_INDEX_H
+#define FIBER_INDEX_H
+
+#include <string>
+#include <vector>
+
+#include "spatialindex.hpp"
+
+namespace ocl
+{
+
+/// \brief node of a centered interval tree in a FiberIndex.
+///
+/// Holds the intervals that contain center, stored twice at positions
+/// [first, first+count) sorted by increasing low end, and at
+/// [first+count, first+2*count) sorted by decreasing high end.
+class FiberNode {
+    public:
+        /// marks a missing child node
+        static const unsigned int NONE = 0xFFFFFFFF;
+        FiberNode() : center(0), left(NONE), right(NONE), first(0), count(0) {}
+        /// intervals of this node contain center
+        double center;
+        /// child node with the intervals entirely below center, or NONE
+        unsigned int left;
+        /// child node with the intervals entirely above center, or NONE
+        unsigned int right;
+        /// the first position in the index-array
+        unsigned int first;
+        /// number of intervals in the node
+        unsigned int count;
+};
+
+/// \brief a stabbing-query index for push-cutter fibers.
+///
+/// A fiber query is a box of fixed size (the cutter) moved along a line. Each
+/// triangle is grown on its low side by the query size (see setCutterSize()), so
+/// that the query box overlaps the triangle exactly when the low corner of the
+/// query is inside the grown triangle box. The query becomes a 2D point query.
+/// The second search axis (z, for fibers) is cut into slabs, and each slab
+/// holds a centered interval tree over the first axis (y for x-fibers, x for y-fibers).
+/// Found triangles are checked against the exact query box before they are visited.
+/// Queries larger than the build size fall back to testing all triangles,
+/// see fitsCutter().
+class FiberIndex : public SpatialIndex {
+    public:
+        FiberIndex();
+        virtual ~FiberIndex() {}
+        /// build the slabs and interval trees over the triangles in list.
+        virtual void build(const std::vector<Triangle>& list);
+        /// search for overlap with Bbox bb. Each found triangle is appended to spans.
+        virtual void search(const Bbox& bb, std::vector<IndexSpan>& spans) const;
+        /// search for overlap with Bbox bb, and call v.visit() on each found triangle.
+        virtual void visit(const Bbox& bb, TriangleVisitor& v) const;
+        /// true if the index was built for this cutter size
+        virtual bool fitsCutter(double radius, double length) const;
+        /// number of interval tree nodes
+        virtual unsigned int nodeCount() const {return nNodes;}
+        /// returns FiberIndexType
+        virtual SpatialIndexType type() const {return FiberIndexType;}
+        /// string repr
+        virtual std::string str() const;
+
+    protected:
+        /// save the slab parameters, nodes, keys and slab roots
+        virtual void save_blocks(std::vector<double>& params, std::vector<FileBlock>& blocks) const;
+        /// use mapped nodes, keys and slab roots
+        virtual bool map_blocks(const std::vector<double>& params, const std::vector<FileBlock>& blocks);
+        /// point nodeData, keyData and rootData at the built arrays
+        virtual void update_views();
+        /// low end of the grown interval of triangle i along the first axis
+        inline double low(boost::uint32_t i) const {return tris[i]->bb[ axes[0] ] - extent[0];}
+        /// high end of the interval of triangle i along the first axis
+        inline double high(boost::uint32_t i) const {return tris[i]->bb[ axes[0]+1 ];}
+        /// build an interval tree over the triangles ids, at depth dep. returns the root node.
+        unsigned int build_tree(std::vector<boost::uint32_t>& ids, unsigned int dep);
+        /// return true if the query is wider than the build size along an axis
+        bool too_wide(const Bbox& bb) const;
+        /// return true if triangle i overlaps bb along both axes
+        inline bool overlaps(const Bbox& bb, boost::uint32_t i) const {
+            const Bbox& tb = tris[i]->bb;
+            return ( tb[ axes[0] ] <= bb[ axes[0]+1 ] ) && ( tb[ axes[0]+1 ] >= bb[ axes[0] ] ) &&
+                   ( tb[ axes[1] ] <= bb[ axes[1]+1 ] ) && ( tb[ axes[1]+1 ] >= bb[ axes[1] ] );
+        }
+        /// find the triangles overlapping bb. Appends them to spans, or if v is not NULL, visits them.
+        void query(const Bbox& bb, std::vector<IndexSpan>* spans, TriangleVisitor* v) const;
+    // DATA
+        /// the two axes, as the Bbox::operator[] index of their min coordinate. Slabs are along axes[1].
+        int axes[2];
+        /// query extent along the two axes, at build time
+        double extent[2];
+        /// low end of the first slab
+        double slabOrigin;
+        /// height of a slab
+        double slabHeight;
+        /// number of slabs
+        unsigned int nSlabs;
+        /// the interval tree nodes of all slabs
+        std::vector<FiberNode> nodes;
+        /// keys[pos] is the sort key of the interval at position pos of the index-array
+        std::vector<double> keys;
+        /// root node of each slab's tree, or FiberNode::NONE for an empty slab
+        std::vector<boost::uint32_t> slabRoot;
+        /// the nodes searched, either nodes or an array in the mapped file
+        const FiberNode* nodeData;
+        /// number of nodes in nodeData
+        unsigned int nNodes;
+        /// the keys searched
+        const double* keyData;
+        /// the slab roots searched
+        const boost::uint32_t* rootData;
+        /// positions [allFirst, indexLength) of the index-array list each triangle once
+        unsigned int allFirst;
+};
+
+} // end ocl namespace
+#endif
+// end file fiberindex.hpp
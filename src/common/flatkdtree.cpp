@@ -0,0 +1,434 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010-2011 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cassert>
+#include <cmath>
+#include <sstream>
+#include <algorithm>
+#include <limits>
+
+#include "flatkdtree.hpp"
+#include "numeric.hpp"
+#include "threadpool.hpp"
+
+namespace ocl
+{
+
+/// the two subtrees of a node are built at the same time, on the ThreadPool, if one has at least this many triangles
+#define PARALLEL_BUILD_SIZE 1024
+/// number of bins for the SAH split rule
+#define SAH_BINS 16
+
+/// predicate used to partition the index-array around a cut value
+class CutPredicate {
+    public:
+        CutPredicate(const std::vector<const Triangle*>& t, int d, double cv) : tris(t), dim(d), cutval(cv) {}
+        /// true for triangles that go into the hi child
+        bool operator()(boost::uint32_t i) const { return (tris[i]->bb[dim] > cutval); }
+    private:
+        const std::vector<const Triangle*>& tris;
+        int dim;
+        double cutval;
+};
+
+/// builds the hi child (part 0) and the lo child (part 1) of a node, see FlatKDTree::build_node()
+class FlatKDBuildTask : public ParallelTask {
+    public:
+        FlatKDBuildTask(FlatKDTree* t, unsigned int f, unsigned int m, unsigned int l, unsigned int n)
+            : tree(t), first(f), mid(m), last(l), node(n) {}
+        void run(unsigned int k) {
+            if ( k == 0 )
+                tree->build_node(first, mid, node+1);
+            else
+                tree->build_node(mid, last, node + 2*(mid-first));
+        }
+    private:
+        /// the tree
+        FlatKDTree* tree;
+        /// start of the hi child in the index-array
+        unsigned int first;
+        /// start of the lo child
+        unsigned int mid;
+        /// end of the lo child
+        unsigned int last;
+        /// the parent node
+        unsigned int node;
+};
+
+void FlatKDTree::build(const std::vector<Triangle>& list) {
+    double t_start = wall_time();
+    nodes.clear();
+    if ( !init_index(list) ) {
+        std::cout << "ERROR: FlatKDTree::build() called with an empty list! \n";
+        update_views();
+        return;
+    }
+    // A subtree over m triangles has at most 2*m-1 nodes. build_node() gives each subtree
+    // its own block of that size, so that subtrees can be built in parallel without
+    // locking, and with the same result as a serial build.
+    std::vector<FlatKDNode> sparse( 2*index.size()-1 );
+    nodes.swap( sparse );
+    build_node(0, index.size(), 0);
+    // remove the unused nodes, and collect statistics
+    nodes.swap( sparse );
+    nodes.reserve( sparse.size() );
+    compact_node(sparse, 0, 0);
+    update_views();
+    buildSeconds = wall_time() - t_start;
+}
+
+void FlatKDTree::build_node(unsigned int first, unsigned int last, unsigned int n) {
+    assert( last > first );
+    int dim;
+    double val, start;
+    calc_spread(first, last, dim, val, start);
+    double cutvalue = start + val/2; // cut in the middle
+    FlatKDNode& node = nodes[n];
+    node.dim = dim;
+    node.cutval = cutvalue;
+    if ( ((last-first) <= bucketSize) || isZero_tol( val ) ) { // a bucket/leaf node
+        node.first = first;
+        node.count = last-first;
+        return;
+    }
+    unsigned int mid = last;
+    if ( sah && calc_sah_cut(first, last, dim, cutvalue) ) {
+        mid = partition(first, last, dim, cutvalue);
+        if ( (mid == first) || (mid == last) ) { // the binned estimate was off, cut in the middle instead
+            calc_spread(first, last, dim, val, start);
+            cutvalue = start + val/2;
+            mid = last;
+        }
+    }
+    if ( mid == last )
+        mid = partition(first, last, dim, cutvalue);
+    node.dim = dim;
+    node.cutval = cutvalue;
+    // hi child is [first, mid) and lo child is [mid, last).
+    // the hi subtree uses nodes n+1 ... n+2*(mid-first)-1, and the lo subtree follows.
+    if (mid > first)
+        node.hi = n+1;
+    if (last > mid)
+        node.lo = n + 2*(mid-first);
+    if ( (mid > first) && (last > mid) && ( std::max(mid-first, last-mid) >= PARALLEL_BUILD_SIZE ) ) {
+        FlatKDBuildTask task(this, first, mid, last, n);
+        ThreadPool::instance().run( task, 2 );
+        return;
+    }
+    if (mid > first)
+        build_node(first, mid, n+1);
+    if (last > mid)
+        build_node(mid, last, n + 2*(mid-first));
+}
+
+unsigned int FlatKDTree::partition(unsigned int first, unsigned int last, int dim, double cutval) {
+    // a stable partition keeps the surface order within each bucket, so triangles
+    // are found in the same order as with KDTree<Triangle>
+    std::vector<boost::uint32_t>::iterator mid_it;
+    mid_it = std::stable_partition( index.begin()+first, index.begin()+last, CutPredicate(tris, dim, cutval) );
+    return mid_it - index.begin();
+}
+
+unsigned int FlatKDTree::compact_node(const std::vector<FlatKDNode>& sparse, unsigned int n, unsigned int dep) {
+    unsigned int idx = nodes.size();
+    nodes.push_back( sparse[n] );
+    if ( sparse[n].isLeaf() ) {
+        ++nLeaves;
+        if (dep > maxDepth)
+            maxDepth = dep;
+        const unsigned int last = sparse[n].first + sparse[n].count;
+        double maxz = tris[ index[ sparse[n].first ] ]->bb.maxpt.z;
+        for (unsigned int k=sparse[n].first+1; k<last; ++k)
+            maxz = std::max( maxz, tris[ index[k] ]->bb.maxpt.z );
+        nodes[idx].maxz = maxz;
+        return idx;
+    }
+    unsigned int hi = FlatKDNode::NONE;
+    unsigned int lo = FlatKDNode::NONE;
+    if ( sparse[n].hi != FlatKDNode::NONE )
+        hi = compact_node(sparse, sparse[n].hi, dep+1);
+    if ( sparse[n].lo != FlatKDNode::NONE )
+        lo = compact_node(sparse, sparse[n].lo, dep+1);
+    nodes[idx].hi = hi;
+    nodes[idx].lo = lo;
+    if ( (hi != FlatKDNode::NONE) && (lo != FlatKDNode::NONE) )
+        nodes[idx].maxz = std::max( nodes[hi].maxz, nodes[lo].maxz );
+    else
+        nodes[idx].maxz = nodes[ (hi != FlatKDNode::NONE) ? hi : lo ].maxz;
+    return idx;
+}
+
+void FlatKDTree::calc_spread(unsigned int first, unsigned int last, int& dim, double& val, double& start) const {
+    double maxval[6];
+    double minval[6];
+    for (unsigned int m=0;m<dimensions.size();++m) {
+        maxval[ dimensions[m] ] = tris[ index[first] ]->bb[ dimensions[m] ];
+        minval[ dimensions[m] ] = maxval[ dimensions[m] ];
+    }
+    for (unsigned int k=first+1; k<last; ++k) {
+        const Bbox& bb = tris[ index[k] ]->bb;
+        for (unsigned int m=0;m<dimensions.size();++m) {
+            const double v = bb[ dimensions[m] ];
+            if ( maxval[ dimensions[m] ] < v )
+                maxval[ dimensions[m] ] = v;
+            if ( minval[ dimensions[m] ] > v )
+                minval[ dimensions[m] ] = v;
+        }
+    }
+    // select the biggest spread
+    dim = dimensions[0];
+    val = maxval[dim]-minval[dim];
+    start = minval[dim];
+    for (unsigned int m=1;m<dimensions.size();++m) {
+        const int d = dimensions[m];
+        if ( (maxval[d]-minval[d]) > val ) {
+            dim = d;
+            val = maxval[d]-minval[d];
+            start = minval[d];
+        }
+    }
+}
+
+// Binned SAH. For a kd-tree searched with boxes of size q, a node whose triangles
+// span the rectangle w*h in the search plane is visited by a query at a random
+// position with probability proportional to (w+qw)*(h+qh). The expected cost of a
+// cut is then the sum of this area times the number of triangles, over both children.
+bool FlatKDTree::calc_sah_cut(unsigned int first, unsigned int last, int& dim, double& cutval) const {
+    const unsigned int nbins = SAH_BINS;
+    // the search plane has two axes, given by dimensions[0..1] and dimensions[2..3]
+    const int a0 = dimensions[0];
+    const int a1 = dimensions[2];
+    const double q0 = queryExtent[a0/2];
+    const double q1 = queryExtent[a1/2];
+    double minval[6];
+    double maxval[6];
+    for (unsigned int m=0;m<dimensions.size();++m) {
+        minval[ dimensions[m] ] = tris[ index[first] ]->bb[ dimensions[m] ];
+        maxval[ dimensions[m] ] = minval[ dimensions[m] ];
+    }
+    for (unsigned int k=first+1; k<last; ++k) {
+        const Bbox& bb = tris[ index[k] ]->bb;
+        for (unsigned int m=0;m<dimensions.size();++m) {
+            const double v = bb[ dimensions[m] ];
+            if ( v < minval[ dimensions[m] ] )
+                minval[ dimensions[m] ] = v;
+            if ( v > maxval[ dimensions[m] ] )
+                maxval[ dimensions[m] ] = v;
+        }
+    }
+    bool found = false;
+    double best_cost = 0;
+    for (unsigned int m=0;m<dimensions.size();++m) {
+        const int d = dimensions[m];
+        const double width = (maxval[d]-minval[d])/nbins;
+        if ( isZero_tol( width ) )
+            continue;
+        // per bin: triangle count, and the extent of the triangles in the search plane
+        unsigned int count[SAH_BINS];
+        double bmin0[SAH_BINS], bmax0[SAH_BINS], bmin1[SAH_BINS], bmax1[SAH_BINS];
+        for (unsigned int b=0;b<nbins;++b) {
+            count[b] = 0;
+            bmin0[b] = bmin1[b] = std::numeric_limits<double>::max();
+            bmax0[b] = bmax1[b] = -std::numeric_limits<double>::max();
+        }
+        for (unsigned int k=first; k<last; ++k) {
+            const Bbox& bb = tris[ index[k] ]->bb;
+            // bin b holds values in ( minval+b*width, minval+(b+1)*width ]
+            double fb = ceil( (bb[d]-minval[d])/width ) - 1;
+            unsigned int b = 0;
+            if ( fb > 0 )
+                b = (fb < nbins) ? (unsigned int)fb : nbins-1;
+            ++count[b];
+            bmin0[b] = std::min( bmin0[b], bb[a0] );
+            bmax0[b] = std::max( bmax0[b], bb[a0+1] );
+            bmin1[b] = std::min( bmin1[b], bb[a1] );
+            bmax1[b] = std::max( bmax1[b], bb[a1+1] );
+        }
+        // sweep from the top, storing the cost of the hi side for each cut
+        double hi_cost[SAH_BINS];
+        unsigned int n_hi = 0;
+        double min0 = std::numeric_limits<double>::max(), max0 = -min0, min1 = min0, max1 = -min0;
+        for (unsigned int b=nbins-1; b>0; --b) {
+            n_hi += count[b];
+            min0 = std::min(min0, bmin0[b]); max0 = std::max(max0, bmax0[b]);
+            min1 = std::min(min1, bmin1[b]); max1 = std::max(max1, bmax1[b]);
+            hi_cost[b] = n_hi ? n_hi*(max0-min0+q0)*(max1-min1+q1) : 0;
+        }
+        // sweep from the bottom, and evaluate the cut below bin b
+        unsigned int n_lo = 0;
+        min0 = std::numeric_limits<double>::max(); max0 = -min0; min1 = min0; max1 = -min0;
+        for (unsigned int b=1; b<nbins; ++b) {
+            n_lo += count[b-1];
+            min0 = std::min(min0, bmin0[b-1]); max0 = std::max(max0, bmax0[b-1]);
+            min1 = std::min(min1, bmin1[b-1]); max1 = std::max(max1, bmax1[b-1]);
+            if ( (n_lo == 0) || (n_lo == (last-first)) )
+                continue; // does not separate anything
+            double cost = n_lo*(max0-min0+q0)*(max1-min1+q1) + hi_cost[b];
+            if ( !found || (cost < best_cost) ) {
+                found = true;
+                best_cost = cost;
+                dim = d;
+                cutval = minval[d] + b*width;
+            }
+        }
+    }
+    return found;
+}
+
+void FlatKDTree::search(const Bbox& bb, std::vector<IndexSpan>& spans) const {
+    assert( !dimensions.empty() );
+    if ( nNodes == 0 )
+        return;
+    search_node(bb, 0, spans);
+}
+
+void FlatKDTree::visit(const Bbox& bb, TriangleVisitor& v) const {
+    assert( !dimensions.empty() );
+    if ( nNodes == 0 )
+        return;
+    visit_node(bb, 0, v);
+}
+
+// same traversal as KDTree::search_node(). The hi child is stored first in the
+// index-array, so the spans come out in order and adjacent buckets merge.
+void FlatKDTree::search_node(const Bbox& bb, unsigned int n, std::vector<IndexSpan>& spans) const {
+    const FlatKDNode& node = nodeData[n];
+    if ( node.isLeaf() ) {
+        append_span(spans, node.first, node.first+node.count);
+        return;
+    }
+    bool search_lo = true;
+    bool search_hi = true;
+    if ( (node.dim % 2) == 0 ) { // cutting along a min-direction: 0, 2, 4
+        if ( node.cutval > bb[node.dim+1] ) // search only lo
+            search_hi = false;
+    } else { // cutting along a max-dimension: 1,3,5
+        if ( node.cutval < bb[node.dim-1] ) // search only hi
+            search_lo = false;
+    }
+    if ( search_hi && (node.hi != FlatKDNode::NONE) )
+        search_node(bb, node.hi, spans);
+    if ( search_lo && (node.lo != FlatKDNode::NONE) )
+        search_node(bb, node.lo, spans);
+}
+
+// same traversal as search_node(), but calls the visitor directly
+void FlatKDTree::visit_node(const Bbox& bb, unsigned int n, TriangleVisitor& v) const {
+    const FlatKDNode& node = nodeData[n];
+    if ( node.isLeaf() ) {
+        const unsigned int last = node.first+node.count;
+        for (unsigned int k=node.first; k<last; ++k)
+            v.visit( *tris[ indexData[k] ], indexData[k] );
+        return;
+    }
+    bool search_lo = true;
+    bool search_hi = true;
+    if ( (node.dim % 2) == 0 ) {
+        if ( node.cutval > bb[node.dim+1] )
+            search_hi = false;
+    } else {
+        if ( node.cutval < bb[node.dim-1] )
+            search_lo = false;
+    }
+    if ( search_hi && (node.hi != FlatKDNode::NONE) )
+        visit_node(bb, node.hi, v);
+    if ( search_lo && (node.lo != FlatKDNode::NONE) )
+        visit_node(bb, node.lo, v);
+}
+
+void FlatKDTree::update_views() {
+    SpatialIndex::update_views();
+    nodeData = nodes.empty() ? NULL : &nodes[0];
+    nNodes = nodes.size();
+}
+
+void FlatKDTree::save_blocks(std::vector<double>& params, std::vector<FileBlock>& blocks) const {
+    blocks.push_back( FileBlock( nodeData, nNodes*sizeof(FlatKDNode) ) );
+}
+
+bool FlatKDTree::map_blocks(const std::vector<double>& params, const std::vector<FileBlock>& blocks) {
+    nodes.clear();
+    if ( (blocks.size() != 1) || (blocks[0].bytes == 0) || (blocks[0].bytes % sizeof(FlatKDNode) != 0) )
+        return false;
+    nodeData = (const FlatKDNode*) blocks[0].data;
+    nNodes = blocks[0].bytes / sizeof(FlatKDNode);
+    // nodes are in depth-first order, so children come after their parent
+    for (unsigned int n=0; n<nNodes; ++n) {
+        const FlatKDNode& node = nodeData[n];
+        if ( node.isLeaf() ) {
+            if ( (node.first > indexLength) || (node.count > indexLength-node.first) )
+                return false;
+        } else {
+            if ( (node.dim < 0) || (node.dim > 5) )
+                return false;
+            if ( (node.hi != FlatKDNode::NONE) && ((node.hi <= n) || (node.hi >= nNodes)) )
+                return false;
+            if ( (node.lo != FlatKDNode::NONE) && ((node.lo <= n) || (node.lo >= nNodes)) )
+                return false;
+        }
+    }
+    return true;
+}
+
+void FlatKDTree::visit_above(const Bbox& bb, ZBoundVisitor& v) const {
+    assert( !dimensions.empty() );
+    if ( nNodes == 0 )
+        return;
+    visit_above_node(bb, 0, v);
+}
+
+// same as visit_node(), but the child with the higher maxz goes first, and
+// subtrees entirely at or below the bound are skipped
+void FlatKDTree::visit_above_node(const Bbox& bb, unsigned int n, ZBoundVisitor& v) const {
+    const FlatKDNode& node = nodeData[n];
+    if ( node.maxz <= v.bound() )
+        return;
+    if ( node.isLeaf() ) {
+        const unsigned int last = node.first+node.count;
+        for (unsigned int k=node.first; k<last; ++k)
+            v.visit( *tris[ indexData[k] ], indexData[k] );
+        return;
+    }
+    unsigned int first = node.hi;
+    unsigned int second = node.lo;
+    if ( (node.dim % 2) == 0 ) {
+        if ( node.cutval > bb[node.dim+1] )
+            first = FlatKDNode::NONE;
+    } else {
+        if ( node.cutval < bb[node.dim-1] )
+            second = FlatKDNode::NONE;
+    }
+    if ( (first != FlatKDNode::NONE) && (second != FlatKDNode::NONE) && (nodeData[second].maxz > nodeData[first].maxz) )
+        std::swap(first, second);
+    if ( first != FlatKDNode::NONE )
+        visit_above_node(bb, first, v);
+    if ( second != FlatKDNode::NONE )
+        visit_above_node(bb, second, v);
+}
+
+std::string FlatKDTree::str() const {
+    std::ostringstream o;
+    o << "FlatKDTree(" << stats_str() << ")";
+    return o.str();
+}
+
+} // end ocl namespace
+// end file flatkdtree.cpp
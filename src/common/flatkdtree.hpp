@@ -0,0 +1,125 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010-2011 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FLAT_KDTREE_H
+#define FLAT_KDTREE_H
+
+#include <string>
+#include <vector>
+
+#include "spatialindex.hpp"
+
+namespace ocl
+{
+
+/// \brief node of a FlatKDTree.
+///
+/// Nodes are stored by value in one std::vector and refer to their children
+/// by index. A leaf (bucket) node refers to a range of the index-array.
+class FlatKDNode {
+    public:
+        /// marks a missing child node
+        static const unsigned int NONE = 0xFFFFFFFF;
+        FlatKDNode() : dim(0), cutval(0), maxz(0), hi(NONE), lo(NONE), first(0), count(0) {}
+        /// return true if this is a leaf/bucket node
+        bool isLeaf() const {return count > 0;}
+        /// dimension of cut, an index into Bbox::operator[]
+        int dim;
+        /// Cut value. Child node hi contains triangles with a higher value than this.
+        double cutval;
+        /// highest z-coordinate of the triangles in the subtree
+        double maxz;
+        /// index of hi child-node, or NONE
+        unsigned int hi;
+        /// index of lo child-node, or NONE
+        unsigned int lo;
+        /// for leaf nodes, the first position in the index-array
+        unsigned int first;
+        /// for leaf nodes, the number of triangles in the bucket (zero for internal nodes)
+        unsigned int count;
+};
+
+/// \brief a kd-tree stored in one contiguous array of nodes.
+///
+/// Works like KDTree<Triangle>, but does not copy any triangles. The leaf nodes
+/// hold 32-bit triangle indices, and the triangles themselves stay in the STLSurf.
+/// Searching produces IndexSpans, one per overlapping bucket.
+class FlatKDTree : public SpatialIndex {
+    friend class FlatKDBuildTask;
+    public:
+        FlatKDTree() : nodeData(NULL), nNodes(0) {}
+        virtual ~FlatKDTree() {}
+        /// build the kd-tree over the triangles in list.
+        virtual void build(const std::vector<Triangle>& list);
+        /// search for overlap with Bbox bb. IndexSpans for overlapping buckets are appended to spans.
+        virtual void search(const Bbox& bb, std::vector<IndexSpan>& spans) const;
+        /// search for overlap with Bbox bb, and call v.visit() on each found triangle.
+        virtual void visit(const Bbox& bb, TriangleVisitor& v) const;
+        /// like visit(), but the higher child first, and only subtrees above v.bound()
+        virtual void visit_above(const Bbox& bb, ZBoundVisitor& v) const;
+        /// number of nodes in the tree
+        virtual unsigned int nodeCount() const {return nNodes;}
+        /// returns KDTreeIndexType
+        virtual SpatialIndexType type() const {return KDTreeIndexType;}
+        /// string repr
+        virtual std::string str() const;
+
+    protected:
+        /// save the nodes
+        virtual void save_blocks(std::vector<double>& params, std::vector<FileBlock>& blocks) const;
+        /// use mapped nodes
+        virtual bool map_blocks(const std::vector<double>& params, const std::vector<FileBlock>& blocks);
+        /// point nodeData at nodes
+        virtual void update_views();
+        /// build node number n for positions [first, last) of the index-array.
+        /// The subtree uses at most the 2*(last-first)-1 nodes starting at n.
+        void build_node(unsigned int first, unsigned int last, unsigned int n);
+        /// find the dimension with the largest spread for positions [first, last)
+        void calc_spread(unsigned int first, unsigned int last, int& dim, double& val, double& start) const;
+        /// \brief find the SAH cut for positions [first, last).
+        ///
+        /// bins the triangles along each dimension and returns the cut with the lowest
+        /// expected cost. returns false if no cut separates the triangles.
+        bool calc_sah_cut(unsigned int first, unsigned int last, int& dim, double& cutval) const;
+        /// partition positions [first, last) so that triangles with bb[dim] > cutval come first.
+        /// returns the position of the first triangle for the lo child.
+        unsigned int partition(unsigned int first, unsigned int last, int dim, double cutval);
+        /// copy the subtree at node n of the sparse build array into nodes, in depth-first order,
+        /// and set maxz. returns the new index of n.
+        unsigned int compact_node(const std::vector<FlatKDNode>& sparse, unsigned int n, unsigned int dep);
+        /// search starting at node n, appending found buckets to spans
+        void search_node(const Bbox& bb, unsigned int n, std::vector<IndexSpan>& spans) const;
+        /// search starting at node n, visiting triangles in found buckets
+        void visit_node(const Bbox& bb, unsigned int n, TriangleVisitor& v) const;
+        /// visit_above() starting at node n
+        void visit_above_node(const Bbox& bb, unsigned int n, ZBoundVisitor& v) const;
+    // DATA
+        /// the nodes, nodes[0] is the root
+        std::vector<FlatKDNode> nodes;
+        /// the nodes searched, either nodes or an array in the mapped file
+        const FlatKDNode* nodeData;
+        /// number of nodes in nodeData
+        unsigned int nNodes;
+};
+
+} // end ocl namespace
+#endif
+// end file flatkdtree.hpp
@@ -0,0 +1,285 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010-2011 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cassert>
+#include <cmath>
+#include <sstream>
+#include <algorithm>
+
+#include "gridindex.hpp"
+#include "numeric.hpp"
+
+namespace ocl
+{
+
+/// maximum number of cells in a GridIndex
+#define GRID_MAX_CELLS (1<<22)
+/// maximum number of cell references per triangle, on average, in a GridIndex
+#define GRID_MAX_REFS 64
+/// relative tolerance when comparing query sizes to the build size
+#define GRID_TOLERANCE 1E-9
+
+/// orders triangle indices by decreasing maximum z-coordinate
+class HigherTriangle {
+    public:
+        HigherTriangle(const std::vector<const Triangle*>& t) : tris(t) {}
+        /// true if triangle i reaches higher than triangle j
+        bool operator()(boost::uint32_t i, boost::uint32_t j) const {
+            return tris[i]->bb.maxpt.z > tris[j]->bb.maxpt.z;
+        }
+    private:
+        const std::vector<const Triangle*>& tris;
+};
+
+GridIndex::GridIndex() {
+    ncells[0] = ncells[1] = 0;
+    allFirst = 0;
+    cellData = NULL;
+    for (int a=0;a<2;++a) {
+        axes[a] = 0;
+        extent[a] = origin[a] = cellSize[a] = 0;
+    }
+}
+
+void GridIndex::build(const std::vector<Triangle>& list) {
+    double t_start = wall_time();
+    cellStart.clear();
+    ncells[0] = ncells[1] = 0;
+    if ( !init_index(list) ) {
+        std::cout << "ERROR: GridIndex::build() called with an empty list! \n";
+        update_views();
+        return;
+    }
+    const unsigned int N = tris.size();
+    axes[0] = dimensions[0];
+    axes[1] = dimensions[2];
+    // bounds of the triangles, grown by half the query size on each side
+    double bmin[2], bmax[2];
+    for (int a=0;a<2;++a) {
+        extent[a] = queryExtent[ axes[a]/2 ];
+        bmin[a] = tris[0]->bb[ axes[a] ];
+        bmax[a] = tris[0]->bb[ axes[a]+1 ];
+    }
+    BOOST_FOREACH(const Triangle* t, tris) {
+        for (int a=0;a<2;++a) {
+            bmin[a] = std::min( bmin[a], t->bb[ axes[a] ] );
+            bmax[a] = std::max( bmax[a], t->bb[ axes[a]+1 ] );
+        }
+    }
+    double size[2];
+    for (int a=0;a<2;++a) {
+        origin[a] = bmin[a] - extent[a]/2;
+        size[a] = bmax[a] - bmin[a] + extent[a];
+    }
+    // cells as large as the query, or with about one triangle each if no query size is set
+    double cs[2];
+    double spacing = sqrt( size[0]*size[1]/N );
+    for (int a=0;a<2;++a) {
+        cs[a] = (extent[a] > 0) ? extent[a] : spacing;
+        if ( isZero_tol( cs[a] ) )
+            cs[a] = std::max( size[a], 1.0 );
+    }
+    while ( !count_refs(size, cs) ) { // too much memory, use larger cells
+        cs[0] *= 1.5;
+        cs[1] *= 1.5;
+    }
+    // cellStart now holds the count of cell c at c+1, sum it up
+    const unsigned int nc = ncells[0]*ncells[1];
+    for (unsigned int c=0; c<nc; ++c)
+        cellStart[c+1] += cellStart[c];
+    allFirst = cellStart[nc];
+    // the cell lists, highest triangle first, followed by all triangles once
+    std::vector<boost::uint32_t> byHeight( index );
+    std::stable_sort( byHeight.begin(), byHeight.end(), HigherTriangle(tris) );
+    std::vector<boost::uint32_t> cells( allFirst + N );
+    std::vector<boost::uint32_t> cursor( cellStart.begin(), cellStart.end()-1 );
+    unsigned int lo[2], hi[2];
+    for (unsigned int j=0; j<N; ++j) {
+        const unsigned int i = byHeight[j];
+        cell_range(i, lo, hi);
+        for (unsigned int y=lo[1]; y<=hi[1]; ++y) {
+            for (unsigned int x=lo[0]; x<=hi[0]; ++x)
+                cells[ cursor[ x + ncells[0]*y ]++ ] = i;
+        }
+        cells[ allFirst + j ] = i;
+    }
+    index.swap( cells );
+    update_views();
+    nLeaves = 0;
+    for (unsigned int c=0; c<nc; ++c) {
+        if ( cellStart[c+1] > cellStart[c] )
+            ++nLeaves;
+    }
+    buildSeconds = wall_time() - t_start;
+}
+
+bool GridIndex::count_refs(const double* size, const double* cs) {
+    for (int a=0;a<2;++a) {
+        double n = ceil( size[a]/cs[a] );
+        if ( n > GRID_MAX_CELLS )
+            return false;
+        ncells[a] = std::max( (unsigned int)n, 1u );
+        cellSize[a] = cs[a];
+    }
+    if ( (double)ncells[0]*ncells[1] > GRID_MAX_CELLS )
+        return false;
+    cellStart.assign( ncells[0]*ncells[1]+1, 0 );
+    const double maxRefs = (double)GRID_MAX_REFS*tris.size();
+    double refs = 0;
+    unsigned int lo[2], hi[2];
+    for (unsigned int i=0; i<tris.size(); ++i) {
+        cell_range(i, lo, hi);
+        refs += (double)(hi[0]-lo[0]+1)*(hi[1]-lo[1]+1);
+        if ( refs > maxRefs ) {
+            cellStart.clear();
+            return false;
+        }
+        for (unsigned int y=lo[1]; y<=hi[1]; ++y) {
+            for (unsigned int x=lo[0]; x<=hi[0]; ++x)
+                ++cellStart[ x + ncells[0]*y + 1 ];
+        }
+    }
+    return true;
+}
+
+void GridIndex::cell_range(unsigned int i, unsigned int* lo, unsigned int* hi) const {
+    const Triangle* t = tris[i];
+    for (int a=0;a<2;++a) {
+        lo[a] = cell_of( t->bb[ axes[a] ]   - extent[a]/2, a );
+        hi[a] = cell_of( t->bb[ axes[a]+1 ] + extent[a]/2, a );
+    }
+}
+
+unsigned int GridIndex::cell_of(double v, int a) const {
+    double c = floor( (v-origin[a])/cellSize[a] );
+    if ( c < 0 )
+        return 0;
+    if ( c >= ncells[a] )
+        return ncells[a]-1;
+    return (unsigned int)c;
+}
+
+IndexSpan GridIndex::find(const Bbox& bb) const {
+    if ( cellData == NULL )
+        return IndexSpan(0,0);
+    unsigned int cell[2];
+    for (int a=0;a<2;++a) {
+        double half = ( bb[ axes[a]+1 ] - bb[ axes[a] ] )/2;
+        if ( half > extent[a]/2 + GRID_TOLERANCE*std::max(1.0, extent[a]) ) // larger than the build size
+            return IndexSpan( allFirst, indexLength );
+        double c = floor( ( bb[ axes[a] ] + half - origin[a] )/cellSize[a] );
+        if ( (c < 0) || (c >= ncells[a]) ) // the query is further than extent/2 from all triangles
+            return IndexSpan(0,0);
+        cell[a] = (unsigned int)c;
+    }
+    unsigned int c = cell[0] + ncells[0]*cell[1];
+    return IndexSpan( cellData[c], cellData[c+1] );
+}
+
+void GridIndex::search(const Bbox& bb, std::vector<IndexSpan>& spans) const {
+    IndexSpan s = find(bb);
+    if ( s.size() > 0 )
+        append_span(spans, s.first, s.last);
+}
+
+void GridIndex::visit(const Bbox& bb, TriangleVisitor& v) const {
+    IndexSpan s = find(bb);
+    for (unsigned int k=s.first; k<s.last; ++k)
+        v.visit( *tris[ indexData[k] ], indexData[k] );
+}
+
+// the cell lists are sorted by height, so stop at the first triangle that is not above the bound
+void GridIndex::visit_above(const Bbox& bb, ZBoundVisitor& v) const {
+    IndexSpan s = find(bb);
+    for (unsigned int k=s.first; k<s.last; ++k) {
+        const Triangle* t = tris[ indexData[k] ];
+        if ( t->bb.maxpt.z <= v.bound() )
+            break;
+        v.visit( *t, indexData[k] );
+    }
+}
+
+bool GridIndex::fitsCutter(double radius, double length) const {
+    if ( cellData == NULL )
+        return false;
+    for (int a=0;a<2;++a) {
+        double q = (axes[a] == 4) ? length : 2*radius;
+        if ( fabs( q - extent[a] ) > GRID_TOLERANCE*std::max(1.0, q) )
+            return false;
+    }
+    return true;
+}
+
+void GridIndex::update_views() {
+    SpatialIndex::update_views();
+    cellData = cellStart.empty() ? NULL : &cellStart[0];
+}
+
+void GridIndex::save_blocks(std::vector<double>& params, std::vector<FileBlock>& blocks) const {
+    for (int a=0;a<2;++a) {
+        params.push_back( axes[a] );
+        params.push_back( extent[a] );
+        params.push_back( origin[a] );
+        params.push_back( cellSize[a] );
+        params.push_back( ncells[a] );
+    }
+    params.push_back( allFirst );
+    blocks.push_back( FileBlock( cellData, (ncells[0]*ncells[1]+1)*sizeof(boost::uint32_t) ) );
+}
+
+bool GridIndex::map_blocks(const std::vector<double>& params, const std::vector<FileBlock>& blocks) {
+    cellStart.clear();
+    if ( (params.size() != 11) || (blocks.size() != 1) )
+        return false;
+    for (int a=0;a<2;++a) {
+        axes[a]     = (int) params[5*a];
+        extent[a]   = params[5*a+1];
+        origin[a]   = params[5*a+2];
+        cellSize[a] = params[5*a+3];
+        ncells[a]   = (unsigned int) params[5*a+4];
+        if ( (axes[a] != dimensions[2*a]) || (ncells[a] == 0) || !(cellSize[a] > 0) )
+            return false;
+    }
+    allFirst = (unsigned int) params[10];
+    const unsigned int nc = ncells[0]*ncells[1];
+    if ( blocks[0].bytes != (nc+1)*sizeof(boost::uint32_t) )
+        return false;
+    cellData = (const boost::uint32_t*) blocks[0].data;
+    if ( (cellData[0] != 0) || (cellData[nc] != allFirst) || (allFirst > indexLength) )
+        return false;
+    for (unsigned int c=0; c<nc; ++c) {
+        if ( cellData[c+1] < cellData[c] )
+            return false;
+    }
+    return true;
+}
+
+std::string GridIndex::str() const {
+    std::ostringstream o;
+    o << "GridIndex(N=" << tris.size() << ", cells=" << ncells[0] << "x" << ncells[1];
+    o << ", cell size=" << cellSize[0] << "x" << cellSize[1];
+    o << ", non-empty cells=" << nLeaves << ", refs=" << allFirst;
+    o << (isMapped() ? ", load time=" : ", build time=") << buildSeconds << " s)";
+    return o.str();
+}
+
+} // end ocl namespace
+// end file gridindex.cpp
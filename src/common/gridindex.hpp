@@ -0,0 +1,105 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010-2011 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef GRID_INDEX_H
+#define GRID_INDEX_H
+
+#include <string>
+#include <vector>
+
+#include "spatialindex.hpp"
+
+namespace ocl
+{
+
+/// \brief a uniform 2D grid of buckets, for queries of a fixed size.
+///
+/// Built for one cutter size (see setCutterSize()). Each cell lists all triangles
+/// that overlap the cell grown by half the query size, so any query centered in
+/// the cell is answered by that one list, without tree traversal.
+/// The cell size follows the cutter diameter, and is increased if the grid
+/// would use more than GRID_MAX_CELLS cells or store more than
+/// GRID_MAX_REFS triangle references per triangle.
+/// Queries larger than the build size fall back to returning all triangles,
+/// so the index should be re-built when the cutter changes, see fitsCutter().
+/// The cell lists are stored back-to-back in the index-array (CSR layout),
+/// and a triangle can be listed in many cells. Each list is sorted by
+/// decreasing triangle height, for visit_above().
+class GridIndex : public SpatialIndex {
+    public:
+        GridIndex();
+        virtual ~GridIndex() {}
+        /// build the grid over the triangles in list.
+        virtual void build(const std::vector<Triangle>& list);
+        /// append the span of the cell containing the center of bb to spans
+        virtual void search(const Bbox& bb, std::vector<IndexSpan>& spans) const;
+        /// call v.visit() on each triangle of the cell containing the center of bb
+        virtual void visit(const Bbox& bb, TriangleVisitor& v) const;
+        /// like visit(), but stops at the first triangle not above v.bound()
+        virtual void visit_above(const Bbox& bb, ZBoundVisitor& v) const;
+        /// true if the grid was built for this cutter size
+        virtual bool fitsCutter(double radius, double length) const;
+        /// number of cells in the grid
+        virtual unsigned int nodeCount() const {return ncells[0]*ncells[1];}
+        /// returns GridIndexType
+        virtual SpatialIndexType type() const {return GridIndexType;}
+        /// string repr
+        virtual std::string str() const;
+
+    protected:
+        /// save the grid parameters and cells
+        virtual void save_blocks(std::vector<double>& params, std::vector<FileBlock>& blocks) const;
+        /// use mapped cells
+        virtual bool map_blocks(const std::vector<double>& params, const std::vector<FileBlock>& blocks);
+        /// point cellData at cellStart
+        virtual void update_views();
+        /// return the span of positions for query bb
+        IndexSpan find(const Bbox& bb) const;
+        /// count the triangle references for a grid of the given size with cell size cs,
+        /// storing the count of cell c in cellStart[c+1].
+        /// returns false, with cellStart empty, if the grid would exceed the memory limits.
+        bool count_refs(const double* size, const double* cs);
+        /// the range of cells [lo, hi] (inclusive) listing triangle number i
+        void cell_range(unsigned int i, unsigned int* lo, unsigned int* hi) const;
+        /// the cell containing coordinate v along axis a, clamped to the grid
+        unsigned int cell_of(double v, int a) const;
+    // DATA
+        /// the two axes of the search plane, as the Bbox::operator[] index of their min coordinate
+        int axes[2];
+        /// query extent along the two axes, at build time
+        double extent[2];
+        /// minimum corner of the grid
+        double origin[2];
+        /// cell size along the two axes
+        double cellSize[2];
+        /// number of cells along the two axes
+        unsigned int ncells[2];
+        /// cell c holds positions [cellStart[c], cellStart[c+1]) of the index-array
+        std::vector<boost::uint32_t> cellStart;
+        /// the cell starts searched, either cellStart or an array in the mapped file
+        const boost::uint32_t* cellData;
+        /// positions [allFirst, indexLength) of the index-array list each triangle once
+        unsigned int allFirst;
+};
+
+} // end ocl namespace
+#endif
+// end file gridindex.hpp
@@ -0,0 +1,131 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010-2011 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+
+#include "indexcache.hpp"
+
+namespace ocl
+{
+
+std::vector<IndexCache::Entry> IndexCache::entries;
+std::vector<IndexCache::ArraysEntry> IndexCache::arraysEntries;
+bool IndexCache::enabled = true;
+unsigned int IndexCache::nHits = 0;
+boost::mutex IndexCache::mutex;
+
+boost::shared_ptr<SpatialIndex> IndexCache::build(boost::shared_ptr<SpatialIndex> idx, const STLSurf& s) {
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        prune();
+        if (enabled) {
+            BOOST_FOREACH(const Entry& e, entries) {
+                if ( (e.surfId != s.getId()) || (e.revision != s.getRevision()) )
+                    continue;
+                boost::shared_ptr<SpatialIndex> cached = e.index.lock();
+                if ( cached && cached->sameSettings(*idx) ) {
+                    ++nHits;
+                    return cached;
+                }
+            }
+        }
+    }
+    // built without the lock, so other threads are not held up. Two threads may then
+    // build equal indexes at the same time, and both are cached.
+    idx->build(s);
+    insert(idx, s);
+    return idx;
+}
+
+void IndexCache::insert(boost::shared_ptr<SpatialIndex> idx, const STLSurf& s) {
+    boost::mutex::scoped_lock lock(mutex);
+    if (!enabled)
+        return;
+    Entry e;
+    e.surfId = s.getId();
+    e.revision = s.getRevision();
+    e.index = idx;
+    entries.push_back(e);
+}
+
+boost::shared_ptr<const SurfaceArrays> IndexCache::arrays(const STLSurf& s) {
+    if ( s.getArrays() ) // e.g. mapped from a file
+        return s.getArrays();
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        prune();
+        if (enabled) {
+            BOOST_FOREACH(const ArraysEntry& e, arraysEntries) {
+                if ( (e.surfId == s.getId()) && (e.revision == s.getRevision()) ) {
+                    boost::shared_ptr<const SurfaceArrays> cached = e.arrays.lock();
+                    if (cached)
+                        return cached;
+                }
+            }
+        }
+    }
+    // built without the lock, as in build()
+    std::vector<const Triangle*> tris;
+    tris.reserve( s.size() );
+    BOOST_FOREACH(const Triangle& t, s.getTriangles())
+        tris.push_back( &t );
+    boost::shared_ptr<SurfaceArrays> a( new SurfaceArrays() );
+    a->build( tris );
+    boost::mutex::scoped_lock lock(mutex);
+    if (enabled) {
+        ArraysEntry e;
+        e.surfId = s.getId();
+        e.revision = s.getRevision();
+        e.arrays = a;
+        arraysEntries.push_back(e);
+    }
+    return a;
+}
+
+unsigned int IndexCache::size() {
+    boost::mutex::scoped_lock lock(mutex);
+    prune();
+    return entries.size();
+}
+
+void IndexCache::clear() {
+    boost::mutex::scoped_lock lock(mutex);
+    entries.clear();
+    arraysEntries.clear();
+}
+
+void IndexCache::prune() {
+    std::vector<Entry> live;
+    BOOST_FOREACH(const Entry& e, entries) {
+        if ( !e.index.expired() )
+            live.push_back(e);
+    }
+    entries.swap(live);
+    std::vector<ArraysEntry> liveArrays;
+    BOOST_FOREACH(const ArraysEntry& e, arraysEntries) {
+        if ( !e.arrays.expired() )
+            liveArrays.push_back(e);
+    }
+    arraysEntries.swap(liveArrays);
+}
+
+} // end ocl namespace
+// end file indexcache.cpp
@@ -0,0 +1,114 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010-2011 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef INDEX_CACHE_H
+#define INDEX_CACHE_H
+
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "spatialindex.hpp"
+#include "stlsurf.hpp"
+
+namespace ocl
+{
+
+/// \brief a cache of built spatial indexes, shared by all Operations.
+///
+/// Operations on the same STLSurf that search in the same plane with the same
+/// index settings share one index, instead of each building their own.
+/// Indexes over the same STLSurf, in any plane, share one SurfaceArrays.
+/// A surface is identified by STLSurf::getId(), and an index is not re-used
+/// after the surface is modified (STLSurf::getRevision()).
+/// The cache only holds weak pointers, so an index is deleted together with
+/// the last Operation that uses it.
+/// Thread-safe, so operations on the same surface can run on different threads.
+class IndexCache {
+    public:
+        /// \brief return an index equal to idx, built over the triangles of s.
+        ///
+        /// returns a cached index if there is one with the same settings as idx.
+        /// Otherwise idx is built and added to the cache, and returned.
+        static boost::shared_ptr<SpatialIndex> build(boost::shared_ptr<SpatialIndex> idx, const STLSurf& s);
+        /// add idx, already built over the triangles of s (see SpatialIndex::load()), to the cache
+        static void insert(boost::shared_ptr<SpatialIndex> idx, const STLSurf& s);
+        /// \brief return the SurfaceArrays of s, built once for each surface and revision.
+        ///
+        /// Called by SpatialIndex::build(const STLSurf&), so that the XY-index for drop-cutter
+        /// and the XZ- and YZ-indexes for push-cutter hold one copy of the arrays between them.
+        /// The arrays set with STLSurf::setArrays(), e.g. mapped from a file, are returned
+        /// if the surface has not been modified since, also when the cache is disabled.
+        static boost::shared_ptr<const SurfaceArrays> arrays(const STLSurf& s);
+        /// enable or disable the cache. When disabled, build() always builds idx.
+        static void setEnabled(bool b) {enabled = b;}
+        /// return true if the cache is enabled
+        static bool isEnabled() {return enabled;}
+        /// number of indexes in the cache that are still in use
+        static unsigned int size();
+        /// number of build() calls that returned a cached index
+        static unsigned int hits() {
+            boost::mutex::scoped_lock lock(mutex);
+            return nHits;
+        }
+        /// forget all cached indexes. Indexes in use by Operations are not affected.
+        static void clear();
+    protected:
+        /// a cached index, and the surface it was built for
+        class Entry {
+            public:
+                /// STLSurf::getId() of the surface
+                unsigned int surfId;
+                /// STLSurf::getRevision() of the surface at build time
+                unsigned int revision;
+                /// the index
+                boost::weak_ptr<SpatialIndex> index;
+        };
+        /// the SurfaceArrays of a surface
+        class ArraysEntry {
+            public:
+                /// STLSurf::getId() of the surface
+                unsigned int surfId;
+                /// STLSurf::getRevision() of the surface at build time
+                unsigned int revision;
+                /// the arrays
+                boost::weak_ptr<const SurfaceArrays> arrays;
+        };
+        /// remove entries no longer in use. call with mutex locked.
+        static void prune();
+    // DATA
+        /// the cache
+        static std::vector<Entry> entries;
+        /// the cached SurfaceArrays
+        static std::vector<ArraysEntry> arraysEntries;
+        /// true if the cache is enabled
+        static bool enabled;
+        /// cache hit count
+        static unsigned int nHits;
+        /// guards entries, arraysEntries and nHits
+        static boost::mutex mutex;
+};
+
+} // end ocl namespace
+#endif
+// end file indexcache.hpp
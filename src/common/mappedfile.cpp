@@ -0,0 +1,126 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010-2011 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+#include "mappedfile.hpp"
+
+namespace ocl
+{
+
+MappedFile::MappedFile() {
+    ptr = NULL;
+    length = 0;
+#ifdef _WIN32
+    file = INVALID_HANDLE_VALUE;
+    mapping = NULL;
+#endif
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+#ifdef _WIN32
+bool MappedFile::open(const std::string& fname) {
+    close();
+    filename = fname;
+    file = CreateFileA( fname.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+    if ( file == INVALID_HANDLE_VALUE ) {
+        std::cout << "MappedFile::open() ERROR: can't open " << fname << "\n";
+        return false;
+    }
+    LARGE_INTEGER sz;
+    if ( !GetFileSizeEx( file, &sz ) || (sz.QuadPart == 0) ) {
+        std::cout << "MappedFile::open() ERROR: " << fname << " is empty\n";
+        close();
+        return false;
+    }
+    length = (std::size_t) sz.QuadPart;
+    mapping = CreateFileMappingA( file, NULL, PAGE_READONLY, 0, 0, NULL );
+    if ( mapping != NULL )
+        ptr = (const char*) MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+    if ( ptr == NULL ) {
+        std::cout << "MappedFile::open() ERROR: can't map " << fname << "\n";
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::close() {
+    if ( ptr != NULL )
+        UnmapViewOfFile( ptr );
+    if ( mapping != NULL )
+        CloseHandle( mapping );
+    if ( file != INVALID_HANDLE_VALUE )
+        CloseHandle( file );
+    ptr = NULL;
+    mapping = NULL;
+    file = INVALID_HANDLE_VALUE;
+    length = 0;
+}
+#else
+bool MappedFile::open(const std::string& fname) {
+    close();
+    filename = fname;
+    int fd = ::open( fname.c_str(), O_RDONLY );
+    if ( fd < 0 ) {
+        std::cout << "MappedFile::open() ERROR: can't open " << fname << "\n";
+        return false;
+    }
+    struct stat st;
+    if ( (fstat(fd, &st) != 0) || (st.st_size == 0) ) {
+        std::cout << "MappedFile::open() ERROR: " << fname << " is empty\n";
+        ::close(fd);
+        return false;
+    }
+    length = st.st_size;
+    void* p = mmap( NULL, length, PROT_READ, MAP_PRIVATE, fd, 0 );
+    ::close(fd); // the mapping stays valid
+    if ( p == MAP_FAILED ) {
+        std::cout << "MappedFile::open() ERROR: can't map " << fname << "\n";
+        length = 0;
+        return false;
+    }
+    ptr = (const char*) p;
+    return true;
+}
+
+void MappedFile::close() {
+    if ( ptr != NULL )
+        munmap( (void*) ptr, length );
+    ptr = NULL;
+    length = 0;
+}
+#endif
+
+} // end ocl namespace
+// end file mappedfile.cpp
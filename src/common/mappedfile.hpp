@@ -0,0 +1,84 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010-2011 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <cstddef>
+
+#include <boost/cstdint.hpp>
+
+namespace ocl
+{
+
+/// \brief a contiguous block of raw data, in a file or about to be written to one
+class FileBlock {
+    public:
+        FileBlock(const void* d, boost::uint64_t b) : data(d), bytes(b) {}
+        /// the data
+        const void* data;
+        /// size in bytes
+        boost::uint64_t bytes;
+};
+
+/// \brief a read-only memory-mapped file.
+///
+/// The file contents are available through data() until close() or destruction,
+/// and pages are only read from disk when first accessed.
+class MappedFile {
+    public:
+        MappedFile();
+        /// unmaps the file
+        virtual ~MappedFile();
+        /// map the file filename. returns false, with an error message, on failure.
+        bool open(const std::string& filename);
+        /// unmap the file
+        void close();
+        /// return true if a file is mapped
+        bool isOpen() const {return ptr != NULL;}
+        /// the first byte of the file
+        const char* data() const {return ptr;}
+        /// size of the file in bytes
+        std::size_t size() const {return length;}
+        /// the name of the mapped file
+        const std::string& name() const {return filename;}
+    private:
+        MappedFile(const MappedFile&); // not copyable
+        MappedFile& operator=(const MappedFile&);
+    // DATA
+        /// start of the mapping
+        const char* ptr;
+        /// length of the mapping
+        std::size_t length;
+        /// name of the file
+        std::string filename;
+#ifdef _WIN32
+        /// file handle
+        void* file;
+        /// file mapping handle
+        void* mapping;
+#endif
+};
+
+} // end ocl namespace
+#endif
+// end file mappedfile.hpp
@@ -0,0 +1,380 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010-2011 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+#include <cassert>
+
+#include <boost/static_assert.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/foreach.hpp>
+
+#include "meshcache.hpp"
+#include "indexcache.hpp"
+#include "indexedmesh.hpp"
+#include "mappedfile.hpp"
+#include "stlreader.hpp"
+#include "threadpool.hpp"
+
+namespace ocl
+{
+
+/// version of the file format written by MeshCache::save()
+#define MESH_FILE_VERSION 2
+/// number of data blocks in a mesh file
+#define MESH_FILE_BLOCKS (6 + SURFACE_ARRAYS_BLOCKS)
+/// the welded vertices, 3 doubles each
+#define MESH_BLOCK_VERTICES 0
+/// the triangles, 3 vertex indices each
+#define MESH_BLOCK_TRIANGLES 1
+/// the triangle normals, 3 doubles each
+#define MESH_BLOCK_NORMALS 2
+/// the triangle bounding-boxes, 6 doubles each in Bbox::operator[] order
+#define MESH_BLOCK_BBOXES 3
+/// the order found by STLSurf::calcMortonOrder(), one 64-bit element per triangle
+#define MESH_BLOCK_MORTON 4
+/// a SpatialIndex saved without triangles, or empty
+#define MESH_BLOCK_INDEX 5
+/// the first of the SURFACE_ARRAYS_BLOCKS blocks of the SurfaceArrays of the triangles
+#define MESH_BLOCK_ARRAYS 6
+/// number of triangles unpacked by one thread at a time
+#define MESH_LOAD_CHUNK 16384
+
+/// \brief header of a mesh file.
+///
+/// The header is followed by a table of MESH_FILE_BLOCKS (offset, bytes) pairs, and the
+/// data blocks, each at a multiple of INDEX_FILE_ALIGN. The file is padded to a multiple of
+/// INDEX_FILE_ALIGN, and the checksum covers everything after the header.
+class MeshFileHeader {
+    public:
+        /// "OCLMESH" and a zero
+        char magic[8];
+        /// MESH_FILE_VERSION
+        boost::uint32_t version;
+        /// 1, written in the byte order of the platform
+        boost::uint32_t byteOrder;
+        /// number of welded vertices
+        boost::uint32_t nVertices;
+        /// number of triangles
+        boost::uint32_t nTriangles;
+        /// number of data blocks
+        boost::uint32_t nBlocks;
+        /// unused
+        boost::uint32_t reserved;
+        /// MeshCache::checksum() of the rest of the file
+        boost::uint64_t checksum;
+};
+BOOST_STATIC_ASSERT( sizeof(MeshFileHeader) == 40 );
+
+/// round n up to a multiple of INDEX_FILE_ALIGN
+static boost::uint64_t align_up(boost::uint64_t n) {
+    return ( (n + INDEX_FILE_ALIGN - 1)/INDEX_FILE_ALIGN )*INDEX_FILE_ALIGN;
+}
+
+/// builds the triangles MESH_LOAD_CHUNK at a time from the blocks of a mapped mesh file,
+/// and finds the bounding-box of each part
+class UnpackTask : public ParallelTask {
+    public:
+        UnpackTask(const double* v, const boost::uint32_t* c, const double* nv, const double* b, unsigned int n, Triangle* t,
+                   std::vector<Bbox>& pb)
+            : vertices(v), corners(c), normals(nv), boxes(b), nTriangles(n), tris(t), partBoxes(pb) {}
+        void run(unsigned int c) {
+            const unsigned int last = std::min( (c+1)*MESH_LOAD_CHUNK, nTriangles );
+            for (unsigned int n=c*MESH_LOAD_CHUNK; n<last; ++n) {
+                const double* p0 = vertices + 3*corners[3*n];
+                const double* p1 = vertices + 3*corners[3*n+1];
+                const double* p2 = vertices + 3*corners[3*n+2];
+                const double* nv = normals + 3*n;
+                const double* b = boxes + 6*n;
+                tris[n] = Triangle( Point(p0[0], p0[1], p0[2]), Point(p1[0], p1[1], p1[2]), Point(p2[0], p2[1], p2[2]),
+                                    Point(nv[0], nv[1], nv[2]), Bbox(b[0], b[1], b[2], b[3], b[4], b[5]) );
+                partBoxes[c].addBbox( tris[n].bb );
+            }
+        }
+    private:
+        /// the welded vertices
+        const double* vertices;
+        /// three vertex indices per triangle
+        const boost::uint32_t* corners;
+        /// the normal of each triangle
+        const double* normals;
+        /// the bounding-box of each triangle
+        const double* boxes;
+        /// number of triangles
+        unsigned int nTriangles;
+        /// the triangle storage of the surface
+        Triangle* tris;
+        /// the bounding-box of each part
+        std::vector<Bbox>& partBoxes;
+};
+
+/// wall-clock time in seconds
+static double cache_time() {
+    const boost::posix_time::ptime epoch( boost::gregorian::date(1970, 1, 1) );
+    return ( boost::posix_time::microsec_clock::universal_time() - epoch ).total_microseconds() * 1e-6;
+}
+
+bool MeshCache::save(const std::string& filename, const STLSurf& s, const SpatialIndex* idx) {
+    if ( s.size() == 0 ) {
+        std::cout << "MeshCache::save() ERROR: the surface is empty\n";
+        return false;
+    }
+    if ( idx && (idx->size() != s.size()) ) {
+        std::cout << "MeshCache::save() ERROR: the index is not built over the surface\n";
+        return false;
+    }
+    // only identical vertices are welded, so that load() restores the triangles exactly
+    std::vector<const Triangle*> ptrs;
+    ptrs.reserve( s.size() );
+    BOOST_FOREACH(const Triangle& t, s.getTriangles())
+        ptrs.push_back( &t );
+    IndexedMesh mesh;
+    mesh.build( ptrs, 0.0 );
+    const unsigned int N = s.size();
+    const unsigned int V = mesh.vertexCount();
+    std::vector<double> vertices( 3*V );
+    for (unsigned int v=0; v<V; ++v) {
+        const Point p = mesh.vertex(v);
+        vertices[3*v] = p.x;
+        vertices[3*v+1] = p.y;
+        vertices[3*v+2] = p.z;
+    }
+    std::vector<boost::uint32_t> corners( 3*N );
+    std::vector<double> normals( 3*N );
+    std::vector<double> boxes( 6*N );
+    for (unsigned int n=0; n<N; ++n) {
+        const Triangle& t = s.getTriangles()[n];
+        for (int k=0;k<3;++k)
+            corners[3*n+k] = mesh.triVertex(n,k);
+        normals[3*n] = t.n.x;
+        normals[3*n+1] = t.n.y;
+        normals[3*n+2] = t.n.z;
+        for (int k=0;k<6;++k)
+            boxes[6*n+k] = t.bb[k];
+    }
+    // saved, so that a BVH built after load() does not need to sort
+    std::vector<boost::uint64_t> morton;
+    if ( s.getMortonOrder() )
+        morton = *s.getMortonOrder();
+    else
+        s.calcMortonOrder(morton);
+    std::ostringstream image;
+    if (idx)
+        idx->save(image, false);
+    const std::string indexImage = image.str();
+    // saved, so that load() uses them in place instead of building them
+    const boost::shared_ptr<const SurfaceArrays> arrays = idx ? idx->getSurfaceArrays() : IndexCache::arrays(s);
+    
+    std::vector<FileBlock> blocks;
+    blocks.push_back( FileBlock( &vertices[0], vertices.size()*sizeof(double) ) );
+    blocks.push_back( FileBlock( &corners[0], corners.size()*sizeof(boost::uint32_t) ) );
+    blocks.push_back( FileBlock( &normals[0], normals.size()*sizeof(double) ) );
+    blocks.push_back( FileBlock( &boxes[0], boxes.size()*sizeof(double) ) );
+    blocks.push_back( FileBlock( &morton[0], morton.size()*sizeof(boost::uint64_t) ) );
+    blocks.push_back( FileBlock( indexImage.data(), indexImage.size() ) );
+    arrays->save_blocks( blocks );
+    assert( blocks.size() == MESH_FILE_BLOCKS );
+    MeshFileHeader h;
+    memset( &h, 0, sizeof(h) );
+    memcpy( h.magic, "OCLMESH", 8 );
+    h.version = MESH_FILE_VERSION;
+    h.byteOrder = 1;
+    h.nVertices = V;
+    h.nTriangles = N;
+    h.nBlocks = MESH_FILE_BLOCKS;
+    boost::uint64_t table[2*MESH_FILE_BLOCKS];
+    boost::uint64_t offset = align_up( sizeof(h) + sizeof(table) );
+    for (int m=0; m<MESH_FILE_BLOCKS; ++m) {
+        table[2*m] = offset;
+        table[2*m+1] = blocks[m].bytes;
+        offset = align_up( offset + blocks[m].bytes );
+    }
+    
+    std::ofstream out( filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+    if ( !out ) {
+        std::cout << "MeshCache::save() ERROR: can't open " << filename << "\n";
+        return false;
+    }
+    out.write( (const char*) &h, sizeof(h) );
+    out.write( (const char*) table, sizeof(table) );
+    const char zeros[INDEX_FILE_ALIGN] = {0};
+    for (int m=0; m<MESH_FILE_BLOCKS; ++m) {
+        boost::uint64_t pos = out.tellp();
+        out.write( zeros, table[2*m] - pos ); // padding
+        if ( blocks[m].bytes > 0 )
+            out.write( (const char*) blocks[m].data, blocks[m].bytes );
+    }
+    boost::uint64_t pos = out.tellp();
+    out.write( zeros, offset - pos );
+    out.close();
+    // the checksum is found from the written file, and patched into the header
+    MappedFile written;
+    bool ok = !out.fail() && written.open(filename);
+    if (ok) {
+        h.checksum = checksum( written.data() + sizeof(h), written.size() - sizeof(h) );
+        written.close();
+        std::fstream patch( filename.c_str(), std::ios::in | std::ios::out | std::ios::binary );
+        patch.seekp( offsetof(MeshFileHeader, checksum) );
+        patch.write( (const char*) &h.checksum, sizeof(h.checksum) );
+        patch.close();
+        ok = !patch.fail();
+    }
+    if ( !ok ) {
+        std::cout << "MeshCache::save() ERROR: writing " << filename << " failed\n";
+        return false;
+    }
+    return true;
+}
+
+bool MeshCache::load(const std::string& filename, STLSurf& s, boost::shared_ptr<SpatialIndex>& idx) {
+    double t_start = cache_time();
+    idx.reset();
+    if ( s.size() != 0 ) {
+        std::cout << "MeshCache::load() ERROR: the STLSurf must be empty\n";
+        return false;
+    }
+    boost::shared_ptr<MappedFile> file( new MappedFile() );
+    if ( !file->open(filename) )
+        return false;
+    const char* data = file->data();
+    // check the header, the checksum, and the block table
+    MeshFileHeader h;
+    if ( file->size() < sizeof(h) ) {
+        std::cout << "MeshCache::load() ERROR: " << filename << " is not a mesh file\n";
+        return false;
+    }
+    memcpy( &h, data, sizeof(h) );
+    if ( memcmp(h.magic, "OCLMESH", 8) != 0 || (h.byteOrder != 1) ) {
+        std::cout << "MeshCache::load() ERROR: " << filename << " is not a mesh file for this platform\n";
+        return false;
+    }
+    if ( h.version != MESH_FILE_VERSION ) {
+        std::cout << "MeshCache::load() ERROR: " << filename << " has version " << h.version;
+        std::cout << ", expected " << MESH_FILE_VERSION << "\n";
+        return false;
+    }
+    boost::uint64_t table[2*MESH_FILE_BLOCKS] = {0};
+    const boost::uint64_t size = file->size();
+    bool valid = (h.nBlocks == MESH_FILE_BLOCKS) && (h.nTriangles > 0) && (size % INDEX_FILE_ALIGN == 0);
+    valid = valid && ( sizeof(h) + sizeof(table) <= size );
+    if ( valid && (checksum( data + sizeof(h), size - sizeof(h) ) != h.checksum) ) {
+        std::cout << "MeshCache::load() ERROR: " << filename << " has a wrong checksum\n";
+        return false;
+    }
+    std::vector<FileBlock> blocks;
+    if (valid) {
+        memcpy( table, data + sizeof(h), sizeof(table) );
+        for (int m=0; m<MESH_FILE_BLOCKS; ++m) {
+            if ( (table[2*m] % INDEX_FILE_ALIGN != 0) || (table[2*m] > size) || (table[2*m+1] > size-table[2*m]) )
+                valid = false;
+            else
+                blocks.push_back( FileBlock( data + table[2*m], table[2*m+1] ) );
+        }
+    }
+    const boost::uint64_t N = h.nTriangles;
+    valid = valid && ( table[2*MESH_BLOCK_VERTICES+1] == 3*sizeof(double)*(boost::uint64_t)h.nVertices );
+    valid = valid && ( table[2*MESH_BLOCK_TRIANGLES+1] == 3*sizeof(boost::uint32_t)*N );
+    valid = valid && ( table[2*MESH_BLOCK_NORMALS+1] == 3*sizeof(double)*N );
+    valid = valid && ( table[2*MESH_BLOCK_BBOXES+1] == 6*sizeof(double)*N );
+    valid = valid && ( table[2*MESH_BLOCK_MORTON+1] == sizeof(boost::uint64_t)*N );
+    const double* vertices = (const double*) ( data + table[2*MESH_BLOCK_VERTICES] );
+    const boost::uint32_t* corners = (const boost::uint32_t*) ( data + table[2*MESH_BLOCK_TRIANGLES] );
+    const double* normals = (const double*) ( data + table[2*MESH_BLOCK_NORMALS] );
+    const double* boxes = (const double*) ( data + table[2*MESH_BLOCK_BBOXES] );
+    const boost::uint64_t* morton = (const boost::uint64_t*) ( data + table[2*MESH_BLOCK_MORTON] );
+    if (valid) {
+        for (boost::uint64_t c=0; c<3*N; ++c) {
+            if ( corners[c] >= h.nVertices ) {
+                valid = false;
+                break;
+            }
+        }
+        for (boost::uint64_t m=0; m<N; ++m) {
+            if ( (morton[m] & 0xFFFFFFFF) >= N ) {
+                valid = false;
+                break;
+            }
+        }
+    }
+    if (!valid) {
+        std::cout << "MeshCache::load() ERROR: " << filename << " is damaged\n";
+        return false;
+    }
+    Triangle* tris = s.appendTriangles( h.nTriangles );
+    const unsigned int nparts = (h.nTriangles + MESH_LOAD_CHUNK - 1) / MESH_LOAD_CHUNK;
+    std::vector<Bbox> partBoxes( nparts );
+    UnpackTask task( vertices, corners, normals, boxes, h.nTriangles, tris, partBoxes );
+    ThreadPool::instance().run( task, nparts );
+    Bbox bb;
+    BOOST_FOREACH(const Bbox& b, partBoxes)
+        bb.addBbox(b);
+    s.trianglesAdded(bb);
+    s.setMortonOrder( morton, h.nTriangles );
+    boost::shared_ptr<SurfaceArrays> arrays( new SurfaceArrays() );
+    if ( arrays->map_blocks(blocks, MESH_BLOCK_ARRAYS, h.nTriangles, file) )
+        s.setArrays(arrays); // used in place by the index below, and by indexes built over s
+    else
+        std::cout << "MeshCache::load() WARNING: the arrays in " << filename << " are damaged, and are built again\n";
+    if ( table[2*MESH_BLOCK_INDEX+1] > 0 ) {
+        SpatialIndex* si = SpatialIndex::load( file, table[2*MESH_BLOCK_INDEX], table[2*MESH_BLOCK_INDEX+1], s );
+        if (si) {
+            idx.reset(si);
+            IndexCache::insert(idx, s);
+        } else {
+            std::cout << "MeshCache::load() WARNING: the index in " << filename << " is not used\n";
+        }
+    }
+    std::cout << "MeshCache: " << h.nTriangles << " triangles, " << h.nVertices << " vertices";
+    if (idx)
+        std::cout << " and a " << idx->str();
+    std::cout << ", loaded in " << cache_time() - t_start << " s\n";
+    return true;
+}
+
+bool MeshCache::convert(const std::wstring& stlfile, const std::string& filename) {
+    STLSurf s;
+    STLReader r(stlfile, s);
+    if ( s.size() == 0 ) {
+        std::cout << "MeshCache::convert() ERROR: no triangles read from the STL file\n";
+        return false;
+    }
+    return save(filename, s);
+}
+
+// a Fletcher-style sum: b depends on the order of the words, not only on their sum
+boost::uint64_t MeshCache::checksum(const char* data, boost::uint64_t bytes) {
+    const boost::uint64_t* w = (const boost::uint64_t*) data;
+    const boost::uint64_t n = bytes / sizeof(boost::uint64_t);
+    boost::uint64_t a = 0;
+    boost::uint64_t b = 0;
+    for (boost::uint64_t m=0; m<n; ++m) {
+        a += w[m];
+        b += a;
+    }
+    return a ^ (b << 1) ^ (b >> 63);
+}
+
+} // end ocl namespace
+// end file meshcache.cpp
@@ -0,0 +1,71 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010-2011 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <string>
+
+#include <boost/shared_ptr.hpp>
+
+#include "spatialindex.hpp"
+#include "stlsurf.hpp"
+
+namespace ocl
+{
+
+/// \brief a compact binary file (.oclmesh) for reloading an STLSurf quickly
+///
+/// The file holds the welded vertices of the surface, three vertex indices per triangle,
+/// and the normal and bounding-box of each triangle, so that no STL text is parsed and
+/// no normals are calculated when loading. A spatial index built over the surface can
+/// be stored with it, and is then searched in place in the memory-mapped file.
+///
+/// The PackedSurf and IndexedMesh used by the cutters (see IndexCache::arrays()) are stored
+/// too, and like the arrays of an embedded index they are searched in place in the mapped file.
+/// Only the Triangle objects are built, because STLSurf stores them by value: load() copies
+/// each triangle once out of the mapped arrays.
+/// The file is versioned and checksummed, and like an index file, see SpatialIndex::save(),
+/// not portable between platforms with different byte order.
+class MeshCache {
+    public:
+        /// \brief write the triangles of s to filename.
+        ///
+        /// If idx is not NULL, it must have been built over the triangles of s, and is saved too.
+        static bool save(const std::string& filename, const STLSurf& s, const SpatialIndex* idx = NULL);
+        /// \brief add the triangles in filename, written by save(), to the empty surface s.
+        ///
+        /// The triangles are copied from the mapped file into s, in parallel, with
+        /// their saved normals and bounding-boxes. s keeps the mapped arrays, see STLSurf::setArrays().
+        /// If the file holds an index it is returned in idx, and added to the IndexCache, so that
+        /// Operations on s with the same index settings use it. The caller keeps idx
+        /// for as long as it should be re-used. Otherwise idx is reset.
+        static bool load(const std::string& filename, STLSurf& s, boost::shared_ptr<SpatialIndex>& idx);
+        /// convert the STL file stlfile to a cache file, without an index
+        static bool convert(const std::wstring& stlfile, const std::string& filename);
+    protected:
+        /// checksum of the 64-bit words in [data, data+bytes), bytes a multiple of 8
+        static boost::uint64_t checksum(const char* data, boost::uint64_t bytes);
+};
+
+} // end ocl namespace
+#endif
+// end file meshcache.hpp
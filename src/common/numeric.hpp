@@ -23,6 +23,8 @@
 
 #include <string>
 
+#include <boost/cstdint.hpp>
+
 #include "point.hpp"
 
 #ifdef _MSC_VER
@@ -93,6 +95,17 @@ bool xy_line_line_intersection( const Point& p1, const Point& p2, double& v,
 /// convert the direction (x,y) into a diangle
 double xyVectorToDiangle(double x, double y);
 
+/// spread the low 16 bits of x to the even bits of the result.
+/// morton_spread(x) | (morton_spread(y) << 1) is the 2D Morton code of (x,y).
+inline boost::uint32_t morton_spread(boost::uint32_t x) {
+    x &= 0x0000FFFF;
+    x = (x | (x << 8)) & 0x00FF00FF;
+    x = (x | (x << 4)) & 0x0F0F0F0F;
+    x = (x | (x << 2)) & 0x33333333;
+    x = (x | (x << 1)) & 0x55555555;
+    return x;
+}
+
 
 } // end ocl namespace
 #endif
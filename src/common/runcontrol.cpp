@@ -0,0 +1,115 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010-2011 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <iostream>
+
+#include "runcontrol.hpp"
+
+namespace ocl
+{
+
+RunControl::RunControl() : interval(PROGRESS_INTERVAL), budget(0), overBudget(false), depth(0),
+                           window(0, 1), total(1), done(0), reported(0) {}
+
+void RunControl::setCallback(boost::shared_ptr<ProgressCallback> c) {
+    boost::mutex::scoped_lock lock(mutex);
+    callback = c;
+}
+
+void RunControl::setCancelToken(boost::shared_ptr<CancelToken> t) {
+    boost::mutex::scoped_lock lock(mutex);
+    token = t;
+}
+
+double RunControl::elapsed() const {
+    return ( boost::posix_time::microsec_clock::universal_time() - startTime ).total_microseconds() * 1e-6;
+}
+
+void RunControl::begin() {
+    boost::mutex::scoped_lock lock(mutex);
+    if ( depth == 0 ) {
+        owner = boost::this_thread::get_id();
+        startTime = boost::posix_time::microsec_clock::universal_time();
+        reportTime = startTime;
+        overBudget = false;
+        reported = 0;
+        window = Window(0, 1);
+    }
+    ++depth;
+    runs.push_back( window );
+    total = 1;
+    done = 0;
+}
+
+void RunControl::end() {
+    boost::unique_lock<boost::mutex> lock(mutex);
+    window = runs.back();
+    runs.pop_back();
+    total = 1;
+    done = 1; // the stage that began the nested run is done with it
+    --depth;
+    if ( depth > 0 )
+        return;
+    if ( overBudget )
+        std::cout << "RunControl: stopped after the time budget of " << budget << " s\n";
+    else if ( token && token->isCancelled() )
+        std::cout << "RunControl: cancelled\n";
+    report(1.0, true, lock);
+}
+
+void RunControl::stage(double lo, double hi, double n) {
+    boost::mutex::scoped_lock lock(mutex);
+    const Window run = runs.empty() ? Window(0, 1) : runs.back();
+    window = Window( run.lo + lo*(run.hi-run.lo), run.lo + hi*(run.hi-run.lo) );
+    total = (n > 0) ? n : 1;
+    done = 0;
+}
+
+void RunControl::advance(double n) {
+    boost::unique_lock<boost::mutex> lock(mutex);
+    done = std::min( done+n, total );
+    report( window.lo + (window.hi-window.lo)*done/total, false, lock );
+}
+
+void RunControl::report(double f, bool force, boost::unique_lock<boost::mutex>& lock) {
+    if ( !callback || (boost::this_thread::get_id() != owner) || (f < reported) )
+        return;
+    const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+    if ( !force && ((now-reportTime).total_microseconds() < interval*1e6) )
+        return;
+    reported = f;
+    reportTime = now;
+    boost::shared_ptr<ProgressCallback> c = callback; // the callback may replace it
+    lock.unlock(); // the callback may call stopped() or a CancelToken
+    c->progress(f);
+    lock.lock();
+}
+
+bool RunControl::stopped() {
+    boost::mutex::scoped_lock lock(mutex);
+    if ( !overBudget && (depth > 0) && (budget > 0) && (elapsed() > budget) )
+        overBudget = true;
+    return overBudget || ( token && token->isCancelled() );
+}
+
+} // end ocl namespace
+// end file runcontrol.cpp
@@ -0,0 +1,161 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010-2011 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef RUN_CONTROL_H
+#define RUN_CONTROL_H
+
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+namespace ocl
+{
+
+/// default minimum time, in seconds, between two calls of a ProgressCallback
+#define PROGRESS_INTERVAL 0.1
+
+/// \brief asks the operations that share it to stop.
+///
+/// Operations check the token between chunks of work, so they return soon after cancel(),
+/// with the results computed so far. One token can be given to several operations.
+class CancelToken {
+    public:
+        CancelToken() : cancelled(false) {}
+        virtual ~CancelToken() {}
+        /// ask the operations to stop. Can be called from any thread.
+        void cancel() {
+            boost::mutex::scoped_lock lock(mutex);
+            cancelled = true;
+        }
+        /// clear the token, so that it can be used for another run
+        void reset() {
+            boost::mutex::scoped_lock lock(mutex);
+            cancelled = false;
+        }
+        /// true after cancel()
+        bool isCancelled() const {
+            boost::mutex::scoped_lock lock(mutex);
+            return cancelled;
+        }
+    private:
+        /// guards cancelled
+        mutable boost::mutex mutex;
+        /// true after cancel()
+        bool cancelled;
+};
+
+/// \brief receives the progress of an Operation
+class ProgressCallback {
+    public:
+        virtual ~ProgressCallback() {}
+        /// \brief the run is fraction done, from 0.0 to 1.0.
+        ///
+        /// Called on the thread that called run(), with increasing fractions, and 1.0 at the end.
+        virtual void progress(double fraction) = 0;
+};
+
+/// \brief the progress, cancellation and time budget of a run of an Operation.
+///
+/// An Operation shares its RunControl with its sub-operations. The run() of an
+/// operation is split into stages, each a part of the fractions 0 to 1, and a
+/// sub-operation run from a stage reports its own progress within that stage.
+/// advance() and stopped() may be called from any thread.
+class RunControl {
+    public:
+        RunControl();
+        virtual ~RunControl() {}
+        /// report progress to c, or to no one if c is empty
+        void setCallback(boost::shared_ptr<ProgressCallback> c);
+        /// call the ProgressCallback at most every s seconds
+        void setInterval(double s) {interval = s;}
+        /// stop when t is cancelled, or never if t is empty
+        void setCancelToken(boost::shared_ptr<CancelToken> t);
+        /// stop when a run has taken s seconds, or never if s is zero
+        void setTimeBudget(double s) {budget = s;}
+        /// the time budget, zero if there is none
+        double getTimeBudget() const {return budget;}
+        /// \brief start a run, or a run nested in the current stage.
+        ///
+        /// The outermost begin() starts the clock of the time budget, and makes the calling
+        /// thread the one that the ProgressCallback is called on.
+        void begin();
+        /// end what begin() started. The outermost end() reports 1.0.
+        void end();
+        /// \brief the next stage of the current run covers the fractions lo to hi of it,
+        /// and is done when advance() has added up to total.
+        void stage(double lo, double hi, double total);
+        /// n more units of the current stage are done
+        void advance(double n);
+        /// true if the run should stop, because the token was cancelled or the budget is used up
+        bool stopped();
+    private:
+        /// the fractions of the outermost run covered by a run or a stage
+        class Window {
+            public:
+                Window(double l, double h) : lo(l), hi(h) {}
+                /// fraction at the start
+                double lo;
+                /// fraction at the end
+                double hi;
+        };
+        /// seconds since the outermost begin()
+        double elapsed() const;
+        /// report fraction f to the callback, if this is the run() thread and the interval has passed
+        void report(double f, bool force, boost::unique_lock<boost::mutex>& lock);
+    // DATA
+        /// guards all the data below
+        boost::mutex mutex;
+        /// receives the progress
+        boost::shared_ptr<ProgressCallback> callback;
+        /// the token, if any
+        boost::shared_ptr<CancelToken> token;
+        /// minimum seconds between two reports
+        double interval;
+        /// seconds a run may take, or zero
+        double budget;
+        /// true when the budget of the current or last run was used up
+        bool overBudget;
+        /// number of begin() without end()
+        unsigned int depth;
+        /// the window of each unfinished begin()
+        std::vector<Window> runs;
+        /// the window of the current stage
+        Window window;
+        /// units of the current stage
+        double total;
+        /// units done of the current stage
+        double done;
+        /// the last fraction reported
+        double reported;
+        /// the thread of the outermost begin()
+        boost::thread::id owner;
+        /// time of the outermost begin()
+        boost::posix_time::ptime startTime;
+        /// time of the last report
+        boost::posix_time::ptime reportTime;
+};
+
+} // end ocl namespace
+#endif
+// end file runcontrol.hpp
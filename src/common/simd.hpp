@@ -0,0 +1,192 @@
+/*  $Id$
+ * 
+ *  Copyright (c) 2010 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *  
+ *  This file is part of OpenCAMlib 
+ *  (see https://github.com/aewallin/opencamlib).
+ *  
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <cmath>
+
+// the widest instruction set enabled in the compiler flags, see the USE_AVX2 option in CMakeLists.txt
+#if defined(__AVX__)
+    #include <immintrin.h>
+    #define OCL_SIMD_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && (_M_IX86_FP >= 2) )
+    #include <emmintrin.h>
+    #define OCL_SIMD_SSE2
+#endif
+
+namespace ocl
+{
+
+///
+/// \brief a few doubles processed by one SIMD instruction.
+///
+/// SimdDouble holds SimdDouble::width doubles: four with AVX, two with SSE2, and
+/// otherwise one, in which case the operations are plain double arithmetic.
+/// A comparison gives a SimdMask with one element per double.
+/// Only the operations needed by the cutter kernels, see DropPacket and DropBlock, are provided.
+///
+#if defined(OCL_SIMD_AVX)
+
+class SimdMask {
+    public:
+        SimdMask(__m256d m) : v(m) {}
+        /// true if any element is set
+        bool any() const {return _mm256_movemask_pd(v) != 0;}
+        /// bit m is set if element m is set
+        int bits() const {return _mm256_movemask_pd(v);}
+        /// element-wise and
+        SimdMask operator&(const SimdMask& o) const {return _mm256_and_pd(v, o.v);}
+        /// the elements
+        __m256d v;
+};
+
+class SimdDouble {
+    public:
+        /// number of doubles
+        enum { width = 4 };
+        SimdDouble() {}
+        SimdDouble(__m256d x) : v(x) {}
+        /// all elements equal to d
+        explicit SimdDouble(double d) : v( _mm256_set1_pd(d) ) {}
+        /// load width doubles from p
+        static SimdDouble load(const double* p) {return _mm256_loadu_pd(p);}
+        /// store width doubles at p
+        void store(double* p) const {_mm256_storeu_pd(p, v);}
+        SimdDouble operator+(const SimdDouble& o) const {return _mm256_add_pd(v, o.v);}
+        SimdDouble operator-(const SimdDouble& o) const {return _mm256_sub_pd(v, o.v);}
+        SimdDouble operator*(const SimdDouble& o) const {return _mm256_mul_pd(v, o.v);}
+        SimdDouble operator/(const SimdDouble& o) const {return _mm256_div_pd(v, o.v);}
+        SimdMask operator<=(const SimdDouble& o) const {return _mm256_cmp_pd(v, o.v, _CMP_LE_OQ);}
+        SimdMask operator>(const SimdDouble& o) const {return _mm256_cmp_pd(v, o.v, _CMP_GT_OQ);}
+        SimdMask operator<(const SimdDouble& o) const {return _mm256_cmp_pd(v, o.v, _CMP_LT_OQ);}
+        SimdMask operator>=(const SimdDouble& o) const {return _mm256_cmp_pd(v, o.v, _CMP_GE_OQ);}
+        SimdDouble operator-() const {return _mm256_xor_pd(v, _mm256_set1_pd(-0.0));}
+        /// the elements
+        __m256d v;
+};
+
+/// element-wise square root
+inline SimdDouble simd_sqrt(const SimdDouble& a) {return _mm256_sqrt_pd(a.v);}
+/// element-wise absolute value
+inline SimdDouble simd_abs(const SimdDouble& a) {return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a.v);}
+/// element-wise m ? a : b
+inline SimdDouble simd_select(const SimdMask& m, const SimdDouble& a, const SimdDouble& b) {return _mm256_blendv_pd(b.v, a.v, m.v);}
+
+#elif defined(OCL_SIMD_SSE2)
+
+class SimdMask {
+    public:
+        SimdMask(__m128d m) : v(m) {}
+        /// true if any element is set
+        bool any() const {return _mm_movemask_pd(v) != 0;}
+        /// bit m is set if element m is set
+        int bits() const {return _mm_movemask_pd(v);}
+        /// element-wise and
+        SimdMask operator&(const SimdMask& o) const {return _mm_and_pd(v, o.v);}
+        /// the elements
+        __m128d v;
+};
+
+class SimdDouble {
+    public:
+        /// number of doubles
+        enum { width = 2 };
+        SimdDouble() {}
+        SimdDouble(__m128d x) : v(x) {}
+        /// all elements equal to d
+        explicit SimdDouble(double d) : v( _mm_set1_pd(d) ) {}
+        /// load width doubles from p
+        static SimdDouble load(const double* p) {return _mm_loadu_pd(p);}
+        /// store width doubles at p
+        void store(double* p) const {_mm_storeu_pd(p, v);}
+        SimdDouble operator+(const SimdDouble& o) const {return _mm_add_pd(v, o.v);}
+        SimdDouble operator-(const SimdDouble& o) const {return _mm_sub_pd(v, o.v);}
+        SimdDouble operator*(const SimdDouble& o) const {return _mm_mul_pd(v, o.v);}
+        SimdDouble operator/(const SimdDouble& o) const {return _mm_div_pd(v, o.v);}
+        SimdMask operator<=(const SimdDouble& o) const {return _mm_cmple_pd(v, o.v);}
+        SimdMask operator>(const SimdDouble& o) const {return _mm_cmpgt_pd(v, o.v);}
+        SimdMask operator<(const SimdDouble& o) const {return _mm_cmplt_pd(v, o.v);}
+        SimdMask operator>=(const SimdDouble& o) const {return _mm_cmpge_pd(v, o.v);}
+        SimdDouble operator-() const {return _mm_xor_pd(v, _mm_set1_pd(-0.0));}
+        /// the elements
+        __m128d v;
+};
+
+/// element-wise square root
+inline SimdDouble simd_sqrt(const SimdDouble& a) {return _mm_sqrt_pd(a.v);}
+/// element-wise absolute value
+inline SimdDouble simd_abs(const SimdDouble& a) {return _mm_andnot_pd(_mm_set1_pd(-0.0), a.v);}
+/// element-wise m ? a : b
+inline SimdDouble simd_select(const SimdMask& m, const SimdDouble& a, const SimdDouble& b) {
+    return _mm_or_pd( _mm_and_pd(m.v, a.v), _mm_andnot_pd(m.v, b.v) );
+}
+
+#else // portable fallback, one double
+
+class SimdMask {
+    public:
+        SimdMask(bool m) : v(m) {}
+        /// true if any element is set
+        bool any() const {return v;}
+        /// bit 0 is set if the element is set
+        int bits() const {return v ? 1 : 0;}
+        /// element-wise and
+        SimdMask operator&(const SimdMask& o) const {return v && o.v;}
+        /// the element
+        bool v;
+};
+
+class SimdDouble {
+    public:
+        /// number of doubles
+        enum { width = 1 };
+        SimdDouble() {}
+        /// all elements equal to d
+        explicit SimdDouble(double d) : v(d) {}
+        /// load width doubles from p
+        static SimdDouble load(const double* p) {return SimdDouble(*p);}
+        /// store width doubles at p
+        void store(double* p) const {*p = v;}
+        SimdDouble operator+(const SimdDouble& o) const {return SimdDouble(v + o.v);}
+        SimdDouble operator-(const SimdDouble& o) const {return SimdDouble(v - o.v);}
+        SimdDouble operator*(const SimdDouble& o) const {return SimdDouble(v * o.v);}
+        SimdDouble operator/(const SimdDouble& o) const {return SimdDouble(v / o.v);}
+        SimdMask operator<=(const SimdDouble& o) const {return v <= o.v;}
+        SimdMask operator>(const SimdDouble& o) const {return v > o.v;}
+        SimdMask operator<(const SimdDouble& o) const {return v < o.v;}
+        SimdMask operator>=(const SimdDouble& o) const {return v >= o.v;}
+        SimdDouble operator-() const {return SimdDouble(-v);}
+        /// the element
+        double v;
+};
+
+/// element-wise square root
+inline SimdDouble simd_sqrt(const SimdDouble& a) {return SimdDouble( sqrt(a.v) );}
+/// element-wise absolute value
+inline SimdDouble simd_abs(const SimdDouble& a) {return SimdDouble( fabs(a.v) );}
+/// element-wise m ? a : b
+inline SimdDouble simd_select(const SimdMask& m, const SimdDouble& a, const SimdDouble& b) {return m.v ? a : b;}
+
+#endif
+
+} // end namespace
+#endif
+// end file simd.hpp
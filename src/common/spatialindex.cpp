@@ -0,0 +1,478 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010-2011 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cassert>
+#include <cstring>
+#include <sstream>
+#include <fstream>
+
+#include <boost/static_assert.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include "spatialindex.hpp"
+#include "flatkdtree.hpp"
+#include "bvh.hpp"
+#include "gridindex.hpp"
+#include "fiberindex.hpp"
+#include "mappedfile.hpp"
+#include "stlsurf.hpp"
+#include "indexcache.hpp"
+
+namespace ocl
+{
+
+/// version of the index file format written by SpatialIndex::save()
+#define INDEX_FILE_VERSION 3
+/// vertices closer than this are welded into one vertex of the IndexedMesh
+#define MESH_WELD_TOLERANCE 1E-9
+
+/// \brief header of an index file.
+///
+/// The header is followed by nParams doubles, a table of nBlocks (offset, bytes) pairs,
+/// and the data blocks. Block 0 holds the triangles as 9 doubles each, block 1 the
+/// index-array, the next nArrayBlocks the SurfaceArrays of the triangles, and the rest
+/// are specific to the type of index. The triangles and arrays are empty in a file
+/// saved without triangles.
+class IndexFileHeader {
+    public:
+        /// "OCLINDEX"
+        char magic[8];
+        /// INDEX_FILE_VERSION
+        boost::uint32_t version;
+        /// 1, written in the byte order of the platform
+        boost::uint32_t byteOrder;
+        /// SpatialIndexType
+        boost::uint32_t type;
+        /// bucket size
+        boost::uint32_t bucketSize;
+        /// 1 for the SAH split rule
+        boost::uint32_t sah;
+        /// number of triangles
+        boost::uint32_t nTriangles;
+        /// length of the index-array
+        boost::uint32_t nIndex;
+        /// number of leaf nodes
+        boost::uint32_t nLeaves;
+        /// depth of the deepest leaf
+        boost::uint32_t maxDepth;
+        /// number of type-specific parameters
+        boost::uint32_t nParams;
+        /// number of data blocks
+        boost::uint32_t nBlocks;
+        /// search dimensions
+        boost::int32_t dimensions[4];
+        /// number of SurfaceArrays blocks, SURFACE_ARRAYS_BLOCKS or 0
+        boost::uint32_t nArrayBlocks;
+        /// query size
+        double queryExtent[3];
+};
+BOOST_STATIC_ASSERT( sizeof(IndexFileHeader) == 96 );
+
+/// round n up to a multiple of INDEX_FILE_ALIGN
+static boost::uint64_t align_up(boost::uint64_t n) {
+    return ( (n + INDEX_FILE_ALIGN - 1)/INDEX_FILE_ALIGN )*INDEX_FILE_ALIGN;
+}
+
+SpatialIndex::SpatialIndex() {
+    bucketSize = 1;
+    sah = false;
+    setCutterSize(0.0, 0.0);
+    nLeaves = 0;
+    maxDepth = 0;
+    buildSeconds = 0.0;
+    indexData = NULL;
+    indexLength = 0;
+    presorted = NULL;
+    arrays.reset( new SurfaceArrays() );
+}
+
+SpatialIndex* SpatialIndex::create(SpatialIndexType t) {
+    switch (t) {
+        case BVHIndexType:
+            return new BVH();
+        case GridIndexType:
+            return new GridIndex();
+        case FiberIndexType:
+            return new FiberIndex();
+        case KDTreeIndexType:
+        default:
+            return new FlatKDTree();
+    }
+}
+
+bool SpatialIndex::sameSettings(const SpatialIndex& o) const {
+    if ( (type() != o.type()) || (bucketSize != o.bucketSize) || (sah != o.sah) || (dimensions != o.dimensions) )
+        return false;
+    if ( !sah && (type() != GridIndexType) ) // the query size only matters for SAH and grids
+        return true;
+    for (int n=0;n<3;++n) {
+        if ( queryExtent[n] != o.queryExtent[n] )
+            return false;
+    }
+    return true;
+}
+
+SpatialIndex* SpatialIndex::emptyCopy() const {
+    SpatialIndex* idx = create( type() );
+    idx->bucketSize = bucketSize;
+    idx->sah = sah;
+    for (int n=0;n<3;++n)
+        idx->queryExtent[n] = queryExtent[n];
+    idx->dimensions = dimensions;
+    return idx;
+}
+
+void SpatialIndex::setCutterSize(double radius, double length) {
+    queryExtent[0] = 2*radius; // x
+    queryExtent[1] = 2*radius; // y
+    queryExtent[2] = length;   // z
+}
+
+void SpatialIndex::setXYDimensions() {
+    dimensions.clear();
+    dimensions.push_back(0); // x
+    dimensions.push_back(1); // x
+    dimensions.push_back(2); // y
+    dimensions.push_back(3); // y
+}
+
+void SpatialIndex::setYZDimensions() {
+    dimensions.clear();
+    dimensions.push_back(2); // y
+    dimensions.push_back(3); // y
+    dimensions.push_back(4); // z
+    dimensions.push_back(5); // z
+}
+
+void SpatialIndex::setXZDimensions() {
+    dimensions.clear();
+    dimensions.push_back(0); // x
+    dimensions.push_back(1); // x
+    dimensions.push_back(4); // z
+    dimensions.push_back(5); // z
+}
+
+void SpatialIndex::search_cutter_overlap(const MillingCutter* c, const CLPoint* cl, std::vector<IndexSpan>& spans) const {
+    search( cutter_bbox(c, cl), spans);
+}
+
+void SpatialIndex::visit_cutter_overlap(const MillingCutter* c, const CLPoint* cl, TriangleVisitor& v) const {
+    visit( cutter_bbox(c, cl), v);
+}
+
+void SpatialIndex::visit_cutter_above(const MillingCutter* c, const CLPoint* cl, ZBoundVisitor& v) const {
+    visit_above( cutter_bbox(c, cl), v);
+}
+
+Bbox SpatialIndex::cutter_bbox(const MillingCutter* c, const CLPoint* cl) {
+    double r = c->getRadius();
+    // build a bounding-box at the current CL
+    return Bbox( cl->x-r, cl->x+r, cl->y-r, cl->y+r, cl->z, cl->z+c->getLength() );
+}
+
+void SpatialIndex::build(const STLSurf& s) {
+    std::vector<boost::uint64_t> order; // sorted here only if this index needs it and s has none
+    presorted = s.getMortonOrder();
+    if ( !presorted && usesMortonOrder() ) {
+        s.calcMortonOrder(order);
+        presorted = &order;
+    }
+    presetArrays = IndexCache::arrays(s);
+    build(s.getTriangles());
+    presorted = NULL;
+    presetArrays.reset();
+}
+
+void SurfaceArrays::build(const std::vector<const Triangle*>& tris) {
+    mapping.reset();
+    packed.build( tris );
+    mesh.build( tris, MESH_WELD_TOLERANCE );
+}
+
+void SurfaceArrays::save_blocks(std::vector<FileBlock>& blocks) const {
+    packed.save_blocks( blocks );
+    mesh.save_blocks( blocks );
+}
+
+bool SurfaceArrays::map_blocks(const std::vector<FileBlock>& blocks, unsigned int first, unsigned int n,
+                               boost::shared_ptr<MappedFile> file) {
+    if ( !packed.map_blocks( blocks, first, n ) || !mesh.map_blocks( blocks, first + PACKED_SURF_BLOCKS, n ) ) {
+        packed.clear();
+        mesh.clear();
+        mapping.reset();
+        return false;
+    }
+    mapping = file;
+    return true;
+}
+
+bool SpatialIndex::init_index(const std::vector<Triangle>& list) {
+    assert( !dimensions.empty() );
+    mapping.reset();
+    indexData = NULL;
+    indexLength = 0;
+    index.clear();
+    tris.clear();
+    nLeaves = 0;
+    maxDepth = 0;
+    tris.reserve( list.size() );
+    index.reserve( list.size() );
+    BOOST_FOREACH(const Triangle& t, list) {
+        index.push_back( tris.size() );
+        tris.push_back( &t );
+    }
+    if ( presetArrays && (presetArrays->size() == tris.size()) ) {
+        arrays = presetArrays;
+    } else {
+        boost::shared_ptr<SurfaceArrays> a( new SurfaceArrays() );
+        a->build( tris );
+        arrays = a;
+    }
+    return !index.empty();
+}
+
+void SpatialIndex::append_span(std::vector<IndexSpan>& spans, unsigned int first, unsigned int last) {
+    if ( !spans.empty() && (spans.back().last == first) )
+        spans.back().last = last;
+    else
+        spans.push_back( IndexSpan(first, last) );
+}
+
+double SpatialIndex::wall_time() {
+    const boost::posix_time::ptime epoch( boost::gregorian::date(1970, 1, 1) );
+    return ( boost::posix_time::microsec_clock::universal_time() - epoch ).total_microseconds() * 1e-6;
+}
+
+void SpatialIndex::update_views() {
+    indexData = index.empty() ? NULL : &index[0];
+    indexLength = index.size();
+}
+
+bool SpatialIndex::save(const std::string& filename) const {
+    if ( tris.empty() ) {
+        std::cout << "SpatialIndex::save() ERROR: the index is empty\n";
+        return false;
+    }
+    std::ofstream out( filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+    if ( !out ) {
+        std::cout << "SpatialIndex::save() ERROR: can't open " << filename << "\n";
+        return false;
+    }
+    save(out, true);
+    out.close();
+    if ( !out ) {
+        std::cout << "SpatialIndex::save() ERROR: writing " << filename << " failed\n";
+        return false;
+    }
+    return true;
+}
+
+void SpatialIndex::save(std::ostream& out, bool withTriangles) const {
+    const boost::uint64_t start = out.tellp();
+    std::vector<double> params;
+    std::vector<FileBlock> blocks;
+    std::vector<double> coords;
+    if (withTriangles) {
+        coords.reserve( 9*tris.size() );
+        BOOST_FOREACH(const Triangle* t, tris) {
+            for (int m=0;m<3;++m) {
+                coords.push_back( t->p[m].x );
+                coords.push_back( t->p[m].y );
+                coords.push_back( t->p[m].z );
+            }
+        }
+    }
+    blocks.push_back( FileBlock( coords.empty() ? NULL : &coords[0], coords.size()*sizeof(double) ) );
+    blocks.push_back( FileBlock( indexData, indexLength*sizeof(boost::uint32_t) ) );
+    if (withTriangles)
+        arrays->save_blocks(blocks);
+    const unsigned int nArrayBlocks = blocks.size() - 2;
+    save_blocks(params, blocks);
+    
+    IndexFileHeader h;
+    memset( &h, 0, sizeof(h) );
+    memcpy( h.magic, "OCLINDEX", 8 );
+    h.version = INDEX_FILE_VERSION;
+    h.byteOrder = 1;
+    h.type = type();
+    h.bucketSize = bucketSize;
+    h.sah = sah ? 1 : 0;
+    h.nTriangles = tris.size();
+    h.nIndex = indexLength;
+    h.nLeaves = nLeaves;
+    h.maxDepth = maxDepth;
+    h.nParams = params.size();
+    h.nBlocks = blocks.size();
+    h.nArrayBlocks = nArrayBlocks;
+    for (unsigned int m=0; m<dimensions.size() && m<4; ++m)
+        h.dimensions[m] = dimensions[m];
+    for (int m=0;m<3;++m)
+        h.queryExtent[m] = queryExtent[m];
+    // the block table, with offsets from the start of the header
+    std::vector<boost::uint64_t> table;
+    boost::uint64_t offset = align_up( sizeof(h) + params.size()*sizeof(double) + 2*blocks.size()*sizeof(boost::uint64_t) );
+    BOOST_FOREACH(const FileBlock& b, blocks) {
+        table.push_back( offset );
+        table.push_back( b.bytes );
+        offset = align_up( offset + b.bytes );
+    }
+    
+    out.write( (const char*) &h, sizeof(h) );
+    if ( !params.empty() )
+        out.write( (const char*) &params[0], params.size()*sizeof(double) );
+    out.write( (const char*) &table[0], table.size()*sizeof(boost::uint64_t) );
+    const char zeros[INDEX_FILE_ALIGN] = {0};
+    for (unsigned int m=0; m<blocks.size(); ++m) {
+        boost::uint64_t pos = (boost::uint64_t) out.tellp() - start;
+        out.write( zeros, table[2*m] - pos ); // padding
+        if ( blocks[m].bytes > 0 )
+            out.write( (const char*) blocks[m].data, blocks[m].bytes );
+    }
+}
+
+SpatialIndex* SpatialIndex::load(const std::string& filename, STLSurf& s) {
+    if ( s.size() != 0 ) {
+        std::cout << "SpatialIndex::load() ERROR: the STLSurf must be empty\n";
+        return NULL;
+    }
+    boost::shared_ptr<MappedFile> file( new MappedFile() );
+    if ( !file->open(filename) )
+        return NULL;
+    return load(file, 0, file->size(), s);
+}
+
+SpatialIndex* SpatialIndex::load(boost::shared_ptr<MappedFile> file, boost::uint64_t start, boost::uint64_t bytes, STLSurf& s) {
+    double t_start = wall_time();
+    const std::string& filename = file->name();
+    const char* data = file->data() + start;
+    // check the header and the block table
+    IndexFileHeader h;
+    if ( (start % INDEX_FILE_ALIGN != 0) || (bytes < sizeof(h)) || (start > file->size()) || (bytes > file->size()-start) ) {
+        std::cout << "SpatialIndex::load() ERROR: " << filename << " is not an index file\n";
+        return NULL;
+    }
+    memcpy( &h, data, sizeof(h) );
+    if ( memcmp(h.magic, "OCLINDEX", 8) != 0 || (h.byteOrder != 1) ) {
+        std::cout << "SpatialIndex::load() ERROR: " << filename << " is not an index file for this platform\n";
+        return NULL;
+    }
+    if ( h.version != INDEX_FILE_VERSION ) {
+        std::cout << "SpatialIndex::load() ERROR: " << filename << " has version " << h.version;
+        std::cout << ", expected " << INDEX_FILE_VERSION << "\n";
+        return NULL;
+    }
+    boost::uint64_t tableEnd = sizeof(h) + h.nParams*sizeof(double) + 2*h.nBlocks*sizeof(boost::uint64_t);
+    bool valid = (h.type <= FiberIndexType) && (h.nTriangles > 0) && (tableEnd <= bytes);
+    valid = valid && ( (h.nArrayBlocks == 0) || (h.nArrayBlocks == SURFACE_ARRAYS_BLOCKS) ) && (h.nBlocks >= 2 + h.nArrayBlocks);
+    std::vector<double> params;
+    std::vector<FileBlock> blocks;
+    if (valid) {
+        params.resize( h.nParams );
+        if ( h.nParams > 0 )
+            memcpy( &params[0], data + sizeof(h), h.nParams*sizeof(double) );
+        std::vector<boost::uint64_t> table( 2*h.nBlocks );
+        memcpy( &table[0], data + sizeof(h) + h.nParams*sizeof(double), table.size()*sizeof(boost::uint64_t) );
+        for (unsigned int m=0; m<h.nBlocks; ++m) {
+            boost::uint64_t offset = table[2*m];
+            boost::uint64_t n = table[2*m+1];
+            if ( (offset % INDEX_FILE_ALIGN != 0) || (offset > bytes) || (n > bytes-offset) )
+                valid = false;
+            else
+                blocks.push_back( FileBlock( data + offset, n ) );
+        }
+    }
+    // the triangles are either in block 0, and added to the empty s,
+    // or were saved elsewhere and are already in s
+    const bool inFile = valid && ( blocks[0].bytes > 0 );
+    if ( valid && !inFile && (s.size() != h.nTriangles) ) {
+        std::cout << "SpatialIndex::load() ERROR: the index in " << filename << " is for " << h.nTriangles;
+        std::cout << " triangles, but the STLSurf has " << s.size() << "\n";
+        return NULL;
+    }
+    if ( inFile && (s.size() != 0) ) {
+        std::cout << "SpatialIndex::load() ERROR: the STLSurf must be empty\n";
+        return NULL;
+    }
+    valid = valid && ( !inFile || (blocks[0].bytes == 9*sizeof(double)*(boost::uint64_t)h.nTriangles) );
+    valid = valid && ( blocks[1].bytes == sizeof(boost::uint32_t)*(boost::uint64_t)h.nIndex );
+    if (valid) {
+        const boost::uint32_t* idx = (const boost::uint32_t*) blocks[1].data;
+        for (unsigned int m=0; m<h.nIndex; ++m) {
+            if ( idx[m] >= h.nTriangles ) {
+                valid = false;
+                break;
+            }
+        }
+    }
+    if (!valid) {
+        std::cout << "SpatialIndex::load() ERROR: " << filename << " is damaged\n";
+        return NULL;
+    }
+    SpatialIndex* si = create( (SpatialIndexType) h.type );
+    si->bucketSize = h.bucketSize;
+    si->sah = (h.sah != 0);
+    for (int m=0;m<3;++m)
+        si->queryExtent[m] = h.queryExtent[m];
+    si->dimensions.assign( h.dimensions, h.dimensions+4 );
+    si->indexData = (const boost::uint32_t*) blocks[1].data;
+    si->indexLength = h.nIndex;
+    si->nLeaves = h.nLeaves;
+    si->maxDepth = h.maxDepth;
+    si->mapping = file;
+    if ( !si->map_blocks(params, std::vector<FileBlock>( blocks.begin() + 2 + h.nArrayBlocks, blocks.end() )) ) {
+        std::cout << "SpatialIndex::load() ERROR: " << filename << " is damaged\n";
+        delete si;
+        return NULL;
+    }
+    if (inFile) { // the triangles go into s, in the saved order
+        const double* c = (const double*) blocks[0].data;
+        s.reserve( h.nTriangles );
+        for (unsigned int m=0; m<h.nTriangles; ++m, c+=9)
+            s.addTriangle( Triangle( Point(c[0],c[1],c[2]), Point(c[3],c[4],c[5]), Point(c[6],c[7],c[8]) ) );
+    }
+    if ( inFile && (h.nArrayBlocks > 0) ) { // the arrays are used in place
+        boost::shared_ptr<SurfaceArrays> a( new SurfaceArrays() );
+        if ( a->map_blocks(blocks, 2, h.nTriangles, file) )
+            s.setArrays(a);
+        else
+            std::cout << "SpatialIndex::load() WARNING: the arrays in " << filename << " are damaged, and are built again\n";
+    }
+    si->tris.reserve( s.size() );
+    BOOST_FOREACH(const Triangle& t, s.getTriangles())
+        si->tris.push_back( &t );
+    si->arrays = IndexCache::arrays(s);
+    si->buildSeconds = wall_time() - t_start;
+    return si;
+}
+
+std::string SpatialIndex::stats_str() const {
+    std::ostringstream o;
+    o << "N=" << tris.size() << ", bucketSize=" << bucketSize;
+    o << ", split=" << (sah ? "SAH" : "midpoint");
+    o << ", nodes=" << nodeCount() << ", leaves=" << nLeaves << ", depth=" << maxDepth;
+    if (nLeaves > 0)
+        o << ", avg. leaf size=" << ((double)tris.size())/nLeaves;
+    o << (isMapped() ? ", load time=" : ", build time=") << buildSeconds << " s";
+    return o.str();
+}
+
+} // end ocl namespace
+// end file spatialindex.cpp
@@ -0,0 +1,288 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010-2011 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SPATIAL_INDEX_H
+#define SPATIAL_INDEX_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/foreach.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "bbox.hpp"
+#include "triangle.hpp"
+#include "packedsurf.hpp"
+#include "indexedmesh.hpp"
+#include "millingcutter.hpp"
+#include "clpoint.hpp"
+#include "trianglevisitor.hpp"
+#include "mappedfile.hpp"
+
+namespace ocl
+{
+
+class STLSurf;
+
+/// blocks in an index file start at multiples of this, and so must an index saved within another file
+#define INDEX_FILE_ALIGN 8
+
+/// type of spatial index used by an Operation to find triangles under the cutter
+enum SpatialIndexType {
+    KDTreeIndexType,    ///< FlatKDTree, the default
+    BVHIndexType,       ///< bounding volume hierarchy, BVH
+    GridIndexType,      ///< uniform grid, GridIndex
+    FiberIndexType      ///< slabs of interval trees for push-cutter fibers, FiberIndex
+};
+
+/// \brief a contiguous range [first, last) of positions in the index-array of a SpatialIndex.
+///
+/// A search returns IndexSpans instead of copies of the found triangles.
+/// Use SpatialIndex::get() to access the triangle at a position.
+class IndexSpan {
+    public:
+        IndexSpan() : first(0), last(0) {}
+        /// span from f up to (but not including) l
+        IndexSpan(unsigned int f, unsigned int l) : first(f), last(l) {}
+        /// number of positions in the span
+        unsigned int size() const {return last-first;}
+        /// first position
+        unsigned int first;
+        /// one past the last position
+        unsigned int last;
+};
+
+/// number of blocks saved by SurfaceArrays::save_blocks()
+#define SURFACE_ARRAYS_BLOCKS (PACKED_SURF_BLOCKS + INDEXED_MESH_BLOCKS)
+
+/// \brief the triangles of a surface in the forms used by the cutter kernels.
+///
+/// Built once for each surface and revision, and shared by all the indexes
+/// over the surface, see IndexCache::arrays(). Index and mesh files store them,
+/// and they are then searched in place in the mapped file, see map_blocks().
+class SurfaceArrays {
+    public:
+        /// build both forms over tris, a pointer-table in surface order
+        void build(const std::vector<const Triangle*>& tris);
+        /// number of triangles
+        unsigned int size() const {return packed.size();}
+        /// append the SURFACE_ARRAYS_BLOCKS arrays of both forms to blocks, for a file
+        void save_blocks(std::vector<FileBlock>& blocks) const;
+        /// \brief use the arrays of n triangles saved by save_blocks() in file, in place.
+        ///
+        /// blocks[first] is the first of them. Keeps file open while the arrays are used.
+        /// returns false if the blocks are not arrays of n triangles.
+        bool map_blocks(const std::vector<FileBlock>& blocks, unsigned int first, unsigned int n,
+                        boost::shared_ptr<MappedFile> file);
+        /// true if the arrays are in a mapped file
+        bool isMapped() const {return mapping.get() != NULL;}
+        /// the triangles, packed
+        PackedSurf packed;
+        /// the triangles, welded
+        IndexedMesh mesh;
+    protected:
+        /// the file that holds the arrays, if they are mapped
+        boost::shared_ptr<MappedFile> mapping;
+};
+
+///
+/// \brief spatial index virtual base class
+///
+/// A spatial index finds the triangles of an STLSurf that overlap a Bbox, in a plane
+/// selected with setXYDimensions(), setYZDimensions() or setXZDimensions().
+/// Triangles are not copied. The index stores 32-bit triangle indices in an
+/// index-array which sub-classes permute so that each leaf is a contiguous range.
+///
+/// A built index can be saved to a file with save(), together with the triangles.
+/// load() maps the file into memory and searches the arrays in the file directly.
+class SpatialIndex {
+    public:
+        SpatialIndex();
+        virtual ~SpatialIndex() {}
+        /// set the bucket-size, the maximum number of triangles in a leaf
+        void setBucketSize(unsigned int b) {bucketSize = b;}
+        /// return the bucket-size
+        unsigned int getBucketSize() const {return bucketSize;}
+        /// use a surface-area-heuristic (SAH) split rule when building.
+        void setSAH(bool b) {sah = b;}
+        /// return true if the SAH split rule is used
+        bool getSAH() const {return sah;}
+        /// \brief set the size of the queries the index is built for.
+        ///
+        /// search_cutter_overlap() queries are 2*radius wide in x and y, and length high in z.
+        /// Used by the SAH cost model, and should be set before build().
+        virtual void setCutterSize(double radius, double length);
+        /// set the search dimension to the XY-plane, for drop-cutter
+        void setXYDimensions();
+        /// set search-plane to YZ, for X-fibers
+        void setYZDimensions();
+        /// set search plane to XZ, for Y-fibers
+        void setXZDimensions();
+        /// build the index over the triangles in list.
+        /// The list must outlive the index, since only pointers and indices are stored.
+        virtual void build(const std::vector<Triangle>& list) = 0;
+        /// \brief build the index over the triangles of surface s.
+        ///
+        /// Same as build(s.getTriangles()), but an index that uses the Morton order of s, see
+        /// usesMortonOrder(), is built from it, and the PackedSurf and IndexedMesh of s are
+        /// shared with other indexes, see IndexCache::arrays(). The Morton order is taken from
+        /// STLSurf::getMortonOrder(), or found here if s has none.
+        void build(const STLSurf& s);
+        /// true if build(const STLSurf&) starts from the Morton order of the surface, with the settings made so far
+        virtual bool usesMortonOrder() const {return false;}
+        /// search for overlap with Bbox bb. IndexSpans for overlapping leaves are appended to spans.
+        virtual void search(const Bbox& bb, std::vector<IndexSpan>& spans) const = 0;
+        /// search for overlap with Bbox bb, and call v.visit() on each found triangle.
+        /// Nothing is allocated, so this is the preferred search in multi-threaded loops.
+        virtual void visit(const Bbox& bb, TriangleVisitor& v) const = 0;
+        /// search for overlap with a MillingCutter c positioned at cl
+        void search_cutter_overlap(const MillingCutter* c, const CLPoint* cl, std::vector<IndexSpan>& spans) const;
+        /// call v.visit() on each triangle overlapping a MillingCutter c positioned at cl
+        void visit_cutter_overlap(const MillingCutter* c, const CLPoint* cl, TriangleVisitor& v) const;
+        /// \brief search for overlap with Bbox bb, and call v.visit() on found triangles above v.bound().
+        ///
+        /// Trees visit the higher child first, and skip subtrees with no point above v.bound(),
+        /// so for drop-cutter the CL-point rises early and most low triangles are never visited.
+        /// The default visits the same triangles as visit().
+        virtual void visit_above(const Bbox& bb, ZBoundVisitor& v) const {visit(bb, v);}
+        /// visit_above() for a MillingCutter c positioned at cl
+        void visit_cutter_above(const MillingCutter* c, const CLPoint* cl, ZBoundVisitor& v) const;
+        /// return the bounding-box of MillingCutter c positioned at cl
+        static Bbox cutter_bbox(const MillingCutter* c, const CLPoint* cl);
+        /// return the Triangle at position pos of the index-array
+        inline const Triangle& get(unsigned int pos) const {return *tris[ indexData[pos] ];}
+        /// return the triangle index, in surface order, at position pos of the index-array
+        inline unsigned int triangleIndex(unsigned int pos) const {return indexData[pos];}
+        /// number of triangles in the index
+        unsigned int size() const {return tris.size();}
+        /// the triangles of the index in structure-of-arrays form, for the cutter kernels.
+        /// Triangle n of the PackedSurf has index n, as passed to TriangleVisitor::visit().
+        /// Shared by the indexes over the same surface.
+        const PackedSurf& getPackedSurf() const {return arrays->packed;}
+        /// the triangles of the index with welded vertices and unique edges.
+        /// Triangle n of the IndexedMesh has index n, as passed to TriangleVisitor::visit().
+        const IndexedMesh& getIndexedMesh() const {return arrays->mesh;}
+        /// the PackedSurf and IndexedMesh of the index, shared with other indexes over the same surface
+        boost::shared_ptr<const SurfaceArrays> getSurfaceArrays() const {return arrays;}
+        /// \brief return true if the index, as built, can answer queries from a cutter of this size.
+        ///
+        /// Trees answer any query. An index that depends on the cutter size, such as
+        /// GridIndex, returns false if it should be re-built with setCutterSize() and build().
+        virtual bool fitsCutter(double radius, double length) const {return true;}
+        /// number of nodes (or cells) in the index
+        virtual unsigned int nodeCount() const = 0;
+        /// number of leaf nodes in the index
+        unsigned int leafCount() const {return nLeaves;}
+        /// depth of the deepest leaf node, the root is at depth zero
+        unsigned int depth() const {return maxDepth;}
+        /// wall-clock time in seconds taken by the last build()
+        double buildTime() const {return buildSeconds;}
+        /// string repr
+        virtual std::string str() const = 0;
+        /// the type of this index
+        virtual SpatialIndexType type() const = 0;
+        /// return true if o is of the same type, with the same settings, so that
+        /// building both over the same triangles gives equal indexes
+        bool sameSettings(const SpatialIndex& o) const;
+        /// return a new, empty, index of the same type and with the same settings
+        SpatialIndex* emptyCopy() const;
+        
+        /// \brief save the index and the triangles to a binary file.
+        ///
+        /// The file starts with a versioned header, followed by a table of data blocks
+        /// which can be used in place when mapped into memory. The file is
+        /// not portable between platforms with different byte order or struct layout.
+        bool save(const std::string& filename) const;
+        /// \brief load an index file written by save().
+        ///
+        /// Adds the saved triangles to s, which must be empty, and returns a new index
+        /// over them, or NULL on error. The index arrays and the SurfaceArrays are not copied,
+        /// but searched in the memory-mapped file, and s keeps the SurfaceArrays, see STLSurf::setArrays().
+        /// Only the Triangle objects of s are built from the file.
+        static SpatialIndex* load(const std::string& filename, STLSurf& s);
+        /// \brief write the index to out, as save() does, at a position that is a multiple of INDEX_FILE_ALIGN.
+        ///
+        /// If withTriangles is false the triangles and their SurfaceArrays are left out, for files that
+        /// store them in another form, see MeshCache.
+        void save(std::ostream& out, bool withTriangles) const;
+        /// \brief load an index written by save(out, withTriangles), from bytes bytes at offset start of file.
+        ///
+        /// An index saved without triangles is loaded over the triangles already in s,
+        /// which must be the ones it was built over. Otherwise s must be empty, and the triangles are added to it.
+        static SpatialIndex* load(boost::shared_ptr<MappedFile> file, boost::uint64_t start, boost::uint64_t bytes, STLSurf& s);
+        /// return true if this index was loaded from a file
+        bool isMapped() const {return mapping.get() != NULL;}
+        
+        /// create a new, empty, spatial index of type t
+        static SpatialIndex* create(SpatialIndexType t);
+    protected:
+        /// the type-specific parameters and data blocks saved by save()
+        virtual void save_blocks(std::vector<double>& params, std::vector<FileBlock>& blocks) const = 0;
+        /// use the parameters and blocks of a mapped index file. returns false if they are invalid.
+        virtual bool map_blocks(const std::vector<double>& params, const std::vector<FileBlock>& blocks) = 0;
+        /// point the search arrays at the built arrays. Called at the end of build().
+        virtual void update_views();
+        /// fill the pointer-table tris and the identity index-array from list. Returns false if list is empty.
+        bool init_index(const std::vector<Triangle>& list);
+        /// append span to spans, merging with the previous span if they are adjacent
+        static void append_span(std::vector<IndexSpan>& spans, unsigned int first, unsigned int last);
+        /// wall-clock time in seconds
+        static double wall_time();
+        /// common part of str(), with the statistics of the last build()
+        std::string stats_str() const;
+    // DATA
+        /// bucket size
+        unsigned int bucketSize;
+        /// true for the SAH split rule, false for the midpoint split rule
+        bool sah;
+        /// query width along x, y, z, used by the SAH cost model
+        double queryExtent[3];
+        /// number of leaf nodes
+        unsigned int nLeaves;
+        /// depth of the deepest leaf
+        unsigned int maxDepth;
+        /// time taken by build()
+        double buildSeconds;
+        /// triangle indices, permuted so that each leaf is a contiguous range
+        std::vector<boost::uint32_t> index;
+        /// the index-array searched, either index or an array in the mapped file
+        const boost::uint32_t* indexData;
+        /// length of indexData
+        unsigned int indexLength;
+        /// the mapped file, for an index created by load()
+        boost::shared_ptr<MappedFile> mapping;
+        /// pointers to the triangles in surface order
+        std::vector<const Triangle*> tris;
+        /// the triangles of tris, packed and welded
+        boost::shared_ptr<const SurfaceArrays> arrays;
+        /// the dimensions used by this index, as indices into Bbox::operator[]
+        std::vector<int> dimensions;
+        /// during build(const STLSurf&), the Morton order of the surface, or NULL
+        const std::vector<boost::uint64_t>* presorted;
+        /// during build(const STLSurf&), the shared arrays of the surface
+        boost::shared_ptr<const SurfaceArrays> presetArrays;
+};
+
+} // end ocl namespace
+#endif
+// end file spatialindex.hpp
@@ -0,0 +1,181 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010-2011 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+
+#ifdef _WIN32
+    #include <windows.h>
+#elif defined(__linux__)
+    #include <pthread.h>
+    #include <sched.h>
+#endif
+
+#include <boost/bind.hpp>
+
+#include "threadpool.hpp"
+
+namespace ocl
+{
+
+// never deleted: the workers are left waiting at exit, as joining threads
+// while a shared library is unloaded can dead-lock
+ThreadPool& ThreadPool::instance() {
+    static ThreadPool* pool = new ThreadPool();
+    return *pool;
+}
+
+unsigned int ThreadPool::cores() {
+    return std::max( 1u, boost::thread::hardware_concurrency() );
+}
+
+ThreadPool::ThreadPool() : stopping(false), running(0), resizing(false), affinity(false), nsize(0) {
+    start( cores() );
+}
+
+ThreadPool::~ThreadPool() {
+    stop();
+}
+
+void ThreadPool::setSize(unsigned int n) {
+    boost::mutex::scoped_lock resizeLock(resize);
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        resizing = true;
+        while ( running > 0 )
+            idle.wait(lock);
+    }
+    stop();
+    start( (n > 0) ? n : cores() );
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        resizing = false;
+    }
+    idle.notify_all();
+}
+
+void ThreadPool::start(unsigned int n) {
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        nsize = n;
+    }
+    for (unsigned int k=0; k+1<n; ++k) {
+        workers.push_back( new boost::thread( boost::bind(&ThreadPool::work, this) ) );
+        pin(k);
+    }
+}
+
+void ThreadPool::stop() {
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        stopping = true;
+    }
+    queued.notify_all();
+    for (unsigned int k=0; k<workers.size(); ++k) {
+        workers[k]->join();
+        delete workers[k];
+    }
+    workers.clear();
+    boost::unique_lock<boost::mutex> lock(mutex);
+    stopping = false;
+}
+
+void ThreadPool::setAffinity(bool a) {
+    boost::mutex::scoped_lock lock(resize);
+    affinity = a;
+    for (unsigned int k=0; k<workers.size(); ++k)
+        pin(k);
+}
+
+void ThreadPool::pin(unsigned int k) {
+    const unsigned int core = (k+1) % cores();
+#ifdef _WIN32
+    DWORD_PTR mask = affinity ? ( (DWORD_PTR) 1 << (core % (8*sizeof(DWORD_PTR))) ) : ~(DWORD_PTR) 0;
+    SetThreadAffinityMask( workers[k]->native_handle(), mask );
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO( &set );
+    if ( affinity ) {
+        CPU_SET( core, &set );
+    } else {
+        for (unsigned int c=0; c<cores(); ++c)
+            CPU_SET( c, &set );
+    }
+    pthread_setaffinity_np( workers[k]->native_handle(), sizeof(cpu_set_t), &set );
+#else
+    (void) core; // no portable way to pin a thread
+#endif
+}
+
+void ThreadPool::execute(const Job& job, boost::unique_lock<boost::mutex>& lock) {
+    lock.unlock();
+    job.task->run( job.part );
+    lock.lock();
+    if ( --job.batch->left == 0 )
+        finished.notify_all();
+}
+
+void ThreadPool::work() {
+    boost::unique_lock<boost::mutex> lock(mutex);
+    for (;;) {
+        while ( jobs.empty() && !stopping )
+            queued.wait(lock);
+        if ( jobs.empty() ) // stopping, and no work left
+            return;
+        const Job job = jobs.front();
+        jobs.pop_front();
+        execute(job, lock);
+    }
+}
+
+// the caller runs part 0, and then the parts that no worker has taken yet.
+// So a run() finishes even when all workers are busy, for example in a run() of their own.
+void ThreadPool::run(ParallelTask& task, unsigned int n) {
+    if ( n == 0 )
+        return;
+    Batch batch(n);
+    boost::unique_lock<boost::mutex> lock(mutex);
+    // a nested run() must not wait for setSize(), which waits for the enclosing run()
+    while ( resizing && (running == 0) )
+        idle.wait(lock);
+    ++running;
+    for (unsigned int k=1; k<n; ++k)
+        jobs.push_back( Job(&task, k, &batch) );
+    if ( n > 1 )
+        queued.notify_all();
+    execute( Job(&task, 0, &batch), lock );
+    while ( batch.left > 0 ) {
+        std::deque<Job>::iterator it = jobs.begin();
+        while ( (it != jobs.end()) && (it->batch != &batch) )
+            ++it;
+        if ( it != jobs.end() ) {
+            const Job job = *it;
+            jobs.erase(it);
+            execute(job, lock);
+        } else {
+            finished.wait(lock);
+        }
+    }
+    if ( --running == 0 )
+        idle.notify_all();
+}
+
+} // end ocl namespace
+// end file threadpool.cpp
@@ -0,0 +1,140 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010-2011 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <deque>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+namespace ocl
+{
+
+/// \brief a parallel loop, split into parts that ThreadPool::run() runs on several threads
+class ParallelTask {
+    public:
+        ParallelTask() {}
+        virtual ~ParallelTask() {}
+        /// run part k. Parts run at the same time, on different threads, and must not throw.
+        virtual void run(unsigned int k) = 0;
+};
+
+/// \brief the threads that all operations run their parallel loops on.
+///
+/// One pool is shared by the whole process, see instance(), so operations that run after
+/// each other or at the same time use the same threads, instead of each starting its own.
+/// A thread calling run() works on its own task while it waits, so run() may be called
+/// from inside a ParallelTask, and the nested parts run on the same threads.
+class ThreadPool {
+    public:
+        /// the pool of the process. started on first use with one thread per core.
+        static ThreadPool& instance();
+        /// \brief use n threads, or one per core if n is zero.
+        ///
+        /// A run() uses the calling thread and n-1 worker threads. Waits until no run() is in
+        /// progress, and restarts the workers. A run() started meanwhile waits for the restart,
+        /// unless other runs are still in progress, e.g. it is nested in one of them.
+        /// Must not be called from inside a ParallelTask, which would wait for itself.
+        void setSize(unsigned int n);
+        /// the number of threads a run() can use
+        unsigned int size() const {
+            boost::mutex::scoped_lock lock(mutex);
+            return nsize;
+        }
+        /// \brief pin worker k to core k+1, or let the workers run on any core.
+        ///
+        /// Core 0 is left to the thread that calls run(). Works on Linux and Windows,
+        /// elsewhere pinning is ignored.
+        void setAffinity(bool a);
+        /// true if the workers are pinned to cores
+        bool getAffinity() const {
+            boost::mutex::scoped_lock lock(resize);
+            return affinity;
+        }
+        /// run task.run(k) for k = 0 to n-1, and return when all parts have returned
+        void run(ParallelTask& task, unsigned int n);
+        /// number of cores
+        static unsigned int cores();
+    private:
+        ThreadPool();
+        virtual ~ThreadPool();
+        ThreadPool(const ThreadPool&); // not copyable
+        ThreadPool& operator=(const ThreadPool&);
+        /// the parts of one run() not yet finished
+        class Batch {
+            public:
+                explicit Batch(unsigned int n) : left(n) {}
+                /// parts not yet returned
+                unsigned int left;
+        };
+        /// a queued part of a task
+        class Job {
+            public:
+                Job(ParallelTask* t, unsigned int k, Batch* b) : task(t), part(k), batch(b) {}
+                /// the task
+                ParallelTask* task;
+                /// the part to run
+                unsigned int part;
+                /// the run() it belongs to
+                Batch* batch;
+        };
+        /// start n-1 workers
+        void start(unsigned int n);
+        /// stop and join all workers
+        void stop();
+        /// runs queued jobs until stop()
+        void work();
+        /// set the affinity of worker k
+        void pin(unsigned int k);
+        /// run job, with mutex locked by lock, and count it as finished
+        void execute(const Job& job, boost::unique_lock<boost::mutex>& lock);
+    // DATA
+        /// serializes setSize() and setAffinity(), which change workers, and guards affinity
+        mutable boost::mutex resize;
+        /// guards jobs, stopping, running, resizing, nsize and the Batch counts
+        mutable boost::mutex mutex;
+        /// signalled when a job is queued or the workers are stopped
+        boost::condition_variable queued;
+        /// signalled when a run() has no parts left
+        boost::condition_variable finished;
+        /// signalled when no run() is in progress, or setSize() has restarted the workers
+        boost::condition_variable idle;
+        /// parts waiting for a thread
+        std::deque<Job> jobs;
+        /// the worker threads
+        std::vector<boost::thread*> workers;
+        /// true while the workers are being stopped
+        bool stopping;
+        /// number of run() calls in progress
+        unsigned int running;
+        /// true while setSize() waits for the runs in progress, and restarts the workers
+        bool resizing;
+        /// pin the workers to cores
+        bool affinity;
+        /// number of threads a run() can use
+        unsigned int nsize;
+};
+
+} // end ocl namespace
+#endif
+// end file threadpool.hpp
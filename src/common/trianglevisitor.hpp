@@ -0,0 +1,200 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010-2011 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRIANGLE_VISITOR_H
+#define TRIANGLE_VISITOR_H
+
+#include "triangle.hpp"
+#include "clpoint.hpp"
+#include "fiber.hpp"
+#include "millingcutter.hpp"
+#include "cutterengine.hpp"
+#include "packedsurf.hpp"
+#include "indexedmesh.hpp"
+
+namespace ocl
+{
+
+///
+/// \brief Triangle visitor virtual base class
+///
+/// A kd-tree search calls visit() for each triangle it finds, instead of
+/// returning a container of triangles. Visitors are small objects that
+/// live on the stack of the calling loop, so a search allocates no memory.
+class TriangleVisitor {
+    public:
+        TriangleVisitor() {}
+        virtual ~TriangleVisitor() {}
+        /// called for each found Triangle t. idx is the index of t in the STLSurf.
+        virtual void visit(const Triangle& t, unsigned int idx) = 0;
+};
+
+/// \brief a TriangleVisitor that only needs triangles reaching above a z-value.
+///
+/// SpatialIndex::visit_above() skips subtrees that are entirely at or below bound().
+/// The bound may rise while visiting.
+class ZBoundVisitor : public TriangleVisitor {
+    public:
+        ZBoundVisitor() {}
+        virtual ~ZBoundVisitor() {}
+        /// triangles with no point above this z-value are not needed
+        virtual double bound() const = 0;
+};
+
+/// \brief drops a MillingCutter at a CLPoint against each visited Triangle
+///
+/// does the same overlap() and below() tests as BatchDropCutter::dropCutter5()
+class DropCutterVisitor : public ZBoundVisitor {
+    public:
+        /// drop cutter c at CLPoint p, against triangles of the PackedSurf ps
+        DropCutterVisitor(const MillingCutter* c, CLPoint& p, const PackedSurf& ps) : cutter(c), cl(p), packed(ps), calls(0) {}
+        virtual ~DropCutterVisitor() {}
+        /// drop the cutter against t, if t is under the cutter
+        virtual void visit(const Triangle& t, unsigned int idx) {
+            if ( cutter->overlaps(cl,t) ) { // cutter overlap triangle? check
+                if ( cl.below(t) ) {
+                    cutter->dropCutter(cl,t,packed,idx);
+                    ++calls;
+                }
+            }
+        }
+        /// a triangle that is not above the CLPoint can not lift it, see CLPoint::below()
+        virtual double bound() const {return cl.z;}
+        /// the cutter
+        const MillingCutter* cutter;
+        /// the CLPoint that is updated
+        CLPoint& cl;
+        /// precomputed triangle data
+        const PackedSurf& packed;
+        /// number of dropCutter() calls made
+        int calls;
+};
+
+/// \brief pushes a MillingCutter along a Fiber against each visited Triangle
+class PushCutterVisitor : public TriangleVisitor {
+    public:
+        /// push cutter c along Fiber fib, against triangles of the PackedSurf ps
+        PushCutterVisitor(const MillingCutter* c, Fiber& fib, const PackedSurf& ps) : cutter(c), f(fib), packed(ps), calls(0) {}
+        virtual ~PushCutterVisitor() {}
+        /// push the cutter against t, and add the resulting interval to the fiber
+        virtual void visit(const Triangle& t, unsigned int idx) {
+            Interval i;
+            cutter->pushCutter(f,i,t,packed,idx);
+            f.addInterval(i);
+            ++calls;
+        }
+        /// the cutter
+        const MillingCutter* cutter;
+        /// the Fiber that is updated
+        Fiber& f;
+        /// precomputed triangle data
+        const PackedSurf& packed;
+        /// number of pushCutter() calls made
+        int calls;
+};
+
+/// \brief a DropCutterVisitor that tests each vertex and edge of an IndexedMesh once
+///
+/// the facet of each visited triangle is tested as by DropCutterVisitor, but a vertex or edge
+/// shared with an earlier visited triangle is skipped. marks must not be shared between threads.
+/// The cutter is dropped by a CutterEngine<Cutter>, MillingCutter for any cutter type.
+template <class Cutter = MillingCutter>
+class MeshDropCutterVisitor : public ZBoundVisitor {
+    public:
+        /// drop cutter c at CLPoint p, against triangles of ps and mesh. starts a new query of marks.
+        /// With vert false the vertices are not tested, see MillingCutter::vertexDrop(DropPacket&, ...)
+        MeshDropCutterVisitor(const Cutter* c, CLPoint& p, const PackedSurf& ps, 
+                              const IndexedMesh& m, MeshMarks& mk, bool vert = true) 
+            : cutter(c), engine(*c), cl(p), packed(ps), mesh(m), marks(mk), vertices(vert), calls(0) {
+            marks.next(mesh);
+        }
+        virtual ~MeshDropCutterVisitor() {}
+        /// drop the cutter against t, if t is under the cutter
+        virtual void visit(const Triangle& t, unsigned int idx) {
+            if ( cutter->overlaps(cl,t) ) {
+                if ( cl.below(t) ) {
+                    engine.dropCutter(cl,t,packed,idx,mesh,marks,vertices);
+                    ++calls;
+                }
+            }
+        }
+        /// a triangle that is not above the CLPoint can not lift it, see CLPoint::below()
+        virtual double bound() const {return cl.z;}
+        /// the cutter
+        const Cutter* cutter;
+        /// drops the cutter
+        CutterEngine<Cutter> engine;
+        /// the CLPoint that is updated
+        CLPoint& cl;
+        /// precomputed triangle data
+        const PackedSurf& packed;
+        /// welded vertices and unique edges
+        const IndexedMesh& mesh;
+        /// the vertices and edges tested so far
+        MeshMarks& marks;
+        /// test the vertices of the triangles
+        bool vertices;
+        /// number of dropCutter() calls made
+        int calls;
+};
+
+/// \brief a PushCutterVisitor that pushes against each vertex and edge of an IndexedMesh once
+///
+/// The Interval of a shared vertex or edge is stored the first time it is found,
+/// and added to the Interval of each later triangle that shares it. Fiber f gets the
+/// same Intervals as from PushCutterVisitor. marks must not be shared between threads.
+/// The cutter is pushed by a CutterEngine<Cutter>, MillingCutter for any cutter type.
+template <class Cutter = MillingCutter>
+class MeshPushCutterVisitor : public TriangleVisitor {
+    public:
+        /// push cutter c along Fiber fib, against triangles of ps and mesh. starts a new query of marks.
+        MeshPushCutterVisitor(const Cutter* c, Fiber& fib, const PackedSurf& ps, 
+                              const IndexedMesh& m, PushMarks& mk) 
+            : cutter(c), engine(*c), f(fib), packed(ps), mesh(m), marks(mk), calls(0) {
+            marks.next(mesh);
+        }
+        virtual ~MeshPushCutterVisitor() {}
+        /// push the cutter against t, and add the resulting interval to the fiber
+        virtual void visit(const Triangle& t, unsigned int idx) {
+            Interval i;
+            engine.pushCutter(f,i,t,packed,idx,mesh,marks);
+            f.addInterval(i);
+            ++calls;
+        }
+        /// the cutter
+        const Cutter* cutter;
+        /// pushes the cutter
+        CutterEngine<Cutter> engine;
+        /// the Fiber that is updated
+        Fiber& f;
+        /// precomputed triangle data
+        const PackedSurf& packed;
+        /// welded vertices and unique edges
+        const IndexedMesh& mesh;
+        /// the vertices and edges pushed against so far, with their Intervals
+        PushMarks& marks;
+        /// number of pushCutter() calls made
+        int calls;
+};
+
+} // end namespace
+#endif
+// end file trianglevisitor.hpp
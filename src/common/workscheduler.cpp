@@ -0,0 +1,127 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010-2011 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <algorithm>
+#include <cassert>
+
+#include <boost/cstdint.hpp>
+
+#include "workscheduler.hpp"
+
+namespace ocl
+{
+
+WorkScheduler::WorkScheduler(unsigned int n, unsigned int t) {
+    if ( t == 0 )
+        t = 1;
+    nslots = t;
+    slots = new Slot[t];
+    for (unsigned int k=0; k<t; ++k) {
+        // thread k gets items [k*n/t, (k+1)*n/t)
+        slots[k].begin = (unsigned int) ( ( (boost::uint64_t) n * k ) / t );
+        slots[k].end   = (unsigned int) ( ( (boost::uint64_t) n * (k+1) ) / t );
+    }
+}
+
+WorkScheduler::~WorkScheduler() {
+    delete [] slots;
+}
+
+void WorkScheduler::lock(unsigned int k) {
+    slots[k].mutex.lock();
+}
+
+void WorkScheduler::unlock(unsigned int k) {
+    slots[k].mutex.unlock();
+}
+
+unsigned int WorkScheduler::remaining(unsigned int k) {
+    lock(k);
+    unsigned int r = slots[k].end - slots[k].begin;
+    unlock(k);
+    return r;
+}
+
+bool WorkScheduler::next(unsigned int k, unsigned int& begin, unsigned int& end) {
+    assert( k < nslots );
+    for (;;) {
+        lock(k);
+        Slot& s = slots[k];
+        if ( s.end > s.begin ) {
+            unsigned int chunk = std::max( 1u, (s.end - s.begin)/WORK_CHUNK_DIVISOR );
+            begin = s.begin;
+            end = s.begin + chunk;
+            s.begin = end;
+            unlock(k);
+            return true;
+        }
+        unlock(k);
+        if ( !steal(k) )
+            return false;
+    }
+}
+
+// only one lock is held at a time, so threads stealing from each other can not deadlock.
+// A range may shrink between the search and the steal, then the search is repeated.
+bool WorkScheduler::steal(unsigned int k) {
+    for (;;) {
+        unsigned int victim = k;
+        unsigned int most = 0;
+        for (unsigned int m=0; m<nslots; ++m) {
+            if ( m == k )
+                continue;
+            const unsigned int r = remaining(m);
+            if ( r > most ) {
+                most = r;
+                victim = m;
+            }
+        }
+        if ( most == 0 )
+            return false;
+        lock(victim);
+        Slot& v = slots[victim];
+        const unsigned int r = v.end - v.begin;
+        if ( r == 0 ) { // emptied by its owner or another thief
+            unlock(victim);
+            continue;
+        }
+        const unsigned int stop = v.end;
+        const unsigned int start = v.end - (r+1)/2;
+        v.end = start;
+        unlock(victim);
+        lock(k);
+        slots[k].begin = start;
+        slots[k].end = stop;
+        unlock(k);
+        return true;
+    }
+}
+
+int WorkScheduler::calls() const {
+    int sum = 0;
+    for (unsigned int k=0; k<nslots; ++k)
+        sum += slots[k].calls;
+    return sum;
+}
+
+} // end ocl namespace
+// end file workscheduler.cpp
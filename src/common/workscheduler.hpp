@@ -0,0 +1,130 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010-2011 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef WORK_SCHEDULER_H
+#define WORK_SCHEDULER_H
+
+#include <boost/thread/mutex.hpp>
+#include <boost/progress.hpp>
+
+#include "threadpool.hpp"
+#include "runcontrol.hpp"
+
+namespace ocl
+{
+
+/// per-thread data is padded to this size, so that two threads do not write to one cache line
+#define CACHE_LINE_SIZE 64
+/// a thread takes this fraction of the items left in its range at a time
+#define WORK_CHUNK_DIVISOR 8
+
+/// \brief shares the items [0, n) of a parallel loop between threads, with work-stealing.
+///
+/// Thread k starts with the k:th contiguous range of items, and takes chunks from its front,
+/// the chunks getting smaller as the range empties. A thread whose range is empty steals the
+/// back half of the largest range left, so threads that finish early help the others.
+/// Each thread also counts its low-level calls in its own slot, and calls() adds them up
+/// after the loop, so the count does not depend on which thread did which item.
+///
+/// The "threads" are the parts of a ParallelTask, part k of the task calls
+/// \code
+///     unsigned int begin, end;
+///     while ( work.next(k, begin, end) ) { ...items begin to end-1... }
+/// \endcode
+/// and the task is run with ThreadPool::run(task, work.threads()).
+class WorkScheduler {
+    public:
+        /// share the items [0, n) between t threads, numbered 0 to t-1
+        WorkScheduler(unsigned int n, unsigned int t);
+        virtual ~WorkScheduler();
+        /// \brief the next chunk [begin, end) of items for thread k.
+        /// returns false when there are no items left for any thread.
+        bool next(unsigned int k, unsigned int& begin, unsigned int& end);
+        /// add c low-level calls to the count of thread k
+        void addCalls(unsigned int k, int c) {slots[k].calls += c;}
+        /// the calls added by all threads. call after the parallel loop.
+        int calls() const;
+        /// number of threads
+        unsigned int threads() const {return nslots;}
+    private:
+        WorkScheduler(const WorkScheduler&); // not copyable
+        WorkScheduler& operator=(const WorkScheduler&);
+        /// remaining items of slot k, read under its lock
+        unsigned int remaining(unsigned int k);
+        /// move the back half of the largest other range to the range of thread k.
+        /// returns false if all ranges are empty.
+        bool steal(unsigned int k);
+        void lock(unsigned int k);
+        void unlock(unsigned int k);
+        /// the items of one thread
+        class Slot {
+            public:
+                Slot() : begin(0), end(0), calls(0) {}
+                /// first item not yet taken
+                unsigned int begin;
+                /// one past the last item
+                unsigned int end;
+                /// low-level calls made by the thread
+                int calls;
+                /// guards begin and end
+                boost::mutex mutex;
+                /// keeps the next slot off the cache line of this one
+                char pad[CACHE_LINE_SIZE];
+        };
+    // DATA
+        /// one slot per thread
+        Slot* slots;
+        /// number of slots
+        unsigned int nslots;
+};
+
+/// \brief a ParallelTask whose parts take the items of a WorkScheduler, and advance a progress display
+/// and the current stage of a RunControl.
+class ScheduledTask : public ParallelTask {
+    public:
+        /// parts take items from w, and advance p and the stage of c by the items done
+        ScheduledTask(WorkScheduler& w, boost::progress_display& p, RunControl& c) : work(w), progress(p), control(c) {}
+        virtual ~ScheduledTask() {}
+    protected:
+        /// advance the progress display and the RunControl by n items. called from any part.
+        void advance(unsigned int n) {
+            {
+                boost::mutex::scoped_lock lock(mutex);
+                progress += n;
+            }
+            control.advance(n);
+        }
+        /// true if the parts should take no more items
+        bool stopped() {return control.stopped();}
+        /// shares the items between the parts
+        WorkScheduler& work;
+        /// shows the items done
+        boost::progress_display& progress;
+        /// receives the progress, and tells when to stop
+        RunControl& control;
+        /// guards progress
+        boost::mutex mutex;
+};
+
+} // end ocl namespace
+#endif
+// end file workscheduler.hpp
@@ -22,6 +22,7 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <typeinfo>
 
 #include <boost/foreach.hpp>
 
@@ -44,7 +45,49 @@ BallCutter::BallCutter(double d, double l) {
     center_height = radius;
 }
 
-// drop-cutter methods: vertex and facet are handled in base-class
+/// the spherical end of a BallCutter, for drop_vertices() and drop_edges()
+class BallProfile {
+    public:
+        BallProfile(double r) : radius(r), radius_sq(r*r) {}
+        /// same as BallCutter::height()
+        SimdDouble height(const SimdDouble& q) const {return SimdDouble(radius) - simd_sqrt( radius_sq - q*q );}
+        /// same as BallCutter::singleEdgeDropCanonical()
+        void edge(const SimdDouble& d, const SimdDouble& u1, const SimdDouble& z1, 
+                  const SimdDouble& u2, const SimdDouble& z2, SimdDouble& cc_u, SimdDouble& cl_z) const {
+            const SimdDouble s = simd_sqrt( radius_sq - d*d );
+            SimdDouble nx = z2 - z1;      // (dz, -du) is a normal to the line
+            SimdDouble ny = -( u2 - u1 );
+            const SimdDouble inv = SimdDouble(1.0) / simd_sqrt( nx*nx + ny*ny );
+            nx = nx*inv;
+            ny = ny*inv;
+            const SimdMask down = ( ny < SimdDouble(0.0) ); // flip normal so it points upward
+            nx = simd_select( down, -nx, nx );
+            ny = simd_select( down, -ny, ny );
+            cc_u = -s*nx;
+            const SimdDouble cc_z = z1 + ( (cc_u - u1)/(u2 - u1) )*(z2 - z1);
+            cl_z = cc_z + s*ny - SimdDouble(radius);
+        }
+        /// cutter radius
+        double radius;
+    private:
+        /// radius squared
+        SimdDouble radius_sq;
+};
+
+// drop-cutter methods: vertex and facet are handled in base-class,
+// except for packets of CL-points and blocks of triangles
+bool BallCutter::vertexDrop(DropPacket& packet, const double* x, const double* y, const double* z, unsigned int n) const {
+    return drop_vertices( BallProfile(radius), packet, x, y, z, n );
+}
+
+bool BallCutter::blockFacetDrop(CLPoint &cl, DropBlock& block, const PackedSurf& ps) const {
+    return drop_facets( cl, block, ps, xy_normal_length, normal_length, center_height );
+}
+
+bool BallCutter::blockEdgeDrop(CLPoint &cl, EdgeBlock& edges) const {
+    return drop_edges( BallProfile(radius), cl, edges );
+}
+
 
 // drop-cutter edgeDrop 
 CC_CLZ_Pair BallCutter::singleEdgeDropCanonical(const Point& u1, const Point& u2) const {
@@ -123,6 +166,10 @@ bool BallCutter::calcCCandUpdateInterval( double t, const Point& p1, const Point
     return i.update_ifCCinEdgeAndTrue( t, cc_tmp, p1, p2, ((cl_center-cc_tmp).z >=0) );
 }
     
+bool BallCutter::hasMeshKernels() const {
+    return typeid(*this) == typeid(BallCutter);
+}
+
 std::string BallCutter::str() const {
     std::ostringstream o;
     o << *this; 
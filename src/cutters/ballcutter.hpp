@@ -34,14 +34,23 @@ namespace ocl
 /// \brief Ball or Spherical MillingCutter (ball-nose endmill)
 ///
 class BallCutter : public MillingCutter {
+    template <class Cutter> friend class CutterEngine;
     public:
         BallCutter();
         /// create a BallCutter with diameter d (radius d/2) and length l
         explicit BallCutter(double d, double l);
         /// offset of Ball is Ball
         MillingCutter* offsetCutter(double d) const {return  new BallCutter(diameter+2*d, length+d);}
+        /// vertexDrop() of a packet of CL-points, see drop_vertices()
+        bool vertexDrop(DropPacket& packet, const double* x, const double* y, const double* z, unsigned int n) const;
+        /// facetDrop() against a block of triangles, see drop_facets()
+        bool blockFacetDrop(CLPoint &cl, DropBlock& block, const PackedSurf& ps) const;
+        /// edge-drop against a block of edges, see drop_edges()
+        bool blockEdgeDrop(CLPoint &cl, EdgeBlock& edges) const;
         /// string repr
         friend std::ostream& operator<<(std::ostream &stream, BallCutter c);
+        /// true for a BallCutter, but not for a class derived from it
+        bool hasMeshKernels() const;
         std::string str() const;
     protected:
         CC_CLZ_Pair singleEdgeDropCanonical(const Point& u1, const Point& u2) const;
@@ -21,6 +21,7 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <typeinfo>
 
 #include <boost/foreach.hpp>
 
@@ -50,21 +51,28 @@ MillingCutter* BullCutter::offsetCutter(double d) const {
     return new BullCutter(diameter+2*d, radius2+d, length+d) ;
 }
 
-// height of cutter at radius r
-double BullCutter::height(double r) const {
-    if ( r <= radius1 )
-        return 0.0; // cylinder
-    else if ( r <= radius )
-        return radius2 - sqrt( square(radius2) - square(r-radius1) ); // toroid
-    else {
-        assert(0);
-        return -1;
-    }
-}
+/// the flat and toroidal end of a BullCutter, for drop_vertices()
+class BullProfile {
+    public:
+        BullProfile(double r, double r1, double r2) : radius(r), radius1(r1), radius2(r2), radius2_sq(r2*r2) {}
+        /// same as BullCutter::height()
+        SimdDouble height(const SimdDouble& q) const {
+            const SimdDouble d = q - radius1;
+            return simd_select( q <= radius1, SimdDouble(0.0), radius2 - simd_sqrt( radius2_sq - d*d ) );
+        }
+        /// cutter radius
+        double radius;
+    private:
+        /// radius of the cylindrical part
+        SimdDouble radius1;
+        /// tube radius of the torus
+        SimdDouble radius2;
+        /// radius2 squared
+        SimdDouble radius2_sq;
+};
 
-// width of cutter at height h
-double BullCutter::width(double h) const {
-    return ( h >= radius2 ) ? radius : radius1 + sqrt(square(radius2)-square(radius2-h)) ;
+bool BullCutter::vertexDrop(DropPacket& packet, const double* x, const double* y, const double* z, unsigned int n) const {
+    return drop_vertices( BullProfile(radius, radius1, radius2), packet, x, y, z, n );
 }
 
 // drop-cutter: vertex and facet are handled in base-class
@@ -154,6 +162,10 @@ bool BullCutter::generalEdgePush(const Fiber& f, Interval& i,  const Point& p1,
     return result;
 }
 
+bool BullCutter::hasMeshKernels() const {
+    return typeid(*this) == typeid(BullCutter);
+}
+
 std::string BullCutter::str() const {
     std::ostringstream o;
     o << *this;
@@ -28,6 +28,7 @@
 
 #include "millingcutter.hpp"
 #include "ellipse.hpp"
+#include "numeric.hpp"
 
 namespace ocl
 {
@@ -37,22 +38,34 @@ namespace ocl
 /// defined by the cutter diameter and by the corner radius
 ///
 class BullCutter : public MillingCutter {
+    template <class Cutter> friend class CutterEngine;
     public:
         BullCutter();
         /// Create bull-cutter with diamter d, corner radius r, and length l.
         BullCutter(double diameter, double radius, double length);
         /// offset of Bull is Bull
         MillingCutter* offsetCutter(double offset) const;
+        /// vertexDrop() of a packet of CL-points, see drop_vertices()
+        bool vertexDrop(DropPacket& packet, const double* x, const double* y, const double* z, unsigned int n) const;
         /// string repr
         friend std::ostream& operator<<(std::ostream &stream, BullCutter c);
+        /// true for a BullCutter, but not for a class derived from it
+        bool hasMeshKernels() const;
         std::string str() const;
         
     protected:
         
         bool generalEdgePush(const Fiber& f, Interval& i,  const Point& p1, const Point& p2) const;
         CC_CLZ_Pair singleEdgeDropCanonical(const Point& u1, const Point& u2) const;
-        double height(double r) const;
-        double width(double h) const; 
+        double height(double r) const {
+            if ( r <= radius1 )
+                return 0.0; // cylinder
+            else if ( r <= radius )
+                return radius2 - sqrt( square(radius2) - square(r-radius1) ); // toroid
+            assert(0);
+            return -1;
+        }
+        double width(double h) const {return ( h >= radius2 ) ? radius : radius1 + sqrt(square(radius2)-square(radius2-h));}
         /// radius of cylindrical part of cutter
         double radius1;
         /// tube radius of torus
@@ -21,6 +21,8 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <algorithm>
+#include <typeinfo>
 
 #include "compositecutter.hpp"
 #include "numeric.hpp"
@@ -57,7 +59,31 @@ void CompositeCutter::addCutter(MillingCutter& c, double r, double h, double zof
 // this allows vertexDrop in the base-class to work as for other cutters
 double CompositeCutter::height(double r) const {
     unsigned int idx = radius_to_index(r);
-    return cutter[idx]->height(r) + zoffset[idx];
+    // r can be up to 1E-6 outside of the radius of the cutter, see validRadius()
+    return cutter[idx]->height( std::min( r, radiusvec[idx] ) ) + zoffset[idx];
+}
+
+/// the sub-cutters of a CompositeCutter, for drop_vertices()
+class CompositeProfile {
+    public:
+        CompositeProfile(const CompositeCutter& c) : radius(c.radius), comp(c) {}
+        /// CompositeCutter::height() of each distance within the radius
+        SimdDouble height(const SimdDouble& q) const {
+            double r[SimdDouble::width];
+            q.store(r);
+            for (int m=0; m<SimdDouble::width; ++m)
+                r[m] = ( r[m] <= radius ) ? comp.height(r[m]) : 0.0;
+            return SimdDouble::load(r);
+        }
+        /// cutter radius
+        double radius;
+    private:
+        /// the cutter
+        const CompositeCutter& comp;
+};
+
+bool CompositeCutter::vertexDrop(DropPacket& packet, const double* x, const double* y, const double* z, unsigned int n) const {
+    return drop_vertices( CompositeProfile(*this), packet, x, y, z, n );
 }
 
 // return the width of the cutter at height h. 
@@ -172,12 +198,31 @@ bool CompositeCutter::facetDrop(CLPoint &cl, const Triangle &t) const {
 }
 
 //********   edge **************************************************** */
+// each edge on its own, the cc-point of the highest edge of a sub-cutter
+// can be outside its radius when the cc-point of a lower edge is not.
 bool CompositeCutter::edgeDrop(CLPoint &cl, const Triangle &t) const {
+    bool result = false;
+    for (int n=0;n<3;n++) { // loop through all three edges
+        const Point p1 = t.p[n];
+        const Point p2 = t.p[(n+1)%3];
+        if ( !isZero_tol( p1.x - p2.x) || !isZero_tol( p1.y - p2.y) ) {
+            Point vxy = p2 - p1;
+            vxy.z = 0;
+            vxy.xyNormalize();
+            if ( meshEdgeDrop(cl, p1, p2, vxy) )
+                result = true;
+        }
+    }
+    return result;
+}
+
+// call meshEdgeDrop on each cutter and keep the highest CL-point with a valid cc-point
+bool CompositeCutter::meshEdgeDrop(CLPoint& cl, const Point& p1, const Point& p2, const Point& vxy) const {
     bool result = false;
     for (unsigned int n=0; n<cutter.size(); ++n) { // loop through cutters
         CLPoint cl_tmp = cl + Point(0,0,zoffset[n]);
         CCPoint* cc_tmp;
-        if ( cutter[n]->edgeDrop(cl_tmp,t) ) { // drop sub-cutter against edge
+        if ( cutter[n]->meshEdgeDrop(cl_tmp,p1,p2,vxy) ) { // drop sub-cutter against edge
             if ( ccValidRadius(n,cl_tmp) ) { // check if cc-point is valid
                 cc_tmp = new CCPoint(*cl_tmp.cc);
                 if (cl.liftZ( cl_tmp.z - zoffset[n] ) ) { // we need to lift the cutter
@@ -269,6 +314,74 @@ bool CompositeCutter::edgePush(const Fiber& f, Interval& i, const Triangle& t) c
     return result;
 }
 
+bool CompositeCutter::meshVertexPush(const Fiber& f, Interval& i, const Point& p) const {
+    bool result = false;
+    std::vector< std::pair<double, CCPoint> > contacts;
+    for (unsigned int n=0; n<cutter.size(); ++n) {
+        Interval ci;
+        Fiber cf(f);
+        cf.p1.z = f.p1.z + zoffset[n];
+        cf.p2.z = f.p2.z + zoffset[n]; // raised/lowered fiber to push along
+        if ( cutter[n]->meshVertexPush(cf,ci,p) ) {
+            if ( ccValidHeight( n, ci.upper_cc, f ) )
+                contacts.push_back( std::pair<double,CCPoint>(ci.upper, ci.upper_cc) );
+            if ( ccValidHeight( n, ci.lower_cc, f ) )
+                contacts.push_back( std::pair<double,CCPoint>(ci.lower, ci.lower_cc) );
+        }
+    }
+    
+    for( unsigned int n=0; n<contacts.size(); ++n ) {
+        i.update( contacts[n].first, contacts[n].second );
+        result = true;
+    }
+    return result;
+}
+
+bool CompositeCutter::meshEdgePush(const Fiber& f, Interval& i, const Point& p1, const Point& p2) const {
+    bool result = false;
+    std::vector< std::pair<double, CCPoint> > contacts;
+    for (unsigned int n=0; n<cutter.size(); ++n) {
+        Interval ci; // interval for this cutter
+        Fiber cf(f); // fiber for this cutter
+        cf.p1.z = f.p1.z + zoffset[n];
+        cf.p2.z = f.p2.z + zoffset[n]; // raised/lowered fiber to push along
+        if ( cutter[n]->meshEdgePush(cf,ci,p1,p2) ) {
+            if ( ccValidHeight( n, ci.upper_cc, f ) )
+                contacts.push_back( std::pair<double,CCPoint>(ci.upper, ci.upper_cc) );
+            if ( ccValidHeight( n, ci.lower_cc, f ) )
+                contacts.push_back( std::pair<double,CCPoint>(ci.lower, ci.lower_cc) );
+        }
+    }
+    
+    for( unsigned int n=0; n<contacts.size(); ++n ) {
+        i.update( contacts[n].first, contacts[n].second );
+        result = true;
+    }
+    return result;
+}
+
+bool CompositeCutter::slicePush(const Fiber& f, Interval& i, const Triangle& t) const {
+    bool result = false;
+    std::vector< std::pair<double, CCPoint> > contacts;
+    for (unsigned int n=0; n<cutter.size(); ++n) {
+        Interval ci;
+        Fiber cf(f);
+        cf.p1.z = f.p1.z + zoffset[n];
+        cf.p2.z = f.p2.z + zoffset[n]; // raised/lowered fiber to push along
+        if ( cutter[n]->slicePush(cf,ci,t) ) {
+            if ( ccValidHeight( n, ci.upper_cc, f ) )
+                contacts.push_back( std::pair<double,CCPoint>(ci.upper, ci.upper_cc) );
+            if ( ccValidHeight( n, ci.lower_cc, f ) )
+                contacts.push_back( std::pair<double,CCPoint>(ci.lower, ci.lower_cc) );
+        }
+    }
+    
+    for( unsigned int n=0; n<contacts.size(); ++n ) {
+        i.update( contacts[n].first, contacts[n].second );
+        result = true;
+    }
+    return result;
+}
 
 MillingCutter* CompositeCutter::offsetCutter(double d) const {
     std::cout << " ERROR: not implemented.\n";
@@ -276,6 +389,19 @@ MillingCutter* CompositeCutter::offsetCutter(double d) const {
     return  new CylCutter(); //FIXME!
 }
 
+bool CompositeCutter::hasMeshKernels() const {
+    const std::type_info& type = typeid(*this);
+    if ( type != typeid(CompositeCutter) && type != typeid(CompCylCutter) && type != typeid(CompBallCutter) &&
+         type != typeid(CylConeCutter) && type != typeid(BallConeCutter) && type != typeid(BullConeCutter) &&
+         type != typeid(ConeConeCutter) )
+        return false;
+    for (unsigned int n=0; n<cutter.size(); ++n) {
+        if ( !cutter[n]->hasMeshKernels() )
+            return false;
+    }
+    return true;
+}
+
 std::string CompositeCutter::str() const {
     std::ostringstream o;
     o << "CompositeCutter with "<< cutter.size() << " cutters:\n";
@@ -53,15 +53,35 @@ class CompositeCutter : public MillingCutter {
         /// call facetDrop() on each cutter in turn, and pick the valid CC/CL point 
         /// as the result for the CompositeCutter
         bool facetDrop(CLPoint &cl, const Triangle &t) const;
-        /// call edgeDrop on each cutter and pick the correct (highest valid CL-point) result
+        /// call meshEdgeDrop on each edge of t, so that each cc-point is checked on its own
         bool edgeDrop(CLPoint &cl, const Triangle &t) const;
+        /// false, the facet contact of a sub-cutter can be lower than the contact of
+        /// another sub-cutter with an edge or vertex of the same triangle
+        bool facetIsHighest() const {return false;}
+        /// true for the composite cutters of this library, if each sub-cutter has mesh kernels
+        bool hasMeshKernels() const;
+        /// the sub-cutters use the Triangle versions, so ps is not used
+        bool facetDrop(CLPoint &cl, const Triangle &t, const PackedSurf& ps, unsigned int n) const {return facetDrop(cl,t);}
+        /// the sub-cutters use the Triangle versions, so ps is not used
+        bool edgeDrop(CLPoint &cl, const Triangle &t, const PackedSurf& ps, unsigned int n) const {return edgeDrop(cl,t);}
+        /// vertexDrop() of a packet of CL-points. The distances are found with SIMD
+        /// instructions, and the height of each sub-cutter one CL-point at a time.
+        bool vertexDrop(DropPacket& packet, const double* x, const double* y, const double* z, unsigned int n) const;
         
         std::string str() const;
+        friend class CompositeProfile;
     protected:   
         
         bool vertexPush(const Fiber& f, Interval& i, const Triangle& t) const;
         bool facetPush(const Fiber& f, Interval& i, const Triangle& t) const;
+        bool facetPush(const Fiber& f, Interval& i, const Triangle& t, const PackedSurf& ps, unsigned int n) const {return facetPush(f,i,t);}
         bool edgePush(const Fiber& f, Interval& i, const Triangle& t) const;
+        /// call meshEdgeDrop on each cutter and pick the highest valid CL-point
+        bool meshEdgeDrop(CLPoint& cl, const Point& p1, const Point& p2, const Point& vxy) const;
+        bool meshVertexPush(const Fiber& f, Interval& i, const Point& p) const;
+        bool meshEdgePush(const Fiber& f, Interval& i, const Point& p1, const Point& p2) const;
+        /// call slicePush on each cutter and keep the contacts at a valid height
+        bool slicePush(const Fiber& f, Interval& i, const Triangle& t) const;
         
         /// convert input radius r to cutter index
         unsigned int radius_to_index(double r) const;
@@ -22,6 +22,7 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <typeinfo>
 
 #include <boost/foreach.hpp>
 
@@ -48,15 +49,22 @@ ConeCutter::ConeCutter(double d, double a, double l) {
     normal_length = 0.0;
 }
 
-double ConeCutter::height(double r) const {
-    assert( tan(angle) > 0.0 ); // guard against division by zero
-    return r/tan(angle);
-}
+/// the conical end of a ConeCutter, for drop_vertices()
+class ConeProfile {
+    public:
+        ConeProfile(double r, double a) : radius(r), tan_angle( tan(a) ) {}
+        /// same as ConeCutter::height()
+        SimdDouble height(const SimdDouble& q) const {return q/tan_angle;}
+        /// cutter radius
+        double radius;
+    private:
+        /// tangent of the half-angle
+        SimdDouble tan_angle;
+};
 
-double ConeCutter::width(double h) const {
-    // grows from zero up to radius
-    // above that (cutter shaft) return radius
-    return (h<center_height) ? h*tan(angle) : radius ;
+bool ConeCutter::vertexDrop(DropPacket& packet, const double* x, const double* y, const double* z, unsigned int n) const {
+    assert( tan(angle) > 0.0 ); // guard against division by zero
+    return drop_vertices( ConeProfile(radius, angle), packet, x, y, z, n );
 }
 
 // ?? Ball-Cone-Bull ??
@@ -68,7 +76,6 @@ MillingCutter* ConeCutter::offsetCutter(double d) const {
 // we either hit the tip, when the slope of the plane is smaller than angle
 // or when the slope is steep, the circular edge between the cone and the cylindrical shaft
 bool ConeCutter::facetDrop(CLPoint &cl, const Triangle &t) const {
-    bool result = false;
     Point normal = t.upNormal(); // facet surface normal    
     if ( isZero_tol( normal.z ) )  // vertical surface
         return false;  //can't drop against vertical surface
@@ -80,28 +87,44 @@ bool ConeCutter::facetDrop(CLPoint &cl, const Triangle &t) const {
         // define plane containing facet
         // a*x + b*y + c*z + d = 0, so
         // d = -a*x - b*y - c*z, where  (a,b,c) = surface normal
-        double a = normal.x;
-        double b = normal.y;
-        double c = normal.z;
         double d = - normal.dot(t.p[0]); 
-        normal.xyNormalize(); // make xy length of normal == 1.0
+        Point xyNormal( normal.x, normal.y, 0.0 );
+        xyNormal.xyNormalize(); // make xy length of normal == 1.0
+        return planeFacetDrop(cl, t, normal, d, xyNormal);
+    }
+}
+
+bool ConeCutter::facetDrop(CLPoint &cl, const Triangle &t, const PackedSurf& ps, unsigned int n) const {
+    if ( ps.has(n, PackedSurf::VERTICAL_FACET) )
+        return false;
+    if ( ps.has(n, PackedSurf::HORIZONTAL_FACET) ) {
+        CCPoint cc_tmp( cl.x, cl.y, ps.z[3*n], FACET_TIP );
+        return cl.liftZ_if_inFacet(cc_tmp.z, cc_tmp, t);
+    }
+    return planeFacetDrop(cl, t, ps.normal(n), ps.d[n], ps.xyNormal(n));
+}
+
+bool ConeCutter::planeFacetDrop(CLPoint &cl, const Triangle &t, const Point& normal, double d, const Point& xyNormal) const {
+    double a = normal.x;
+    double b = normal.y;
+    double c = normal.z;
+    // the plane is steeper than the cone when its slope sqrt(a^2+b^2)/c is larger than center_height/radius.
+    // only one of the two contacts below touches the plane, with the other the plane would cut the cutter.
+    if ( radius*sqrt( square(a) + square(b) ) > center_height*c ) {
         // cylindrical contact point case
         // find the xy-coordinates of the cc-point
-        CCPoint cyl_cc_tmp =  cl - radius*normal;
+        CCPoint cyl_cc_tmp =  cl - radius*xyNormal;
         cyl_cc_tmp.z = (1.0/c)*(-d-a*cyl_cc_tmp.x-b*cyl_cc_tmp.y);
-        double cyl_cl_z = cyl_cc_tmp.z - length; // tip positioned here
+        double cyl_cl_z = cyl_cc_tmp.z - center_height; // tip positioned here
         cyl_cc_tmp.type = FACET_CYL;
-        
-        // tip contact with facet
-        CCPoint tip_cc_tmp(cl.x,cl.y,0.0);
-        tip_cc_tmp.z = (1.0/c)*(-d-a*tip_cc_tmp.x-b*tip_cc_tmp.y);
-        double tip_cl_z = tip_cc_tmp.z;
-        tip_cc_tmp.type = FACET_TIP;
-              
-        result = result || cl.liftZ_if_inFacet( tip_cl_z, tip_cc_tmp, t);
-        result = result || cl.liftZ_if_inFacet( cyl_cl_z, cyl_cc_tmp, t);
-        return result; 
+        return cl.liftZ_if_inFacet( cyl_cl_z, cyl_cc_tmp, t);
     }
+    // tip contact with facet
+    CCPoint tip_cc_tmp(cl.x,cl.y,0.0);
+    tip_cc_tmp.z = (1.0/c)*(-d-a*tip_cc_tmp.x-b*tip_cc_tmp.y);
+    double tip_cl_z = tip_cc_tmp.z;
+    tip_cc_tmp.type = FACET_TIP;
+    return cl.liftZ_if_inFacet( tip_cl_z, tip_cc_tmp, t);
 }
 
 // cone sliced with vertical plane results in a hyperbola as the intersection curve
@@ -146,6 +169,19 @@ bool ConeCutter::facetPush(const Fiber& fib, Interval& i,  const Triangle& t) co
     return result;
 }
 
+bool ConeCutter::facetPush(const Fiber& fib, Interval& i,  const Triangle& t, const PackedSurf& ps, unsigned int n) const {
+    if ( ps.has(n, PackedSurf::Z_NORMAL) )
+        return false;
+    bool result = false;
+    const Point normal = ps.normal(n);
+    const Point xy_normal = ps.xyNormal(n);
+    if ( generalFacetPush( 0, 0, 0, normal, xy_normal, fib, i, t) ) // TIP
+        result = true;
+    if ( generalFacetPush( 0, this->center_height, this->xy_normal_length, normal, xy_normal, fib, i ,t) ) // BASE
+        result = true;
+    return result;
+}
+
 // cone is pushed along Fiber f into contact with edge p1-p2
 bool ConeCutter::generalEdgePush(const Fiber& f, Interval& i,  const Point& p1, const Point& p2) const {
     bool result = false;
@@ -319,6 +355,10 @@ bool ConeCutter::circle_CC( double t, const Point& p1, const Point& p2, const Fi
     return i.update_ifCCinEdgeAndTrue( t, cc_tmp, p1, p2, (true) );
 }
 
+bool ConeCutter::hasMeshKernels() const {
+    return typeid(*this) == typeid(ConeCutter);
+}
+
 std::string ConeCutter::str() const {
     std::ostringstream o;
     o << *this;
@@ -21,6 +21,7 @@
 #ifndef CONE_CUTTER_HPP
 #define CONE_CUTTER_HPP
 
+#include <cmath>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -35,6 +36,7 @@ namespace ocl
 /// cone defined by diameter and the cone half-angle(in radians). sharp tip. 
 /// 60 degrees or 90 degrees are common
 class ConeCutter : public MillingCutter {
+    template <class Cutter> friend class CutterEngine;
     public:
         ConeCutter();
         /// create a ConeCutter with specified maximum diameter and cone-angle
@@ -44,14 +46,23 @@ class ConeCutter : public MillingCutter {
         MillingCutter* offsetCutter(double d) const;
         /// Cone facet-drop is special, since we can make contact with either the tip or the circular rim
         bool facetDrop(CLPoint &cl, const Triangle &t) const; 
+        /// facetDrop() reading the precomputed normal and plane of triangle n of ps
+        bool facetDrop(CLPoint &cl, const Triangle &t, const PackedSurf& ps, unsigned int n) const;
+        /// vertexDrop() of a packet of CL-points, see drop_vertices()
+        bool vertexDrop(DropPacket& packet, const double* x, const double* y, const double* z, unsigned int n) const;
         /// string repr
         friend std::ostream& operator<<(std::ostream &stream, ConeCutter c);
+        /// true for a ConeCutter, but not for a class derived from it
+        bool hasMeshKernels() const;
         std::string str() const;
         
     protected:
         CC_CLZ_Pair singleEdgeDropCanonical(const Point& u1, const Point& u2) const;
         
+        bool planeFacetDrop(CLPoint &cl, const Triangle &t, const Point& normal, double d, const Point& xyNormal) const;
+        
         bool facetPush(const Fiber& fib, Interval& i,  const Triangle& t) const;
+        bool facetPush(const Fiber& fib, Interval& i,  const Triangle& t, const PackedSurf& ps, unsigned int n) const;
             
         bool generalEdgePush(const Fiber& f, Interval& i,  const Point& p1, const Point& p2) const;
         
@@ -64,8 +75,12 @@ class ConeCutter : public MillingCutter {
                          const Fiber& f, 
                          Interval& i) const; 
                          
-        double height(double r) const;
-        double width(double h) const;
+        double height(double r) const {
+            assert( tan(angle) > 0.0 ); // guard against division by zero
+            return r/tan(angle);
+        }
+        /// grows from zero up to radius, above that (cutter shaft) return radius
+        double width(double h) const {return (h<center_height) ? h*tan(angle) : radius;}
         /// the half-angle of the cone, in radians
         double angle;
 };
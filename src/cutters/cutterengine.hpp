@@ -0,0 +1,324 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef CUTTER_ENGINE_H
+#define CUTTER_ENGINE_H
+
+#include <vector>
+
+#include "millingcutter.hpp"
+#include "cylcutter.hpp"
+#include "ballcutter.hpp"
+#include "bullcutter.hpp"
+#include "conecutter.hpp"
+#include "numeric.hpp"
+
+namespace ocl
+{
+
+/// \brief the drop-cutter and push-cutter of a mesh, compiled for one cutter type.
+///
+/// The mesh and block dropCutter() and the mesh pushCutter() are written once, here.
+/// They call height(), width(), planeFacetDrop(), singleEdgeDropCanonical() and the other
+/// contact functions by their qualified name Cutter::f(), so that they can be inlined.
+/// Cutter is CylCutter, BallCutter, BullCutter or ConeCutter, and must be the exact type of
+/// the cutter. CutterEngine<MillingCutter> calls the virtual MillingCutter functions instead,
+/// for any other cutter, and is what the MillingCutter entry points of the same name run.
+/// A cutter without MillingCutter::hasMeshKernels(), such as a class derived from a cutter of this
+/// library or a MillingCutter subclassed in Python, is dropped with dropCutter(cl, t) and pushed with
+/// pushCutter(f, i, t) on each triangle, so that its overrides are called.
+/// See BatchDropCutter::dropCutter6() and BatchPushCutter::pushCutter3().
+template <class Cutter>
+class CutterEngine {
+    public:
+        /// an engine for cutter c
+        explicit CutterEngine(const Cutter& c) : cutter(c), perTriangle( !c.hasMeshKernels() ) {}
+        /// MillingCutter::vertexDrop(DropPacket&, ...)
+        bool vertexDrop(DropPacket& packet, const double* x, const double* y, const double* z, unsigned int n) const {
+            if (perTriangle) // the vertices are dropped against with each triangle
+                return false;
+            return packetDrop(packet, x, y, z, n);
+        }
+        /// MillingCutter::dropCutter(cl, t, ps, n, mesh, marks, vertices)
+        bool dropCutter(CLPoint &cl, const Triangle &t, const PackedSurf& ps, unsigned int n,
+                        const IndexedMesh& mesh, MeshMarks& marks, bool vertices = true) const {
+            if (perTriangle)
+                return cutter.MillingCutter::dropCutter(cl, t);
+            bool facet(false), vertex(false), edge(false);
+            if (cl.below(t)) {
+                facet = facetDrop(cl,t,ps,n);
+                if ( !facet || !facetIsHighest() ) {
+                    for (int k=0; (k<3) && vertices; k++) {
+                        const boost::uint32_t vtx = mesh.triVertex(n,k);
+                        if ( marks.markVertex(vtx) && singleVertexDrop(cl, mesh.vertex(vtx)) )
+                            vertex = true;
+                    }
+                    if ( cl.below(t) ) {
+                        for (int k=0;k<3;k++) {
+                            const boost::uint32_t edg = mesh.triEdge(n,k);
+                            if ( ( edg != IndexedMesh::NONE ) && mesh.xyEdge(edg) && marks.markEdge(edg) ) {
+                                if ( meshEdgeDrop(cl, mesh.vertex( mesh.edgeVertex(edg,0) ), 
+                                                      mesh.vertex( mesh.edgeVertex(edg,1) ), mesh.edgeDir(edg)) )
+                                    edge = true;
+                            }
+                        }
+                    }
+                }
+            }
+            return ( facet || vertex || edge ); 
+        }
+        /// MillingCutter::dropCutter(cl, block, ps, mesh, marks)
+        bool dropCutter(CLPoint &cl, DropBlock& block, const PackedSurf& ps,
+                        const IndexedMesh& mesh, MeshMarks& marks) const {
+            if (perTriangle) {
+                bool result = false;
+                for (unsigned int j=0; j<block.size(); ++j) {
+                    if ( cutter.MillingCutter::dropCutter(cl, *block.t[j]) )
+                        result = true;
+                }
+                return result;
+            }
+            bool facet = blockFacetDrop(cl, block, ps);
+            block.gatherEdges(cl, mesh, marks);
+            bool edge = blockEdgeDrop(cl, block.edges);
+            return ( facet || edge );
+        }
+        /// MillingCutter::pushCutter(f, i, t, ps, n, mesh, marks)
+        bool pushCutter(const Fiber& f, Interval& i, const Triangle& t, const PackedSurf& ps, unsigned int n,
+                        const IndexedMesh& mesh, PushMarks& marks) const {
+            if (perTriangle)
+                return cutter.MillingCutter::pushCutter(f, i, t);
+            std::vector<Interval>& contacts = marks.contacts;
+            bool v(false), fa(false), e(false);
+            for (int k=0;k<3;k++) {
+                const boost::uint32_t vtx = mesh.triVertex(n,k);
+                if ( marks.markVertex(vtx) ) { // first triangle with this vertex
+                    marks.vertexSlot[vtx] = contacts.size();
+                    contacts.push_back( Interval() );
+                    vertexPush(f, contacts.back(), mesh.vertex(vtx));
+                }
+                if ( MillingCutter::mergeContact(i, contacts[ marks.vertexSlot[vtx] ]) )
+                    v = true;
+            }
+            if ( slicePush(f,i,t) ) // not shared with other triangles
+                v = true;
+            fa = facetPush(f,i,t,ps,n);
+            for (int k=0;k<3;k++) {
+                const boost::uint32_t edg = mesh.triEdge(n,k);
+                if ( edg == IndexedMesh::NONE ) // welded to a point, covered by the vertex
+                    continue;
+                if ( marks.markEdge(edg) ) { // first triangle with this edge
+                    marks.edgeSlot[edg] = contacts.size();
+                    contacts.push_back( Interval() );
+                    edgePush(f, contacts.back(), mesh.vertex( mesh.edgeVertex(edg,0) ), mesh.vertex( mesh.edgeVertex(edg,1) ));
+                }
+                if ( MillingCutter::mergeContact(i, contacts[ marks.edgeSlot[edg] ]) )
+                    e = true;
+            }
+            return v || fa || e;
+        }
+    protected:
+        /// MillingCutter::vertexDrop(DropPacket&, ...)
+        bool packetDrop(DropPacket& packet, const double* x, const double* y, const double* z, unsigned int n) const {
+            return cutter.Cutter::vertexDrop(packet, x, y, z, n);
+        }
+        /// MillingCutter::facetDrop(cl, t, ps, n)
+        bool facetDrop(CLPoint &cl, const Triangle &t, const PackedSurf& ps, unsigned int n) const {
+            if ( ps.has(n, PackedSurf::VERTICAL_FACET) )
+                return false;
+            if ( ps.has(n, PackedSurf::HORIZONTAL_FACET) ) {
+                CCPoint cc_tmp( cl.x, cl.y, ps.z[3*n], FACET);
+                return cl.liftZ_if_inFacet(cc_tmp.z, cc_tmp, t);
+            }
+            return cutter.Cutter::planeFacetDrop(cl, t, ps.normal(n), ps.d[n], ps.xyNormal(n));
+        }
+        /// MillingCutter::facetIsHighest()
+        bool facetIsHighest() const {
+            return cutter.Cutter::facetIsHighest();
+        }
+        /// MillingCutter::singleVertexDrop()
+        bool singleVertexDrop(CLPoint& cl, const Point& p) const {
+            double q = cl.xyDistance(p);
+            if ( q <= cutter.getRadius() ) {
+                CCPoint cc_tmp(p, VERTEX);
+                return cl.liftZ( p.z - cutter.Cutter::height(q), cc_tmp );
+            }
+            return false;
+        }
+        /// MillingCutter::meshEdgeDrop() and singleEdgeDrop()
+        bool meshEdgeDrop(CLPoint& cl, const Point& p1, const Point& p2, const Point& vxy) const {
+            const double d = cl.xyDistanceToLine(p1,p2);
+            if ( d > cutter.getRadius() )  // no contact with edge
+                return false;
+            Point sc = cl.xyClosestPoint( p1, p2 );
+            Point u1( (p1-sc).dot(vxy) , d, p1.z);
+            Point u2( (p2-sc).dot(vxy) , d, p2.z);
+            CC_CLZ_Pair contact = cutter.Cutter::singleEdgeDropCanonical( u1, u2 );
+            CCPoint cc_tmp( sc + contact.first * vxy, EDGE);
+            cc_tmp.z_projectOntoEdge(p1,p2);
+            return cl.liftZ_if_InsidePoints( contact.second , cc_tmp , p1, p2);
+        }
+        /// MillingCutter::blockFacetDrop()
+        bool blockFacetDrop(CLPoint &cl, DropBlock& block, const PackedSurf& ps) const {
+            bool result = false;
+            for (unsigned int j=0; j<block.size(); ++j) {
+                if ( cl.below( *block.t[j] ) && facetDrop(cl, *block.t[j], ps, block.n[j]) ) {
+                    block.facet[j] = facetIsHighest();
+                    result = true;
+                }
+            }
+            return result;
+        }
+        /// MillingCutter::blockEdgeDrop()
+        bool blockEdgeDrop(CLPoint &cl, EdgeBlock& edges) const {
+            bool result = false;
+            for (unsigned int j=0; j<edges.size(); ++j) {
+                if ( meshEdgeDrop(cl, Point(edges.x1[j], edges.y1[j], edges.z1[j]), 
+                                      Point(edges.x2[j], edges.y2[j], edges.z2[j]), Point(edges.vx[j], edges.vy[j], 0.0)) )
+                    result = true;
+            }
+            return result;
+        }
+        /// MillingCutter::meshVertexPush()
+        bool vertexPush(const Fiber& f, Interval& i, const Point& p) const {
+            if ( ( p.z >= f.p1.z ) && ( p.z <= (f.p1.z + cutter.getLength()) ) ) // p.z is within cutter
+                return cutter.singleVertexPush(f, i, p, VERTEX, cutter.Cutter::width( p.z - f.p1.z ) );
+            return false;
+        }
+        /// MillingCutter::facetPush(f, i, t, ps, n)
+        bool facetPush(const Fiber& f, Interval& i, const Triangle& t, const PackedSurf& ps, unsigned int n) const {
+            return cutter.Cutter::facetPush(f, i, t, ps, n);
+        }
+        /// MillingCutter::slicePush()
+        bool slicePush(const Fiber& f, Interval& i, const Triangle& t) const {
+            return cutter.Cutter::slicePush(f, i, t);
+        }
+        /// MillingCutter::meshEdgePush() and singleEdgePush()
+        bool edgePush(const Fiber& f, Interval& i, const Point& p1, const Point& p2) const {
+            const double h = p1.z - f.p1.z; // height of edge above fiber
+            if ( (h > 0.0) && isZero_tol( p2.z-p1.z ) && cutter.horizEdgePush(f, i, p1, p2, cutter.Cutter::width(h)) )
+                return true;
+            bool result = false;
+            if ( cutter.shaftEdgePush(f,i,p1,p2) )
+                result = true;
+            if ( cutter.Cutter::generalEdgePush(f,i,p1,p2) )
+                result = true;
+            return result;
+        }
+        /// the cutter
+        const Cutter& cutter;
+        /// drop and push one Triangle at a time, as the cutter has no mesh kernels
+        const bool perTriangle;
+};
+
+// the horizontal facet of a ConeCutter is touched by the tip
+template <>
+inline bool CutterEngine<ConeCutter>::facetDrop(CLPoint &cl, const Triangle &t, const PackedSurf& ps, unsigned int n) const {
+    if ( ps.has(n, PackedSurf::VERTICAL_FACET) )
+        return false;
+    if ( ps.has(n, PackedSurf::HORIZONTAL_FACET) ) {
+        CCPoint cc_tmp( cl.x, cl.y, ps.z[3*n], FACET_TIP );
+        return cl.liftZ_if_inFacet(cc_tmp.z, cc_tmp, t);
+    }
+    return cutter.ConeCutter::planeFacetDrop(cl, t, ps.normal(n), ps.d[n], ps.xyNormal(n));
+}
+
+// CylCutter and BallCutter have SIMD kernels for blocks of facets and edges
+template <>
+inline bool CutterEngine<CylCutter>::blockFacetDrop(CLPoint &cl, DropBlock& block, const PackedSurf& ps) const {
+    return cutter.CylCutter::blockFacetDrop(cl, block, ps);
+}
+
+template <>
+inline bool CutterEngine<CylCutter>::blockEdgeDrop(CLPoint &cl, EdgeBlock& edges) const {
+    return cutter.CylCutter::blockEdgeDrop(cl, edges);
+}
+
+template <>
+inline bool CutterEngine<BallCutter>::blockFacetDrop(CLPoint &cl, DropBlock& block, const PackedSurf& ps) const {
+    return cutter.BallCutter::blockFacetDrop(cl, block, ps);
+}
+
+template <>
+inline bool CutterEngine<BallCutter>::blockEdgeDrop(CLPoint &cl, EdgeBlock& edges) const {
+    return cutter.BallCutter::blockEdgeDrop(cl, edges);
+}
+
+// CutterEngine<MillingCutter> calls the virtual functions, for any cutter
+template <>
+inline bool CutterEngine<MillingCutter>::packetDrop(DropPacket& packet, const double* x, const double* y, const double* z, unsigned int n) const {
+    return cutter.vertexDrop(packet, x, y, z, n);
+}
+
+template <>
+inline bool CutterEngine<MillingCutter>::facetDrop(CLPoint &cl, const Triangle &t, const PackedSurf& ps, unsigned int n) const {
+    return cutter.facetDrop(cl, t, ps, n);
+}
+
+template <>
+inline bool CutterEngine<MillingCutter>::facetIsHighest() const {
+    return cutter.facetIsHighest();
+}
+
+template <>
+inline bool CutterEngine<MillingCutter>::singleVertexDrop(CLPoint& cl, const Point& p) const {
+    return cutter.singleVertexDrop(cl, p);
+}
+
+template <>
+inline bool CutterEngine<MillingCutter>::meshEdgeDrop(CLPoint& cl, const Point& p1, const Point& p2, const Point& vxy) const {
+    return cutter.meshEdgeDrop(cl, p1, p2, vxy);
+}
+
+template <>
+inline bool CutterEngine<MillingCutter>::blockFacetDrop(CLPoint &cl, DropBlock& block, const PackedSurf& ps) const {
+    return cutter.blockFacetDrop(cl, block, ps);
+}
+
+template <>
+inline bool CutterEngine<MillingCutter>::blockEdgeDrop(CLPoint &cl, EdgeBlock& edges) const {
+    return cutter.blockEdgeDrop(cl, edges);
+}
+
+template <>
+inline bool CutterEngine<MillingCutter>::vertexPush(const Fiber& f, Interval& i, const Point& p) const {
+    return cutter.meshVertexPush(f, i, p);
+}
+
+template <>
+inline bool CutterEngine<MillingCutter>::facetPush(const Fiber& f, Interval& i, const Triangle& t, const PackedSurf& ps, unsigned int n) const {
+    return cutter.facetPush(f, i, t, ps, n);
+}
+
+template <>
+inline bool CutterEngine<MillingCutter>::slicePush(const Fiber& f, Interval& i, const Triangle& t) const {
+    return cutter.slicePush(f, i, t);
+}
+
+template <>
+inline bool CutterEngine<MillingCutter>::edgePush(const Fiber& f, Interval& i, const Point& p1, const Point& p2) const {
+    return cutter.meshEdgePush(f, i, p1, p2);
+}
+
+} // end namespace
+#endif
+// end file cutterengine.hpp
@@ -22,8 +22,7 @@
 #include <iostream>
 #include <sstream>
 #include <string>
-
-#include <boost/foreach.hpp>
+#include <typeinfo>
 
 #include "cylcutter.hpp"
 #include "bullcutter.hpp" // for offsetCutter()
@@ -46,8 +45,45 @@ CylCutter::CylCutter(double d, double l) {
     center_height = 0.0;
 }
 
-// drop-cutter vertexDrop is handled by the base-class method in MillingCutter
-// drop-cutter facetDrop is handled by the base-class method in MillingCutter
+/// the flat end of a CylCutter, for drop_vertices() and drop_edges()
+class CylProfile {
+    public:
+        CylProfile(double r) : radius(r), radius_sq(r*r) {}
+        /// the flat end has zero height inside the radius
+        SimdDouble height(const SimdDouble& q) const {return SimdDouble(0.0);}
+        /// same as CylCutter::singleEdgeDropCanonical()
+        void edge(const SimdDouble& d, const SimdDouble& u1, const SimdDouble& z1, 
+                  const SimdDouble& u2, const SimdDouble& z2, SimdDouble& cc_u, SimdDouble& cl_z) const {
+            const SimdDouble s = simd_sqrt( radius_sq - d*d );
+            const SimdDouble du = u2 - u1, dz = z2 - z1;
+            const SimdDouble z_plus  = z1 + ( ( s - u1)/du )*dz;
+            const SimdDouble z_minus = z1 + ( (-s - u1)/du )*dz;
+            const SimdMask higher = ( z_plus > z_minus );
+            cc_u = simd_select( higher, s, -s );
+            cl_z = simd_select( higher, z_plus, z_minus );
+        }
+        /// cutter radius
+        double radius;
+    private:
+        /// radius squared
+        SimdDouble radius_sq;
+};
+
+// drop-cutter vertexDrop is handled by the base-class method in MillingCutter,
+// and for packets of CL-points here
+bool CylCutter::vertexDrop(DropPacket& packet, const double* x, const double* y, const double* z, unsigned int n) const {
+    return drop_vertices( CylProfile(radius), packet, x, y, z, n );
+}
+
+// drop-cutter facetDrop is handled by the base-class method in MillingCutter,
+// and for blocks of triangles here
+bool CylCutter::blockFacetDrop(CLPoint &cl, DropBlock& block, const PackedSurf& ps) const {
+    return drop_facets( cl, block, ps, xy_normal_length, normal_length, center_height );
+}
+
+bool CylCutter::blockEdgeDrop(CLPoint &cl, EdgeBlock& edges) const {
+    return drop_edges( CylProfile(radius), cl, edges );
+}
 
 // we handle the edge-drop here.
 CC_CLZ_Pair CylCutter::singleEdgeDropCanonical(const Point& u1, const Point& u2) const {
@@ -70,14 +106,16 @@ CC_CLZ_Pair CylCutter::singleEdgeDropCanonical(const Point& u1, const Point& u2)
     return CC_CLZ_Pair( cc_u, cl_z);
 }
 
-// general purpose vertexPush, delegates to this->width(h) 
+// the vertices, and the ends of the slice of t at the fiber height
 bool CylCutter::vertexPush(const Fiber& f, Interval& i, const Triangle& t) const {
-    bool result = false;
-    BOOST_FOREACH( const Point& p, t.p) {
-        if (this->singleVertexPush(f,i,p, VERTEX) )
-            result = true;
-    }
+    bool result = MillingCutter::vertexPush(f,i,t);
+    if ( slicePush(f,i,t) )
+        result = true;
+    return result;
+}
 
+bool CylCutter::slicePush(const Fiber& f, Interval& i, const Triangle& t) const {
+    bool result = false;
     Point p1, p2;
     if ( t.zslice_verts(p1, p2, f.p1.z) ) {
         p1.z = f.p1.z; // z-coord should be very close to f.p1.z, but set it exactly anyway.
@@ -87,10 +125,13 @@ bool CylCutter::vertexPush(const Fiber& f, Interval& i, const Triangle& t) const
         if (this->singleVertexPush(f,i,p2, VERTEX_CYL))
             result = true;
     }
-    
     return result;
 }
 
+bool CylCutter::hasMeshKernels() const {
+    return typeid(*this) == typeid(CylCutter);
+}
+
 std::string CylCutter::str() const {
     std::ostringstream o;
     o << *this;
@@ -37,17 +37,28 @@ namespace ocl
 ///
 /// defined by one parameter, the cutter diameter
 class CylCutter : public MillingCutter {
+    template <class Cutter> friend class CutterEngine;
     public:
         CylCutter();
         /// create CylCutter with diameter d and length l
         explicit CylCutter(double d, double l);
         /// offset of Cylinder is BullCutter
         MillingCutter* offsetCutter(double d) const {return new BullCutter(diameter+2*d, d, length+d);}
+        /// vertexDrop() of a packet of CL-points, see drop_vertices()
+        bool vertexDrop(DropPacket& packet, const double* x, const double* y, const double* z, unsigned int n) const;
+        /// facetDrop() against a block of triangles, see drop_facets()
+        bool blockFacetDrop(CLPoint &cl, DropBlock& block, const PackedSurf& ps) const;
+        /// edge-drop against a block of edges, see drop_edges()
+        bool blockEdgeDrop(CLPoint &cl, EdgeBlock& edges) const;
         /// string repr
         friend std::ostream& operator<<(std::ostream &stream, CylCutter c);        
+        /// true for a CylCutter, but not for a class derived from it
+        bool hasMeshKernels() const;
         std::string str() const;
     protected:
         bool vertexPush(const Fiber& f, Interval& i, const Triangle& t) const;
+        /// push the cylinder against the ends of the slice of t at the fiber height
+        bool slicePush(const Fiber& f, Interval& i, const Triangle& t) const;
         CC_CLZ_Pair singleEdgeDropCanonical(const Point& u1, const Point& u2) const;
         double height(double r) const {return ( r <= radius ) ? 0.0 : -1.0;}
         double width(double h) const {return radius;} 
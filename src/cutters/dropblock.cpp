@@ -0,0 +1,149 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "dropblock.hpp"
+
+namespace ocl
+{
+
+void DropBlock::gatherEdges(const CLPoint& cl, const IndexedMesh& mesh, MeshMarks& marks) {
+    edges.clear();
+    for (unsigned int j=0; j<count; ++j) {
+        if ( facet[j] || !cl.below( *t[j] ) )
+            continue;
+        for (int k=0;k<3;k++) {
+            const boost::uint32_t edg = mesh.triEdge(n[j],k);
+            if ( ( edg != IndexedMesh::NONE ) && mesh.xyEdge(edg) && marks.markEdge(edg) ) {
+                if ( mesh.edgeMaxZ(edg) > cl.z ) // a lower edge can not lift cl
+                    edges.add(mesh, edg);
+            }
+        }
+    }
+}
+
+bool drop_facets(CLPoint& cl, DropBlock& block, const PackedSurf& ps,
+                 double xy_normal_length, double normal_length, double center_height) {
+    bool result = false;
+    // the facets that are neither vertical nor horizontal are copied into lanes,
+    // horizontal facets are tested here, and vertical ones can not be dropped against
+    double nx[DROP_BLOCK_SIZE], ny[DROP_BLOCK_SIZE], nz[DROP_BLOCK_SIZE], d[DROP_BLOCK_SIZE];
+    double xynx[DROP_BLOCK_SIZE], xyny[DROP_BLOCK_SIZE];
+    double px[3][DROP_BLOCK_SIZE], py[3][DROP_BLOCK_SIZE], pz[3][DROP_BLOCK_SIZE];
+    unsigned int slot[DROP_BLOCK_SIZE];
+    unsigned int lanes = 0;
+    for (unsigned int j=0; j<block.size(); ++j) {
+        const unsigned int n = block.n[j];
+        if ( ps.has(n, PackedSurf::VERTICAL_FACET) || !cl.below( *block.t[j] ) )
+            continue;
+        if ( ps.has(n, PackedSurf::HORIZONTAL_FACET) ) {
+            CCPoint cc_tmp( cl.x, cl.y, ps.z[3*n], FACET );
+            if ( cc_tmp.isInside( *block.t[j] ) ) {
+                block.facet[j] = true;
+                if ( cl.liftZ( cc_tmp.z, cc_tmp ) )
+                    result = true;
+            }
+            continue;
+        }
+        nx[lanes] = ps.nx[n];
+        ny[lanes] = ps.ny[n];
+        nz[lanes] = ps.nz[n];
+        d[lanes] = ps.d[n];
+        xynx[lanes] = ps.xynx[n];
+        xyny[lanes] = ps.xyny[n];
+        for (int k=0; k<3; ++k) {
+            px[k][lanes] = ps.x[3*n+k];
+            py[k][lanes] = ps.y[3*n+k];
+            pz[k][lanes] = ps.z[3*n+k];
+        }
+        slot[lanes] = j;
+        ++lanes;
+    }
+    if ( lanes == 0 )
+        return result;
+    const int W = SimdDouble::width;
+    for (unsigned int m=lanes; (m % W) != 0; ++m) { // repeat the last facet
+        nx[m] = nx[lanes-1]; ny[m] = ny[lanes-1]; nz[m] = nz[lanes-1]; d[m] = d[lanes-1];
+        xynx[m] = xynx[lanes-1]; xyny[m] = xyny[lanes-1];
+        for (int k=0; k<3; ++k) {
+            px[k][m] = px[k][lanes-1];
+            py[k][m] = py[k][lanes-1];
+            pz[k][m] = pz[k][lanes-1];
+        }
+    }
+    const SimdDouble clx( cl.x ), cly( cl.y );
+    const SimdDouble xl( xy_normal_length ), nl( normal_length ), ch( center_height );
+    const SimdDouble zero( 0.0 ), one( 1.0 );
+    double best = cl.z;
+    double cc[3] = {0, 0, 0};
+    bool found = false;
+    for (unsigned int j=0; j<lanes; j+=W) {
+        const SimdDouble Nx = SimdDouble::load( &nx[j] ), Ny = SimdDouble::load( &ny[j] ), Nz = SimdDouble::load( &nz[j] );
+        // the radiusvector points from the cc-point to the cutter-center, as in MillingCutter::planeFacetDrop()
+        const SimdDouble rx = xl*SimdDouble::load( &xynx[j] ) + nl*Nx;
+        const SimdDouble ry = xl*SimdDouble::load( &xyny[j] ) + nl*Ny;
+        const SimdDouble rz = nl*Nz;
+        const SimdDouble ccx = clx - rx, ccy = cly - ry;
+        const SimdDouble ccz = ( one/Nz )*( -SimdDouble::load( &d[j] ) - Nx*ccx - Ny*ccy ); // cc-point lies in the plane
+        const SimdDouble tip_z = ccz + rz - ch;
+        // Point::isInside(const Triangle&)
+        const SimdDouble x0 = SimdDouble::load( &px[0][j] ), y0 = SimdDouble::load( &py[0][j] ), z0 = SimdDouble::load( &pz[0][j] );
+        const SimdDouble v0x = SimdDouble::load( &px[2][j] ) - x0, v0y = SimdDouble::load( &py[2][j] ) - y0, v0z = SimdDouble::load( &pz[2][j] ) - z0;
+        const SimdDouble v1x = SimdDouble::load( &px[1][j] ) - x0, v1y = SimdDouble::load( &py[1][j] ) - y0, v1z = SimdDouble::load( &pz[1][j] ) - z0;
+        const SimdDouble v2x = ccx - x0, v2y = ccy - y0, v2z = ccz - z0;
+        const SimdDouble dot00 = v0x*v0x + v0y*v0y + v0z*v0z;
+        const SimdDouble dot01 = v0x*v1x + v0y*v1y + v0z*v1z;
+        const SimdDouble dot02 = v0x*v2x + v0y*v2y + v0z*v2z;
+        const SimdDouble dot11 = v1x*v1x + v1y*v1y + v1z*v1z;
+        const SimdDouble dot12 = v1x*v2x + v1y*v2y + v1z*v2z;
+        const SimdDouble invD = one / ( dot00*dot11 - dot01*dot01 );
+        const SimdDouble u = ( dot11*dot02 - dot01*dot12 )*invD;
+        const SimdDouble v = ( dot00*dot12 - dot01*dot02 )*invD;
+        const int bits = ( (u > zero) & (v > zero) & (u + v < one) ).bits();
+        if ( bits == 0 )
+            continue;
+        double lane[4][SimdDouble::width];
+        tip_z.store( lane[0] );
+        ccx.store( lane[1] );
+        ccy.store( lane[2] );
+        ccz.store( lane[3] );
+        for (int m=0; (m<W) && (j+m<lanes); ++m) {
+            if ( !(bits & (1<<m)) )
+                continue;
+            block.facet[ slot[j+m] ] = true; // the edges are not higher than the facet
+            if ( lane[0][m] > best ) {
+                best = lane[0][m];
+                cc[0] = lane[1][m];
+                cc[1] = lane[2][m];
+                cc[2] = lane[3][m];
+                found = true;
+            }
+        }
+    }
+    if (found) {
+        CCPoint cc_tmp( cc[0], cc[1], cc[2], FACET );
+        if ( cl.liftZ( best, cc_tmp ) )
+            result = true;
+    }
+    return result;
+}
+
+} // end namespace
+// end file dropblock.cpp
@@ -0,0 +1,197 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DROP_BLOCK_H
+#define DROP_BLOCK_H
+
+#include <boost/cstdint.hpp>
+
+#include "clpoint.hpp"
+#include "ccpoint.hpp"
+#include "triangle.hpp"
+#include "packedsurf.hpp"
+#include "indexedmesh.hpp"
+#include "simd.hpp"
+
+namespace ocl
+{
+
+/// number of triangles in a DropBlock, a multiple of SimdDouble::width
+#define DROP_BLOCK_SIZE 16
+/// number of edges in an EdgeBlock, enough for all edges of a DropBlock
+#define EDGE_BLOCK_SIZE (3*DROP_BLOCK_SIZE)
+
+/// \brief edges of an IndexedMesh dropped against together, as a structure of arrays.
+///
+/// See MillingCutter::blockEdgeDrop() and drop_edges().
+class EdgeBlock {
+    public:
+        EdgeBlock() : count(0) {}
+        /// remove all edges
+        void clear() {count = 0;}
+        /// add edge e of mesh, the block must not be full
+        void add(const IndexedMesh& mesh, boost::uint32_t e) {
+            const Point p1 = mesh.vertex( mesh.edgeVertex(e,0) );
+            const Point p2 = mesh.vertex( mesh.edgeVertex(e,1) );
+            const Point v = mesh.edgeDir(e);
+            x1[count] = p1.x; y1[count] = p1.y; z1[count] = p1.z;
+            x2[count] = p2.x; y2[count] = p2.y; z2[count] = p2.z;
+            vx[count] = v.x;  vy[count] = v.y;
+            ++count;
+        }
+        /// repeat the last edge up to a multiple of SimdDouble::width
+        void pad() {
+            for (unsigned int m=count; (m % SimdDouble::width) != 0; ++m) {
+                x1[m] = x1[count-1]; y1[m] = y1[count-1]; z1[m] = z1[count-1];
+                x2[m] = x2[count-1]; y2[m] = y2[count-1]; z2[m] = z2[count-1];
+                vx[m] = vx[count-1]; vy[m] = vy[count-1];
+            }
+        }
+        /// number of edges
+        unsigned int size() const {return count;}
+        /// first endpoint
+        double x1[EDGE_BLOCK_SIZE], y1[EDGE_BLOCK_SIZE], z1[EDGE_BLOCK_SIZE];
+        /// second endpoint
+        double x2[EDGE_BLOCK_SIZE], y2[EDGE_BLOCK_SIZE], z2[EDGE_BLOCK_SIZE];
+        /// unit XY-direction from the first to the second endpoint
+        double vx[EDGE_BLOCK_SIZE], vy[EDGE_BLOCK_SIZE];
+    private:
+        /// number of edges
+        unsigned int count;
+};
+
+/// \brief triangles dropped against together, for one CL-point.
+///
+/// See MillingCutter::dropCutter(CLPoint&, DropBlock&, ...).
+class DropBlock {
+    public:
+        DropBlock() : count(0) {}
+        /// remove all triangles
+        void clear() {count = 0;}
+        /// add triangle t, with index n in the PackedSurf and IndexedMesh. The block must not be full.
+        void add(const Triangle& tri, unsigned int idx) {
+            t[count] = &tri;
+            n[count] = idx;
+            facet[count] = false;
+            ++count;
+        }
+        /// number of triangles
+        unsigned int size() const {return count;}
+        /// \brief set edges to the xy-edges of mesh, not yet tested in the current query of marks,
+        /// of the triangles without block.facet that cl is below. Edges lower than cl are skipped.
+        void gatherEdges(const CLPoint& cl, const IndexedMesh& mesh, MeshMarks& marks);
+        /// true if the block holds DROP_BLOCK_SIZE triangles
+        bool full() const {return count == DROP_BLOCK_SIZE;}
+        /// the triangles
+        const Triangle* t[DROP_BLOCK_SIZE];
+        /// index of each triangle in the PackedSurf and IndexedMesh
+        unsigned int n[DROP_BLOCK_SIZE];
+        /// set by MillingCutter::blockFacetDrop() when the edges of a triangle can not lift the CL-point
+        bool facet[DROP_BLOCK_SIZE];
+        /// the edges to drop against
+        EdgeBlock edges;
+    private:
+        /// number of triangles
+        unsigned int count;
+};
+
+/// \brief MillingCutter::planeFacetDrop() of cl against the facets of block, SimdDouble::width facets at a time.
+///
+/// For cutters that use the base-class facetDrop(), which depends on the cutter only
+/// through xy_normal_length, normal_length and center_height.
+/// Sets block.facet for the triangles where the CC-point is inside the facet.
+/// returns true if cl was lifted.
+bool drop_facets(CLPoint& cl, DropBlock& block, const PackedSurf& ps,
+                 double xy_normal_length, double normal_length, double center_height);
+
+/// \brief MillingCutter::meshEdgeDrop() of cl against all edges, SimdDouble::width edges at a time.
+///
+/// The cutter shape is given by the Profile, which has a member radius, and a function
+/// edge(d, u1, z1, u2, z2, cc_u, cl_z) with the arithmetic of the singleEdgeDropCanonical()
+/// of the cutter: the edge from (u1, d, z1) to (u2, d, z2) gives the CC-point at cc_u along the edge, and cl_z.
+/// The rest has the same arithmetic as MillingCutter::singleEdgeDrop().
+/// returns true if cl was lifted.
+template <class Profile>
+bool drop_edges(const Profile& prof, CLPoint& cl, EdgeBlock& edges) {
+    const unsigned int count = edges.size();
+    if ( count == 0 )
+        return false;
+    edges.pad();
+    const int W = SimdDouble::width;
+    const SimdDouble clx( cl.x ), cly( cl.y ), radius( prof.radius );
+    const SimdDouble zero( 0.0 ), one( 1.0 );
+    double best = cl.z;
+    double cc[3] = {0, 0, 0};
+    bool found = false;
+    for (unsigned int j=0; j<count; j+=W) {
+        const SimdDouble x1 = SimdDouble::load( &edges.x1[j] ), y1 = SimdDouble::load( &edges.y1[j] );
+        const SimdDouble x2 = SimdDouble::load( &edges.x2[j] ), y2 = SimdDouble::load( &edges.y2[j] );
+        const SimdDouble wx = x2 - x1, wy = y2 - y1;
+        // Point::xyDistanceToLine()
+        const SimdDouble nx = wy, ny = -wx;
+        const SimdDouble inv = one / simd_sqrt( nx*nx + ny*ny );
+        const SimdDouble d = simd_abs( (nx*inv)*(x1-clx) + (ny*inv)*(y1-cly) );
+        const SimdMask inside = ( d <= radius ); // potential contact with edge
+        if ( !inside.any() )
+            continue;
+        const SimdDouble z1 = SimdDouble::load( &edges.z1[j] ), z2 = SimdDouble::load( &edges.z2[j] );
+        const SimdDouble vx = SimdDouble::load( &edges.vx[j] ), vy = SimdDouble::load( &edges.vy[j] );
+        // Point::xyClosestPoint()
+        const SimdDouble u = ( (clx-x1)*wx + (cly-y1)*wy ) / ( wx*wx + wy*wy );
+        const SimdDouble scx = x1 + u*wx, scy = y1 + u*wy;
+        // edge endpoints along the edge, CL is at the origin
+        const SimdDouble u1 = (x1-scx)*vx + (y1-scy)*vy;
+        const SimdDouble u2 = (x2-scx)*vx + (y2-scy)*vy;
+        SimdDouble cc_u, cl_z;
+        prof.edge( d, u1, z1, u2, z2, cc_u, cl_z );
+        // translate back, Point::z_projectOntoEdge() and Point::isInside(p1, p2)
+        const SimdDouble ccx = scx + cc_u*vx, ccy = scy + cc_u*vy;
+        const SimdDouble wz = z2 - z1;
+        const SimdDouble tz = simd_select( simd_abs(wx) > simd_abs(wy), (ccx-x1)/wx, (ccy-y1)/wy );
+        const SimdDouble ccz = z1 + tz*wz;
+        const SimdDouble t = ( (ccx-x1)*wx + (ccy-y1)*wy + (ccz-z1)*wz ) / ( wx*wx + wy*wy + wz*wz );
+        const int bits = ( inside & (t >= zero) & (t <= one) & (cl_z > SimdDouble(best)) ).bits();
+        if ( bits == 0 )
+            continue;
+        double lane[4][SimdDouble::width];
+        cl_z.store( lane[0] );
+        ccx.store( lane[1] );
+        ccy.store( lane[2] );
+        ccz.store( lane[3] );
+        for (int m=0; (m<W) && (j+m<count); ++m) {
+            if ( (bits & (1<<m)) && (lane[0][m] > best) ) {
+                best = lane[0][m];
+                cc[0] = lane[1][m];
+                cc[1] = lane[2][m];
+                cc[2] = lane[3][m];
+                found = true;
+            }
+        }
+    }
+    if (!found)
+        return false;
+    CCPoint cc_tmp( cc[0], cc[1], cc[2], EDGE );
+    return cl.liftZ( best, cc_tmp );
+}
+
+} // end namespace
+#endif
+// end file dropblock.hpp
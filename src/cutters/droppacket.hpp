@@ -0,0 +1,147 @@
+/*  $Id$
+ * 
+ *  Copyright (c) 2010 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *  
+ *  This file is part of OpenCAMlib 
+ *  (see https://github.com/aewallin/opencamlib).
+ *  
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DROP_PACKET_H
+#define DROP_PACKET_H
+
+#include <algorithm>
+
+#include "clpoint.hpp"
+#include "ccpoint.hpp"
+#include "simd.hpp"
+
+namespace ocl
+{
+
+/// number of CL-points in a DropPacket, a multiple of SimdDouble::width
+#define DROP_PACKET_SIZE 8
+
+/// \brief a group of CL-points dropped together against the same vertices.
+///
+/// See MillingCutter::vertexDrop(DropPacket&, ...). The coordinates of the points
+/// are copied into arrays, so that they can be loaded into SIMD registers.
+class DropPacket {
+    public:
+        DropPacket() : count(0) {}
+        /// remove all CL-points
+        void clear() {count = 0;}
+        /// add cl to the packet, which must not be full
+        void add(CLPoint& cl) {
+            p[count] = &cl;
+            x[count] = cl.x;
+            y[count] = cl.y;
+            ++count;
+        }
+        /// number of CL-points in the packet
+        unsigned int size() const {return count;}
+        /// true if the packet holds DROP_PACKET_SIZE CL-points
+        bool full() const {return count == DROP_PACKET_SIZE;}
+        /// the CL-points
+        CLPoint* p[DROP_PACKET_SIZE];
+        /// x-coordinates of the CL-points
+        double x[DROP_PACKET_SIZE];
+        /// y-coordinates of the CL-points
+        double y[DROP_PACKET_SIZE];
+    private:
+        /// number of CL-points
+        unsigned int count;
+};
+
+/// \brief vertexDrop() of the CL-points of packet against the vertices (x[i], y[i], z[i]), 0 <= i < n.
+///
+/// The vertices must be sorted by decreasing z, so that the loop can stop at the first vertex
+/// below all CL-points. The cutter shape is given by the Profile, which has a member radius
+/// and a function SimdDouble height(const SimdDouble& q) for distances q <= radius.
+/// Distances, heights and the highest contact are found for SimdDouble::width CL-points
+/// at a time, with the same arithmetic as MillingCutter::singleVertexDrop().
+/// returns true if any CL-point was lifted.
+template <class Profile>
+bool drop_vertices(const Profile& prof, DropPacket& packet, const double* x, const double* y, const double* z, unsigned int n) {
+    const unsigned int count = packet.size();
+    if ( count == 0 )
+        return false;
+    const int W = SimdDouble::width;
+    const int V = DROP_PACKET_SIZE / W;
+    // the unused places of the packet repeat its last CL-point
+    double lane[3][DROP_PACKET_SIZE];
+    for (unsigned int m=0; m<DROP_PACKET_SIZE; ++m) {
+        const unsigned int k = std::min( m, count-1 );
+        lane[0][m] = packet.x[k];
+        lane[1][m] = packet.y[k];
+        lane[2][m] = packet.p[k]->z;
+    }
+    SimdDouble cx[V], cy[V], best[V], which[V];
+    for (int j=0; j<V; ++j) {
+        cx[j] = SimdDouble::load( &lane[0][j*W] );
+        cy[j] = SimdDouble::load( &lane[1][j*W] );
+        best[j] = SimdDouble::load( &lane[2][j*W] );
+        which[j] = SimdDouble(-1.0);
+    }
+    double lowest = *std::min_element( lane[2], lane[2]+DROP_PACKET_SIZE );
+    const SimdDouble radius( prof.radius );
+    for (unsigned int i=0; i<n; ++i) {
+        if ( z[i] <= lowest ) // the cutter height is not negative, so no CL-point can be lifted
+            break;
+        const SimdDouble vx( x[i] );
+        const SimdDouble vy( y[i] );
+        const SimdDouble vz( z[i] );
+        bool lifted = false;
+        for (int j=0; j<V; ++j) {
+            const SimdDouble dx = cx[j] - vx;
+            const SimdDouble dy = cy[j] - vy;
+            const SimdDouble q = simd_sqrt( dx*dx + dy*dy );   // distance in XY-plane from cl to p
+            const SimdMask inside = ( q <= radius );          // p is inside the cutter
+            if ( !inside.any() )
+                continue;
+            const SimdDouble h = vz - prof.height(q);
+            const SimdMask higher = inside & ( h > best[j] );
+            if ( !higher.any() )
+                continue;
+            best[j] = simd_select( higher, h, best[j] );
+            which[j] = simd_select( higher, SimdDouble( (double) i ), which[j] );
+            lifted = true;
+        }
+        if (lifted) {
+            for (int j=0; j<V; ++j)
+                best[j].store( &lane[2][j*W] );
+            lowest = *std::min_element( lane[2], lane[2]+DROP_PACKET_SIZE );
+        }
+    }
+    double vertex[DROP_PACKET_SIZE];
+    for (int j=0; j<V; ++j) {
+        best[j].store( &lane[2][j*W] );
+        which[j].store( &vertex[j*W] );
+    }
+    bool result = false;
+    for (unsigned int m=0; m<count; ++m) {
+        if ( vertex[m] < 0 )
+            continue;
+        const unsigned int i = (unsigned int) vertex[m];
+        CCPoint cc_tmp( x[i], y[i], z[i], VERTEX );
+        if ( packet.p[m]->liftZ( lane[2][m], cc_tmp ) )
+            result = true;
+    }
+    return result;
+}
+
+} // end namespace
+#endif
+// end file droppacket.hpp
@@ -22,6 +22,7 @@
 #include <boost/foreach.hpp>
 
 #include "millingcutter.hpp"
+#include "cutterengine.hpp"
 #include "numeric.hpp"
 
 namespace ocl
@@ -36,10 +37,40 @@ MillingCutter* MillingCutter::offsetCutter(double d) const {
 bool MillingCutter::vertexDrop(CLPoint &cl, const Triangle &t) const {
     bool result = false;
     BOOST_FOREACH( const Point& p, t.p) {           // test each vertex of triangle
-        double q = cl.xyDistance(p);                // distance in XY-plane from cl to p
+        if ( this->singleVertexDrop(cl,p) )
+            result = true;
+    }
+    return result;
+}
+
+bool MillingCutter::singleVertexDrop(CLPoint &cl, const Point& p) const {
+    double q = cl.xyDistance(p);                    // distance in XY-plane from cl to p
+    if ( q <= radius ) {                            // p is inside the cutter
+        CCPoint cc_tmp(p, VERTEX);
+        return cl.liftZ( p.z - this->height(q), cc_tmp );
+    }
+    return false;
+}
+
+bool MillingCutter::vertexDrop(DropPacket& packet, const double* x, const double* y, const double* z, unsigned int n) const {
+    bool result = false;
+    for (unsigned int m=0; m<packet.size(); ++m) {
+        CLPoint& cl = *packet.p[m];
+        for (unsigned int i=0; (i<n) && (z[i] > cl.z); ++i) { // lower vertices can't lift cl
+            if ( this->singleVertexDrop( cl, Point(x[i], y[i], z[i]) ) )
+                result = true;
+        }
+    }
+    return result;
+}
+
+bool MillingCutter::vertexDrop(CLPoint &cl, const PackedSurf& ps, unsigned int n) const {
+    bool result = false;
+    for (unsigned int k=3*n; k<3*n+3; ++k) { // test each vertex of triangle
+        double q = sqrt( square(cl.x-ps.x[k]) + square(cl.y-ps.y[k]) ); // distance in XY-plane from cl to p
         if ( q <= radius ) {                        // p is inside the cutter
-            CCPoint cc_tmp(p, VERTEX);
-            if ( cl.liftZ( p.z - this->height(q), cc_tmp ) )
+            CCPoint cc_tmp( ps.x[k], ps.y[k], ps.z[k], VERTEX);
+            if ( cl.liftZ( ps.z[k] - this->height(q), cc_tmp ) )
                 result = true;
         } 
     }
@@ -64,14 +95,29 @@ bool MillingCutter::facetDrop(CLPoint &cl, const Triangle &t) const { // Drop cu
         normal.normalize(); // make length of normal == 1.0
         Point xyNormal( normal.x, normal.y, 0.0);
         xyNormal.xyNormalize();
-        // define the radiusvector which points from the cc-point to the cutter-center 
-        Point radiusvector = this->xy_normal_length*xyNormal + this->normal_length*normal;
-        CCPoint cc_tmp = cl - radiusvector; // NOTE xy-coords right, z-coord is not.
-        cc_tmp.z = (1.0/normal.z)*(-d-normal.x*cc_tmp.x-normal.y*cc_tmp.y); // cc-point lies in the plane.
-        cc_tmp.type = FACET;
-        double tip_z = cc_tmp.z + radiusvector.z - this->center_height;
-        return cl.liftZ_if_inFacet(tip_z, cc_tmp, t);
+        return planeFacetDrop(cl, t, normal, d, xyNormal);
+    }
+}
+
+bool MillingCutter::planeFacetDrop(CLPoint &cl, const Triangle &t, const Point& normal, double d, const Point& xyNormal) const {
+    // define the radiusvector which points from the cc-point to the cutter-center 
+    Point radiusvector = this->xy_normal_length*xyNormal + this->normal_length*normal;
+    CCPoint cc_tmp = cl - radiusvector; // NOTE xy-coords right, z-coord is not.
+    cc_tmp.z = (1.0/normal.z)*(-d-normal.x*cc_tmp.x-normal.y*cc_tmp.y); // cc-point lies in the plane.
+    cc_tmp.type = FACET;
+    double tip_z = cc_tmp.z + radiusvector.z - this->center_height;
+    return cl.liftZ_if_inFacet(tip_z, cc_tmp, t);
+}
+
+// the normal, plane and xy-normal were computed once by PackedSurf::build()
+bool MillingCutter::facetDrop(CLPoint &cl, const Triangle &t, const PackedSurf& ps, unsigned int n) const {
+    if ( ps.has(n, PackedSurf::VERTICAL_FACET) )
+        return false;  //can't drop against vertical surface
+    if ( ps.has(n, PackedSurf::HORIZONTAL_FACET) ) { // horizontal plane special case
+        CCPoint cc_tmp( cl.x, cl.y, ps.z[3*n], FACET);
+        return cl.liftZ_if_inFacet(cc_tmp.z, cc_tmp, t);
     }
+    return planeFacetDrop(cl, t, ps.normal(n), ps.d[n], ps.xyNormal(n));
 }
 
 // edge-drop function which calls the sub-class MillingCutter::singleEdgeDrop on each 
@@ -93,6 +139,28 @@ bool MillingCutter::edgeDrop(CLPoint &cl, const Triangle &t) const {
     return result;
 }
 
+bool MillingCutter::edgeDrop(CLPoint &cl, const Triangle &t, const PackedSurf& ps, unsigned int n) const {
+    bool result = false;
+    for (int k=0;k<3;k++) { // loop through all three edges
+        if ( ps.has(n, PackedSurf::XY_EDGE << k) ) {
+            const Point p1 = ps.vertex(n, k);
+            const Point p2 = ps.vertex(n, (k+1)%3);
+            const double d = cl.xyDistanceToLine(p1,p2);
+            if (d<=radius)  // potential contact with edge
+                if ( this->singleEdgeDrop(cl,p1,p2,ps.edgeDir(n,k),d) )
+                    result=true;
+        }
+    }
+    return result;
+}
+
+bool MillingCutter::meshEdgeDrop(CLPoint& cl, const Point& p1, const Point& p2, const Point& vxy) const {
+    const double d = cl.xyDistanceToLine(p1,p2);
+    if (d<=radius)  // potential contact with edge
+        return this->singleEdgeDrop(cl,p1,p2,vxy,d);
+    return false;
+}
+
 // 1) translate the geometry so that in the XY plane cl = (0,0) 
 // 2) rotate the p1-p2 edge so that a new edge u1-u2 lies along the x-axis
 // 3) call singleEdgeDropCanonical(), implemented in the sub-class.
@@ -122,6 +190,10 @@ bool MillingCutter::singleEdgeDrop(CLPoint& cl, const Point& p1, const Point& p2
     Point v = p2 - p1;          // vector along edge, from p1 -> p2
     Point vxy( v.x, v.y, 0.0);  // XY projection
     vxy.xyNormalize();          // normalized XY edge vector
+    return singleEdgeDrop(cl, p1, p2, vxy, d);
+}
+
+bool MillingCutter::singleEdgeDrop(CLPoint& cl, const Point& p1, const Point& p2, const Point& vxy, double d) const {
     // figure out u-coordinates of p1 and p2 (i.e. x-coord in the rotated system)
     Point sc = cl.xyClosestPoint( p1, p2 );
     assert( ( (cl-sc).xyNorm() - d ) < 1E-6 );
@@ -145,25 +217,32 @@ bool MillingCutter::vertexPush(const Fiber& f, Interval& i, const Triangle& t) c
     return result;
 }
 
+bool MillingCutter::meshVertexPush(const Fiber& f, Interval& i, const Point& p) const {
+    return this->singleVertexPush(f,i,p,VERTEX);
+}
+
 bool MillingCutter::singleVertexPush(const Fiber& f, Interval& i, const Point& p, CCType cctyp) const {
-    bool result = false;
     if ( ( p.z >= f.p1.z ) && ( p.z <= (f.p1.z+ this->getLength()) ) ) { // p.z is within cutter
-        Point pq = p.xyClosestPoint(f.p1, f.p2); // closest point on fiber
-        double q = (p-pq).xyNorm(); // distance in XY-plane from fiber to p
         double h = p.z - f.p1.z;
         assert( h>= 0.0);
-        double cwidth = this->width( h );
-        if ( q <= cwidth ) { // we are going to hit the vertex p
-            double ofs = sqrt( square( cwidth ) - square(q) ); // distance along fiber 
-            Point start = pq - ofs*f.dir;
-            Point stop  = pq + ofs*f.dir;
-            CCPoint cc_tmp( p, cctyp );
-            i.updateUpper( f.tval(stop) , cc_tmp );
-            i.updateLower( f.tval(start) , cc_tmp );
-            result = true;                
-        }             
+        return singleVertexPush(f, i, p, cctyp, this->width( h ) );
     }
-    return result;
+    return false;
+}
+
+bool MillingCutter::singleVertexPush(const Fiber& f, Interval& i, const Point& p, CCType cctyp, double cwidth) const {
+    Point pq = p.xyClosestPoint(f.p1, f.p2); // closest point on fiber
+    double q = (p-pq).xyNorm(); // distance in XY-plane from fiber to p
+    if ( q <= cwidth ) { // we are going to hit the vertex p
+        double ofs = sqrt( square( cwidth ) - square(q) ); // distance along fiber 
+        Point start = pq - ofs*f.dir;
+        Point stop  = pq + ofs*f.dir;
+        CCPoint cc_tmp( p, cctyp );
+        i.updateUpper( f.tval(stop) , cc_tmp );
+        i.updateLower( f.tval(start) , cc_tmp );
+        return true;
+    }
+    return false;
 }
 
 bool MillingCutter::facetPush(const Fiber& fib, Interval& i,  const Triangle& t) const {
@@ -181,15 +260,36 @@ bool MillingCutter::generalFacetPush(double normal_length,
                                      Interval& i,  
                                      const Triangle& t) 
                                      const {
-    bool result = false;
     Point normal = t.upNormal(); // facet surface normal, pointing up 
     if ( normal.zParallel() ) // normal points in z-dir   
-        return result; //can't push against horizontal plane, stop here.
+        return false; //can't push against horizontal plane, stop here.
     normal.normalize();
     Point xy_normal = normal;
     xy_normal.z = 0;
     xy_normal.xyNormalize();
-    
+    return generalFacetPush(normal_length, center_height, xy_normal_length, normal, xy_normal, fib, i, t);
+}
+
+bool MillingCutter::facetPush(const Fiber& fib, Interval& i, const Triangle& t, const PackedSurf& ps, unsigned int n) const {
+    if ( ps.has(n, PackedSurf::Z_NORMAL) )
+        return false;
+    return generalFacetPush(this->normal_length,
+                            this->center_height,
+                            this->xy_normal_length,
+                            ps.normal(n), ps.xyNormal(n),
+                            fib,i,t);
+}
+
+bool MillingCutter::generalFacetPush(double normal_length,
+                                     double center_height,
+                                     double xy_normal_length,
+                                     const Point& normal,
+                                     const Point& xy_normal,
+                                     const Fiber& fib, 
+                                     Interval& i,  
+                                     const Triangle& t) 
+                                     const {
+    bool result = false;
     //   find a point on the plane from which radius2*normal+radius1*xy_normal lands on the fiber+radius2*Point(0,0,1) 
     //   (u,v) locates a point on the triangle facet    v0+ u*(v1-v0)+v*(v2-v0)    u,v in [0,1]
     //   t locates a point along the fiber:             p1 + t*(p2-p1)             t in [0,1]
@@ -300,6 +400,10 @@ bool MillingCutter::singleEdgePush(const Fiber& f, Interval& i,  const Point& p1
     return result;
 }
 
+bool MillingCutter::meshEdgePush(const Fiber& f, Interval& i, const Point& p1, const Point& p2) const {
+    return this->singleEdgePush(f,i,p1,p2);
+}
+
 // this is used for the cylindrical shaft of Cyl, Ball, Bull, Cone
 bool MillingCutter::shaftEdgePush(const Fiber& f, Interval& i,  const Point& p1, const Point& p2) const {
     // push cutter along Fiber f in contact with edge p1-p2
@@ -333,34 +437,37 @@ bool MillingCutter::shaftEdgePush(const Fiber& f, Interval& i,  const Point& p1,
 
 // this is the horizontal edge case
 bool MillingCutter::horizEdgePush(const Fiber& f, Interval& i,  const Point& p1, const Point& p2) const {
-    bool result=false;
     double h = p1.z - f.p1.z; // height of edge above fiber
     if ( (h > 0.0) ) {
-        if ( isZero_tol( p2.z-p1.z ) ) { // this is the horizontal-edge special case
-            double eff_radius = this->width( h ); // the cutter acts as a cylinder with eff_radius 
-            // contact this cylinder/circle against edge in xy-plane
-            double qt;      // fiber is f.p1 + qt*(f.p2-f.p1)
-            double qv;      // line  is p1 + qv*(p2-p1)
-            if (xy_line_line_intersection( p1 , p2, qv, f.p1, f.p2, qt ) ) {
-                Point q = p1 + qv*(p2-p1); // the intersection point
-                // from q, go v-units along tangent, then eff_r*normal, and end up on fiber:
-                // q + ccv*tangent + r*normal = p1 + clt*(p2-p1)
-                double ccv, clt;
-                Point xy_tang=p2-p1;
-                xy_tang.z=0;
-                xy_tang.xyNormalize();
-                Point xy_normal = xy_tang.xyPerp();
-                Point q1 = q+eff_radius*xy_normal;
-                Point q2 = q1+(p2-p1);
-                if ( xy_line_line_intersection( q1 , q2, ccv, f.p1, f.p2, clt ) ) {
-                    double t_cl1 = clt;
-                    double t_cl2 = qt + (qt - clt );
-                    if ( calcCCandUpdateInterval(t_cl1, ccv, q, p1, p2, f, i, f.p1.z, EDGE_HORIZ) )
-                        result = true;
-                    if ( calcCCandUpdateInterval(t_cl2, -ccv, q, p1, p2, f, i, f.p1.z, EDGE_HORIZ) )
-                        result = true;
-                }
-            }
+        if ( isZero_tol( p2.z-p1.z ) ) // this is the horizontal-edge special case
+            return horizEdgePush(f, i, p1, p2, this->width( h ) ); // the cutter acts as a cylinder with eff_radius 
+    }
+    return false;
+}
+
+bool MillingCutter::horizEdgePush(const Fiber& f, Interval& i,  const Point& p1, const Point& p2, double eff_radius) const {
+    bool result=false;
+    // contact the cylinder/circle of radius eff_radius against edge in xy-plane
+    double qt;      // fiber is f.p1 + qt*(f.p2-f.p1)
+    double qv;      // line  is p1 + qv*(p2-p1)
+    if (xy_line_line_intersection( p1 , p2, qv, f.p1, f.p2, qt ) ) {
+        Point q = p1 + qv*(p2-p1); // the intersection point
+        // from q, go v-units along tangent, then eff_r*normal, and end up on fiber:
+        // q + ccv*tangent + r*normal = p1 + clt*(p2-p1)
+        double ccv, clt;
+        Point xy_tang=p2-p1;
+        xy_tang.z=0;
+        xy_tang.xyNormalize();
+        Point xy_normal = xy_tang.xyPerp();
+        Point q1 = q+eff_radius*xy_normal;
+        Point q2 = q1+(p2-p1);
+        if ( xy_line_line_intersection( q1 , q2, ccv, f.p1, f.p2, clt ) ) {
+            double t_cl1 = clt;
+            double t_cl2 = qt + (qt - clt );
+            if ( calcCCandUpdateInterval(t_cl1, ccv, q, p1, p2, f, i, f.p1.z, EDGE_HORIZ) )
+                result = true;
+            if ( calcCCandUpdateInterval(t_cl2, -ccv, q, p1, p2, f, i, f.p1.z, EDGE_HORIZ) )
+                result = true;
         }
     }
     //std::cout << " horizEdgePush = " << result << "\n";
@@ -381,6 +488,27 @@ bool MillingCutter::pushCutter(const Fiber& f, Interval& i, const Triangle& t) c
     return v || fa || e;
 }
 
+bool MillingCutter::pushCutter(const Fiber& f, Interval& i, const Triangle& t, const PackedSurf& ps, unsigned int n) const {
+    bool v = vertexPush(f,i,t); 
+    bool fa = facetPush(f,i,t,ps,n);
+    bool e = edgePush(f,i,t);
+    return v || fa || e;
+}
+
+bool MillingCutter::mergeContact(Interval& i, Interval& c) {
+    if ( c.upper_cc.type == NONE ) // no contact
+        return false;
+    i.updateUpper( c.upper, c.upper_cc );
+    i.updateLower( c.lower, c.lower_cc );
+    return true;
+}
+
+// the vertices and edges shared with triangles already pushed against along f
+// are not pushed against again, their Intervals are read from marks.contacts instead.
+bool MillingCutter::pushCutter(const Fiber& f, Interval& i, const Triangle& t, const PackedSurf& ps, unsigned int n,
+                               const IndexedMesh& mesh, PushMarks& marks) const {
+    return CutterEngine<MillingCutter>(*this).pushCutter(f, i, t, ps, n, mesh, marks);
+}
 
 // call vertex, facet, and edge drop methods on input Triangle t
 bool MillingCutter::dropCutter(CLPoint &cl, const Triangle &t) const {
@@ -397,7 +525,7 @@ bool MillingCutter::dropCutter(CLPoint &cl, const Triangle &t) const {
     
     if (cl.below(t)) {
         facet = facetDrop(cl,t); // if we make contact with the facet...
-        if (!facet) {            // ...then we will not hit an edge/vertex, so don't check for that
+        if ( !facet || !facetIsHighest() ) { // ...then we will not hit an edge/vertex, so don't check for that
             vertex = vertexDrop(cl,t);
             if ( cl.below(t) ) {
                 edge = edgeDrop(cl,t); 
@@ -408,10 +536,60 @@ bool MillingCutter::dropCutter(CLPoint &cl, const Triangle &t) const {
     return ( facet || vertex || edge ); 
 }
 
+// as dropCutter() above, with the cutter-independent data of t read from ps
+bool MillingCutter::dropCutter(CLPoint &cl, const Triangle &t, const PackedSurf& ps, unsigned int n) const {
+    bool facet(false), vertex(false), edge(false);
+    if (cl.below(t)) {
+        facet = facetDrop(cl,t,ps,n);
+        if ( !facet || !facetIsHighest() ) {
+            vertex = vertexDrop(cl,ps,n);
+            if ( cl.below(t) ) {
+                edge = edgeDrop(cl,t,ps,n); 
+            }
+        }
+    }
+    return ( facet || vertex || edge ); 
+}
+
+// as dropCutter() above, but a vertex or edge shared with a triangle already
+// tested in this query can not lift cl any further, so it is not tested again.
+bool MillingCutter::dropCutter(CLPoint &cl, const Triangle &t, const PackedSurf& ps, unsigned int n,
+                               const IndexedMesh& mesh, MeshMarks& marks, bool vertices) const {
+    return CutterEngine<MillingCutter>(*this).dropCutter(cl, t, ps, n, mesh, marks, vertices);
+}
+
+// the facets first, since a CC-point inside a facet is higher than any CC-point
+// on its edges, and then the edges of the other triangles, once per query.
+bool MillingCutter::dropCutter(CLPoint &cl, DropBlock& block, const PackedSurf& ps,
+                               const IndexedMesh& mesh, MeshMarks& marks) const {
+    return CutterEngine<MillingCutter>(*this).dropCutter(cl, block, ps, mesh, marks);
+}
+
+bool MillingCutter::blockFacetDrop(CLPoint &cl, DropBlock& block, const PackedSurf& ps) const {
+    bool result = false;
+    for (unsigned int j=0; j<block.size(); ++j) {
+        if ( cl.below( *block.t[j] ) && facetDrop(cl, *block.t[j], ps, block.n[j]) ) {
+            block.facet[j] = facetIsHighest();
+            result = true;
+        }
+    }
+    return result;
+}
+
+bool MillingCutter::blockEdgeDrop(CLPoint &cl, EdgeBlock& edges) const {
+    bool result = false;
+    for (unsigned int j=0; j<edges.size(); ++j) {
+        if ( this->meshEdgeDrop(cl, Point(edges.x1[j], edges.y1[j], edges.z1[j]), 
+                                    Point(edges.x2[j], edges.y2[j], edges.z2[j]), Point(edges.vx[j], edges.vy[j], 0.0)) )
+            result = true;
+    }
+    return result;
+}
+
 // TESTING ONLY, don't use for real
 bool MillingCutter::dropCutterSTL(CLPoint &cl, const STLSurf &s) const {
     bool result=false;
-    BOOST_FOREACH( const Triangle& t, s.tris) {
+    BOOST_FOREACH( const Triangle& t, s.getTriangles()) {
         if ( this->dropCutter(cl,t) )
             result = true;
     }
@@ -31,12 +31,17 @@
 #include "point.hpp"
 #include "clpoint.hpp"
 #include "ccpoint.hpp"
+#include "packedsurf.hpp"
+#include "indexedmesh.hpp"
+#include "droppacket.hpp"
+#include "dropblock.hpp"
 
 namespace ocl
 {
 
 class Triangle;
 class STLSurf;
+template <class Cutter> class CutterEngine;
 
 // CC_CLZ_Pair is the return type of 
 // CC is the x-coordinate of the cutter-contact point
@@ -44,11 +49,26 @@ class STLSurf;
 typedef std::pair< double, double > CC_CLZ_Pair;
 typedef std::pair< double, double > DoublePair;
 
+/// \brief MeshMarks for pushing along a Fiber, with the Interval of each vertex and edge pushed against
+///
+/// One per thread. The contacts are kept, with their capacity, from one Fiber to the next.
+class PushMarks : public MeshMarks {
+    public:
+        /// start a new query on mesh m, and forget the contacts of the last one
+        void next(const IndexedMesh& m) {
+            MeshMarks::next(m);
+            contacts.clear();
+        }
+        /// the Intervals of the vertices and edges marked in this query, at vertexSlot and edgeSlot
+        std::vector<Interval> contacts;
+};
+
 ///
 /// \brief MillingCutter is a base-class for all milling cutters
 ///
 class MillingCutter {
     friend class CompositeCutter;
+    template <class Cutter> friend class CutterEngine;
 
     public:
         /// default constructor
@@ -79,6 +99,17 @@ class MillingCutter {
         /// if cl.z is too low, updates cl.z so that cutter does not cut the facet.
         /// CompositeCutter may be the only sub-class that needs to reimplement this function.
         virtual bool facetDrop(CLPoint &cl, const Triangle &t) const;
+        /// \brief true if a contact found by facetDrop() is the highest contact with the triangle,
+        /// so that dropCutter() need not test its vertices and edges.
+        /// CompositeCutter returns false, its facet contact may not be the highest one.
+        virtual bool facetIsHighest() const {return true;}
+        /// \brief true if the mesh and block versions of dropCutter() and pushCutter() give the
+        /// same results as dropCutter(cl, t) and pushCutter(f, i, t).
+        ///
+        /// Only the cutter classes of this library return true, and not classes derived from them,
+        /// which may override facetDrop(), edgeDrop() or the push functions that only the Triangle
+        /// versions call. CutterEngine drops and pushes other cutters one Triangle at a time.
+        virtual bool hasMeshKernels() const {return false;}
         /// \brief drop cutter at (cl.x, cl.y) against the three edges of input Triangle t.
         /// calls the sub-class MillingCutter::singleEdgeDrop on each edge
         /// if cl.z is too low, updates cl.z so that cutter does not cut any edge.
@@ -88,6 +119,46 @@ class MillingCutter {
         /// Follows the template-method, or "self-delegation" design pattern.
         /// if cl.z is too low, updates cl.z so that the cutter does not cut Triangle t.
         bool dropCutter(CLPoint &cl, const Triangle &t) const;
+        
+        /// \brief vertexDrop() against triangle n of the PackedSurf ps
+        bool vertexDrop(CLPoint &cl, const PackedSurf& ps, unsigned int n) const;
+        /// \brief facetDrop() against Triangle t, reading the precomputed normal and plane of triangle n of ps
+        virtual bool facetDrop(CLPoint &cl, const Triangle &t, const PackedSurf& ps, unsigned int n) const;
+        /// \brief edgeDrop() against triangle n of ps, using the precomputed XY edge directions
+        virtual bool edgeDrop(CLPoint& cl, const Triangle &t, const PackedSurf& ps, unsigned int n) const;
+        /// \brief dropCutter() against Triangle t, which is triangle n of the PackedSurf ps.
+        /// Gives the same result as dropCutter(cl, t), with less arithmetic per call.
+        bool dropCutter(CLPoint &cl, const Triangle &t, const PackedSurf& ps, unsigned int n) const;
+        /// \brief dropCutter() against triangle n, testing each vertex and edge of mesh once per query.
+        /// Vertices and edges already tested in the current query of marks are skipped.
+        /// With vertices false no vertex is tested, for CL-points already dropped
+        /// against the vertices with vertexDrop(DropPacket&, ...).
+        bool dropCutter(CLPoint &cl, const Triangle &t, const PackedSurf& ps, unsigned int n,
+                        const IndexedMesh& mesh, MeshMarks& marks, bool vertices = true) const;
+        /// \brief vertexDrop() of all CL-points of packet against the n vertices (x[i], y[i], z[i]).
+        ///
+        /// The vertices must be sorted by decreasing z. The cutters in this directory find the
+        /// distances and heights of several CL-points at once with SIMD instructions, see drop_vertices().
+        /// This default calls singleVertexDrop() for each CL-point and vertex.
+        /// returns true if any CL-point was lifted.
+        virtual bool vertexDrop(DropPacket& packet, const double* x, const double* y, const double* z, unsigned int n) const;
+        /// \brief dropCutter() against the triangles of block, without their vertices.
+        ///
+        /// The facets are dropped against with blockFacetDrop(), and the edges not yet tested in the
+        /// current query of marks, of the triangles where the facet gave no contact, with blockEdgeDrop().
+        /// Gives the same cl.z as dropCutter(cl,t,ps,n,mesh,marks,false) on each triangle.
+        bool dropCutter(CLPoint &cl, DropBlock& block, const PackedSurf& ps,
+                        const IndexedMesh& mesh, MeshMarks& marks) const;
+        /// \brief facetDrop() against each triangle of block, sets block.facet where the edges need not be tested.
+        ///
+        /// CylCutter and BallCutter test several facets at once with SIMD instructions, see drop_facets().
+        /// This default calls facetDrop() on each triangle.
+        virtual bool blockFacetDrop(CLPoint &cl, DropBlock& block, const PackedSurf& ps) const;
+        /// \brief meshEdgeDrop() against each edge of edges.
+        ///
+        /// CylCutter and BallCutter test several edges at once with SIMD instructions, see drop_edges().
+        /// This default calls meshEdgeDrop() on each edge.
+        virtual bool blockEdgeDrop(CLPoint &cl, EdgeBlock& edges) const;
 
         /// \brief call dropCutter on all Triangles in an STLSurf 
         /// drops the MillingCutter at Point cl down along the z-axis
@@ -102,6 +173,14 @@ class MillingCutter {
         /// would violate/gouge the Triangle.
         /// Return true if contact was made with the Triangle
         bool pushCutter(const Fiber& f, Interval& i, const Triangle& t) const;
+        /// pushCutter() against Triangle t, which is triangle n of the PackedSurf ps
+        bool pushCutter(const Fiber& f, Interval& i, const Triangle& t, const PackedSurf& ps, unsigned int n) const;
+        /// \brief pushCutter() against triangle n, pushing against each vertex and edge of mesh once per Fiber.
+        /// The Interval found for a vertex or edge is stored in marks.contacts, at the slot given by marks,
+        /// and re-used for the other triangles that share it. Interval i gets the same
+        /// vertex, facet and edge contacts as pushCutter(f, i, t).
+        bool pushCutter(const Fiber& f, Interval& i, const Triangle& t, const PackedSurf& ps, unsigned int n,
+                        const IndexedMesh& mesh, PushMarks& marks) const;
         
         /// return a string representation of the MillingCutter
         virtual std::string str() const {return "MillingCutter (all derived classes should override this)";}
@@ -116,10 +195,20 @@ class MillingCutter {
         
         /// push cutter against a single vertex p
         bool singleVertexPush(const Fiber& f, Interval& i, const Point& p, CCType cctyp) const;
+        /// singleVertexPush() with the width cwidth of the cutter at the height of p given
+        bool singleVertexPush(const Fiber& f, Interval& i, const Point& p, CCType cctyp, double cwidth) const;
+        /// push cutter against vertex p of an IndexedMesh. calls singleVertexPush().
+        virtual bool meshVertexPush(const Fiber& f, Interval& i, const Point& p) const;
+        /// \brief push cutter against the contacts of Triangle t that are not at a vertex, facet or edge.
+        /// CylCutter pushes against the ends of the slice of t at the height of the fiber.
+        /// called by vertexPush() of these cutters, and by the mesh pushCutter() for each triangle.
+        virtual bool slicePush(const Fiber& f, Interval& i, const Triangle& t) const {return false;}
         
         /// push cutter along Fiber f into contact with facet of Triangle t, and update Interval i
         /// calls generalFacetPush()
         virtual bool facetPush(const Fiber& f, Interval& i, const Triangle& t) const;
+        /// facetPush() reading the precomputed normal of triangle n of ps
+        virtual bool facetPush(const Fiber& f, Interval& i, const Triangle& t, const PackedSurf& ps, unsigned int n) const;
         
         /// push cutter with given normal/center/xy_length into contact with Triangle facet
         bool generalFacetPush(       double normal_length,
@@ -129,6 +218,16 @@ class MillingCutter {
                                      Interval& i,  
                                      const Triangle& t) 
                                      const;
+        /// generalFacetPush() with the unit up-normal and unit XY-normal of t given
+        bool generalFacetPush(       double normal_length,
+                                     double center_height,
+                                     double xy_normal_length,
+                                     const Point& normal,
+                                     const Point& xy_normal,
+                                     const Fiber& fib, 
+                                     Interval& i,  
+                                     const Triangle& t) 
+                                     const;
 
         /// push cutter along Fiber f into contact with edges of Triangle t, update Interval i.
         /// calls singleEdgePush() on all three edges of Triangle t.
@@ -138,11 +237,15 @@ class MillingCutter {
         /// push cutter along fiber against a single edge p1-p2
         /// calls horizEdgePush(), shaftEdgePush(), and generalEdgePush()
         bool singleEdgePush(const Fiber& f, Interval& i,  const Point& p1, const Point& p2) const;
+        /// push cutter against edge p1-p2 of an IndexedMesh. calls singleEdgePush().
+        virtual bool meshEdgePush(const Fiber& f, Interval& i, const Point& p1, const Point& p2) const;
         
         /// push-cutter horizontal edge case
         /// horizontal are much simpler than the general case.
         /// we can consider the cutter circular with an effective radius of this->width(h)
         bool horizEdgePush(const Fiber& f, Interval& i,  const Point& p1, const Point& p2) const;
+        /// horizEdgePush() against a horizontal edge, with the effective radius eff_radius given
+        bool horizEdgePush(const Fiber& f, Interval& i,  const Point& p1, const Point& p2, double eff_radius) const;
         
         /// push-cutter cylindrical shaft case.
         /// This is called when the contact is above the sphere/toroid/cone shaped lower part of the cutter
@@ -160,12 +263,25 @@ class MillingCutter {
         /// CCPoint calculation and interval update for push-cutter
         bool calcCCandUpdateInterval( double t, double ccv, const Point& q, const Point& p1, const Point& p2, 
                                       const Fiber& f, Interval& i, double height, CCType cctyp) const;
+        /// extend Interval i with the contacts of the vertex/edge Interval c, returns false if c has none
+        static bool mergeContact(Interval& i, Interval& c);
         
     // DROP-CUTTER
+        /// drop cutter at (cl.x, cl.y) against the single vertex p
+        bool singleVertexDrop(CLPoint& cl, const Point& p) const;
+        /// drop cutter against edge p1-p2 of an IndexedMesh, with unit XY-direction vxy.
+        /// the edge must have a non-zero XY projection. calls singleEdgeDrop().
+        virtual bool meshEdgeDrop(CLPoint& cl, const Point& p1, const Point& p2, const Point& vxy) const;
         /// drop cutter against edge p1-p2 at xy-distance d from cl
         /// translates to cl=(0,0) and rotates edge to be along x-axis 
         /// for call to singleEdgeDropCanonical()
         bool singleEdgeDrop(CLPoint& cl, const Point& p1, const Point& p2, double d) const;
+        /// singleEdgeDrop() with the unit XY-direction vxy of p1-p2 given
+        bool singleEdgeDrop(CLPoint& cl, const Point& p1, const Point& p2, const Point& vxy, double d) const;
+        /// facetDrop() against the non-vertical, non-horizontal facet of Triangle t,
+        /// with unit up-normal, plane constant d, and unit XY-normal xyNormal.
+        /// ConeCutter redefines this.
+        virtual bool planeFacetDrop(CLPoint &cl, const Triangle &t, const Point& normal, double d, const Point& xyNormal) const;
         /// edge-drop in the 'canonical' position with cl=(0,0,cl.z) and edge u1-u2 along x-axis.
         /// returns x-coordinate of cc-point and cl.z as a CC_CLZ_Pair.
         /// must be implemented in a subclass.
@@ -25,12 +25,16 @@
 #include <boost/python.hpp>
 
 #include "millingcutter.hpp"
+#include "operation_py.hpp"
 
 namespace ocl
 {
 
 /* required wrapper class for virtual functions in boost-python */
 /// \brief a wrapper required for boost-python
+///
+/// Operations release the GIL while they run, and may call these from worker threads,
+/// so each override takes the GIL while it looks up and calls the Python method.
 // see documentation:
 // http://www.boost.org/doc/libs/1_43_0/libs/python/doc/tutorial/doc/html/python/exposing.html#python.inheritance
 class MillingCutter_py : public MillingCutter, public boost::python::wrapper<MillingCutter>
@@ -38,8 +42,11 @@ class MillingCutter_py : public MillingCutter, public boost::python::wrapper<Mil
     public:
         // vertex
         bool vertexDrop(CLPoint &cl, const Triangle &t) const {
-            if ( boost::python::override ovr_vertexDrop = this->get_override("vertexDrop"))
-                return ovr_vertexDrop(cl, t);
+            {
+                ScopedGILAcquire gil;
+                if ( boost::python::override ovr_vertexDrop = this->get_override("vertexDrop") )
+                    return ovr_vertexDrop(cl, t);
+            }
             return MillingCutter::vertexDrop(cl, t);
         }
         /// python-wrapper boilerplate...
@@ -49,8 +56,11 @@ class MillingCutter_py : public MillingCutter, public boost::python::wrapper<Mil
         
         // facet
         bool facetDrop(CLPoint &cl, const Triangle &t) const {
-            if ( boost::python::override ovr_facetDrop = this->get_override("facetDrop"))
-                return ovr_facetDrop(cl, t);
+            {
+                ScopedGILAcquire gil;
+                if ( boost::python::override ovr_facetDrop = this->get_override("facetDrop") )
+                    return ovr_facetDrop(cl, t);
+            }
             return MillingCutter::facetDrop(cl, t);
         }
         /// python-wrapper boilerplate...
@@ -61,18 +71,32 @@ class MillingCutter_py : public MillingCutter, public boost::python::wrapper<Mil
         
         // edge
         bool edgeDrop(CLPoint &cl, const Triangle &t) const {   
-            if ( boost::python::override ovr_edgeDrop = this->get_override("edgeDrop"))
-                return ovr_edgeDrop(cl, t);
+            {
+                ScopedGILAcquire gil;
+                if ( boost::python::override ovr_edgeDrop = this->get_override("edgeDrop") )
+                    return ovr_edgeDrop(cl, t);
+            }
             return MillingCutter::edgeDrop(cl, t);
         }  
         /// python-wrapper boilerplate...
         bool default_edgeDrop(CLPoint &cl, const Triangle &t) const {
             return this->MillingCutter::edgeDrop(cl,t);
         }
+        /// the packed versions go through the python overrides above
+        bool facetDrop(CLPoint &cl, const Triangle &t, const PackedSurf& ps, unsigned int n) const {
+            return facetDrop(cl, t);
+        }
+        /// the packed versions go through the python overrides above
+        bool edgeDrop(CLPoint &cl, const Triangle &t, const PackedSurf& ps, unsigned int n) const {
+            return edgeDrop(cl, t);
+        }
         
         MillingCutter* offsetCutter(double d) const {
-            if ( boost::python::override ovr_offsetCutter = this->get_override("offsetCutter") )
-                return ovr_offsetCutter(d);
+            {
+                ScopedGILAcquire gil;
+                if ( boost::python::override ovr_offsetCutter = this->get_override("offsetCutter") )
+                    return ovr_offsetCutter(d);
+            }
             return MillingCutter::offsetCutter(d);
         }  
         /// python-wrapper boilerplate...
@@ -81,8 +105,10 @@ class MillingCutter_py : public MillingCutter, public boost::python::wrapper<Mil
         }
         
         std::string str() const {
-            if ( boost::python::override ovr_str = this->get_override("str")) {
-                return ovr_str();
+            {
+                ScopedGILAcquire gil;
+                if ( boost::python::override ovr_str = this->get_override("str") )
+                    return ovr_str();
             }
             return MillingCutter::str();
         } 
@@ -38,6 +38,7 @@ AdaptivePathDropCutter::AdaptivePathDropCutter() {
     minimumZ = 0.0;
     subOp.clear();
     subOp.push_back( new PointDropCutter() ); // we delegate to PointDropCutter, who does the heavy lifting
+    shareRunControl();
     sampling = 0.1;
     min_sampling = 0.01;
     cosLimit = 0.999;
@@ -49,14 +50,19 @@ AdaptivePathDropCutter::~AdaptivePathDropCutter() {
 }
 
 void AdaptivePathDropCutter::run() {
+    control->begin();
     adaptive_sampling_run();
+    control->end();
 }
 
 void AdaptivePathDropCutter::adaptive_sampling_run() {
     //std::cout << " apdc::adaptive_sampling_run()... ";
     
     clpoints.clear();
+    control->stage( 0.0, 1.0, path->span_list.size() ); // each span samples the t-range [0, 1]
     BOOST_FOREACH( const Span* span, path->span_list ) {  // this loop could run in parallel, since spans don't depend on eachother
+        if ( control->stopped() ) // the points sampled so far are kept
+            break;
         CLPoint start = span->getPoint(0.0);
         CLPoint stop = span->getPoint(1.0);
         subOp[0]->run(start);
@@ -70,6 +76,8 @@ void AdaptivePathDropCutter::adaptive_sampling_run() {
 void AdaptivePathDropCutter::adaptive_sample(const Span* span, double start_t, double stop_t, CLPoint start_cl, CLPoint stop_cl) {
     const double mid_t = start_t + (stop_t-start_t)/2.0; // mid point sample
     assert( mid_t > start_t );  assert( mid_t < stop_t );
+    if ( control->stopped() )
+        return;
     CLPoint mid_cl = span->getPoint(mid_t);
     //std::cout << " apdc sampling at " << mid_t << "\n";
     subOp[0]->run( mid_cl );
@@ -79,6 +87,7 @@ void AdaptivePathDropCutter::adaptive_sample(const Span* span, double start_t, d
         adaptive_sample( span, start_t, mid_t , start_cl, mid_cl  );
         adaptive_sample( span, mid_t  , stop_t, mid_cl  , stop_cl );
     } else {
+        control->advance( stop_t-start_t );
         clpoints.push_back(stop_cl); 
     }
 }
@@ -19,46 +19,273 @@
  *  along with this program. If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+#include <typeinfo>
+
 #include <boost/foreach.hpp>
 #include <boost/progress.hpp>
 
-#ifdef _OPENMP // this should really not be a check for Windows, but a check for OpenMP
-    #include <omp.h>
-#endif
-
 #include "point.hpp"
 #include "triangle.hpp"
 #include "batchdropcutter.hpp"
+#include "cutterengine.hpp"
+#include "trianglevisitor.hpp"
+#include "workscheduler.hpp"
+#include "threadpool.hpp"
+#include "numeric.hpp"
 
 namespace ocl
 {
 
+/// maximum number of tiles along x or y in BatchDropCutter::dropCutter6()
+#define MAX_TILES 0xFFFF
+
+/// orders positions of a SpatialIndex by decreasing triangle height
+class HigherPosition {
+    public:
+        HigherPosition(const SpatialIndex* si) : root(si) {}
+        /// true if the triangle at position i reaches higher than the one at j
+        bool operator()(unsigned int i, unsigned int j) const {
+            return root->get(i).bb.maxpt.z > root->get(j).bb.maxpt.z;
+        }
+    private:
+        const SpatialIndex* root;
+};
+
+/// orders welded vertices of an IndexedMesh by decreasing z
+class HigherVertex {
+    public:
+        HigherVertex(const IndexedMesh& m) : mesh(m) {}
+        /// true if vertex i is higher than vertex j
+        bool operator()(boost::uint32_t i, boost::uint32_t j) const {
+            return mesh.vertex(i).z > mesh.vertex(j).z;
+        }
+    private:
+        const IndexedMesh& mesh;
+};
+
+/// the points of BatchDropCutter::dropCutter4(), vertices, facets and edges in turn
+class DropCutter4Task : public ScheduledTask {
+    public:
+        DropCutter4Task(WorkScheduler& w, boost::progress_display& p, RunControl& rc, const SpatialIndex* si,
+                        const MillingCutter* c, std::vector<CLPoint>& cl)
+            : ScheduledTask(w, p, rc), root(si), cutter(c), clref(cl) {}
+        void run(unsigned int part) {
+            std::vector<IndexSpan> spans;
+            unsigned int begin, end, n, k;
+            while ( !stopped() && work.next(part, begin, end) ) {
+                for (n=begin;n<end;n++) {
+                    spans.clear();
+                    root->search_cutter_overlap( cutter, &clref[n], spans );
+                    BOOST_FOREACH( const IndexSpan& s, spans) {
+                        for (k=s.first; k<s.last; ++k) { // loop over found triangles
+                            const Triangle& t = root->get(k);
+                            if ( cutter->overlaps(clref[n],t) ) { // cutter overlap triangle? check
+                                if (clref[n].below(t)) {
+                                    cutter->vertexDrop( clref[n],t);
+                                    work.addCalls(part, 1);
+                                }
+                            }
+                        }
+                    }
+                    BOOST_FOREACH( const IndexSpan& s, spans) {
+                        for (k=s.first; k<s.last; ++k) {
+                            const Triangle& t = root->get(k);
+                            if ( cutter->overlaps(clref[n],t) ) {
+                                if (clref[n].below(t))
+                                    cutter->facetDrop( clref[n],t);
+                            }
+                        }
+                    }
+                    BOOST_FOREACH( const IndexSpan& s, spans) {
+                        for (k=s.first; k<s.last; ++k) {
+                            const Triangle& t = root->get(k);
+                            if ( cutter->overlaps(clref[n],t) ) {
+                                if (clref[n].below(t))
+                                    cutter->edgeDrop( clref[n],t);
+                            }
+                        }
+                    }
+                }
+                advance( end-begin );
+            }
+        }
+    private:
+        const SpatialIndex* root;
+        const MillingCutter* cutter;
+        std::vector<CLPoint>& clref;
+};
+
+/// the points of BatchDropCutter::dropCutter5(), with a MeshDropCutterVisitor
+class DropCutter5Task : public ScheduledTask {
+    public:
+        DropCutter5Task(WorkScheduler& w, boost::progress_display& p, RunControl& rc, const SpatialIndex* si,
+                        const MillingCutter* c, std::vector<CLPoint>& cl)
+            : ScheduledTask(w, p, rc), root(si), cutter(c), clref(cl) {}
+        void run(unsigned int part) {
+            MeshMarks marks; // vertices and edges tested for the current CL-point, one per part
+            unsigned int begin, end;
+            while ( !stopped() && work.next(part, begin, end) ) {
+                for (unsigned int n=begin; n<end; ++n) {
+                    MeshDropCutterVisitor<> v( cutter, clref[n], root->getPackedSurf(), root->getIndexedMesh(), marks ); // on the stack, no allocation per CL-point
+                    root->visit_cutter_above( cutter, &clref[n], v ); // skips triangles below the CL-point
+                    work.addCalls(part, v.calls);
+                }
+                advance( end-begin );
+            }
+        }
+    private:
+        const SpatialIndex* root;
+        const MillingCutter* cutter;
+        std::vector<CLPoint>& clref;
+};
+
+/// the tiles of BatchDropCutter::dropTiles(), dropped with a CutterEngine<Cutter>
+template <class Cutter>
+class DropTilesTask : public ScheduledTask {
+    public:
+        /// tile t is clref[ order[m].second ] for m from tiles[t] to tiles[t+1]-1
+        DropTilesTask(WorkScheduler& w, boost::progress_display& p, RunControl& rc, const SpatialIndex* si, const Cutter& cu,
+                      std::vector<CLPoint>& cl, const std::vector< std::pair<boost::uint32_t, unsigned int> >& o,
+                      const std::vector<unsigned int>& ti, double radius, bool s)
+            : ScheduledTask(w, p, rc), root(si), c(cu), engine(cu), clref(cl), order(o), tiles(ti), r(radius), simd(s),
+              mesh( si->getIndexedMesh() ), packed( si->getPackedSurf() ) {}
+        void run(unsigned int part) {
+            std::vector<IndexSpan> spans;
+            std::vector<unsigned int> candidates;
+            std::vector<boost::uint32_t> verts;
+            std::vector<double> vx, vy, vz;
+            DropPacket packet;
+            DropBlock block;
+            MeshMarks marks;
+            unsigned int begin, end, t, m, k;
+            while ( !stopped() && work.next(part, begin, end) ) {
+                for (t=begin; t<end; ++t) {
+                    Bbox bb; // around the CL-points of the tile
+                    for (m=tiles[t]; m<tiles[t+1]; ++m)
+                        bb.addPoint( clref[ order[m].second ] );
+                    spans.clear();
+                    root->search( Bbox( bb.minpt.x-r, bb.maxpt.x+r, bb.minpt.y-r, bb.maxpt.y+r, 
+                                        bb.minpt.z, bb.maxpt.z+c.getLength() ), spans );
+                    // highest triangles first, so each CL-point rises early, and the
+                    // loop below stops at the first triangle that can not lift it
+                    candidates.clear();
+                    BOOST_FOREACH( const IndexSpan& s, spans) {
+                        for (k=s.first; k<s.last; ++k)
+                            candidates.push_back(k);
+                    }
+                    std::stable_sort( candidates.begin(), candidates.end(), HigherPosition(root) );
+                    if ( !simd ) {
+                        for (m=tiles[t]; m<tiles[t+1]; ++m) {
+                            CLPoint& cl = clref[ order[m].second ];
+                            MeshDropCutterVisitor<Cutter> v( &c, cl, packed, mesh, marks );
+                            BOOST_FOREACH( unsigned int pos, candidates ) {
+                                const Triangle& tri = root->get(pos);
+                                if ( !cl.below(tri) )
+                                    break;
+                                v.visit( tri, root->triangleIndex(pos) );
+                            }
+                            work.addCalls(part, v.calls);
+                        }
+                        continue;
+                    }
+                    // the vertices of the candidates are dropped against packets of CL-points,
+                    // highest vertex first, and the triangles below test only facets and edges
+                    marks.next(mesh);
+                    verts.clear();
+                    BOOST_FOREACH( unsigned int pos, candidates ) {
+                        const unsigned int n = root->triangleIndex(pos);
+                        for (k=0; k<3; ++k) {
+                            if ( marks.markVertex( mesh.triVertex(n,k) ) )
+                                verts.push_back( mesh.triVertex(n,k) );
+                        }
+                    }
+                    std::sort( verts.begin(), verts.end(), HigherVertex(mesh) );
+                    vx.resize( verts.size() );
+                    vy.resize( verts.size() );
+                    vz.resize( verts.size() );
+                    for (k=0; k<verts.size(); ++k) {
+                        const Point p = mesh.vertex( verts[k] );
+                        vx[k] = p.x;
+                        vy[k] = p.y;
+                        vz[k] = p.z;
+                    }
+                    if ( !verts.empty() ) {
+                        packet.clear();
+                        for (m=tiles[t]; m<tiles[t+1]; ++m) {
+                            packet.add( clref[ order[m].second ] );
+                            if ( packet.full() || (m+1 == tiles[t+1]) ) {
+                                engine.vertexDrop( packet, &vx[0], &vy[0], &vz[0], verts.size() );
+                                packet.clear();
+                            }
+                        }
+                    }
+                    // each CL-point against blocks of the triangles under the cutter
+                    for (m=tiles[t]; m<tiles[t+1]; ++m) {
+                        CLPoint& cl = clref[ order[m].second ];
+                        marks.next(mesh);
+                        k = 0;
+                        while ( k < candidates.size() ) {
+                            block.clear();
+                            for ( ; (k < candidates.size()) && !block.full(); ++k) {
+                                const Triangle& tri = root->get( candidates[k] );
+                                if ( !cl.below(tri) ) { // nor are any of the lower ones
+                                    k = candidates.size();
+                                    break;
+                                }
+                                if ( c.overlaps(cl,tri) )
+                                    block.add( tri, root->triangleIndex( candidates[k] ) );
+                            }
+                            if ( block.size() > 0 ) {
+                                engine.dropCutter( cl, block, packed, mesh, marks );
+                                work.addCalls(part, block.size());
+                            }
+                        }
+                    }
+                }
+                advance( tiles[end]-tiles[begin] );
+            }
+        }
+    private:
+        const SpatialIndex* root;
+        const Cutter& c;
+        const CutterEngine<Cutter> engine;
+        std::vector<CLPoint>& clref;
+        const std::vector< std::pair<boost::uint32_t, unsigned int> >& order;
+        const std::vector<unsigned int>& tiles;
+        /// cutter radius
+        const double r;
+        /// use the SIMD kernels
+        const bool simd;
+        const IndexedMesh& mesh;
+        const PackedSurf& packed;
+};
+
 //********   ********************** */
 
 BatchDropCutter::BatchDropCutter() {
     clpoints = new std::vector<CLPoint>();
     nCalls = 0;
-#ifdef _OPENMP
-    nthreads = omp_get_num_procs(); // figure out how many cores we have
-#endif
+    nthreads = ThreadPool::instance().size();
     cutter = NULL;
     bucketSize = 1;
-    root = new KDTree<Triangle>();
+    simd = true;
+    createIndex();
 }
 
 BatchDropCutter::~BatchDropCutter() { 
     clpoints->clear();
     delete clpoints;
-    delete root;
 }
  
 void BatchDropCutter::setSTL(const STLSurf &s) {
     std::cout << "bdc::setSTL()\n";
     surf = &s;
+    createIndex();
     root->setXYDimensions(); // we search for triangles in the XY plane, don't care about Z-coordinate
     root->setBucketSize( bucketSize );
-    root->build(s.tris);
-    std::cout << "bdc::setSTL() done.\n";
+    buildIndex(s);
+    std::cout << "bdc::setSTL() done. " << root->str() << "\n";
 }
 
 
@@ -70,10 +297,10 @@ void BatchDropCutter::appendPoint(CLPoint& p) {
 // drop cutter against all triangles in surface
 void BatchDropCutter::dropCutter1() {
     std::cout << "dropCutterSTL1 " << clpoints->size() << 
-              " cl-points and " << surf->tris.size() << " triangles...";
+              " cl-points and " << surf->size() << " triangles...";
     nCalls = 0;
     BOOST_FOREACH(CLPoint &cl, *clpoints) {
-        BOOST_FOREACH( const Triangle& t, surf->tris) {// test against all triangles in s
+        BOOST_FOREACH( const Triangle& t, surf->getTriangles()) {// test against all triangles in s
             cutter->dropCutter(cl,t);
             ++nCalls;
         }
@@ -86,17 +313,20 @@ void BatchDropCutter::dropCutter1() {
 // then only drop cutter against found triangles
 void BatchDropCutter::dropCutter2() {
     std::cout << "dropCutterSTL2 " << clpoints->size() << 
-            " cl-points and " << surf->tris.size() << " triangles.\n";
+            " cl-points and " << surf->size() << " triangles.\n";
+    updateIndex();
     std::cout.flush();
     nCalls = 0;
-    std::list<Triangle> *triangles_under_cutter;
+    std::vector<IndexSpan> spans;
     BOOST_FOREACH(CLPoint &cl, *clpoints) { //loop through each CL-point
-        triangles_under_cutter = root->search_cutter_overlap( cutter , &cl);
-        BOOST_FOREACH( const Triangle& t, *triangles_under_cutter) {
-            cutter->dropCutter(cl,t);
-            ++nCalls;
+        spans.clear();
+        root->search_cutter_overlap( cutter , &cl, spans);
+        BOOST_FOREACH( const IndexSpan& s, spans) {
+            for (unsigned int k=s.first; k<s.last; ++k) {
+                cutter->dropCutter(cl, root->get(k) );
+                ++nCalls;
+            }
         }
-        delete triangles_under_cutter;
     }
     
     std::cout << "done. " << nCalls << " dropCutter() calls.\n";
@@ -107,141 +337,132 @@ void BatchDropCutter::dropCutter2() {
 // compared to dropCutter2, add an additional explicit overlap-test before testing triangle
 void BatchDropCutter::dropCutter3() {
     std::cout << "dropCutterSTL3 " << clpoints->size() << 
-            " cl-points and " << surf->tris.size() << " triangles.\n";
+            " cl-points and " << surf->size() << " triangles.\n";
+    updateIndex();
     nCalls = 0;
     boost::progress_display show_progress( clpoints->size() );
-    std::list<Triangle> *triangles_under_cutter;
+    std::vector<IndexSpan> spans;
     BOOST_FOREACH(CLPoint &cl, *clpoints) { //loop through each CL-point
-        triangles_under_cutter = root->search_cutter_overlap( cutter , &cl);
-        BOOST_FOREACH( const Triangle& t, *triangles_under_cutter) {
-            if (cutter->overlaps(cl,t)) {
-                if ( cl.below(t) ) {
-                    cutter->dropCutter(cl,t);
-                    ++nCalls;
+        spans.clear();
+        root->search_cutter_overlap( cutter , &cl, spans);
+        BOOST_FOREACH( const IndexSpan& s, spans) {
+            for (unsigned int k=s.first; k<s.last; ++k) {
+                const Triangle& t = root->get(k);
+                if (cutter->overlaps(cl,t)) {
+                    if ( cl.below(t) ) {
+                        cutter->dropCutter(cl,t);
+                        ++nCalls;
+                    }
                 }
             }
         }
         ++show_progress;
-        delete triangles_under_cutter;
     }
     
     std::cout << "done. " << nCalls << " dropCutter() calls.\n";
     return;
 }
 
-// use OpenMP to share work between threads
+// share work between the threads of the ThreadPool
 void BatchDropCutter::dropCutter4() {
     std::cout << "dropCutterSTL4 " << clpoints->size() << 
-            " cl-points and " << surf->tris.size() << " triangles.\n";
+            " cl-points and " << surf->size() << " triangles.\n";
+    updateIndex();
     boost::progress_display show_progress( clpoints->size() );
     nCalls = 0;
-    int calls=0;
-    long int ntris = 0;
-    std::list<Triangle>* tris;
-#ifdef _WIN32 // OpenMP version 2 of VS2013 OpenMP need signed loop variable
-	int n; // loop variable
-#else
-	unsigned int n; // loop variable
-#endif
     unsigned int Nmax = clpoints->size();
     std::vector<CLPoint>& clref = *clpoints; 
-    int nloop=0;
-#ifdef _OPENMP
-    omp_set_num_threads(nthreads); // the constructor sets number of threads right
-                                   // or the user can explicitly specify something else
-#endif
-    std::list<Triangle>::iterator it;
-    #pragma omp parallel for shared( nloop, ntris, calls, clref) private(n,tris,it)
-        for (n=0;n< Nmax ;n++) { // PARALLEL OpenMP loop!
-#ifdef _OPENMP
-            if ( n== 0 ) { // first iteration
-                if (omp_get_thread_num() == 0 ) 
-                    std::cout << "Number of OpenMP threads = "<< omp_get_num_threads() << "\n";// print out how many threads we are using
-            }
-#endif
-            nloop++;
-            tris = root->search_cutter_overlap( cutter, &clref[n] );
-            assert( tris->size() <= ntriangles ); // can't possibly find more triangles than in the STLSurf 
-            for( it=tris->begin(); it!=tris->end() ; ++it) { // loop over found triangles  
-                if ( cutter->overlaps(clref[n],*it) ) { // cutter overlap triangle? check
-                    if (clref[n].below(*it)) {
-                        cutter->vertexDrop( clref[n],*it);
-                        ++calls;
-                    }
-                }
-            }
-            for( it=tris->begin(); it!=tris->end() ; ++it) { // loop over found triangles  
-                if ( cutter->overlaps(clref[n],*it) ) { // cutter overlap triangle? check
-                    if (clref[n].below(*it))
-                        cutter->facetDrop( clref[n],*it);
-                }
-            }
-            for( it=tris->begin(); it!=tris->end() ; ++it) { // loop over found triangles  
-                if ( cutter->overlaps(clref[n],*it) ) { // cutter overlap triangle? check
-                    if (clref[n].below(*it))
-                        cutter->edgeDrop( clref[n],*it);
-                }
-            }
-            ntris += tris->size();
-            delete( tris );
-            ++show_progress;
-        } // end OpenMP PARALLEL for
-    nCalls = calls;
+    WorkScheduler work( Nmax, nthreads );
+    DropCutter4Task task( work, show_progress, *control, root.get(), cutter, clref );
+    control->stage( 0.0, 1.0, Nmax );
+    ThreadPool::instance().run( task, work.threads() );
+    nCalls = work.calls();
     std::cout << " " << nCalls << " dropCutter() calls.\n";
     return;
 }
 
-// use OpenMP to share work between threads
+// share work between the threads of the ThreadPool, with a WorkScheduler
 void BatchDropCutter::dropCutter5() {
     std::cout << "dropCutterSTL5 " << clpoints->size() << 
-            " cl-points and " << surf->tris.size() << " triangles.\n";
+            " cl-points and " << surf->size() << " triangles.\n";
+    updateIndex();
     boost::progress_display show_progress( clpoints->size() );
     nCalls = 0;
-    int calls=0;
-    long int ntris = 0;
-    std::list<Triangle>* tris;
-#ifdef _WIN32 // OpenMP version 2 of VS2013 OpenMP need signed loop variable
-	int n; // loop variable
-#else
-	unsigned int n; // loop variable
-#endif
-	unsigned int Nmax = clpoints->size();
+    unsigned int Nmax = clpoints->size();
     std::vector<CLPoint>& clref = *clpoints; 
-    int nloop=0;
-    
-#ifdef _OPENMP
-    omp_set_num_threads(nthreads); // the constructor sets number of threads right
-                                   // or the user can explicitly specify something else
-#endif
-    std::list<Triangle>::iterator it;
-    #pragma omp parallel for schedule(dynamic) shared( nloop, ntris, calls, clref ) private(n,tris,it) 
-        for (n=0;n<Nmax;++n) { // PARALLEL OpenMP loop!
-#ifdef _OPENMP
-            if ( n== 0 ) { // first iteration
-                if (omp_get_thread_num() == 0 ) 
-                    std::cout << "Number of OpenMP threads = "<< omp_get_num_threads() << "\n";
-            }
-#endif
-            nloop++;
-            tris = root->search_cutter_overlap( cutter, &clref[n] );
-            assert( tris );
-            assert( tris->size() <= ntriangles ); // can't possibly find more triangles than in the STLSurf 
-            for( it=tris->begin(); it!=tris->end() ; ++it) { // loop over found triangles  
-                if ( cutter->overlaps(clref[n],*it) ) { // cutter overlap triangle? check
-                    if (clref[n].below(*it)) {
-                        cutter->dropCutter( clref[n],*it);
-                        ++calls;
-                    }
-                }
-            }
-            ntris += tris->size();
-            delete( tris );
-            ++show_progress;
-        } // end OpenMP PARALLEL for
-    nCalls = calls;
+    WorkScheduler work( Nmax, nthreads );
+    DropCutter5Task task( work, show_progress, *control, root.get(), cutter, clref );
+    control->stage( 0.0, 1.0, Nmax );
+    ThreadPool::instance().run( task, work.threads() );
+    nCalls = work.calls();
     std::cout << "\n " << nCalls << " dropCutter() calls.\n";
     return;
 }
 
+// search once per tile of CL-points, and share tiles between the threads of the ThreadPool
+template <class Cutter>
+void BatchDropCutter::dropTiles(const Cutter& c) {
+    std::cout << "dropCutterSTL6 " << clpoints->size() << 
+            " cl-points and " << surf->size() << " triangles.\n";
+    updateIndex();
+    nCalls = 0;
+    if ( clpoints->empty() )
+        return;
+    boost::progress_display show_progress( clpoints->size() );
+    std::vector<CLPoint>& clref = *clpoints;
+    const unsigned int Nmax = clref.size();
+    const double r = cutter->getRadius();
+    // tiles as wide as the cutter, so that a tile search finds about four times
+    // the triangles of a single CL-point
+    double minx = clref[0].x, maxx = clref[0].x;
+    double miny = clref[0].y, maxy = clref[0].y;
+    BOOST_FOREACH(const CLPoint& cl, clref) {
+        minx = std::min(minx, cl.x);
+        maxx = std::max(maxx, cl.x);
+        miny = std::min(miny, cl.y);
+        maxy = std::max(maxy, cl.y);
+    }
+    double tile = std::max( 2*r, std::max(maxx-minx, maxy-miny)/MAX_TILES );
+    if ( !(tile > 0) )
+        tile = 1.0;
+    // sort the points by the Morton code of their tile
+    std::vector< std::pair<boost::uint32_t, unsigned int> > order( Nmax );
+    for (unsigned int m=0; m<Nmax; ++m) {
+        boost::uint32_t tx = (boost::uint32_t) ( (clref[m].x - minx)/tile );
+        boost::uint32_t ty = (boost::uint32_t) ( (clref[m].y - miny)/tile );
+        order[m] = std::make_pair( morton_spread(tx) | (morton_spread(ty) << 1), m );
+    }
+    std::sort( order.begin(), order.end() );
+    // tile t is order[ tiles[t] ] up to order[ tiles[t+1] ]
+    std::vector<unsigned int> tiles;
+    for (unsigned int m=0; m<Nmax; ++m) {
+        if ( (m == 0) || (order[m].first != order[m-1].first) )
+            tiles.push_back(m);
+    }
+    tiles.push_back(Nmax);
+    unsigned int nTiles = tiles.size()-1;
+    WorkScheduler work( nTiles, nthreads );
+    DropTilesTask<Cutter> task( work, show_progress, *control, root.get(), c, clref, order, tiles, r, simd );
+    control->stage( 0.0, 1.0, Nmax );
+    ThreadPool::instance().run( task, work.threads() );
+    nCalls = work.calls();
+    std::cout << "\n " << nCalls << " dropCutter() calls in " << nTiles << " tiles.\n";
+    return;
+}
+
+// the one type switch: dropTiles() is compiled once for each cutter type
+void BatchDropCutter::dropCutter6() {
+    if ( typeid(*cutter) == typeid(CylCutter) )
+        dropTiles( static_cast<const CylCutter&>(*cutter) );
+    else if ( typeid(*cutter) == typeid(BallCutter) )
+        dropTiles( static_cast<const BallCutter&>(*cutter) );
+    else if ( typeid(*cutter) == typeid(BullCutter) )
+        dropTiles( static_cast<const BullCutter&>(*cutter) );
+    else if ( typeid(*cutter) == typeid(ConeCutter) )
+        dropTiles( static_cast<const ConeCutter&>(*cutter) );
+    else
+        dropTiles( *cutter ); // CompositeCutter and others, with virtual calls, or per Triangle
+}
+
 }// end namespace
 // end file batchdropcutter.cpp
@@ -28,7 +28,7 @@
 
 #include "clpoint.hpp"
 #include "millingcutter.hpp"
-#include "kdtree.hpp"
+#include "spatialindex.hpp"
 #include "operation.hpp"
 
 namespace ocl
@@ -44,7 +44,7 @@ class Triangle;
 /// To find triangles overlapping the cutter a kd-tree data structure is used.
 /// The list of CLPoint's will be updated with the correct z-height as well
 /// as corresponding CCPoint's
-/// Some versions of this algorithm use OpenMP for multi-threading.
+/// Some versions of this algorithm run on the threads of the ThreadPool.
 class BatchDropCutter : public Operation {
     public:
         BatchDropCutter();
@@ -54,12 +54,26 @@ class BatchDropCutter : public Operation {
         /// append to list of CL-points to evaluate
         void appendPoint(CLPoint& p);
         /// run drop-cutter on all clpoints
-        void run() {this->dropCutter5();};
+        void run() {
+            control->begin();
+            if ( indexType == GridIndexType ) // a grid answers single-point queries without search
+                this->dropCutter5();
+            else
+                this->dropCutter6();
+            control->end();
+        };
     // getters and setters
         /// return a vector of CLPoints, the result of this operation
         std::vector<CLPoint> getCLPoints() {return *clpoints;}
 		/// clears the vector of CLPoints
 		void clearCLPoints() {clpoints->clear();}
+        /// \brief use the SIMD drop-cutter kernels in dropCutter6(), the default.
+        ///
+        /// With s false each CL-point is dropped against one triangle at a time,
+        /// for validating the kernels against the scalar code.
+        void setSIMD(bool s) {simd = s;}
+        /// return true if the SIMD drop-cutter kernels are used
+        bool getSIMD() const {return simd;}
         
     protected:
         /// unoptimized drop-cutter,  tests against all triangles of surface
@@ -68,13 +82,32 @@ class BatchDropCutter : public Operation {
         void dropCutter2();
         /// kd-tree and explicit overlap test      
         void dropCutter3();
-        /// use OpenMP for multi-threading     
+        /// share the CL-points between the threads of the ThreadPool
         void dropCutter4();
         /// version 5 of the algorithm
         void dropCutter5();
+        /// \brief version 6, search once per tile of nearby CL-points.
+        ///
+        /// CL-points are sorted into square tiles along a Morton (Z-order) curve.
+        /// Each tile is searched once, with the tile's box grown by the cutter radius,
+        /// and the points of the tile are tested against the found triangles, highest first,
+        /// until a triangle is reached that is entirely below the CL-point.
+        /// The CL-points stay in their original order.
+        /// With setSIMD(true) the vertices of the tile are dropped against packets of
+        /// CL-points, see MillingCutter::vertexDrop(DropPacket&, ...), and each CL-point
+        /// against blocks of triangles, see MillingCutter::dropCutter(CLPoint&, DropBlock&, ...).
+        /// CylCutter, BallCutter, BullCutter and ConeCutter are dropped by a CutterEngine of their
+        /// type, with no virtual calls per triangle, other cutters through the MillingCutter interface,
+        /// one Triangle at a time if they have no MillingCutter::hasMeshKernels().
+        void dropCutter6();
+        /// \brief dropCutter6() with cutter c, the exact type of *cutter, see CutterEngine.
+        template <class Cutter>
+        void dropTiles(const Cutter& c);
     // DATA
         /// pointer to list of CL-points on which to run drop-cutter.
         std::vector<CLPoint>* clpoints;
+        /// use the SIMD kernels in dropCutter6()
+        bool simd;
 
 };
 
@@ -25,6 +25,7 @@
 #include <boost/foreach.hpp> 
 
 #include "batchdropcutter.hpp"
+#include "operation_py.hpp"
 
 namespace ocl
 {
@@ -33,6 +34,40 @@ namespace ocl
 class BatchDropCutter_py : public BatchDropCutter {
     public:
         BatchDropCutter_py() : BatchDropCutter() {};
+        /// report the progress of run() to the Python callable f, as f(fraction). None removes it.
+        void setProgressCallback_py(boost::python::object f) {
+            setProgressCallback( progress_callback_py(f) );
+        }
+        /// run() without the GIL, so other Python threads can run
+        void run_py() {
+            ScopedGILRelease nogil;
+            run();
+        }
+        /// setSTL() without the GIL, as it may build a spatial index. s must not be modified until it returns.
+        void setSTL_py(const STLSurf& s) {
+            ScopedGILRelease nogil;
+            setSTL(s);
+        }
+        /// setCutter() without the GIL, as it may re-build the spatial index
+        void setCutter_py(const MillingCutter* c) {
+            ScopedGILRelease nogil;
+            setCutter(c);
+        }
+        /// loadIndex() without the GIL, as it reads the file. s must not be used until it returns.
+        bool loadIndex_py(const std::string& filename, STLSurf& s) {
+            ScopedGILRelease nogil;
+            return loadIndex(filename, s);
+        }
+        /// saveIndex() without the GIL, as it writes the file
+        bool saveIndex_py(const std::string& filename) const {
+            ScopedGILRelease nogil;
+            return saveIndex(filename);
+        }
+        /// saveCache() without the GIL, as it writes the file
+        bool saveCache_py(const std::string& filename) const {
+            ScopedGILRelease nogil;
+            return saveCache(filename);
+        }
         /// return CL-points to Python
         boost::python::list getCLPoints_py() {
             boost::python::list plist;
@@ -45,12 +80,12 @@ class BatchDropCutter_py : public BatchDropCutter {
         /// more for visualization and demonstration.
         boost::python::list getTrianglesUnderCutter(CLPoint& cl, MillingCutter& cutter) {
             boost::python::list trilist;
-            std::list<Triangle> *triangles_under_cutter = new std::list<Triangle>();
-            triangles_under_cutter = root->search_cutter_overlap( &cutter , &cl);
-            BOOST_FOREACH(Triangle t, *triangles_under_cutter) {
-                trilist.append(t);
+            std::vector<IndexSpan> spans;
+            root->search_cutter_overlap( &cutter , &cl, spans);
+            BOOST_FOREACH(const IndexSpan& s, spans) {
+                for (unsigned int k=s.first; k<s.last; ++k)
+                    trilist.append( root->get(k) );
             }
-            delete triangles_under_cutter;
             return trilist;
         };
 };
@@ -37,6 +37,7 @@ PathDropCutter::PathDropCutter() {
     minimumZ = 0.0;
     subOp.clear();
     subOp.push_back( new BatchDropCutter() );  // we delegate to BatchDropCutter, who does the heavy lifting
+    shareRunControl();
     sampling = 0.1;
 }
 
@@ -51,7 +52,9 @@ void PathDropCutter::setPath(const Path *p) {
 }
 
 void PathDropCutter::run() {
+    control->begin();
     uniform_sampling_run();
+    control->end();
 
 }
 
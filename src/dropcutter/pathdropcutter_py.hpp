@@ -26,6 +26,7 @@
 #include <boost/foreach.hpp> 
 
 #include "pathdropcutter.hpp"
+#include "operation_py.hpp"
 
 namespace ocl
 {
@@ -34,6 +35,30 @@ namespace ocl
 class PathDropCutter_py : public PathDropCutter {
     public:
         PathDropCutter_py() : PathDropCutter() {};
+        /// report the progress of run() to the Python callable f, as f(fraction). None removes it.
+        void setProgressCallback_py(boost::python::object f) {
+            setProgressCallback( progress_callback_py(f) );
+        }
+        /// run() without the GIL, so other Python threads can run
+        void run_py() {
+            ScopedGILRelease nogil;
+            run();
+        }
+        /// setSTL() without the GIL, as it may build a spatial index. s must not be modified until it returns.
+        void setSTL_py(const STLSurf& s) {
+            ScopedGILRelease nogil;
+            setSTL(s);
+        }
+        /// setCutter() without the GIL, as it may re-build the spatial index
+        void setCutter_py(const MillingCutter* c) {
+            ScopedGILRelease nogil;
+            setCutter(c);
+        }
+        /// loadIndex() without the GIL, as it reads the file. s must not be used until it returns.
+        bool loadIndex_py(const std::string& filename, STLSurf& s) {
+            ScopedGILRelease nogil;
+            return loadIndex(filename, s);
+        }
         /// return a list of CL-points to python
         boost::python::list getCLPoints_py() {
             boost::python::list plist;
@@ -22,13 +22,10 @@
 #include <boost/foreach.hpp>
 #include <boost/progress.hpp>
 
-#ifdef _OPENMP 
-    #include <omp.h>
-#endif
-
 #include "point.hpp"
 #include "triangle.hpp"
 #include "pointdropcutter.hpp"
+#include "threadpool.hpp"
 
 
 namespace ocl
@@ -38,24 +35,24 @@ namespace ocl
 
 PointDropCutter::PointDropCutter() {
     nCalls = 0;
-#ifdef _OPENMP
-    nthreads = omp_get_num_procs(); // figure out how many cores we have
-#endif
+    nthreads = ThreadPool::instance().size();
     cutter = NULL;
     bucketSize = 1;
-    root = new KDTree<Triangle>();
+    createIndex();
 }
 
 void PointDropCutter::setSTL(const STLSurf &s) {
     //std::cout << "PointDropCutter::setSTL()\n";
     surf = &s;
+    createIndex();
     root->setXYDimensions(); // we search for triangles in the XY plane, don't care about Z-coordinate
     root->setBucketSize( bucketSize );
-    root->build(s.tris);
+    buildIndex(s);
 }
 
 void PointDropCutter::run(CLPoint& clp) {
     //std::cout << "PointDropCutter::run() clp= " << clp << " dropped to ";
+    updateIndex();
     pointDropCutter1(clp);
     //std::cout  << clp << " nCalls = " << nCalls <<"\n ";
 }
@@ -64,19 +61,9 @@ void PointDropCutter::run(CLPoint& clp) {
 void PointDropCutter::pointDropCutter1(CLPoint& clp) {
     nCalls = 0;
     int calls=0;
-    std::list<Triangle>* tris;
-    //tris=new std::list<Triangle>();
-    tris = root->search_cutter_overlap( cutter, &clp );
-    std::list<Triangle>::iterator it;
-    for( it=tris->begin(); it!=tris->end() ; ++it) { // loop over found triangles  
-        if ( cutter->overlaps(clp,*it) ) { // cutter overlap triangle? check
-            if (clp.below(*it)) {
-                cutter->dropCutter(clp,*it);
-                ++calls;
-            }
-        }
-    }
-    delete( tris );
+    MeshDropCutterVisitor<> v( cutter, clp, root->getPackedSurf(), root->getIndexedMesh(), marks );
+    root->visit_cutter_above( cutter, &clp, v );
+    calls = v.calls;
     nCalls = calls;
     return;
 }
@@ -27,7 +27,7 @@
 
 #include "clpoint.hpp"
 #include "millingcutter.hpp"
-#include "kdtree.hpp"
+#include "spatialindex.hpp"
 #include "operation.hpp"
 
 namespace ocl
@@ -42,7 +42,6 @@ class PointDropCutter : public Operation {
         PointDropCutter();
         virtual ~PointDropCutter() {
             //std::cout << " ~PointDropCutter() \n";
-            delete root;
         }
         void setSTL(const STLSurf &s);
         void run(CLPoint& cl);
@@ -54,6 +53,8 @@ class PointDropCutter : public Operation {
     protected:
         /// first simple implementation of this operation
         void pointDropCutter1(CLPoint& clp);
+        /// vertices and edges tested for the current CL-point
+        MeshMarks marks;
 };
 
 } // end namespace
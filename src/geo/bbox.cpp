@@ -95,6 +95,13 @@ void Bbox::addTriangle(const Triangle &t) {
     return;
 }
 
+void Bbox::addBbox(const Bbox& b) {
+    if ( !b.initialized )
+        return;
+    addPoint( b.minpt );
+    addPoint( b.maxpt );
+}
+
 /// does this Bbox overlap with b?
 bool Bbox::overlaps(const Bbox& b) const {
     if  ( (this->maxpt.x < b.minpt.x) || (this->minpt.x > b.maxpt.x) )
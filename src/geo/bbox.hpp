@@ -61,6 +61,10 @@ class Bbox {
         /// Calls addPoint() for each vertex of the Triangle.
         void addTriangle(const Triangle& t);
         
+        /// Enlarge the Bbox so that Bbox b is contained within it.
+        /// Does nothing if nothing has been added to b.
+        void addBbox(const Bbox& b);
+        
         friend std::ostream &operator<<(std::ostream& stream, const Bbox b);
         
 //DATA
@@ -0,0 +1,293 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010-2011 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cmath>
+#include <queue>
+#include <algorithm>
+#include <iostream>
+
+#include <boost/foreach.hpp>
+
+#include "decimator.hpp"
+#include "stlsurf.hpp"
+#include "indexedmesh.hpp"
+#include "numeric.hpp"
+
+namespace ocl
+{
+
+/// triangles before and after a collapse must face along the normal of the ring by at least
+/// this cosine, so that rounding errors can't turn a triangle over
+#define DECIMATE_MIN_FACING 1E-3
+
+/// a vertex that can be removed, queued by the error bound of the collapse
+class Collapse {
+    public:
+        Collapse(double c, boost::uint32_t vertex, boost::uint32_t s) : cost(c), u(vertex), stamp(s) {}
+        /// ordered so that std::priority_queue returns the cheapest collapse first,
+        /// and of equally cheap ones the lowest vertex
+        bool operator<(const Collapse& o) const {
+            return (cost > o.cost) || ( (cost == o.cost) && (u > o.u) );
+        }
+        /// error bound of the new triangles
+        double cost;
+        /// the vertex to remove
+        boost::uint32_t u;
+        /// the ring-count of u when queued
+        boost::uint32_t stamp;
+};
+
+void Decimator::run(STLSurf& s) {
+    nInput = s.size();
+    nOutput = nInput;
+    maxError = 0;
+    if ( nInput == 0 )
+        return;
+    // only identical vertices are welded, so that the remaining vertices are exactly the original ones
+    std::vector<const Triangle*> ptrs;
+    ptrs.reserve( nInput );
+    BOOST_FOREACH(const Triangle& t, s.getTriangles())
+        ptrs.push_back( &t );
+    IndexedMesh mesh;
+    mesh.build( ptrs, 0.0 );
+    const unsigned int V = mesh.vertexCount();
+    pos.resize( V );
+    for (unsigned int v=0; v<V; ++v)
+        pos[v] = mesh.vertex(v);
+    corners.resize( 3*nInput );
+    for (unsigned int n=0; n<nInput; ++n) {
+        for (int k=0;k<3;++k)
+            corners[3*n+k] = mesh.triVertex(n,k);
+    }
+    error.assign( nInput, 0.0 );
+    alive.assign( nInput, 1 );
+    vertexTris.assign( V, std::vector<boost::uint32_t>() );
+    for (unsigned int c=0; c<3*nInput; ++c)
+        vertexTris[ corners[c] ].push_back( c/3 );
+    
+    // a vertex is queued again, with a new stamp, when its ring changes
+    std::vector<boost::uint32_t> stamp( V, 0 );
+    std::priority_queue<Collapse> queue;
+    boost::uint32_t v;
+    double cost;
+    for (unsigned int u=0; u<V; ++u) {
+        if ( candidate(u, v, cost) )
+            queue.push( Collapse(cost, u, 0) );
+    }
+    std::vector<boost::uint32_t> link, fan;
+    while ( !queue.empty() ) {
+        const Collapse c = queue.top();
+        queue.pop();
+        if ( c.stamp != stamp[c.u] )
+            continue;
+        // the neighbours of the neighbours of u may have changed, so check again
+        if ( !candidate(c.u, v, cost) )
+            continue;
+        if ( cost > c.cost ) {
+            queue.push( Collapse(cost, c.u, c.stamp) );
+            continue;
+        }
+        ring(c.u, link, fan);
+        collapse(c.u, v, cost);
+        BOOST_FOREACH(boost::uint32_t w, link) {
+            ++stamp[w];
+            if ( candidate(w, v, cost) )
+                queue.push( Collapse(cost, w, stamp[w]) );
+        }
+    }
+    
+    std::vector<Triangle> remaining;
+    remaining.reserve( nOutput );
+    for (unsigned int n=0; n<nInput; ++n) {
+        if ( !alive[n] )
+            continue;
+        remaining.push_back( Triangle( pos[corners[3*n]], pos[corners[3*n+1]], pos[corners[3*n+2]] ) );
+        maxError = std::max( maxError, error[n] );
+    }
+    s.swapTriangles( remaining );
+    std::cout << "Decimator: " << nInput << " triangles reduced to " << nOutput;
+    std::cout << ", max. error " << maxError << " (tolerance " << tolerance << ")\n";
+    // free the working arrays
+    std::vector<Point>().swap( pos );
+    std::vector<boost::uint32_t>().swap( corners );
+    std::vector<double>().swap( error );
+    std::vector<unsigned char>().swap( alive );
+    std::vector< std::vector<boost::uint32_t> >().swap( vertexTris );
+}
+
+bool Decimator::ring(boost::uint32_t u, std::vector<boost::uint32_t>& link, std::vector<boost::uint32_t>& fan) const {
+    link.clear();
+    fan.clear();
+    const std::vector<boost::uint32_t>& tris = vertexTris[u];
+    const unsigned int k = tris.size();
+    if ( k < 3 )
+        return false;
+    // the corners following u in each triangle
+    std::vector<boost::uint32_t> from(k), to(k);
+    for (unsigned int i=0; i<k; ++i) {
+        const boost::uint32_t* c = &corners[ 3*tris[i] ];
+        const int m = (c[0] == u) ? 0 : ( (c[1] == u) ? 1 : 2 );
+        from[i] = c[ (m+1)%3 ];
+        to[i] = c[ (m+2)%3 ];
+        if ( (from[i] == u) || (to[i] == u) || (from[i] == to[i]) )
+            return false;
+    }
+    // follow the ring from the first triangle
+    std::vector<bool> used( k, false );
+    link.push_back( from[0] );
+    fan.push_back( tris[0] );
+    used[0] = true;
+    boost::uint32_t next = to[0];
+    while ( fan.size() < k ) {
+        unsigned int i = 0;
+        while ( (i < k) && (used[i] || (from[i] != next)) )
+            ++i;
+        if ( i == k )
+            return false;
+        link.push_back( next );
+        fan.push_back( tris[i] );
+        used[i] = true;
+        next = to[i];
+    }
+    if ( next != link[0] )
+        return false;
+    std::vector<boost::uint32_t> sorted( link );
+    std::sort( sorted.begin(), sorted.end() );
+    return std::adjacent_find( sorted.begin(), sorted.end() ) == sorted.end();
+}
+
+bool Decimator::candidate(boost::uint32_t u, boost::uint32_t& v, double& cost) const {
+    std::vector<boost::uint32_t> link, fan;
+    if ( !ring(u, link, fan) )
+        return false;
+    const unsigned int k = link.size();
+    const Point& pu = pos[u];
+    Point normal(0,0,0);
+    for (unsigned int i=0; i<k; ++i)
+        normal += ( pos[link[i]] - pu ).cross( pos[link[(i+1)%k]] - pu );
+    if ( normal.norm() == 0.0 )
+        return false;
+    normal.normalize();
+    // the ring must cover its polygon in the plane once: all triangles face along
+    // the normal, and the ring goes around u once
+    double angle = 0.0;
+    double errMax = 0.0;
+    double hmin = normal.dot(pu);
+    double hmax = hmin;
+    for (unsigned int i=0; i<k; ++i) {
+        const Point a = pos[link[i]] - pu;
+        const Point b = pos[link[(i+1)%k]] - pu;
+        const Point c = a.cross(b);
+        if ( c.dot(normal) <= DECIMATE_MIN_FACING*c.norm() )
+            return false;
+        const Point ap = a - normal.dot(a)*normal;
+        const Point bp = b - normal.dot(b)*normal;
+        angle += atan2( normal.dot( ap.cross(bp) ), ap.dot(bp) );
+        errMax = std::max( errMax, error[fan[i]] );
+        const double h = normal.dot( pos[link[i]] );
+        hmin = std::min( hmin, h );
+        hmax = std::max( hmax, h );
+    }
+    if ( angle > 3*PI )
+        return false;
+    // old and new triangles are interpolated between these heights along the normal
+    cost = errMax + (hmax - hmin);
+    if ( cost > tolerance )
+        return false;
+    // of the neighbours that give valid new triangles, choose the one with the least tilted triangles
+    double best = 0.0;
+    for (unsigned int j=0; j<k; ++j) {
+        const boost::uint32_t w = link[j];
+        const boost::uint32_t prev = link[(j+k-1)%k];
+        const boost::uint32_t next = link[(j+1)%k];
+        bool valid = true;
+        for (unsigned int i=0; (i<k) && valid; ++i) { // no edge or triangle may be doubled
+            const boost::uint32_t x = link[i];
+            if ( (x != w) && (x != prev) && (x != next) && adjacent(w, x) )
+                valid = false;
+        }
+        double worst = 1.0;
+        for (unsigned int i=0; (i<k) && valid; ++i) {
+            if ( (i == j) || (i == (j+k-1)%k) ) // the triangles with w, removed by the collapse
+                continue;
+            const boost::uint32_t a = link[i];
+            const boost::uint32_t b = link[(i+1)%k];
+            const Point c = ( pos[a] - pos[w] ).cross( pos[b] - pos[w] );
+            const double facing = ( c.norm() > 0.0 ) ? c.dot(normal)/c.norm() : 0.0;
+            if ( (facing <= DECIMATE_MIN_FACING) || hasTriangle(w, a, b) )
+                valid = false;
+            worst = std::min( worst, facing );
+        }
+        if ( valid && (worst > best) ) {
+            best = worst;
+            v = w;
+        }
+    }
+    return best > 0.0;
+}
+
+void Decimator::collapse(boost::uint32_t u, boost::uint32_t v, double cost) {
+    const std::vector<boost::uint32_t> tris( vertexTris[u] );
+    BOOST_FOREACH(boost::uint32_t t, tris) {
+        boost::uint32_t* c = &corners[3*t];
+        if ( (c[0] == v) || (c[1] == v) || (c[2] == v) ) { // the two triangles on edge u-v
+            alive[t] = 0;
+            --nOutput;
+            for (int m=0;m<3;++m) {
+                if ( c[m] == u )
+                    continue;
+                std::vector<boost::uint32_t>& vt = vertexTris[ c[m] ];
+                vt.erase( std::find( vt.begin(), vt.end(), t ) );
+            }
+        } else {
+            for (int m=0;m<3;++m) {
+                if ( c[m] == u )
+                    c[m] = v;
+            }
+            error[t] = cost;
+            vertexTris[v].push_back(t);
+        }
+    }
+    vertexTris[u].clear();
+}
+
+bool Decimator::hasTriangle(boost::uint32_t a, boost::uint32_t b, boost::uint32_t c) const {
+    BOOST_FOREACH(boost::uint32_t t, vertexTris[a]) {
+        const boost::uint32_t* p = &corners[3*t];
+        const bool hasB = (p[0] == b) || (p[1] == b) || (p[2] == b);
+        const bool hasC = (p[0] == c) || (p[1] == c) || (p[2] == c);
+        if ( hasB && hasC )
+            return true;
+    }
+    return false;
+}
+
+bool Decimator::adjacent(boost::uint32_t a, boost::uint32_t b) const {
+    BOOST_FOREACH(boost::uint32_t t, vertexTris[a]) {
+        const boost::uint32_t* p = &corners[3*t];
+        if ( (p[0] == b) || (p[1] == b) || (p[2] == b) )
+            return true;
+    }
+    return false;
+}
+
+} // end namespace
+// end file decimator.cpp
@@ -0,0 +1,100 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010-2011 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DECIMATOR_H
+#define DECIMATOR_H
+
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+#include "point.hpp"
+
+namespace ocl
+{
+
+class STLSurf;
+
+/// \brief simplifies an STLSurf by half-edge collapses, within a guaranteed Hausdorff distance.
+///
+/// A vertex u is removed by moving it onto one of its neighbours v, so the remaining
+/// vertices keep their positions. Only vertices with a closed ring of triangles are removed,
+/// so the borders of the surface are kept. Before a collapse the ring of u and the new triangles
+/// from v are projected onto a plane with the average normal of the ring. When both cover the
+/// polygon of the ring exactly once, each point of the old ring moves along the normal to the
+/// new triangles, by at most the spread of the ring vertices along the normal.
+/// Each triangle keeps a bound on the distance between it and the part of the original
+/// surface it stands for. A collapse adds the spread to the largest bound in the ring,
+/// and is made only if the sum is within the tolerance. Vertices are removed cheapest first.
+class Decimator {
+    public:
+        /// decimate with the Hausdorff distance tolerance tol
+        Decimator(double tol) : tolerance(tol), nInput(0), nOutput(0), maxError(0) {}
+        virtual ~Decimator() {}
+        /// replace the triangles of s with the decimated triangles
+        void run(STLSurf& s);
+        /// number of triangles before run()
+        unsigned int getInputSize() const {return nInput;}
+        /// number of triangles after run()
+        unsigned int getOutputSize() const {return nOutput;}
+        /// bound on the Hausdorff distance between the surface before and after run()
+        double getMaxError() const {return maxError;}
+    protected:
+        /// \brief the triangles around vertex u, in order.
+        ///
+        /// Triangle fan[i] has the corners u, link[i] and link[i+1] (modulo the size), in this order.
+        /// returns false if the triangles do not form one closed ring.
+        bool ring(boost::uint32_t u, std::vector<boost::uint32_t>& link, std::vector<boost::uint32_t>& fan) const;
+        /// \brief find the best collapse of vertex u.
+        ///
+        /// returns false if u can't be removed within the tolerance. Otherwise sets v to the neighbour
+        /// to move u to, and cost to the error bound of the new triangles.
+        bool candidate(boost::uint32_t u, boost::uint32_t& v, double& cost) const;
+        /// move vertex u onto its neighbour v, giving the new triangles the error bound cost
+        void collapse(boost::uint32_t u, boost::uint32_t v, double cost);
+        /// return true if the vertices a, b and c are the corners of a live triangle
+        bool hasTriangle(boost::uint32_t a, boost::uint32_t b, boost::uint32_t c) const;
+        /// return true if a and b are corners of the same live triangle
+        bool adjacent(boost::uint32_t a, boost::uint32_t b) const;
+    // DATA
+        /// the Hausdorff distance tolerance
+        double tolerance;
+        /// number of triangles before run()
+        unsigned int nInput;
+        /// number of triangles after run()
+        unsigned int nOutput;
+        /// the largest error bound of the remaining triangles
+        double maxError;
+        /// the welded vertices
+        std::vector<Point> pos;
+        /// three vertex indices per triangle
+        std::vector<boost::uint32_t> corners;
+        /// error bound per triangle
+        std::vector<double> error;
+        /// non-zero for triangles not removed by a collapse
+        std::vector<unsigned char> alive;
+        /// the live triangles at each vertex
+        std::vector< std::vector<boost::uint32_t> > vertexTris;
+};
+
+} // end namespace
+#endif
+// end file decimator.hpp
@@ -0,0 +1,250 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010-2011 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cmath>
+#include <algorithm>
+
+#include <boost/foreach.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/functional/hash.hpp>
+
+#include "indexedmesh.hpp"
+#include "numeric.hpp"
+
+namespace ocl
+{
+
+/// the welding grid cells are this many times the welding tolerance, so that most
+/// vertices are far from the faces of their cell, and only their own cell is searched
+#define WELD_CELL_SCALE 1024.0
+
+/// a cell of the welding grid
+class WeldCell {
+    public:
+        WeldCell(boost::int64_t a, boost::int64_t b, boost::int64_t c) : i(a), j(b), k(c) {}
+        bool operator==(const WeldCell& o) const {return (i == o.i) && (j == o.j) && (k == o.k);}
+        /// grid coordinates
+        boost::int64_t i, j, k;
+};
+
+/// hash function for boost::unordered_map
+std::size_t hash_value(const WeldCell& c) {
+    std::size_t seed = 0;
+    boost::hash_combine(seed, c.i);
+    boost::hash_combine(seed, c.j);
+    boost::hash_combine(seed, c.k);
+    return seed;
+}
+
+const boost::uint32_t IndexedMesh::NONE;
+
+void IndexedMesh::update_views() {
+    vx = built.vx.empty() ? NULL : &built.vx[0];
+    vy = built.vy.empty() ? NULL : &built.vy[0];
+    vz = built.vz.empty() ? NULL : &built.vz[0];
+    triVerts = built.triVerts.empty() ? NULL : &built.triVerts[0];
+    triEdges = built.triEdges.empty() ? NULL : &built.triEdges[0];
+    edgeVerts = built.edgeVerts.empty() ? NULL : &built.edgeVerts[0];
+    ex = built.ex.empty() ? NULL : &built.ex[0];
+    ey = built.ey.empty() ? NULL : &built.ey[0];
+    edgeFlags = built.edgeFlags.empty() ? NULL : &built.edgeFlags[0];
+    nTriangles = built.triVerts.size()/3;
+    nVertices = built.vx.size();
+    nEdges = built.edgeVerts.size()/2;
+}
+
+void IndexedMesh::clear() {
+    built = Built();
+    update_views();
+}
+
+void IndexedMesh::build(const std::vector<const Triangle*>& tris, double tol) {
+    built = Built();
+    tolerance = tol;
+    const unsigned int N = tris.size();
+    // weld: vertices are listed per grid cell, and a corner is welded to the first
+    // vertex within tol in its own cell, or in a neighbouring cell if it is within tol of it
+    const double h = (tol > 0) ? WELD_CELL_SCALE*tol : 1.0;
+    boost::unordered_map<WeldCell, boost::uint32_t> cellHead;
+    cellHead.rehash( N ); // about one vertex per two triangles, and few per cell
+    std::vector<boost::uint32_t> nextInCell;
+    built.triVerts.reserve(3*N);
+    BOOST_FOREACH(const Triangle* t, tris) {
+        for (int m=0;m<3;++m) {
+            const Point& p = t->p[m];
+            const double f[3] = { floor(p.x/h), floor(p.y/h), floor(p.z/h) };
+            const WeldCell cell( (boost::int64_t) f[0], (boost::int64_t) f[1], (boost::int64_t) f[2] );
+            // the range of neighbouring cells along each axis that are within tol of p
+            int lo[3], hi[3];
+            const double c[3] = { p.x, p.y, p.z };
+            for (int a=0;a<3;++a) {
+                lo[a] = ( (tol > 0) && (c[a] - tol < f[a]*h) ) ? -1 : 0;
+                hi[a] = ( (tol > 0) && (c[a] + tol >= (f[a]+1)*h) ) ? 1 : 0;
+            }
+            boost::uint32_t found = NONE;
+            for (int di=lo[0]; (di<=hi[0]) && (found == NONE); ++di) {
+                for (int dj=lo[1]; (dj<=hi[1]) && (found == NONE); ++dj) {
+                    for (int dk=lo[2]; (dk<=hi[2]) && (found == NONE); ++dk) {
+                        boost::unordered_map<WeldCell, boost::uint32_t>::const_iterator it;
+                        it = cellHead.find( WeldCell(cell.i+di, cell.j+dj, cell.k+dk) );
+                        if ( it == cellHead.end() )
+                            continue;
+                        for (boost::uint32_t v=it->second; v!=NONE; v=nextInCell[v]) {
+                            if ( (fabs(built.vx[v]-p.x) <= tol) && (fabs(built.vy[v]-p.y) <= tol) && (fabs(built.vz[v]-p.z) <= tol) ) {
+                                found = v;
+                                break;
+                            }
+                        }
+                    }
+                }
+            }
+            if ( found == NONE ) {
+                found = built.vx.size();
+                built.vx.push_back( p.x );
+                built.vy.push_back( p.y );
+                built.vz.push_back( p.z );
+                boost::unordered_map<WeldCell, boost::uint32_t>::iterator it = cellHead.find(cell);
+                if ( it == cellHead.end() ) {
+                    nextInCell.push_back( NONE );
+                    cellHead.insert( std::make_pair(cell, found) );
+                } else { // prepend to the list of the cell
+                    nextInCell.push_back( it->second );
+                    it->second = found;
+                }
+            }
+            built.triVerts.push_back( found );
+        }
+    }
+    // unique edges: the triangle edges are bucketed by their lower vertex, each bucket
+    // is sorted by the higher vertex, and equal neighbours in a bucket are one edge.
+    // Edges are numbered in (lower vertex, higher vertex) order.
+    const unsigned int V = built.vx.size();
+    std::vector<boost::uint32_t> start( V+1, 0 ); // bucket a is [start[a], start[a+1])
+    for (unsigned int c=0; c<3*N; ++c) {
+        const boost::uint32_t a = built.triVerts[c];
+        const boost::uint32_t b = built.triVerts[ 3*(c/3) + (c+1)%3 ];
+        if ( a != b ) // not collapsed by welding
+            ++start[ std::min(a,b) + 1 ];
+    }
+    for (unsigned int v=0; v<V; ++v)
+        start[v+1] += start[v];
+    std::vector<boost::uint64_t> bucket( start[V] ); // (higher vertex << 32) | corner
+    std::vector<boost::uint32_t> fill( start.begin(), start.end()-1 );
+    for (unsigned int c=0; c<3*N; ++c) {
+        const boost::uint32_t a = built.triVerts[c];
+        const boost::uint32_t b = built.triVerts[ 3*(c/3) + (c+1)%3 ];
+        if ( a != b )
+            bucket[ fill[ std::min(a,b) ]++ ] = ( (boost::uint64_t) std::max(a,b) << 32 ) | c;
+    }
+    built.triEdges.assign( 3*N, NONE );
+    for (unsigned int a=0; a<V; ++a) {
+        std::sort( bucket.begin()+start[a], bucket.begin()+start[a+1] );
+        for (unsigned int m=start[a]; m<start[a+1]; ++m) {
+            const boost::uint32_t b = (boost::uint32_t) (bucket[m] >> 32);
+            if ( (m == start[a]) || ((bucket[m-1] >> 32) != b) ) {
+                built.edgeVerts.push_back( a );
+                built.edgeVerts.push_back( b );
+                // the same test and arithmetic as MillingCutter::edgeDrop() and singleEdgeDrop()
+                built.edgeFlags.push_back( ( !isZero_tol( built.vx[a]-built.vx[b] ) || !isZero_tol( built.vy[a]-built.vy[b] ) ) ? 1 : 0 );
+                Point vxy( built.vx[b]-built.vx[a], built.vy[b]-built.vy[a], 0.0 );
+                vxy.xyNormalize();
+                built.ex.push_back( vxy.x );
+                built.ey.push_back( vxy.y );
+            }
+            built.triEdges[ bucket[m] & 0xFFFFFFFF ] = built.edgeVerts.size()/2 - 1;
+        }
+    }
+    update_views();
+}
+
+void IndexedMesh::save_blocks(std::vector<FileBlock>& blocks) const {
+    blocks.push_back( FileBlock( &tolerance, sizeof(double) ) );
+    blocks.push_back( FileBlock( vx, nVertices*sizeof(double) ) );
+    blocks.push_back( FileBlock( vy, nVertices*sizeof(double) ) );
+    blocks.push_back( FileBlock( vz, nVertices*sizeof(double) ) );
+    blocks.push_back( FileBlock( triVerts, 3*(boost::uint64_t)nTriangles*sizeof(boost::uint32_t) ) );
+    blocks.push_back( FileBlock( triEdges, 3*(boost::uint64_t)nTriangles*sizeof(boost::uint32_t) ) );
+    blocks.push_back( FileBlock( edgeVerts, 2*(boost::uint64_t)nEdges*sizeof(boost::uint32_t) ) );
+    blocks.push_back( FileBlock( ex, nEdges*sizeof(double) ) );
+    blocks.push_back( FileBlock( ey, nEdges*sizeof(double) ) );
+    blocks.push_back( FileBlock( edgeFlags, nEdges ) );
+}
+
+bool IndexedMesh::map_blocks(const std::vector<FileBlock>& blocks, unsigned int first, unsigned int n) {
+    if ( blocks.size() < first + INDEXED_MESH_BLOCKS )
+        return false;
+    const FileBlock* b = &blocks[first];
+    const boost::uint64_t N = n;
+    const boost::uint64_t V = b[1].bytes/sizeof(double);
+    const boost::uint64_t E = b[9].bytes;
+    if ( (b[0].bytes != sizeof(double)) || (V > NONE) || (E > NONE) )
+        return false;
+    if ( (b[1].bytes != V*sizeof(double)) || (b[2].bytes != V*sizeof(double)) || (b[3].bytes != V*sizeof(double)) ||
+         (b[4].bytes != 3*N*sizeof(boost::uint32_t)) || (b[5].bytes != 3*N*sizeof(boost::uint32_t)) ||
+         (b[6].bytes != 2*E*sizeof(boost::uint32_t)) || (b[7].bytes != E*sizeof(double)) || (b[8].bytes != E*sizeof(double)) )
+        return false;
+    // the searches index the vertex and edge arrays with these without checking them
+    const boost::uint32_t* tv = static_cast<const boost::uint32_t*>( b[4].data );
+    const boost::uint32_t* te = static_cast<const boost::uint32_t*>( b[5].data );
+    const boost::uint32_t* ev = static_cast<const boost::uint32_t*>( b[6].data );
+    for (boost::uint64_t c=0; c<3*N; ++c) {
+        if ( (tv[c] >= V) || ((te[c] != NONE) && (te[c] >= E)) )
+            return false;
+    }
+    for (boost::uint64_t c=0; c<2*E; ++c) {
+        if ( ev[c] >= V )
+            return false;
+    }
+    built = Built();
+    tolerance = *static_cast<const double*>( b[0].data );
+    vx = static_cast<const double*>( b[1].data );
+    vy = static_cast<const double*>( b[2].data );
+    vz = static_cast<const double*>( b[3].data );
+    triVerts = tv;
+    triEdges = te;
+    edgeVerts = ev;
+    ex = static_cast<const double*>( b[7].data );
+    ey = static_cast<const double*>( b[8].data );
+    edgeFlags = static_cast<const unsigned char*>( b[9].data );
+    nTriangles = n;
+    nVertices = V;
+    nEdges = E;
+    return true;
+}
+
+void MeshMarks::next(const IndexedMesh& m) {
+    if ( (vertexStamp.size() != m.vertexCount()) || (edgeStamp.size() != m.edgeCount()) ) {
+        vertexStamp.assign( m.vertexCount(), 0 );
+        edgeStamp.assign( m.edgeCount(), 0 );
+        vertexSlot.resize( m.vertexCount() );
+        edgeSlot.resize( m.edgeCount() );
+        stamp = 0;
+    }
+    ++stamp;
+    if ( stamp == 0 ) { // wrapped around, so old marks could match
+        std::fill( vertexStamp.begin(), vertexStamp.end(), 0 );
+        std::fill( edgeStamp.begin(), edgeStamp.end(), 0 );
+        stamp = 1;
+    }
+}
+
+} // end namespace
+// end file indexedmesh.cpp
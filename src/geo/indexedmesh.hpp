@@ -0,0 +1,171 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010-2011 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef INDEXED_MESH_H
+#define INDEXED_MESH_H
+
+#include <vector>
+#include <algorithm>
+
+#include <boost/cstdint.hpp>
+
+#include "point.hpp"
+#include "triangle.hpp"
+#include "mappedfile.hpp"
+
+namespace ocl
+{
+
+/// number of arrays saved by IndexedMesh::save_blocks()
+#define INDEXED_MESH_BLOCKS 10
+
+/// \brief the triangles of a surface as shared vertices and edges
+///
+/// In an STL file each triangle has its own copy of its three vertices.
+/// IndexedMesh welds vertices closer than a tolerance into one, and lists each
+/// edge between two welded vertices once. Triangle n refers to its vertices and edges
+/// by index, so a search can test each vertex and edge once, instead of once for
+/// every triangle that shares it. See MeshDropCutterVisitor and MeshPushCutterVisitor.
+/// Triangle n here is the triangle with index n in the SpatialIndex that built it.
+class IndexedMesh {
+    public:
+        /// marks the edges of a triangle with two welded vertices
+        static const boost::uint32_t NONE = 0xFFFFFFFF;
+        IndexedMesh() : tolerance(0) {update_views();}
+        virtual ~IndexedMesh() {}
+        /// weld the vertices of tris that are within tol of each other, and find the unique edges
+        void build(const std::vector<const Triangle*>& tris, double tol);
+        /// remove all vertices, edges and triangles
+        void clear();
+        /// number of triangles
+        unsigned int size() const {return nTriangles;}
+        /// number of welded vertices
+        unsigned int vertexCount() const {return nVertices;}
+        /// number of unique edges
+        unsigned int edgeCount() const {return nEdges;}
+        /// welded vertex v
+        inline Point vertex(boost::uint32_t v) const {return Point( vx[v], vy[v], vz[v] );}
+        /// index of vertex k of triangle n
+        inline boost::uint32_t triVertex(unsigned int n, int k) const {return triVerts[3*n+k];}
+        /// index of edge k of triangle n, from vertex k to vertex (k+1)%3, or NONE
+        inline boost::uint32_t triEdge(unsigned int n, int k) const {return triEdges[3*n+k];}
+        /// index of endpoint k (0 or 1) of edge e
+        inline boost::uint32_t edgeVertex(boost::uint32_t e, int k) const {return edgeVerts[2*e+k];}
+        /// unit XY-direction of edge e, from endpoint 0 to endpoint 1
+        inline Point edgeDir(boost::uint32_t e) const {return Point( ex[e], ey[e], 0.0 );}
+        /// true if edge e has a non-zero XY projection
+        inline bool xyEdge(boost::uint32_t e) const {return edgeFlags[e] != 0;}
+        /// highest z-coordinate of edge e
+        inline double edgeMaxZ(boost::uint32_t e) const {return std::max( vz[ edgeVerts[2*e] ], vz[ edgeVerts[2*e+1] ] );}
+        /// the welding tolerance used by build()
+        double getTolerance() const {return tolerance;}
+        /// append the INDEXED_MESH_BLOCKS arrays to blocks, for a file
+        void save_blocks(std::vector<FileBlock>& blocks) const;
+        /// \brief use the arrays of a mesh of n triangles saved by save_blocks(), in place.
+        ///
+        /// blocks[first] is the first of them. The memory must outlive this IndexedMesh.
+        /// returns false if the blocks do not fit n triangles, or an index is out of range.
+        bool map_blocks(const std::vector<FileBlock>& blocks, unsigned int first, unsigned int n);
+    protected:
+        /// point the arrays at built
+        void update_views();
+        /// the arrays filled by build()
+        class Built {
+            public:
+                /// see IndexedMesh::vx and the other arrays of the same name
+                std::vector<double> vx, vy, vz, ex, ey;
+                /// see IndexedMesh::triVerts and the other arrays of the same name
+                std::vector<boost::uint32_t> triVerts, triEdges, edgeVerts;
+                /// see IndexedMesh::edgeFlags
+                std::vector<unsigned char> edgeFlags;
+        };
+        /// the arrays filled by build(), empty if the arrays are mapped
+        Built built;
+        /// welding tolerance
+        double tolerance;
+        /// number of triangles
+        unsigned int nTriangles;
+        /// number of welded vertices
+        unsigned int nVertices;
+        /// number of unique edges
+        unsigned int nEdges;
+        /// welded vertex x-coordinates
+        const double* vx;
+        /// welded vertex y-coordinates
+        const double* vy;
+        /// welded vertex z-coordinates
+        const double* vz;
+        /// three vertex indices per triangle
+        const boost::uint32_t* triVerts;
+        /// three edge indices per triangle
+        const boost::uint32_t* triEdges;
+        /// two vertex indices per edge, the lower index first
+        const boost::uint32_t* edgeVerts;
+        /// unit XY edge direction x-component
+        const double* ex;
+        /// unit XY edge direction y-component
+        const double* ey;
+        /// non-zero if the edge has a non-zero XY projection
+        const unsigned char* edgeFlags;
+    private:
+        IndexedMesh(const IndexedMesh&); // not copyable, the arrays may point into built
+        IndexedMesh& operator=(const IndexedMesh&);
+};
+
+/// \brief per-thread marks for visiting each vertex and edge of an IndexedMesh once per query
+///
+/// Call next() at the start of each query. Marks are stamped with a query counter,
+/// so starting a query does not clear any arrays.
+class MeshMarks {
+    public:
+        MeshMarks() : stamp(0) {}
+        /// start a new query on mesh m
+        void next(const IndexedMesh& m);
+        /// returns true the first time vertex v is marked in this query
+        inline bool markVertex(boost::uint32_t v) {
+            if ( vertexStamp[v] == stamp )
+                return false;
+            vertexStamp[v] = stamp;
+            return true;
+        }
+        /// returns true the first time edge e is marked in this query
+        inline bool markEdge(boost::uint32_t e) {
+            if ( edgeStamp[e] == stamp )
+                return false;
+            edgeStamp[e] = stamp;
+            return true;
+        }
+        /// per-vertex slots, valid for vertices marked in this query
+        std::vector<boost::uint32_t> vertexSlot;
+        /// per-edge slots, valid for edges marked in this query
+        std::vector<boost::uint32_t> edgeSlot;
+    protected:
+        /// the current query
+        boost::uint32_t stamp;
+        /// query in which each vertex was last marked
+        std::vector<boost::uint32_t> vertexStamp;
+        /// query in which each edge was last marked
+        std::vector<boost::uint32_t> edgeStamp;
+};
+
+} // end namespace
+#endif
+// end file indexedmesh.hpp
@@ -0,0 +1,156 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010-2011 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <boost/foreach.hpp>
+
+#include "packedsurf.hpp"
+#include "numeric.hpp"
+
+namespace ocl
+{
+
+void PackedSurf::update_views() {
+    x = built.x.empty() ? NULL : &built.x[0];
+    y = built.y.empty() ? NULL : &built.y[0];
+    z = built.z.empty() ? NULL : &built.z[0];
+    nx = built.nx.empty() ? NULL : &built.nx[0];
+    ny = built.ny.empty() ? NULL : &built.ny[0];
+    nz = built.nz.empty() ? NULL : &built.nz[0];
+    d = built.d.empty() ? NULL : &built.d[0];
+    xynx = built.xynx.empty() ? NULL : &built.xynx[0];
+    xyny = built.xyny.empty() ? NULL : &built.xyny[0];
+    ex = built.ex.empty() ? NULL : &built.ex[0];
+    ey = built.ey.empty() ? NULL : &built.ey[0];
+    flags = built.flags.empty() ? NULL : &built.flags[0];
+    nTriangles = built.flags.size();
+}
+
+void PackedSurf::clear() {
+    built = Built();
+    update_views();
+}
+
+void PackedSurf::build(const std::vector<const Triangle*>& tris) {
+    built = Built();
+    const unsigned int N = tris.size();
+    built.x.reserve(3*N);
+    built.y.reserve(3*N);
+    built.z.reserve(3*N);
+    built.nx.reserve(N);
+    built.ny.reserve(N);
+    built.nz.reserve(N);
+    built.d.reserve(N);
+    built.xynx.reserve(N);
+    built.xyny.reserve(N);
+    built.ex.reserve(3*N);
+    built.ey.reserve(3*N);
+    built.flags.reserve(N);
+    BOOST_FOREACH(const Triangle* t, tris) {
+        unsigned char f = 0;
+        for (int k=0;k<3;++k) {
+            const Point& p1 = t->p[k];
+            const Point& p2 = t->p[(k+1)%3];
+            built.x.push_back( p1.x );
+            built.y.push_back( p1.y );
+            built.z.push_back( p1.z );
+            // the same tests and the same arithmetic as the Triangle versions
+            // of MillingCutter::edgeDrop() and singleEdgeDrop()
+            if ( !isZero_tol( p1.x - p2.x) || !isZero_tol( p1.y - p2.y) )
+                f |= (XY_EDGE << k);
+            Point vxy( p2.x-p1.x, p2.y-p1.y, 0.0 );
+            vxy.xyNormalize();
+            built.ex.push_back( vxy.x );
+            built.ey.push_back( vxy.y );
+        }
+        // as in MillingCutter::facetDrop() and generalFacetPush()
+        Point normal = t->upNormal();
+        if ( isZero_tol( normal.z ) )
+            f |= VERTICAL_FACET;
+        if ( isZero_tol( normal.x ) && isZero_tol( normal.y ) )
+            f |= HORIZONTAL_FACET;
+        if ( normal.zParallel() )
+            f |= Z_NORMAL;
+        built.d.push_back( - normal.dot( t->p[0] ) );
+        normal.normalize();
+        built.nx.push_back( normal.x );
+        built.ny.push_back( normal.y );
+        built.nz.push_back( normal.z );
+        Point xyNormal( normal.x, normal.y, 0.0 );
+        xyNormal.xyNormalize();
+        built.xynx.push_back( xyNormal.x );
+        built.xyny.push_back( xyNormal.y );
+        built.flags.push_back( f );
+    }
+    update_views();
+}
+
+unsigned int PackedSurf::bytes() const {
+    return sizeof(double)*nTriangles*(5*3 + 6) + nTriangles;
+}
+
+void PackedSurf::save_blocks(std::vector<FileBlock>& blocks) const {
+    const boost::uint64_t N = nTriangles;
+    blocks.push_back( FileBlock( x, 3*N*sizeof(double) ) );
+    blocks.push_back( FileBlock( y, 3*N*sizeof(double) ) );
+    blocks.push_back( FileBlock( z, 3*N*sizeof(double) ) );
+    blocks.push_back( FileBlock( nx, N*sizeof(double) ) );
+    blocks.push_back( FileBlock( ny, N*sizeof(double) ) );
+    blocks.push_back( FileBlock( nz, N*sizeof(double) ) );
+    blocks.push_back( FileBlock( d, N*sizeof(double) ) );
+    blocks.push_back( FileBlock( xynx, N*sizeof(double) ) );
+    blocks.push_back( FileBlock( xyny, N*sizeof(double) ) );
+    blocks.push_back( FileBlock( ex, 3*N*sizeof(double) ) );
+    blocks.push_back( FileBlock( ey, 3*N*sizeof(double) ) );
+    blocks.push_back( FileBlock( flags, N ) );
+}
+
+bool PackedSurf::map_blocks(const std::vector<FileBlock>& blocks, unsigned int first, unsigned int n) {
+    if ( blocks.size() < first + PACKED_SURF_BLOCKS )
+        return false;
+    const FileBlock* b = &blocks[first];
+    const boost::uint64_t N = n;
+    // the x, y, z, ex and ey arrays have three values per triangle
+    const boost::uint64_t sizes[PACKED_SURF_BLOCKS] = { 3*N, 3*N, 3*N, N, N, N, N, N, N, 3*N, 3*N, 0 };
+    for (int k=0; k<PACKED_SURF_BLOCKS-1; ++k) {
+        if ( b[k].bytes != sizes[k]*sizeof(double) )
+            return false;
+    }
+    if ( b[PACKED_SURF_BLOCKS-1].bytes != N )
+        return false;
+    built = Built();
+    x = static_cast<const double*>( b[0].data );
+    y = static_cast<const double*>( b[1].data );
+    z = static_cast<const double*>( b[2].data );
+    nx = static_cast<const double*>( b[3].data );
+    ny = static_cast<const double*>( b[4].data );
+    nz = static_cast<const double*>( b[5].data );
+    d = static_cast<const double*>( b[6].data );
+    xynx = static_cast<const double*>( b[7].data );
+    xyny = static_cast<const double*>( b[8].data );
+    ex = static_cast<const double*>( b[9].data );
+    ey = static_cast<const double*>( b[10].data );
+    flags = static_cast<const unsigned char*>( b[11].data );
+    nTriangles = n;
+    return true;
+}
+
+} // end namespace
+// end file packedsurf.cpp
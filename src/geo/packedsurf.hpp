@@ -0,0 +1,129 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010-2011 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PACKED_SURF_H
+#define PACKED_SURF_H
+
+#include <vector>
+
+#include "point.hpp"
+#include "triangle.hpp"
+#include "mappedfile.hpp"
+
+namespace ocl
+{
+
+/// number of arrays saved by PackedSurf::save_blocks()
+#define PACKED_SURF_BLOCKS 12
+
+/// \brief triangles of a surface stored as a structure of arrays
+///
+/// Holds the vertices of each triangle in contiguous coordinate arrays, together
+/// with the cutter-independent data that MillingCutter::facetDrop(), edgeDrop() and
+/// facetPush() would otherwise compute on every call: the unit up-normal, the
+/// plane constant, the XY-normal and the XY edge directions.
+/// Triangle n here is the triangle with index n in the SpatialIndex that built it,
+/// i.e. the idx passed to TriangleVisitor::visit().
+/// The arrays are either built by build(), or used in place in a mapped file, see map_blocks().
+class PackedSurf {
+    public:
+        /// per-triangle flags
+        enum Flags {
+            VERTICAL_FACET   = 1,  ///< up-normal has zero z-component, no facet drop
+            HORIZONTAL_FACET = 2,  ///< up-normal has zero xy-components (within tolerance)
+            Z_NORMAL         = 4,  ///< up-normal is exactly along z, no facet push
+            XY_EDGE          = 8   ///< XY_EDGE << k is set if edge k has a non-zero XY projection
+        };
+        PackedSurf() {update_views();}
+        virtual ~PackedSurf() {}
+        /// fill the arrays from tris
+        void build(const std::vector<const Triangle*>& tris);
+        /// remove all triangles
+        void clear();
+        /// number of triangles
+        unsigned int size() const {return nTriangles;}
+        /// vertex k of triangle n
+        inline Point vertex(unsigned int n, int k) const {return Point( x[3*n+k], y[3*n+k], z[3*n+k] );}
+        /// unit normal of triangle n, with positive z-coordinate
+        inline Point normal(unsigned int n) const {return Point( nx[n], ny[n], nz[n] );}
+        /// unit XY-projection of the normal of triangle n
+        inline Point xyNormal(unsigned int n) const {return Point( xynx[n], xyny[n], 0.0 );}
+        /// unit XY-direction of edge k, from vertex k to vertex (k+1)%3, of triangle n
+        inline Point edgeDir(unsigned int n, int k) const {return Point( ex[3*n+k], ey[3*n+k], 0.0 );}
+        /// true if flag f is set for triangle n
+        inline bool has(unsigned int n, int f) const {return (flags[n] & f) != 0;}
+        /// bytes used by the arrays
+        unsigned int bytes() const;
+        /// append the PACKED_SURF_BLOCKS arrays to blocks, for a file
+        void save_blocks(std::vector<FileBlock>& blocks) const;
+        /// \brief use the arrays of n triangles saved by save_blocks(), in place.
+        ///
+        /// blocks[first] is the first of them. The memory must outlive this PackedSurf.
+        /// returns false if the blocks do not fit n triangles.
+        bool map_blocks(const std::vector<FileBlock>& blocks, unsigned int first, unsigned int n);
+    // DATA
+        /// vertex x-coordinates, three per triangle
+        const double* x;
+        /// vertex y-coordinates, three per triangle
+        const double* y;
+        /// vertex z-coordinates, three per triangle
+        const double* z;
+        /// unit up-normal x-component
+        const double* nx;
+        /// unit up-normal y-component
+        const double* ny;
+        /// unit up-normal z-component
+        const double* nz;
+        /// plane constant d, the facet is in the plane nx*x + ny*y + nz*z + d = 0
+        const double* d;
+        /// unit XY-normal x-component
+        const double* xynx;
+        /// unit XY-normal y-component
+        const double* xyny;
+        /// unit XY edge direction x-component, three per triangle
+        const double* ex;
+        /// unit XY edge direction y-component, three per triangle
+        const double* ey;
+        /// Flags of each triangle
+        const unsigned char* flags;
+    protected:
+        /// point the arrays at built
+        void update_views();
+        /// the arrays filled by build()
+        class Built {
+            public:
+                /// see PackedSurf::x and the other arrays of the same name
+                std::vector<double> x, y, z, nx, ny, nz, d, xynx, xyny, ex, ey;
+                /// see PackedSurf::flags
+                std::vector<unsigned char> flags;
+        };
+        /// the arrays filled by build(), empty if the arrays are mapped
+        Built built;
+        /// number of triangles
+        unsigned int nTriangles;
+    private:
+        PackedSurf(const PackedSurf&); // not copyable, the arrays may point into built
+        PackedSurf& operator=(const PackedSurf&);
+};
+
+} // end namespace
+#endif
+// end file packedsurf.hpp
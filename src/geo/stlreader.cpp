@@ -21,13 +21,31 @@
  *  You should have received a copy of the GNU Lesser General Public License
  *  along with this program. If not, see <http://www.gnu.org/licenses/>.
 */
-#include <fstream>  // required by read_from_file()
+#include <iostream>
 #include <sstream>
+#include <locale>
 #include <cstring>
-#include <list>
+#include <cmath>
+#include <cfloat>
+#include <vector>
+#include <algorithm>
+
+#include <boost/cstdint.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 
 #include "stlreader.hpp"
 #include "stlsurf.hpp"
+#include "mappedfile.hpp"
+#include "threadpool.hpp"
+
+/// size of the header of a binary STL file, including the facet count
+#define STL_HEADER_SIZE 84
+/// size of a facet record in a binary STL file
+#define STL_FACET_SIZE 50
+/// number of facets converted by one thread at a time
+#define STL_READ_CHUNK 16384
+/// approximate number of bytes of an ASCII STL file parsed by one thread at a time
+#define STL_ASCII_CHUNK (1<<20)
 
 namespace ocl
 {
@@ -54,107 +72,352 @@ namespace ocl
         return str_for_Ttc.c_str();
     }
 
-    void STLReader::read_from_file(const wchar_t* filepath, STLSurf& surface) {
-        // read the stl file
-        std::ifstream ifs(Ttc(filepath), ios::binary);
-        if(!ifs)return;
-
-        char solid_string[6] = "aaaaa";
-        ifs.read(solid_string, 5);
-        if(ifs.eof())return;
-        if(strcmp(solid_string, "solid"))
-        {
-            // try binary file read
-
-            // read the header
-            char header[81];
-            header[80] = 0;
-            memcpy(header, solid_string, 5);
-            ifs.read(&header[5], 75);
-
-            unsigned int num_facets = 0;
-            ifs.read((char*)(&num_facets), 4);
-
-            for(unsigned int i = 0; i<num_facets; i++)
-            {
-                float n[3];
-                float x[3][3];
-                ifs.read((char*)(n), 12);
-                ifs.read((char*)(x[0]), 36);
-                short attr;
-                ifs.read((char*)(&attr), 2);
-                surface.addTriangle(Triangle(Point(x[0][0], x[0][1], x[0][2]), 
-                    Point(x[1][0], x[1][1], x[1][2]), 
-                    Point(x[2][0], x[2][1], x[2][2])));
+    /// wall-clock time in seconds
+    static double read_time() {
+        const boost::posix_time::ptime epoch( boost::gregorian::date(1970, 1, 1) );
+        return ( boost::posix_time::microsec_clock::universal_time() - epoch ).total_microseconds() * 1e-6;
+    }
+
+    /// print the number of triangles read from file, and the throughput
+    static void report(const MappedFile& file, unsigned int num_facets, double seconds) {
+        double mb = file.size() / 1.0E6;
+        std::cout << "STLReader: " << num_facets << " triangles, " << mb << " MB in " << seconds << " s";
+        if ( seconds > 0 )
+            std::cout << " (" << mb/seconds << " MB/s)";
+        std::cout << "\n";
+    }
+
+    /// \brief true if rounding d to a float may not round the decimal number d was rounded from.
+    ///
+    /// d is the correctly rounded double of a decimal number. Rounding it again to float gives
+    /// the correctly rounded float, unless d is exactly halfway between two floats, or outside
+    /// the range of normal floats.
+    static bool float_rounding_unsure(double d) {
+        d = fabs(d);
+        if ( d == 0.0 )
+            return false;
+        if ( (d < FLT_MIN) || (d > FLT_MAX) )
+            return true;
+        boost::uint64_t bits;
+        memcpy( &bits, &d, 8 );
+        // a double has 29 more mantissa bits than a float. Halfway, they are a one and 28 zeros.
+        return (bits & 0x1FFFFFFF) == 0x10000000;
+    }
+
+    /// parse the number in [p, end) with the standard library, in the "C" locale. Slow, but correctly rounded.
+    static float parse_float_slow(const char* p, const char* end) {
+        std::istringstream in( std::string(p, end) );
+        in.imbue( std::locale::classic() );
+        float f = 0;
+        if ( in >> f )
+            return f;
+        // out of the range of float. Read as a double, which gives an infinity or a denormal as strtof() would.
+        std::istringstream din( std::string(p, end) );
+        din.imbue( std::locale::classic() );
+        double d = 0;
+        din >> d;
+        return (float) d;
+    }
+
+    /// \brief parse a decimal floating-point number at p, and return the position after it.
+    ///
+    /// Always uses '.' as the decimal point, whatever the locale. Returns p, and sets f
+    /// to zero, if there is no number at p. f is the correctly rounded float, as from strtof().
+    static const char* parse_float(const char* p, const char* end, float& f) {
+        const char* start = p;
+        bool negative = false;
+        if ( (p < end) && ((*p == '-') || (*p == '+')) ) {
+            negative = (*p == '-');
+            ++p;
+        }
+        boost::uint64_t mantissa = 0; // the first 19 significant digits
+        int digits = 0;
+        int exponent = 0;
+        bool found = false;
+        bool dropped = false; // true if a non-zero digit did not fit in mantissa
+        for ( ; (p < end) && (*p >= '0') && (*p <= '9'); ++p ) {
+            if ( digits < 19 ) {
+                mantissa = 10*mantissa + (*p - '0');
+                if ( mantissa > 0 )
+                    ++digits;
+            } else {
+                ++exponent; // digit dropped
+                dropped = dropped || (*p != '0');
+            }
+            found = true;
+        }
+        if ( (p < end) && (*p == '.') ) {
+            for ( ++p; (p < end) && (*p >= '0') && (*p <= '9'); ++p ) {
+                if ( digits < 19 ) {
+                    mantissa = 10*mantissa + (*p - '0');
+                    if ( mantissa > 0 )
+                        ++digits;
+                    --exponent;
+                } else {
+                    dropped = dropped || (*p != '0');
+                }
+                found = true;
+            }
+        }
+        if ( !found ) {
+            f = 0;
+            return start;
+        }
+        if ( (p < end) && ((*p == 'e') || (*p == 'E')) ) {
+            const char* q = p+1;
+            bool eneg = false;
+            if ( (q < end) && ((*q == '-') || (*q == '+')) ) {
+                eneg = (*q == '-');
+                ++q;
+            }
+            int e = 0;
+            bool edigits = false;
+            for ( ; (q < end) && (*q >= '0') && (*q <= '9'); ++q ) {
+                if ( e < 10000 )
+                    e = 10*e + (*q - '0');
+                edigits = true;
+            }
+            if ( edigits ) {
+                exponent += eneg ? -e : e;
+                p = q;
+            }
+        }
+        // a mantissa up to 2^53 and powers of ten up to 1E22 are exact in a double, so for
+        // the usual short coordinates value is the correctly rounded double, from one operation
+        static const double pow10[] = { 1E0, 1E1, 1E2, 1E3, 1E4, 1E5, 1E6, 1E7, 1E8, 1E9, 1E10, 1E11,
+                                        1E12, 1E13, 1E14, 1E15, 1E16, 1E17, 1E18, 1E19, 1E20, 1E21, 1E22 };
+        if ( !dropped && (mantissa <= ((boost::uint64_t) 1 << 53)) && (exponent >= -22) && (exponent <= 22) ) {
+            double value = (double) mantissa;
+            if ( exponent >= 0 )
+                value *= pow10[exponent];
+            else
+                value /= pow10[-exponent];
+            if ( !float_rounding_unsure(value) ) {
+                f = (float) ( negative ? -value : value );
+                return p;
+            }
+        }
+        f = parse_float_slow(start, p);
+        return p;
+    }
+
+    /// skip spaces and tabs
+    static const char* skip_blanks(const char* p, const char* end) {
+        while ( (p < end) && ((*p == ' ') || (*p == '\t')) )
+            ++p;
+        return p;
+    }
+
+    /// return true if the line at p starts with the keyword word, after blanks
+    static bool line_starts_with(const char* p, const char* end, const char* word) {
+        p = skip_blanks(p, end);
+        const std::size_t n = strlen(word);
+        return ( (std::size_t)(end-p) >= n ) && ( strncmp(p, word, n) == 0 );
+    }
+
+    /// return the start of the first line at or after p that starts with "facet", or end
+    static const char* next_facet(const char* p, const char* end) {
+        while ( p < end ) {
+            if ( line_starts_with(p, end, "facet") )
+                return p;
+            p = (const char*) memchr( p, '\n', end-p );
+            if ( p == NULL )
+                return end;
+            ++p;
+        }
+        return end;
+    }
+
+    /// \brief parse the facets of an ASCII STL file in [p, end), appending nine vertex coordinates per facet to coords.
+    ///
+    /// p is at the start of a line. A facet is added at its "endfacet" line, if it had three vertices.
+    static void parse_ascii(const char* p, const char* end, std::vector<float>& coords) {
+        float x[9];
+        int vertex = 0;
+        while ( p < end ) {
+            const char* q = skip_blanks(p, end);
+            if ( line_starts_with(q, end, "vertex") ) {
+                q += 6;
+                for (int k=0; k<3; ++k) {
+                    q = skip_blanks(q, end);
+                    float c;
+                    q = parse_float(q, end, c);
+                    if ( vertex < 3 )
+                        x[3*vertex+k] = c;
+                }
+                ++vertex;
+            } else if ( line_starts_with(q, end, "facet") ) {
+                vertex = 0;
+            } else if ( line_starts_with(q, end, "endfacet") ) {
+                if ( vertex >= 3 )
+                    coords.insert( coords.end(), x, x+9 );
+                vertex = 0;
             }
+            p = (const char*) memchr( q, '\n', end-q );
+            if ( p == NULL )
+                break;
+            ++p;
         }
-        else
-        {
-            // "solid" already found
-            char str[1024] = "solid";
-            ifs.getline(&str[5], 1024);
-            //char title[1024];
-            //if(sscanf(str, "solid %s", title) == 1)
-            //m_title.assign(Ctt(title));
-
-            float n[3];
-            float x[3][3];
-            char five_chars[6] = "aaaaa";
-
-            int vertex = 0;
-
-            while(!ifs.eof())
-            {
-                ifs.getline(str, 1024);
-
-                int i = 0, j = 0;
-                for(; i<5; i++, j++)
-                {
-                    if(str[j] == 0)break;
-                    while(str[j] == ' ' || str[j] == '\t')j++;
-                    five_chars[i] = str[j];
+    }
+
+    /// the bounding-box of the boxes of all chunks
+    static Bbox merge(const std::vector<Bbox>& boxes) {
+        Bbox bb;
+        for (unsigned int c=0; c<boxes.size(); ++c)
+            bb.addBbox( boxes[c] );
+        return bb;
+    }
+
+    /// converts the facet records of a binary STL file, STL_READ_CHUNK facets per part,
+    /// and finds the bounding-box of each part
+    class BinaryFacetTask : public ParallelTask {
+        public:
+            BinaryFacetTask(const char* d, unsigned int n, Triangle* t, std::vector<Bbox>& b)
+                : data(d), num_facets(n), tris(t), boxes(b) {}
+            void run(unsigned int c) {
+                const unsigned int last = std::min( (c+1)*STL_READ_CHUNK, num_facets );
+                for (unsigned int i=c*STL_READ_CHUNK; i<last; ++i) {
+                    // the record is the normal, three vertices, and a 2-byte attribute.
+                    // records are not 4-byte aligned, so the vertices are copied out.
+                    float x[9];
+                    memcpy( x, data + STL_HEADER_SIZE + (std::size_t) i * STL_FACET_SIZE + 12, 36 );
+                    tris[i] = Triangle( Point(x[0], x[1], x[2]), Point(x[3], x[4], x[5]), Point(x[6], x[7], x[8]) );
+                    boxes[c].addTriangle( tris[i] );
                 }
-                if(i == 5)
-                {
-                    if(!strcmp(five_chars, "verte"))
-                    {
-#ifdef WIN32
-                        sscanf(str, " vertex %f %f %f", &(x[vertex][0]), &(x[vertex][1]), &(x[vertex][2]));
-#else
-                        std::istringstream ss(str);
-                        ss.imbue(std::locale("C"));
-                        while(ss.peek() == ' ') ss.seekg(1, ios_base::cur);
-                        ss.seekg(std::string("vertex").size(), ios_base::cur);
-                        ss >> x[vertex][0] >> x[vertex][1] >> x[vertex][2];
-#endif
-                        vertex++;
-                        if(vertex > 2)vertex = 2;
-                    }
-                    else if(!strcmp(five_chars, "facet"))
-                    {
-#ifdef WIN32
-                        sscanf(str, " facet normal %f %f %f", &(n[0]), &(n[1]), &(n[2]));
-#else
-                        std::istringstream ss(str);
-                        ss.imbue(std::locale("C"));
-                        while(ss.peek() == ' ') ss.seekg(1, ios_base::cur);
-                        ss.seekg(std::string("facet normal").size(), ios_base::cur);
-                        ss >> n[0] >> n[1] >> n[2];
-#endif
-                        vertex = 0;
-                    }
-                    else if(!strcmp(five_chars, "endfa"))
-                    {
-                        if(vertex == 2)
-                        {
-                            surface.addTriangle(Triangle(Point(x[0][0], x[0][1], x[0][2]), 
-                                Point(x[1][0], x[1][1], x[1][2]), 
-                                Point(x[2][0], x[2][1], x[2][2])));
-                        }
-                    }
+            }
+        private:
+            /// the mapped file
+            const char* data;
+            /// number of facets to convert
+            unsigned int num_facets;
+            /// the triangle storage of the surface
+            Triangle* tris;
+            /// the bounding-box of each part
+            std::vector<Bbox>& boxes;
+    };
+
+    /// parses part c of an ASCII STL file, from starts[c] up to starts[c+1], into coords[c]
+    class AsciiParseTask : public ParallelTask {
+        public:
+            AsciiParseTask(const std::vector<const char*>& s, std::vector< std::vector<float> >& c) : starts(s), coords(c) {}
+            void run(unsigned int c) {
+                parse_ascii( starts[c], starts[c+1], coords[c] );
+            }
+        private:
+            /// the start of each chunk, and the end of the file
+            const std::vector<const char*>& starts;
+            /// the coordinates parsed from each chunk
+            std::vector< std::vector<float> >& coords;
+    };
+
+    /// converts the coordinates of parsed chunk c into triangles offsets[c] up to offsets[c+1],
+    /// and finds their bounding-box
+    class AsciiFacetTask : public ParallelTask {
+        public:
+            AsciiFacetTask(const std::vector< std::vector<float> >& c, const std::vector<unsigned int>& o, Triangle* t,
+                           std::vector<Bbox>& b)
+                : coords(c), offsets(o), tris(t), boxes(b) {}
+            void run(unsigned int c) {
+                const float* x = coords[c].empty() ? NULL : &coords[c][0];
+                for (unsigned int i=offsets[c]; i<offsets[c+1]; ++i, x+=9) {
+                    tris[i] = Triangle( Point(x[0], x[1], x[2]), Point(x[3], x[4], x[5]), Point(x[6], x[7], x[8]) );
+                    boxes[c].addTriangle( tris[i] );
                 }
             }
+        private:
+            /// the coordinates parsed from each chunk
+            const std::vector< std::vector<float> >& coords;
+            /// the first triangle of each chunk
+            const std::vector<unsigned int>& offsets;
+            /// the triangle storage of the surface
+            Triangle* tris;
+            /// the bounding-box of each chunk
+            std::vector<Bbox>& boxes;
+    };
+
+    void STLReader::read_from_file(const wchar_t* filepath, STLSurf& surface) {
+        // read the stl file
+        MappedFile file;
+        if ( !file.open( Ttc(filepath) ) || (file.size() < 5) )
+            return;
+        // a binary file may also start with "solid", but then its size matches the facet count
+        bool binary = ( strncmp(file.data(), "solid", 5) != 0 );
+        if ( !binary && (file.size() >= STL_HEADER_SIZE) ) {
+            boost::uint32_t num_facets;
+            memcpy( &num_facets, file.data() + 80, 4 );
+            binary = ( (num_facets > 0) && 
+                       (file.size() == STL_HEADER_SIZE + (std::size_t) num_facets * STL_FACET_SIZE) );
+        }
+        if ( binary ) {
+            read_binary(file, surface);
+            return;
+        }
+        read_ascii(file, surface);
+    }
+
+    void STLReader::read_binary(const MappedFile& file, STLSurf& surface) {
+        double t_start = read_time();
+        if ( file.size() < STL_HEADER_SIZE ) {
+            std::cout << "STLReader ERROR: " << file.name() << " is too short for a binary STL file\n";
+            return;
+        }
+        const char* data = file.data();
+        boost::uint32_t num_facets;
+        memcpy( &num_facets, data + 80, 4 );
+        // don't trust a header count larger than the file
+        const std::size_t file_facets = (file.size() - STL_HEADER_SIZE) / STL_FACET_SIZE;
+        if ( num_facets > file_facets ) {
+            std::cout << "STLReader WARNING: " << file.name() << " has " << num_facets << " facets in the header,";
+            std::cout << " but only " << file_facets << " in the file\n";
+            num_facets = file_facets;
+        }
+        if ( num_facets == 0 )
+            return;
+        Triangle* tris = surface.appendTriangles( num_facets );
+        const unsigned int nchunks = (num_facets + STL_READ_CHUNK - 1) / STL_READ_CHUNK;
+        std::vector<Bbox> boxes( nchunks );
+        BinaryFacetTask task( data, num_facets, tris, boxes );
+        ThreadPool::instance().run( task, nchunks );
+        surface.trianglesAdded( merge(boxes) );
+        report(file, num_facets, read_time() - t_start);
+    }
+
+    // the file is split into chunks that start at a "facet" line, and each chunk
+    // is parsed on its own. A facet never spans two chunks.
+    void STLReader::read_ascii(const MappedFile& file, STLSurf& surface) {
+        double t_start = read_time();
+        const char* data = file.data();
+        const char* end = data + file.size();
+        // skip the "solid name" line
+        const char* p = (const char*) memchr( data, '\n', file.size() );
+        if ( p == NULL )
+            return;
+        std::vector<const char*> starts;
+        starts.push_back( next_facet(p+1, end) );
+        while ( starts.back() < end ) {
+            const char* s = starts.back();
+            const char* line = NULL; // the first line starting after s + STL_ASCII_CHUNK
+            if ( end - s > STL_ASCII_CHUNK )
+                line = (const char*) memchr( s + STL_ASCII_CHUNK, '\n', end - (s + STL_ASCII_CHUNK) );
+            starts.push_back( (line != NULL) ? next_facet(line+1, end) : end );
         }
+        const unsigned int nchunks = starts.size()-1;
+        std::vector< std::vector<float> > coords( nchunks );
+        AsciiParseTask parse( starts, coords );
+        ThreadPool::instance().run( parse, nchunks );
+        // chunk c becomes triangles offsets[c] up to offsets[c+1]
+        std::vector<unsigned int> offsets( nchunks+1, 0 );
+        for (unsigned int c=0; c<nchunks; ++c)
+            offsets[c+1] = offsets[c] + coords[c].size()/9;
+        const unsigned int num_facets = offsets[nchunks];
+        if ( num_facets == 0 )
+            return;
+        Triangle* tris = surface.appendTriangles( num_facets );
+        std::vector<Bbox> boxes( nchunks );
+        AsciiFacetTask convert( coords, offsets, tris, boxes );
+        ThreadPool::instance().run( convert, nchunks );
+        surface.trianglesAdded( merge(boxes) );
+        report(file, num_facets, read_time() - t_start);
     }
 
 }
@@ -22,10 +22,13 @@
 #ifndef STLREADER_H
 #define STLREADER_H
 
+#include <string>
+
 namespace ocl
 {
     
 class STLSurf;
+class MappedFile;
 
 
 /// \brief STL file reader, reads an STL file and calls addTriangle on the STLSurf
@@ -42,6 +45,16 @@ class STLReader {
     private:
         /// read STL-surface from file
         void read_from_file(const wchar_t* filepath, STLSurf& surface);
+        /// \brief read a binary STL file.
+        ///
+        /// The 50-byte facet records of the mapped file are converted in chunks on the threads of
+        /// the ThreadPool, straight into the triangle storage of surface.
+        void read_binary(const MappedFile& file, STLSurf& surface);
+        /// \brief read an ASCII STL file.
+        ///
+        /// The mapped file is split at "facet" lines into chunks that are parsed on the ThreadPool,
+        /// with a number parser that does not depend on the locale.
+        void read_ascii(const MappedFile& file, STLSurf& surface);
 };
 
 }
@@ -19,16 +19,70 @@
  *  along with this program. If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include <list>
+#include <vector>
 #include <cassert>
+#include <algorithm>
 
 #include <boost/foreach.hpp>
 
 #include "stlsurf.hpp"
+#include "decimator.hpp"
+#include "numeric.hpp"
+#include "threadpool.hpp"
 
 namespace ocl
 {
 
+/// number of Morton codes computed by one thread at a time
+#define MORTON_CHUNK 16384
+
+/// computes the Morton code of each triangle, MORTON_CHUNK triangles per part, see STLSurf::calcMortonOrder()
+class MortonTask : public ParallelTask {
+    public:
+        MortonTask(const std::vector<Triangle>& t, const Bbox& b, std::vector<boost::uint64_t>& o)
+            : tris(t), bb(b), order(o) {
+            // 16 bits per axis, over the bounding-box of the surface
+            sx = (bb.maxpt.x > bb.minpt.x) ? 65535.0/(bb.maxpt.x-bb.minpt.x) : 0.0;
+            sy = (bb.maxpt.y > bb.minpt.y) ? 65535.0/(bb.maxpt.y-bb.minpt.y) : 0.0;
+        }
+        void run(unsigned int c) {
+            const unsigned int last = std::min( (unsigned int) tris.size(), (c+1)*MORTON_CHUNK );
+            for (unsigned int n=c*MORTON_CHUNK; n<last; ++n) {
+                const Bbox& b = tris[n].bb;
+                boost::uint32_t qx = (boost::uint32_t) std::min( 65535.0, std::max( 0.0, (0.5*(b.minpt.x+b.maxpt.x)-bb.minpt.x)*sx ) );
+                boost::uint32_t qy = (boost::uint32_t) std::min( 65535.0, std::max( 0.0, (0.5*(b.minpt.y+b.maxpt.y)-bb.minpt.y)*sy ) );
+                boost::uint64_t code = morton_spread(qx) | (morton_spread(qy) << 1);
+                order[n] = (code << 32) | (boost::uint32_t) n;
+            }
+        }
+    private:
+        /// the triangles
+        const std::vector<Triangle>& tris;
+        /// the bounding-box of the surface
+        const Bbox& bb;
+        /// the codes, with the triangle number in the low 32 bits
+        std::vector<boost::uint64_t>& order;
+        /// scale of the x-axis
+        double sx;
+        /// scale of the y-axis
+        double sy;
+};
+
+/// sort v by the high 32 bits of each element. The sort is stable, so equal codes stay in triangle order.
+static void radix_sort_high(std::vector<boost::uint64_t>& v) {
+    std::vector<boost::uint64_t> tmp( v.size() );
+    for (int shift=32; shift<64; shift+=8) { // least significant byte of the code first
+        unsigned int count[257] = {0};
+        BOOST_FOREACH(boost::uint64_t x, v)
+            ++count[ ((x >> shift) & 0xFF) + 1 ];
+        for (int b=0; b<256; ++b)
+            count[b+1] += count[b];
+        BOOST_FOREACH(boost::uint64_t x, v)
+            tmp[ count[ (x >> shift) & 0xFF ]++ ] = x;
+        v.swap(tmp);
+    }
+}
+
 void STLSurf::addTriangle(const Triangle &t) {
     
     // some sanity-checking:
@@ -38,9 +92,79 @@ void STLSurf::addTriangle(const Triangle &t) {
     
     tris.push_back(t);
     bb.addTriangle(t);
+    ++revision;
     return;
 }
 
+Triangle* STLSurf::appendTriangles(unsigned int n) {
+    const unsigned int first = tris.size();
+    tris.resize( first + n );
+    ++revision;
+    return (n > 0) ? &tris[first] : NULL;
+}
+
+void STLSurf::trianglesAdded(unsigned int first) {
+    for (unsigned int n=first; n<tris.size(); ++n)
+        bb.addTriangle( tris[n] );
+    ++revision;
+}
+
+void STLSurf::trianglesAdded(const Bbox& box) {
+    bb.addBbox( box );
+    ++revision;
+}
+
+void STLSurf::swapTriangles(std::vector<Triangle>& t) {
+    tris.swap(t);
+    bb.clear();
+    trianglesAdded(0);
+}
+
+void STLSurf::calcMortonOrder() {
+    calcMortonOrder( mortonOrder );
+    mortonRevision = revision;
+}
+
+void STLSurf::calcMortonOrder(std::vector<boost::uint64_t>& order) const {
+    const unsigned int N = tris.size();
+    order.resize(N);
+    if ( N == 0 )
+        return;
+    MortonTask task( tris, bb, order );
+    ThreadPool::instance().run( task, (N + MORTON_CHUNK - 1) / MORTON_CHUNK );
+    radix_sort_high( order );
+}
+
+STLSurf& STLSurf::operator=(const STLSurf& s) {
+    if (this != &s) {
+        tris = s.tris;
+        bb = s.bb;
+        ++revision;
+    }
+    return *this;
+}
+
+void STLSurf::setMortonOrder(const boost::uint64_t* order, unsigned int n) {
+    mortonOrder.assign( order, order+n );
+    mortonRevision = revision;
+}
+
+void STLSurf::setArrays(boost::shared_ptr<const SurfaceArrays> a) {
+    arrays = a;
+    arraysRevision = revision;
+}
+
+double STLSurf::decimate(double tol) {
+    Decimator d(tol);
+    d.run(*this);
+    return d.getMaxError();
+}
+
+unsigned int STLSurf::next_id() {
+    static unsigned int count = 0;
+    return ++count;
+}
+
 void STLSurf::rotate(double xr, double yr, double zr) {
     //std::cout << " before " << t << "\n";
     bb.clear();
@@ -52,6 +176,7 @@ void STLSurf::rotate(double xr, double yr, double zr) {
         //std::cin >> c;
         bb.addTriangle(t);
     } 
+    ++revision;
 }
 
 unsigned int STLSurf::size() const {
@@ -59,7 +184,7 @@ unsigned int STLSurf::size() const {
 }
 
 std::ostream &operator<<(std::ostream &stream, const STLSurf s) {
-  stream << "STLSurf(N="<< s.tris.size() <<")";
+  stream << "STLSurf(N="<< s.size() <<")";
   return stream;
 }
 
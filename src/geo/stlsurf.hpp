@@ -21,7 +21,10 @@
 #ifndef STLSURF_H
 #define STLSURF_H
 
-#include <list>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include "triangle.hpp"
 #include "bbox.hpp"
@@ -30,29 +33,101 @@ namespace ocl
 {
     
 class Point;
+class SurfaceArrays;
 
 /// \brief STL surface, essentially an unordered list of Triangle objects
 ///
 /// STL surfaces consist of triangles. There is by definition no structure
 /// or order among the triangles, i.e. they can be positioned or connected in arbitrary ways.
+/// The triangles are stored contiguously, and triangle n is getTriangles()[n]. They are
+/// only modified through member functions, each of which changes the revision.
+/// References to triangles are invalidated by any modification.
 class STLSurf {
     public:
         /// Create an empty STL-surface
-        STLSurf() {};
+        STLSurf() : id( next_id() ), revision(0), mortonRevision(0), arraysRevision(0) {};
+        /// copy constructor. The copy is a new surface, with its own id.
+        STLSurf(const STLSurf& s) : bb(s.bb), tris(s.tris), id( next_id() ), revision(0), mortonRevision(0), arraysRevision(0) {};
+        /// assignment, counts as a modification of this surface
+        STLSurf& operator=(const STLSurf& s);
         /// destructor
         virtual ~STLSurf() {};
         /// add Triangle t to this surface
         void addTriangle(const Triangle& t);
         /// return number of triangles in surface
         unsigned int size() const;
+        /// allocate storage for n triangles, to avoid re-allocation while adding them
+        void reserve(unsigned int n) {tris.reserve(n);}
+        /// \brief append n triangles, to be written in place, and return a pointer to the first of them.
+        ///
+        /// For readers that fill the triangles in parallel instead of through addTriangle().
+        /// Call trianglesAdded() with the old size() when they are written.
+        Triangle* appendTriangles(unsigned int n);
+        /// add the triangles from first onwards, written through appendTriangles(),
+        /// to the bounding-box, and count them as a modification
+        void trianglesAdded(unsigned int first);
+        /// like trianglesAdded(first), for a reader that found box, the bounding-box of the
+        /// added triangles, while writing them, so that they are not scanned again
+        void trianglesAdded(const Bbox& box);
+        /// replace the triangles of this surface with those in t, which gets the old triangles
+        void swapTriangles(std::vector<Triangle>& t);
         /// call Triangle::rotate on all triangles
         void rotate(double xr,double yr, double zr);
-        /// list of Triangles in this surface
-        std::list<Triangle> tris; 
+        /// \brief remove triangles while the surface stays within distance tol of the original, see Decimator.
+        ///
+        /// Prints the number of triangles before and after, and returns the bound on the distance.
+        double decimate(double tol);
+        /// a number unique to this surface object, see IndexCache
+        unsigned int getId() const {return id;}
+        /// the number of modifications made to this surface, by addTriangle(), rotate(), decimate(), operator= and the like
+        unsigned int getRevision() const {return revision;}
+        /// \brief sort the triangles by the Morton code of the XY-centre of their bounding-box.
+        ///
+        /// A BVH can be built from the sorted order without partitioning the triangles.
+        /// The order is not found when the surface is read, but by SpatialIndex::build(const STLSurf&)
+        /// for an index that uses it, see SpatialIndex::usesMortonOrder().
+        void calcMortonOrder();
+        /// find the order of calcMortonOrder() into order, without storing it in the surface
+        void calcMortonOrder(std::vector<boost::uint64_t>& order) const;
+        /// use the n elements of order, found by calcMortonOrder() for the same triangles earlier, e.g. saved by MeshCache
+        void setMortonOrder(const boost::uint64_t* order, unsigned int n);
+        /// \brief the order found by calcMortonOrder(), or NULL if the surface was modified since.
+        ///
+        /// Each element is the 32-bit Morton code in the high half and the triangle index in the
+        /// low half, so the elements are sorted by code.
+        const std::vector<boost::uint64_t>* getMortonOrder() const {
+            return ( !mortonOrder.empty() && (mortonRevision == revision) ) ? &mortonOrder : NULL;
+        }
+        /// use a, built or mapped from a file for the same triangles earlier, as the arrays of
+        /// this surface, see IndexCache::arrays(). Not copied with the surface.
+        void setArrays(boost::shared_ptr<const SurfaceArrays> a);
+        /// the arrays set by setArrays(), or NULL if the surface was modified since
+        boost::shared_ptr<const SurfaceArrays> getArrays() const {
+            return ( arraysRevision == revision ) ? arrays : boost::shared_ptr<const SurfaceArrays>();
+        }
+        /// the Triangles in this surface
+        const std::vector<Triangle>& getTriangles() const {return tris;}
         /// bounding-box
         Bbox bb;
         /// STLSurf string repr
         friend std::ostream &operator<<(std::ostream& stream, const STLSurf s);
+    protected:
+        /// the Triangles in this surface
+        std::vector<Triangle> tris;
+        /// return a new surface id
+        static unsigned int next_id();
+        /// surface id
+        unsigned int id;
+        /// modification count
+        unsigned int revision;
+        /// the triangles sorted by calcMortonOrder()
+        std::vector<boost::uint64_t> mortonOrder;
+        /// revision when mortonOrder was found
+        unsigned int mortonRevision;
+        /// the arrays set by setArrays()
+        boost::shared_ptr<const SurfaceArrays> arrays;
+        /// revision when arrays was set
+        unsigned int arraysRevision;
 };
 
 } // end namespace
@@ -25,6 +25,7 @@
 #include <boost/foreach.hpp>
 
 #include "stlsurf.hpp"
+#include "meshcache.hpp"
 
 namespace ocl
 {
@@ -35,7 +36,7 @@ class STLSurf_py : public STLSurf {
         /// default constructor
         STLSurf_py() : STLSurf() {};
         /// return list of all triangles to python
-        boost::python::list getTriangles() const {
+        boost::python::list getTriangles_py() const {
             boost::python::list tlist;
             BOOST_FOREACH(Triangle t, tris) {
                 tlist.append(Triangle_py(t));
@@ -55,12 +56,27 @@ class STLSurf_py : public STLSurf {
             return bounds;
         };
         
+        /// save the triangles to a mesh cache file, see MeshCache::save()
+        bool save_cache(const std::string& filename) const {
+            return MeshCache::save(filename, *this);
+        }
+        /// \brief load a mesh cache file into this empty surface, see MeshCache::load()
+        ///
+        /// The triangles are copied into the surface. The packed and welded arrays, and an index
+        /// in the file, are searched in place, kept with the surface, and used by operations on it.
+        bool load_cache(const std::string& filename) {
+            return MeshCache::load(filename, *this, cachedIndex);
+        }
+        
         /// string output
         std::string str() const {
             std::ostringstream o;
             o << *this;
             return o.str();
         };
+    protected:
+        /// the index loaded by load_cache(), if any
+        boost::shared_ptr<SpatialIndex> cachedIndex;
 };
 
 } // end namespace
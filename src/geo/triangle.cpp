@@ -44,12 +44,20 @@ Triangle::Triangle(Point p1, Point p2, Point p3) {
     calcBB();
 }
 
+Triangle::Triangle(const Point& p1, const Point& p2, const Point& p3, const Point& normal, const Bbox& box) {
+    p[0]=p1;
+    p[1]=p2;
+    p[2]=p3;
+    n=normal;
+    bb=box;
+}
+
 Triangle::Triangle(const Triangle &t) {
     p[0]=t.p[0];
     p[1]=t.p[1];
     p[2]=t.p[2];
-    calcNormal();
-    calcBB();
+    n=t.n; // calculated from the same vertices, so not calculated again
+    bb=t.bb;
 }
  
 
@@ -43,6 +43,9 @@ class Triangle {
         virtual ~Triangle() {}
         /// Create a triangle with the vertices p1, p2, and p3.
         Triangle(Point p1, Point p2, Point p3);   
+        /// Create a triangle with the vertices p1, p2, and p3, and a normal and
+        /// bounding-box calculated earlier, e.g. read from a MeshCache file
+        Triangle(const Point& p1, const Point& p2, const Point& p3, const Point& normal, const Bbox& box);
         
         /// return true if Triangle is sliced by a z-plane at z=zcut
         /// modify p1 and p2 so that they are intesections of the triangle edges
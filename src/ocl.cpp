@@ -25,6 +25,8 @@
 #include <boost/python/docstring_options.hpp>
 
 #include "version_string.hpp" // autogenerated by version_string.cmake
+#include "threadpool.hpp"
+#include "operation_py.hpp"
 
 std::string ocl_docstring() {
     return "OpenCAMLib docstring";
@@ -34,6 +36,24 @@ std::string ocl_version() {
     return VERSION_STRING;
 }
 
+// the ThreadPool shared by all operations
+void set_thread_pool_size(unsigned int n) {
+    ocl::ScopedGILRelease nogil; // waits for the workers to finish their queued parts
+    ocl::ThreadPool::instance().setSize(n);
+}
+
+unsigned int get_thread_pool_size() {
+    return ocl::ThreadPool::instance().size();
+}
+
+void set_thread_affinity(bool a) {
+    ocl::ThreadPool::instance().setAffinity(a);
+}
+
+bool get_thread_affinity() {
+    return ocl::ThreadPool::instance().getAffinity();
+}
+
 namespace bp = boost::python;
 
 void export_cutters();
@@ -58,6 +78,10 @@ BOOST_PYTHON_MODULE(ocl) {
     
     bp::def("__doc__", ocl_docstring);
     bp::def("version", ocl_version);
+    bp::def("setThreadPoolSize", set_thread_pool_size, "use n threads, or one per core if n is zero. Not while an operation runs.");
+    bp::def("getThreadPoolSize", get_thread_pool_size);
+    bp::def("setThreadAffinity", set_thread_affinity, "pin the pool threads to cores");
+    bp::def("getThreadAffinity", get_thread_affinity);
     export_geometry(); // see ocl_geometry.cpp
     export_cutters(); // see ocl_cutters.cpp    
     export_algo(); // see ocl_algo.cpp
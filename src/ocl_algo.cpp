@@ -29,6 +29,7 @@
 #include "adaptivewaterline_py.hpp"  
 #include "lineclfilter_py.hpp"    
 #include "numeric.hpp"
+#include "indexcache.hpp"
 
 #include "zigzag.hpp"
 
@@ -58,12 +59,23 @@ void export_algo() {
         .def("__str__", &ZigZag::str)
     ;
 
+    bp::class_<CancelToken, boost::shared_ptr<CancelToken>, boost::noncopyable>("CancelToken")
+        .def("cancel", &CancelToken::cancel)
+        .def("reset", &CancelToken::reset)
+        .def("isCancelled", &CancelToken::isCancelled)
+    ;
     bp::class_<BatchPushCutter>("BatchPushCutter_base")
     ;
     bp::class_<BatchPushCutter_py, bp::bases<BatchPushCutter> >("BatchPushCutter")
-        .def("run", &BatchPushCutter_py::run)
-        .def("setSTL", &BatchPushCutter_py::setSTL)
-        .def("setCutter", &BatchPushCutter_py::setCutter)
+        .def("run", &BatchPushCutter_py::run_py)
+        .def("setProgressCallback", &BatchPushCutter_py::setProgressCallback_py)
+        .def("setProgressInterval", &BatchPushCutter_py::setProgressInterval)
+        .def("setCancelToken", &BatchPushCutter_py::setCancelToken)
+        .def("setTimeBudget", &BatchPushCutter_py::setTimeBudget)
+        .def("getTimeBudget", &BatchPushCutter_py::getTimeBudget)
+        .def("isStopped", &BatchPushCutter_py::isStopped)
+        .def("setSTL", &BatchPushCutter_py::setSTL_py)
+        .def("setCutter", &BatchPushCutter_py::setCutter_py)
         .def("setThreads", &BatchPushCutter_py::setThreads)
         .def("appendFiber", &BatchPushCutter_py::appendFiber)
         .def("getOverlapTriangles", &BatchPushCutter_py::getOverlapTriangles)
@@ -74,6 +86,13 @@ void export_algo() {
         .def("getThreads", &BatchPushCutter_py::getThreads)
         .def("setBucketSize", &BatchPushCutter_py::setBucketSize)
         .def("getBucketSize", &BatchPushCutter_py::getBucketSize)
+        .def("setSAH", &BatchPushCutter_py::setSAH)
+        .def("setIndexType", &BatchPushCutter_py::setIndexType)
+        .def("loadIndex", &BatchPushCutter_py::loadIndex_py)
+        .def("saveIndex", &BatchPushCutter_py::saveIndex_py)
+        .def("saveCache", &BatchPushCutter_py::saveCache_py)
+        .def("getSAH", &BatchPushCutter_py::getSAH)
+        .def("getIndexType", &BatchPushCutter_py::getIndexType)
         .def("setXDirection", &BatchPushCutter_py::setXDirection)
         .def("setYDirection", &BatchPushCutter_py::setYDirection)
     ;
@@ -103,16 +122,25 @@ void export_algo() {
     bp::class_<Waterline>("Waterline_base")
     ;
     bp::class_<Waterline_py, bp::bases<Waterline> >("Waterline")
-        .def("setCutter", &Waterline_py::setCutter)
-        .def("setSTL", &Waterline_py::setSTL)
+        .def("setCutter", &Waterline_py::setCutter_py)
+        .def("setSTL", &Waterline_py::setSTL_py)
         .def("setZ", &Waterline_py::setZ)
         .def("setSampling", &Waterline_py::setSampling)
-        .def("run", &Waterline_py::run)
-        .def("run2", &Waterline_py::run2)
+        .def("run", &Waterline_py::run_py)
+        .def("setProgressCallback", &Waterline_py::setProgressCallback_py)
+        .def("setProgressInterval", &Waterline_py::setProgressInterval)
+        .def("setCancelToken", &Waterline_py::setCancelToken)
+        .def("setTimeBudget", &Waterline_py::setTimeBudget)
+        .def("getTimeBudget", &Waterline_py::getTimeBudget)
+        .def("isStopped", &Waterline_py::isStopped)
+        .def("run2", &Waterline_py::run2_py)
         .def("reset", &Waterline_py::reset)
         .def("getLoops", &Waterline_py::py_getLoops)
         .def("setThreads", &Waterline_py::setThreads)
         .def("getThreads", &Waterline_py::getThreads)
+        .def("setSAH", &Waterline_py::setSAH)
+        .def("setIndexType", &Waterline_py::setIndexType)
+        .def("loadIndex", &Waterline_py::loadIndex_py)
         .def("getXFibers", &Waterline_py::py_getXFibers)
         .def("getYFibers", &Waterline_py::py_getYFibers)
         
@@ -120,22 +148,41 @@ void export_algo() {
     bp::class_<AdaptiveWaterline>("AdaptiveWaterline_base")
     ;
     bp::class_<AdaptiveWaterline_py, bp::bases<AdaptiveWaterline> >("AdaptiveWaterline")
-        .def("setCutter", &AdaptiveWaterline_py::setCutter)
-        .def("setSTL", &AdaptiveWaterline_py::setSTL)
+        .def("setCutter", &AdaptiveWaterline_py::setCutter_py)
+        .def("setSTL", &AdaptiveWaterline_py::setSTL_py)
         .def("setZ", &AdaptiveWaterline_py::setZ)
         .def("setSampling", &AdaptiveWaterline_py::setSampling)
         .def("setMinSampling", &AdaptiveWaterline_py::setMinSampling)
-        .def("run", &AdaptiveWaterline_py::run)
-        .def("run2", &AdaptiveWaterline_py::run2)
+        .def("run", &AdaptiveWaterline_py::run_py)
+        .def("setProgressCallback", &AdaptiveWaterline_py::setProgressCallback_py)
+        .def("setProgressInterval", &AdaptiveWaterline_py::setProgressInterval)
+        .def("setCancelToken", &AdaptiveWaterline_py::setCancelToken)
+        .def("setTimeBudget", &AdaptiveWaterline_py::setTimeBudget)
+        .def("getTimeBudget", &AdaptiveWaterline_py::getTimeBudget)
+        .def("isStopped", &AdaptiveWaterline_py::isStopped)
+        .def("run2", &AdaptiveWaterline_py::run2_py)
         .def("reset", &AdaptiveWaterline_py::reset)
         //.def("run2", &AdaptiveWaterline_py::run2) // uses Weave::build2()
         .def("getLoops", &AdaptiveWaterline_py::py_getLoops)
         .def("setThreads", &AdaptiveWaterline_py::setThreads)
         .def("getThreads", &AdaptiveWaterline_py::getThreads)
+        .def("setSAH", &AdaptiveWaterline_py::setSAH)
+        .def("setIndexType", &AdaptiveWaterline_py::setIndexType)
+        .def("loadIndex", &AdaptiveWaterline_py::loadIndex_py)
         .def("getXFibers", &AdaptiveWaterline_py::getXFibers)
         .def("getYFibers", &AdaptiveWaterline_py::getYFibers)
     ;
     
+    bp::enum_<SpatialIndexType>("SpatialIndexType")
+        .value("KDTree", KDTreeIndexType)
+        .value("BVH", BVHIndexType)
+        .value("Grid", GridIndexType)
+        .value("Fiber", FiberIndexType)
+    ;
+    bp::def("indexCacheSize", &IndexCache::size); // number of spatial indexes shared between operations
+    bp::def("indexCacheHits", &IndexCache::hits);
+    bp::def("clearIndexCache", &IndexCache::clear);
+    bp::def("setIndexCacheEnabled", &IndexCache::setEnabled);
     bp::enum_<weave::VertexType>("WeaveVertexType")
         .value("CL", weave::CL)
         .value("CL_DONE",weave::CL_DONE)
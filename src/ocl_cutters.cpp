@@ -42,11 +42,11 @@ void export_cutters() {
 // http://www.boost.org/doc/libs/1_43_0/libs/python/doc/tutorial/doc/html/python/exposing.html#python.inheritance
 
     bp::class_<MillingCutter_py , boost::noncopyable>("MillingCutter")
-        .def("vertexDrop", &MillingCutter::vertexDrop, &MillingCutter_py::default_vertexDrop )
-        .def("facetDrop",  &MillingCutter::facetDrop,  &MillingCutter_py::default_facetDrop )
-        .def("edgeDrop",   &MillingCutter::edgeDrop,   &MillingCutter_py::default_edgeDrop )
-        .def("dropCutter", &MillingCutter::dropCutter)
-        .def("pushCutter", &MillingCutter::pushCutter)
+        .def("vertexDrop", static_cast< bool (MillingCutter::*)(CLPoint&, const Triangle&) const>(&MillingCutter::vertexDrop), &MillingCutter_py::default_vertexDrop )
+        .def("facetDrop",  static_cast< bool (MillingCutter::*)(CLPoint&, const Triangle&) const>(&MillingCutter::facetDrop),  &MillingCutter_py::default_facetDrop )
+        .def("edgeDrop",   static_cast< bool (MillingCutter::*)(CLPoint&, const Triangle&) const>(&MillingCutter::edgeDrop),   &MillingCutter_py::default_edgeDrop )
+        .def("dropCutter", static_cast< bool (MillingCutter::*)(CLPoint&, const Triangle&) const>(&MillingCutter::dropCutter))
+        .def("pushCutter", static_cast< bool (MillingCutter::*)(const Fiber&, Interval&, const Triangle&) const>(&MillingCutter::pushCutter))
         .def("offsetCutter", &MillingCutter::offsetCutter,  bp::return_value_policy<bp::manage_new_object>() )
         .def("__str__",    &MillingCutter::str, &MillingCutter_py::default_str )
         .def("getRadius", &MillingCutter::getRadius )
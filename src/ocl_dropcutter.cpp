@@ -39,10 +39,16 @@ void export_dropcutter() {
     bp::class_<BatchDropCutter>("BatchDropCutter_base")
     ;
     bp::class_<BatchDropCutter_py, bp::bases<BatchDropCutter> >("BatchDropCutter")
-        .def("run", &BatchDropCutter_py::run)
+        .def("run", &BatchDropCutter_py::run_py)
+        .def("setProgressCallback", &BatchDropCutter_py::setProgressCallback_py)
+        .def("setProgressInterval", &BatchDropCutter_py::setProgressInterval)
+        .def("setCancelToken", &BatchDropCutter_py::setCancelToken)
+        .def("setTimeBudget", &BatchDropCutter_py::setTimeBudget)
+        .def("getTimeBudget", &BatchDropCutter_py::getTimeBudget)
+        .def("isStopped", &BatchDropCutter_py::isStopped)
         .def("getCLPoints", &BatchDropCutter_py::getCLPoints_py)
-        .def("setSTL", &BatchDropCutter_py::setSTL)
-        .def("setCutter", &BatchDropCutter_py::setCutter)
+        .def("setSTL", &BatchDropCutter_py::setSTL_py)
+        .def("setCutter", &BatchDropCutter_py::setCutter_py)
         .def("setThreads", &BatchDropCutter_py::setThreads)
         .def("getThreads", &BatchDropCutter_py::getThreads)
         .def("appendPoint", &BatchDropCutter_py::appendPoint)
@@ -50,28 +56,52 @@ void export_dropcutter() {
         .def("getCalls", &BatchDropCutter_py::getCalls)
         .def("getBucketSize", &BatchDropCutter_py::getBucketSize)
         .def("setBucketSize", &BatchDropCutter_py::setBucketSize)
+        .def("setSAH", &BatchDropCutter_py::setSAH)
+        .def("setIndexType", &BatchDropCutter_py::setIndexType)
+        .def("loadIndex", &BatchDropCutter_py::loadIndex_py)
+        .def("saveIndex", &BatchDropCutter_py::saveIndex_py)
+        .def("saveCache", &BatchDropCutter_py::saveCache_py)
+        .def("getSAH", &BatchDropCutter_py::getSAH)
+        .def("getIndexType", &BatchDropCutter_py::getIndexType)
+        .def("setSIMD", &BatchDropCutter_py::setSIMD)
+        .def("getSIMD", &BatchDropCutter_py::getSIMD)
     ;
 
 
     bp::class_<PathDropCutter>("PathDropCutter_base")
     ;
     bp::class_<PathDropCutter_py , bp::bases<PathDropCutter> >("PathDropCutter")
-        .def("run", &PathDropCutter_py::run)
+        .def("run", &PathDropCutter_py::run_py)
+        .def("setProgressCallback", &PathDropCutter_py::setProgressCallback_py)
+        .def("setProgressInterval", &PathDropCutter_py::setProgressInterval)
+        .def("setCancelToken", &PathDropCutter_py::setCancelToken)
+        .def("setTimeBudget", &PathDropCutter_py::setTimeBudget)
+        .def("getTimeBudget", &PathDropCutter_py::getTimeBudget)
+        .def("isStopped", &PathDropCutter_py::isStopped)
         .def("getCLPoints", &PathDropCutter_py::getCLPoints_py)
-        .def("setCutter", &PathDropCutter_py::setCutter)
-        .def("setSTL", &PathDropCutter_py::setSTL)
+        .def("setCutter", &PathDropCutter_py::setCutter_py)
+        .def("setSTL", &PathDropCutter_py::setSTL_py)
         .def("setSampling", &PathDropCutter_py::setSampling)
         .def("setPath", &PathDropCutter_py::setPath)
         .def("getZ", &PathDropCutter_py::getZ)
         .def("setZ", &PathDropCutter_py::setZ)
+        .def("setSAH", &PathDropCutter_py::setSAH)
+        .def("setIndexType", &PathDropCutter_py::setIndexType)
+        .def("loadIndex", &PathDropCutter_py::loadIndex_py)
     ;
     bp::class_<AdaptivePathDropCutter>("AdaptivePathDropCutter_base")
     ;
     bp::class_<AdaptivePathDropCutter_py , bp::bases<AdaptivePathDropCutter> >("AdaptivePathDropCutter")
-        .def("run", &AdaptivePathDropCutter_py::run)
+        .def("run", &AdaptivePathDropCutter_py::run_py)
+        .def("setProgressCallback", &AdaptivePathDropCutter_py::setProgressCallback_py)
+        .def("setProgressInterval", &AdaptivePathDropCutter_py::setProgressInterval)
+        .def("setCancelToken", &AdaptivePathDropCutter_py::setCancelToken)
+        .def("setTimeBudget", &AdaptivePathDropCutter_py::setTimeBudget)
+        .def("getTimeBudget", &AdaptivePathDropCutter_py::getTimeBudget)
+        .def("isStopped", &AdaptivePathDropCutter_py::isStopped)
         .def("getCLPoints", &AdaptivePathDropCutter_py::getCLPoints_py)
-        .def("setCutter", &AdaptivePathDropCutter_py::setCutter)
-        .def("setSTL", &AdaptivePathDropCutter_py::setSTL)
+        .def("setCutter", &AdaptivePathDropCutter_py::setCutter_py)
+        .def("setSTL", &AdaptivePathDropCutter_py::setSTL_py)
         .def("setSampling", &AdaptivePathDropCutter_py::setSampling)
         .def("setMinSampling", &AdaptivePathDropCutter_py::setMinSampling)
         .def("setCosLimit", &AdaptivePathDropCutter_py::setCosLimit)
@@ -79,6 +109,9 @@ void export_dropcutter() {
         .def("setPath", &AdaptivePathDropCutter_py::setPath)
         .def("getZ", &AdaptivePathDropCutter_py::getZ)
         .def("setZ", &AdaptivePathDropCutter_py::setZ)
+        .def("setSAH", &AdaptivePathDropCutter_py::setSAH)
+        .def("setIndexType", &AdaptivePathDropCutter_py::setIndexType)
+        .def("loadIndex", &AdaptivePathDropCutter_py::loadIndex_py)
     ;
 
 
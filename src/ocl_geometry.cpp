@@ -124,14 +124,18 @@ void export_geometry() {
         .def("__str__", &STLSurf_py::str)
         .def("size", &STLSurf_py::size)
         .def("rotate", &STLSurf_py::rotate)
+        .def("decimate", &STLSurf_py::decimate)
         .def("getBounds", &STLSurf_py::getBounds)
-        .def("getTriangles", &STLSurf_py::getTriangles)
-        .def_readonly("tris", &STLSurf_py::tris)
+        .def("getTriangles", &STLSurf_py::getTriangles_py)
+        .def("save_cache", &STLSurf_py::save_cache)
+        .def("load_cache", &STLSurf_py::load_cache)
+        .add_property("tris", &STLSurf_py::getTriangles_py)
         .def_readonly("bb", &STLSurf_py::bb)
     ;
     bp::class_<STLReader>("STLReader")
         .def(bp::init<const std::wstring&, STLSurf&>())
     ;
+    bp::def("convertSTL", &MeshCache::convert); // STL file to mesh cache file
     bp::class_<Bbox>("Bbox")
         .def("isInside", &Bbox::isInside )
         .def_readonly("maxpt", &Bbox::maxpt)
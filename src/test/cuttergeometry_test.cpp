@@ -0,0 +1,105 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010-2011 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// drop-cutter heights of the ConeCutter and CompositeCutter geometry fixes.
+// each case gives the height before the fix, and the correct height after it.
+
+#include <cmath>
+
+#include "testutil.hpp"
+#include "batchdropcutter.hpp"
+
+using namespace ocl;
+
+#define HEIGHT_TOL 1E-9
+
+/// the height of c dropped at (x,y) onto t, with dropCutter(cl, t) and with a BatchDropCutter.
+/// fails if the two do not agree.
+static double drop(MillingCutter& c, const Triangle& t, double x, double y) {
+    CLPoint cl(x, y, -100);
+    c.dropCutter(cl, t);
+    STLSurf s;
+    s.addTriangle(t);
+    BatchDropCutter bdc;
+    bdc.setSTL(s);
+    bdc.setCutter(&c);
+    CLPoint start(x, y, -100);
+    bdc.appendPoint(start);
+    bdc.run();
+    OCL_CHECK( fabs( bdc.getCLPoints()[0].z - cl.z ) < HEIGHT_TOL );
+    return cl.z;
+}
+
+/// true if h is the correct height, and not the height before the fix
+static bool fixed(double h, double correct, double before) {
+    return ( fabs(h - correct) < HEIGHT_TOL ) && ( fabs(h - before) > HEIGHT_TOL );
+}
+
+int main() {
+    const double angle = 0.7;
+
+    // a steep facet, on the plane z=2x, touches the rim of a ConeCutter at its center_height,
+    // not at the tip and not at its length. before: 0, the tip height
+    {
+        ConeCutter cone(4, angle, 20);
+        Triangle t( Point(-10,-10,-20), Point(10,-10,20), Point(0,10,0) );
+        OCL_CHECK( fixed( drop(cone, t, 0, 0), 4 - 2/tan(angle), 0 ) );
+    }
+
+    // the cone part of a CylConeCutter touches the edge x=2 above the facet contact of the cylinder.
+    // before: 2, the facet contact, because the edges were not tried after it
+    {
+        CylConeCutter cc(2, 6, angle);
+        Triangle t( Point(2,-10,4), Point(2,10,4), Point(-10,0,-20) );
+        OCL_CHECK( fixed( drop(cc, t, 0, 0), 4 - 1/tan(angle), 2 ) );
+    }
+
+    // a vertex just outside the cylinder radius, below the cone part.
+    // before: 1, because CompositeCutter::height() used the cylinder past its radius, which returned -1
+    {
+        CylConeCutter cc(2, 6, angle);
+        Triangle t( Point(1+5E-7,0,0), Point(20,-5,-50), Point(20,5,-50) );
+        OCL_CHECK( fixed( drop(cc, t, 0, 0), 0, 1 ) );
+    }
+
+    // the edge (-1.5,-0.5,0)-(0.5,3.5,0) passes at radius sqrt(5)/2 and touches the cone part.
+    // before: -0.4248..., because only the highest edge contact of each sub-cutter was checked against its radii
+    {
+        CylConeCutter cc(2, 6, angle);
+        Triangle t( Point(0.5,0,-1.5), Point(-1.5,-0.5,0), Point(0.5,3.5,0) );
+        CLPoint cl(0, 0, -100);
+        cc.edgeDrop(cl, t);
+        OCL_CHECK( fixed( cl.z, -(sqrt(5.0)/2 - 1)/tan(angle), -0.4248218142465483 ) );
+    }
+
+    // the same height-clamp bug as above, on demo.stl. before: 1.5857864022254944
+    {
+        STLSurf s;
+        test::readSTL("demo.stl", s);
+        CylConeCutter cc(2, 6, angle);
+        CLPoint cl(2.9999999999999996, 7.0000000000000018, s.bb.minpt.z - 10);
+        for (unsigned int n=0; n<s.size(); ++n)
+            cc.dropCutter(cl, s.getTriangles()[n]);
+        OCL_CHECK( fixed( cl.z, 0.58578640222549438, 1.5857864022254944 ) );
+    }
+
+    return test::result("cuttergeometry_test");
+}
@@ -0,0 +1,150 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010-2011 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Decimator: fewer triangles, correct counts, and a measured Hausdorff distance within the bound
+
+#include <cmath>
+#include <algorithm>
+
+#include "testutil.hpp"
+#include "decimator.hpp"
+
+using namespace ocl;
+
+/// the samples per triangle side, for the measured distance
+#define SAMPLES 4
+
+/// the closest point to p on triangle t
+static Point closest(const Point& p, const Triangle& t) {
+    const Point& a = t.p[0];
+    const Point& b = t.p[1];
+    const Point& c = t.p[2];
+    const Point ab = b - a;
+    const Point ac = c - a;
+    const Point ap = p - a;
+    const double d1 = ab.dot(ap);
+    const double d2 = ac.dot(ap);
+    if ( d1 <= 0 && d2 <= 0 )
+        return a;
+    const Point bp = p - b;
+    const double d3 = ab.dot(bp);
+    const double d4 = ac.dot(bp);
+    if ( d3 >= 0 && d4 <= d3 )
+        return b;
+    const double vc = d1*d4 - d3*d2;
+    if ( vc <= 0 && d1 >= 0 && d3 <= 0 )
+        return a + (d1/(d1 - d3))*ab;
+    const Point cp = p - c;
+    const double d5 = ab.dot(cp);
+    const double d6 = ac.dot(cp);
+    if ( d6 >= 0 && d5 <= d6 )
+        return c;
+    const double vb = d5*d2 - d1*d6;
+    if ( vb <= 0 && d2 >= 0 && d6 <= 0 )
+        return a + (d2/(d2 - d6))*ac;
+    const double va = d3*d6 - d5*d4;
+    if ( va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0 )
+        return b + ((d4 - d3)/((d4 - d3) + (d5 - d6)))*(c - b);
+    const double denom = 1.0/(va + vb + vc);
+    return a + (vb*denom)*ab + (vc*denom)*ac;
+}
+
+/// \brief the largest distance from a point of a to the nearest triangle of b.
+///
+/// a is sampled on a grid of barycentric coordinates, which includes its vertices and edges.
+static double distance(const STLSurf& a, const STLSurf& b) {
+    const std::vector<Triangle> ta( a.getTriangles().begin(), a.getTriangles().end() );
+    const std::vector<Triangle> tb( b.getTriangles().begin(), b.getTriangles().end() );
+    double dmax = 0;
+    for (unsigned int n=0; n<ta.size(); ++n) {
+        for (int i=0; i<=SAMPLES; ++i) {
+            for (int j=0; j<=SAMPLES-i; ++j) {
+                const double u = double(i)/SAMPLES;
+                const double v = double(j)/SAMPLES;
+                const Point p = ta[n].p[0] + u*(ta[n].p[1] - ta[n].p[0]) + v*(ta[n].p[2] - ta[n].p[0]);
+                double dmin = -1;
+                for (unsigned int m=0; m<tb.size(); ++m) {
+                    const double d = ( p - closest(p, tb[m]) ).norm();
+                    if ( dmin < 0 || d < dmin )
+                        dmin = d;
+                }
+                dmax = std::max(dmax, dmin);
+            }
+        }
+    }
+    return dmax;
+}
+
+/// decimate a copy of s with tol, and check the counts and the two-way distance to s
+static void check(const STLSurf& s, double tol) {
+    STLSurf d(s);
+    Decimator dec(tol);
+    dec.run(d);
+    OCL_CHECK( dec.getOutputSize() < s.size() );
+    OCL_CHECK( dec.getInputSize() == s.size() );
+    OCL_CHECK( dec.getOutputSize() == d.size() );
+    OCL_CHECK( dec.getMaxError() <= tol );
+    const double dist = std::max( distance(s, d), distance(d, s) );
+    std::cout << "measured distance " << dist << "\n";
+    OCL_CHECK( dist <= tol );
+    OCL_CHECK( dist <= dec.getMaxError() + 1E-9 );
+}
+
+/// a fine grid of n by n squares over the unit square, on the surface z = f(x,y)
+static void grid(STLSurf& s, unsigned int n, double amplitude) {
+    for (unsigned int i=0; i<n; ++i) {
+        for (unsigned int j=0; j<n; ++j) {
+            Point p[4];
+            for (unsigned int k=0; k<4; ++k) {
+                const double x = double(i + k%2)/n;
+                const double y = double(j + k/2)/n;
+                p[k] = Point( x, y, amplitude*sin(3*x)*cos(2*y) );
+            }
+            s.addTriangle( Triangle(p[0], p[1], p[3]) );
+            s.addTriangle( Triangle(p[0], p[3], p[2]) );
+        }
+    }
+}
+
+int main() {
+    {
+        STLSurf plane;
+        grid(plane, 30, 0);
+        check(plane, 1E-6);
+    }
+    {
+        STLSurf wave;
+        grid(wave, 30, 0.2);
+        check(wave, 0.01);
+    }
+    {
+        STLSurf demo;
+        test::readSTL("demo.stl", demo);
+        check(demo, 0.05);
+    }
+    // the bound is also kept for a larger tolerance, with fewer triangles left
+    {
+        STLSurf demo;
+        test::readSTL("demo.stl", demo);
+        check(demo, 0.5);
+    }
+    return test::result("decimator_test");
+}
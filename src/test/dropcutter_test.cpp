@@ -0,0 +1,141 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010-2011 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// BatchDropCutter, with every cutter and index type and with the SIMD kernels
+// on and off, against dropping each CL-point on every triangle of the surface
+
+#include <cmath>
+
+#include "testutil.hpp"
+#include "batchdropcutter.hpp"
+#include "clpoint.hpp"
+
+using namespace ocl;
+
+/// tolerance for comparing CL-point heights
+#define DROP_TEST_TOL 1E-9
+
+/// CL-points on a grid with spacing step over the surface, below it
+static std::vector<CLPoint> makePoints(const STLSurf& s, double step) {
+    std::vector<CLPoint> points;
+    const Bbox& bb = s.bb;
+    for (double x = bb.minpt.x - 1; x < bb.maxpt.x + 1; x += step) {
+        for (double y = bb.minpt.y - 1; y < bb.maxpt.y + 1; y += step)
+            points.push_back( CLPoint(x, y, bb.minpt.z - 10) );
+    }
+    return points;
+}
+
+/// drop c at points against each triangle of s, as BatchDropCutter::dropCutter1()
+static void bruteForce(const STLSurf& s, const MillingCutter& c, std::vector<CLPoint>& points) {
+    for (unsigned int n=0; n<points.size(); ++n) {
+        for (unsigned int m=0; m<s.size(); ++m)
+            c.dropCutter( points[n], s.getTriangles()[m] );
+    }
+}
+
+/// a BatchDropCutter that runs the older versions of the algorithm
+class VersionDropCutter : public BatchDropCutter {
+    public:
+        /// run version v, 2 to 6
+        void run(int v) {
+            switch (v) {
+                case 2: dropCutter2(); break;
+                case 3: dropCutter3(); break;
+                case 4: dropCutter4(); break;
+                case 5: dropCutter5(); break;
+                default: dropCutter6(); break;
+            }
+        }
+};
+
+/// compare BatchDropCutter against bruteForce() on the surface in file, with CL-points step apart
+static void testSurface(const std::string& file, double step) {
+    STLSurf s;
+    test::readSTL(file, s);
+    std::vector<MillingCutter*> cutters = test::makeCutters();
+    std::vector<SpatialIndexType> types = test::indexTypes();
+    std::vector<CLPoint> points = makePoints(s, step);
+    for (unsigned int c=0; c<cutters.size(); ++c) {
+        std::vector<CLPoint> expected( points );
+        bruteForce(s, *cutters[c], expected);
+        for (unsigned int t=0; t<types.size(); ++t) {
+            for (int simd=0; simd<2; ++simd) {
+                BatchDropCutter bdc;
+                bdc.setIndexType( types[t] );
+                bdc.setSIMD( simd == 1 );
+                bdc.setSTL(s);
+                bdc.setCutter( cutters[c] );
+                for (unsigned int n=0; n<points.size(); ++n)
+                    bdc.appendPoint( points[n] );
+                bdc.run();
+                std::vector<CLPoint> result = bdc.getCLPoints();
+                OCL_CHECK( result.size() == expected.size() );
+                int wrong = 0;
+                for (unsigned int n=0; (n<result.size()) && (n<expected.size()); ++n) {
+                    if ( fabs( result[n].z - expected[n].z ) > DROP_TEST_TOL )
+                        ++wrong;
+                }
+                if (wrong)
+                    std::cout << file << " " << cutters[c]->str() << " " << test::indexName( types[t] )
+                              << ( simd ? " SIMD" : " scalar" ) << ": " << wrong << " of "
+                              << points.size() << " CL-points differ\n";
+                OCL_CHECK( wrong == 0 );
+            }
+        }
+    }
+    test::freeCutters(cutters);
+}
+
+/// each version searches the surface as modified after setSTL(), not the index built by setSTL()
+static void testModified() {
+    STLSurf s;
+    test::readSTL("demo.stl", s);
+    BallCutter cutter(4, 20);
+    for (int v=2; v<=6; ++v) {
+        STLSurf moved(s);
+        VersionDropCutter bdc;
+        bdc.setSTL(moved);
+        bdc.setCutter(&cutter);
+        moved.rotate(0, 0, 0.3);
+        std::vector<CLPoint> points = makePoints(moved, 1.0);
+        for (unsigned int n=0; n<points.size(); ++n)
+            bdc.appendPoint( points[n] );
+        bdc.run(v);
+        bruteForce(moved, cutter, points);
+        std::vector<CLPoint> result = bdc.getCLPoints();
+        int wrong = 0;
+        for (unsigned int n=0; n<result.size(); ++n) {
+            if ( fabs( result[n].z - points[n].z ) > DROP_TEST_TOL )
+                ++wrong;
+        }
+        if (wrong)
+            std::cout << "dropCutter" << v << " on a modified surface: " << wrong << " of " << points.size() << " CL-points differ\n";
+        OCL_CHECK( wrong == 0 );
+    }
+}
+
+int main() {
+    testModified();
+    testSurface("demo.stl", 0.4);
+    testSurface("mount_rush.stl", 1.7);
+    return test::result("dropcutter_test");
+}
@@ -0,0 +1,79 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010-2011 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// IndexCache shares one index per surface and settings, and one
+// PackedSurf and IndexedMesh per surface, between indexes in all planes
+
+#include <boost/shared_ptr.hpp>
+
+#include "testutil.hpp"
+#include "indexcache.hpp"
+
+using namespace ocl;
+
+/// a new index of type t over s, in the XY-plane if xy, otherwise in the XZ-plane
+static boost::shared_ptr<SpatialIndex> makeIndex(SpatialIndexType t, bool xy, const STLSurf& s) {
+    boost::shared_ptr<SpatialIndex> idx( SpatialIndex::create(t) );
+    if (xy)
+        idx->setXYDimensions();
+    else
+        idx->setXZDimensions();
+    return IndexCache::build(idx, s);
+}
+
+int main() {
+    STLSurf s;
+    test::readSTL("demo.stl", s);
+    std::vector<SpatialIndexType> types = test::indexTypes();
+    for (unsigned int t=0; t<types.size(); ++t) {
+        boost::shared_ptr<SpatialIndex> xy = makeIndex( types[t], true, s );
+        boost::shared_ptr<SpatialIndex> xy2 = makeIndex( types[t], true, s );
+        boost::shared_ptr<SpatialIndex> xz = makeIndex( types[t], false, s );
+        OCL_CHECK( xy == xy2 );
+        OCL_CHECK( xy != xz );
+        OCL_CHECK( &xy->getPackedSurf() == &xz->getPackedSurf() );
+        OCL_CHECK( &xy->getIndexedMesh() == &xz->getIndexedMesh() );
+        OCL_CHECK( xy->getPackedSurf().size() == s.size() );
+    }
+
+    // indexes of different types share the arrays too
+    boost::shared_ptr<SpatialIndex> kd = makeIndex( KDTreeIndexType, true, s );
+    boost::shared_ptr<SpatialIndex> grid = makeIndex( GridIndexType, true, s );
+    OCL_CHECK( &kd->getPackedSurf() == &grid->getPackedSurf() );
+
+    // a modified surface gets new arrays, and an unmodified copy its own
+    STLSurf copy(s);
+    boost::shared_ptr<SpatialIndex> other = makeIndex( KDTreeIndexType, true, copy );
+    OCL_CHECK( &kd->getPackedSurf() != &other->getPackedSurf() );
+    s.addTriangle( Triangle( Point(0,0,0), Point(1,0,0), Point(0,1,0) ) );
+    boost::shared_ptr<SpatialIndex> changed = makeIndex( KDTreeIndexType, true, s );
+    OCL_CHECK( changed != kd );
+    OCL_CHECK( &kd->getPackedSurf() != &changed->getPackedSurf() );
+    OCL_CHECK( changed->getPackedSurf().size() == s.size() );
+
+    // with the cache disabled nothing is shared
+    IndexCache::setEnabled(false);
+    boost::shared_ptr<SpatialIndex> a = makeIndex( BVHIndexType, true, s );
+    boost::shared_ptr<SpatialIndex> b = makeIndex( BVHIndexType, false, s );
+    OCL_CHECK( &a->getPackedSurf() != &b->getPackedSurf() );
+    IndexCache::setEnabled(true);
+    return test::result("indexcache_test");
+}
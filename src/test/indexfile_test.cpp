@@ -0,0 +1,180 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010-2011 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// each type of spatial index saved to a file loads back with the same
+// triangles and arrays, and finds the same triangles as the index it was saved from
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+
+#include <boost/scoped_ptr.hpp>
+
+#include "testutil.hpp"
+#include "batchdropcutter.hpp"
+
+using namespace ocl;
+
+/// collects the indices of the visited triangles
+class CollectVisitor : public TriangleVisitor {
+    public:
+        void visit(const Triangle& t, unsigned int idx) {found.push_back(idx);}
+        std::vector<unsigned int> found;
+};
+
+/// the sorted triangle indices idx finds with search() in bb
+static std::vector<unsigned int> searched(const SpatialIndex& idx, const Bbox& bb) {
+    std::vector<IndexSpan> spans;
+    idx.search(bb, spans);
+    std::vector<unsigned int> found;
+    for (unsigned int n=0; n<spans.size(); ++n) {
+        for (unsigned int pos=spans[n].first; pos<spans[n].last; ++pos)
+            found.push_back( idx.triangleIndex(pos) );
+    }
+    std::sort( found.begin(), found.end() );
+    return found;
+}
+
+/// the sorted triangle indices idx finds with visit() in bb
+static std::vector<unsigned int> visited(const SpatialIndex& idx, const Bbox& bb) {
+    CollectVisitor v;
+    idx.visit(bb, v);
+    std::sort( v.found.begin(), v.found.end() );
+    return v.found;
+}
+
+/// a random number in [lo, hi]
+static double random(double lo, double hi) {
+    return lo + (hi-lo)*std::rand()/RAND_MAX;
+}
+
+/// a random box over, or partly over, s
+static Bbox randomBox(const STLSurf& s) {
+    const Bbox& bb = s.bb;
+    double x = random( bb.minpt.x - 2, bb.maxpt.x + 2 );
+    double y = random( bb.minpt.y - 2, bb.maxpt.y + 2 );
+    double z = random( bb.minpt.z - 2, bb.maxpt.z + 2 );
+    return Bbox( x, x + random(0, 5), y, y + random(0, 5), z, z + random(0, 5) );
+}
+
+/// write the first half of file name over it
+static void truncate(const std::string& name) {
+    std::vector<char> bytes;
+    {
+        std::ifstream in( name.c_str(), std::ios::binary );
+        bytes.assign( std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() );
+    }
+    std::ofstream out( name.c_str(), std::ios::binary );
+    out.write( &bytes[0], bytes.size()/2 );
+}
+
+int main() {
+    const std::string name = "indexfile_test.ocl";
+    STLSurf s;
+    test::readSTL("demo.stl", s);
+    std::srand(1);
+    std::vector<SpatialIndexType> types = test::indexTypes();
+    for (unsigned int t=0; t<types.size(); ++t) {
+        for (int plane=0; plane<3; ++plane) {
+            boost::scoped_ptr<SpatialIndex> idx( SpatialIndex::create( types[t] ) );
+            idx->setCutterSize(2, 10);
+            if ( plane == 0 )
+                idx->setXYDimensions();
+            else if ( plane == 1 )
+                idx->setXZDimensions();
+            else
+                idx->setYZDimensions();
+            idx->build(s);
+            OCL_CHECK( idx->save(name) );
+
+            STLSurf loaded;
+            boost::scoped_ptr<SpatialIndex> mapped( SpatialIndex::load(name, loaded) );
+            OCL_CHECK( mapped.get() != NULL );
+            if ( !mapped )
+                continue;
+            OCL_CHECK( mapped->isMapped() );
+            OCL_CHECK( mapped->sameSettings(*idx) );
+            OCL_CHECK( test::sameTriangles(s, loaded) );
+            OCL_CHECK( mapped->nodeCount() == idx->nodeCount() );
+            // the packed and welded arrays are searched in the file, and kept by the surface
+            OCL_CHECK( mapped->getSurfaceArrays()->isMapped() );
+            OCL_CHECK( loaded.getArrays() == mapped->getSurfaceArrays() );
+            OCL_CHECK( test::sameArrays( *idx->getSurfaceArrays(), *mapped->getSurfaceArrays() ) );
+            int wrong = 0;
+            for (int n=0; n<500; ++n) {
+                Bbox bb = randomBox(s);
+                if ( searched(*idx, bb) != searched(*mapped, bb) || visited(*idx, bb) != visited(*mapped, bb) )
+                    ++wrong;
+            }
+            if (wrong)
+                std::cout << test::indexName( types[t] ) << " plane " << plane << ": " << wrong << " of 500 searches differ\n";
+            OCL_CHECK( wrong == 0 );
+
+            // the file is only loaded into an empty surface
+            boost::scoped_ptr<SpatialIndex> again( SpatialIndex::load(name, loaded) );
+            OCL_CHECK( again.get() == NULL );
+        }
+    }
+
+    // through an Operation, which re-uses the loaded index
+    CylCutter cutter(3, 20);
+    BatchDropCutter bdc;
+    bdc.setIndexType( BVHIndexType );
+    bdc.setSTL(s);
+    bdc.setCutter(&cutter);
+    OCL_CHECK( bdc.saveIndex(name) );
+    STLSurf loaded;
+    BatchDropCutter bdc2;
+    OCL_CHECK( bdc2.loadIndex(name, loaded) );
+    OCL_CHECK( bdc2.getIndexType() == BVHIndexType );
+    bdc2.setCutter(&cutter);
+    for (double x = s.bb.minpt.x; x < s.bb.maxpt.x; x += 0.5) {
+        for (double y = s.bb.minpt.y; y < s.bb.maxpt.y; y += 0.5) {
+            CLPoint cl(x, y, s.bb.minpt.z - 10);
+            bdc.appendPoint(cl);
+            bdc2.appendPoint(cl);
+        }
+    }
+    bdc.run();
+    bdc2.run();
+    std::vector<CLPoint> a = bdc.getCLPoints();
+    std::vector<CLPoint> b = bdc2.getCLPoints();
+    OCL_CHECK( a.size() == b.size() );
+    int wrong = 0;
+    for (unsigned int n=0; (n<a.size()) && (n<b.size()); ++n) {
+        if ( a[n].z != b[n].z )
+            ++wrong;
+    }
+    OCL_CHECK( wrong == 0 );
+
+    // a truncated file is not loaded
+    truncate(name);
+    {
+        STLSurf empty;
+        boost::scoped_ptr<SpatialIndex> damaged( SpatialIndex::load(name, empty) );
+        OCL_CHECK( damaged.get() == NULL );
+        OCL_CHECK( empty.size() == 0 );
+    }
+    std::remove( name.c_str() );
+    return test::result("indexfile_test");
+}
@@ -0,0 +1,146 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010-2011 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// a surface saved to a .oclmesh file, with and without an index, loads
+// back with the same triangles, and drop-cutter gives the same results on it
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+#include <boost/shared_ptr.hpp>
+
+#include "testutil.hpp"
+#include "meshcache.hpp"
+#include "indexcache.hpp"
+#include "batchdropcutter.hpp"
+
+using namespace ocl;
+
+/// drop c on s at a grid of points, with an index of type t
+static std::vector<CLPoint> drop(const STLSurf& s, MillingCutter* c, SpatialIndexType t) {
+    BatchDropCutter bdc;
+    bdc.setIndexType(t);
+    bdc.setSTL(s);
+    bdc.setCutter(c);
+    for (double x = s.bb.minpt.x; x < s.bb.maxpt.x; x += 0.5) {
+        for (double y = s.bb.minpt.y; y < s.bb.maxpt.y; y += 0.5) {
+            CLPoint cl(x, y, s.bb.minpt.z - 10);
+            bdc.appendPoint(cl);
+        }
+    }
+    bdc.run();
+    return bdc.getCLPoints();
+}
+
+/// true if a and b are at the same heights
+static bool sameHeights(const std::vector<CLPoint>& a, const std::vector<CLPoint>& b) {
+    if ( a.size() != b.size() )
+        return false;
+    for (unsigned int n=0; n<a.size(); ++n) {
+        if ( a[n].z != b[n].z )
+            return false;
+    }
+    return true;
+}
+
+/// change one byte in the middle of file name
+static void damage(const std::string& name) {
+    std::vector<char> bytes;
+    {
+        std::ifstream in( name.c_str(), std::ios::binary );
+        bytes.assign( std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() );
+    }
+    bytes[ bytes.size()/2 ] ^= 0x55;
+    std::ofstream out( name.c_str(), std::ios::binary );
+    out.write( &bytes[0], bytes.size() );
+}
+
+int main() {
+    const std::string name = "meshcache_test.oclmesh";
+    STLSurf s;
+    test::readSTL("demo.stl", s);
+    CylCutter cutter(3, 20);
+
+    // without an index
+    OCL_CHECK( MeshCache::save(name, s) );
+    {
+        STLSurf loaded;
+        boost::shared_ptr<SpatialIndex> idx;
+        OCL_CHECK( MeshCache::load(name, loaded, idx) );
+        OCL_CHECK( !idx );
+        OCL_CHECK( test::sameTriangles(s, loaded) );
+        std::vector<boost::uint64_t> order;
+        s.calcMortonOrder(order);
+        OCL_CHECK( loaded.getMortonOrder() && (*loaded.getMortonOrder() == order) );
+        // the packed and welded arrays are used in place, also by an index built over the surface
+        OCL_CHECK( loaded.getArrays() && loaded.getArrays()->isMapped() );
+        OCL_CHECK( test::sameArrays( *IndexCache::arrays(s), *loaded.getArrays() ) );
+        boost::shared_ptr<SpatialIndex> built( SpatialIndex::create( KDTreeIndexType ) );
+        built->setXYDimensions();
+        built->build(loaded);
+        OCL_CHECK( built->getSurfaceArrays() == loaded.getArrays() );
+        OCL_CHECK( sameHeights( drop(s, &cutter, KDTreeIndexType), drop(loaded, &cutter, KDTreeIndexType) ) );
+    }
+
+    // with the index of each type, which an operation on the loaded surface re-uses
+    std::vector<SpatialIndexType> types = test::indexTypes();
+    for (unsigned int t=0; t<types.size(); ++t) {
+        if ( types[t] == FiberIndexType ) // not a drop-cutter index
+            continue;
+        BatchDropCutter bdc;
+        bdc.setIndexType( types[t] );
+        bdc.setSTL(s);
+        bdc.setCutter(&cutter);
+        OCL_CHECK( bdc.saveCache(name) );
+        STLSurf loaded;
+        boost::shared_ptr<SpatialIndex> idx;
+        OCL_CHECK( MeshCache::load(name, loaded, idx) );
+        OCL_CHECK( idx && idx->isMapped() && (idx->type() == types[t]) && (idx->size() == s.size()) );
+        OCL_CHECK( idx && (idx->getSurfaceArrays() == loaded.getArrays()) && idx->getSurfaceArrays()->isMapped() );
+        OCL_CHECK( test::sameTriangles(s, loaded) );
+        unsigned int hits = IndexCache::hits();
+        std::vector<CLPoint> after = drop(loaded, &cutter, types[t]);
+        OCL_CHECK( IndexCache::hits() == hits+1 );
+        OCL_CHECK( sameHeights( drop(s, &cutter, types[t]), after ) );
+    }
+
+    // a damaged file is not loaded
+    damage(name);
+    {
+        STLSurf loaded;
+        boost::shared_ptr<SpatialIndex> idx;
+        OCL_CHECK( !MeshCache::load(name, loaded, idx) );
+        OCL_CHECK( loaded.size() == 0 );
+    }
+
+    // converted directly from the STL file
+    std::string stl = std::string(OCL_STL_DIR) + "/demo.stl";
+    OCL_CHECK( MeshCache::convert( std::wstring( stl.begin(), stl.end() ), name ) );
+    {
+        STLSurf loaded;
+        boost::shared_ptr<SpatialIndex> idx;
+        OCL_CHECK( MeshCache::load(name, loaded, idx) );
+        OCL_CHECK( test::sameTriangles(s, loaded) );
+    }
+    std::remove( name.c_str() );
+    return test::result("meshcache_test");
+}
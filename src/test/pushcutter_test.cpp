@@ -0,0 +1,138 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010-2011 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// BatchPushCutter, with every cutter and index type, against pushing each
+// fiber against every triangle of the surface one at a time
+
+#include <algorithm>
+#include <cmath>
+
+#include "testutil.hpp"
+#include "batchpushcutter.hpp"
+#include "fiber.hpp"
+#include "interval.hpp"
+
+using namespace ocl;
+
+/// tolerance for comparing interval ends
+#define PUSH_TEST_TOL 1E-9
+
+static bool lowerLess(const Interval& a, const Interval& b) {
+    return a.lower < b.lower;
+}
+
+/// the intervals of f, sorted and with touching intervals joined
+static std::vector<Interval> normalized(const Fiber& f) {
+    std::vector<Interval> in( f.ints );
+    std::sort( in.begin(), in.end(), lowerLess );
+    std::vector<Interval> out;
+    for (unsigned int n=0; n<in.size(); ++n) {
+        if ( !out.empty() && in[n].lower <= out.back().upper + PUSH_TEST_TOL )
+            out.back().upper = std::max( out.back().upper, in[n].upper );
+        else
+            out.push_back( in[n] );
+    }
+    return out;
+}
+
+/// true if fibers a and b cover the same intervals
+static bool sameIntervals(const Fiber& a, const Fiber& b) {
+    std::vector<Interval> ia = normalized(a);
+    std::vector<Interval> ib = normalized(b);
+    if ( ia.size() != ib.size() )
+        return false;
+    for (unsigned int n=0; n<ia.size(); ++n) {
+        if ( fabs( ia[n].lower - ib[n].lower ) > PUSH_TEST_TOL ||
+             fabs( ia[n].upper - ib[n].upper ) > PUSH_TEST_TOL )
+            return false;
+    }
+    return true;
+}
+
+/// fibers along x (or y if !xdir) covering the surface at a few heights
+static std::vector<Fiber> makeFibers(const STLSurf& s, bool xdir) {
+    std::vector<Fiber> fibers;
+    const Bbox& bb = s.bb;
+    double zstep = (bb.maxpt.z - bb.minpt.z) / 4;
+    for (int k=1; k<4; ++k) {
+        double z = bb.minpt.z + k*zstep;
+        if (xdir) {
+            for (double y = bb.minpt.y - 1; y < bb.maxpt.y + 1; y += 0.37)
+                fibers.push_back( Fiber( Point(bb.minpt.x - 5, y, z), Point(bb.maxpt.x + 5, y, z) ) );
+        } else {
+            for (double x = bb.minpt.x - 1; x < bb.maxpt.x + 1; x += 0.37)
+                fibers.push_back( Fiber( Point(x, bb.minpt.y - 5, z), Point(x, bb.maxpt.y + 5, z) ) );
+        }
+    }
+    return fibers;
+}
+
+/// push c along fibers against each triangle of s, as BatchPushCutter::pushCutter1()
+static void bruteForce(const STLSurf& s, const MillingCutter& c, std::vector<Fiber>& fibers) {
+    for (unsigned int n=0; n<fibers.size(); ++n) {
+        for (unsigned int m=0; m<s.size(); ++m) {
+            Interval i;
+            c.pushCutter( fibers[n], i, s.getTriangles()[m] );
+            fibers[n].addInterval(i);
+        }
+    }
+}
+
+int main() {
+    STLSurf s;
+    test::readSTL("demo.stl", s);
+    std::vector<MillingCutter*> cutters = test::makeCutters();
+    std::vector<SpatialIndexType> types = test::indexTypes();
+    for (int dir=0; dir<2; ++dir) {
+        bool xdir = (dir == 0);
+        std::vector<Fiber> fibers = makeFibers(s, xdir);
+        for (unsigned int c=0; c<cutters.size(); ++c) {
+            std::vector<Fiber> expected( fibers );
+            bruteForce(s, *cutters[c], expected);
+            for (unsigned int t=0; t<types.size(); ++t) {
+                BatchPushCutter bpc;
+                if (xdir)
+                    bpc.setXDirection();
+                else
+                    bpc.setYDirection();
+                bpc.setIndexType( types[t] );
+                bpc.setSTL(s);
+                bpc.setCutter( cutters[c] );
+                for (unsigned int n=0; n<fibers.size(); ++n)
+                    bpc.appendFiber( fibers[n] );
+                bpc.run();
+                std::vector<Fiber>& result = *bpc.getFibers();
+                int wrong = 0;
+                for (unsigned int n=0; n<result.size(); ++n) {
+                    if ( !sameIntervals( result[n], expected[n] ) )
+                        ++wrong;
+                }
+                if (wrong)
+                    std::cout << cutters[c]->str() << " " << test::indexName( types[t] ) << ( xdir ? " X" : " Y" )
+                              << ": " << wrong << " of " << fibers.size() << " fibers differ\n";
+                OCL_CHECK( result.size() == expected.size() );
+                OCL_CHECK( wrong == 0 );
+            }
+        }
+    }
+    test::freeCutters(cutters);
+    return test::result("pushcutter_test");
+}
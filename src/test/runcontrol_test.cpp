@@ -0,0 +1,198 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010-2011 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// progress callbacks, cancellation and time budgets of operations
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "testutil.hpp"
+#include "runcontrol.hpp"
+#include "batchdropcutter.hpp"
+#include "batchpushcutter.hpp"
+#include "waterline.hpp"
+
+using namespace ocl;
+
+/// records the reported fractions, and cancels token once the run is cancelAt done
+class RecordProgress : public ProgressCallback {
+    public:
+        RecordProgress(boost::shared_ptr<CancelToken> t, double at)
+            : token(t), cancelAt(at), thread( boost::this_thread::get_id() ), otherThread(false) {}
+        void progress(double fraction) {
+            fractions.push_back(fraction);
+            otherThread = otherThread || ( boost::this_thread::get_id() != thread );
+            if ( token && (fraction >= cancelAt) )
+                token->cancel();
+        }
+        /// true if the fractions increase from 0 to 1, and end at 1
+        bool increasing() const {
+            if ( fractions.empty() || (fractions.back() != 1.0) )
+                return false;
+            for (unsigned int n=0; n<fractions.size(); ++n) {
+                if ( (fractions[n] < 0.0) || (fractions[n] > 1.0) || ( (n > 0) && (fractions[n] < fractions[n-1]) ) )
+                    return false;
+            }
+            return true;
+        }
+        boost::shared_ptr<CancelToken> token;
+        double cancelAt;
+        boost::thread::id thread;
+        bool otherThread;
+        std::vector<double> fractions;
+};
+
+/// the start height of the CL-points
+static double startZ(const STLSurf& s) {return s.bb.minpt.z - 10;}
+
+/// a BatchDropCutter with a grid of CL-points, step apart, over s
+static void setup(BatchDropCutter& bdc, const STLSurf& s, MillingCutter* c, double step) {
+    bdc.setSTL(s);
+    bdc.setCutter(c);
+    for (double x = s.bb.minpt.x + 1; x < s.bb.maxpt.x - 1; x += step) {
+        for (double y = s.bb.minpt.y + 1; y < s.bb.maxpt.y - 1; y += step) {
+            CLPoint cl(x, y, startZ(s));
+            bdc.appendPoint(cl);
+        }
+    }
+}
+
+/// the number of CL-points of bdc at another height than in complete, the result of a run that was not stopped
+static unsigned int notDropped(BatchDropCutter& bdc, const std::vector<CLPoint>& complete) {
+    std::vector<CLPoint> points = bdc.getCLPoints();
+    unsigned int n = 0;
+    for (unsigned int m=0; m<points.size(); ++m) {
+        if ( (m >= complete.size()) || (points[m].z != complete[m].z) )
+            ++n;
+    }
+    return n;
+}
+
+int main() {
+    STLSurf s;
+    test::readSTL("mount_rush.stl", s);
+    BallCutter cutter(4, 20);
+
+    // progress without a stop
+    std::vector<CLPoint> complete;
+    {
+        BatchDropCutter bdc;
+        setup(bdc, s, &cutter, 0.3);
+        boost::shared_ptr<RecordProgress> p( new RecordProgress( boost::shared_ptr<CancelToken>(), 1.0 ) );
+        bdc.setProgressCallback(p);
+        bdc.setProgressInterval(0);
+        bdc.run();
+        OCL_CHECK( p->increasing() );
+        OCL_CHECK( p->fractions.size() > 2 );
+        OCL_CHECK( !p->otherThread );
+        OCL_CHECK( !bdc.isStopped() );
+        complete = bdc.getCLPoints();
+    }
+    unsigned int lifted = 0; // CL-points with triangles under them
+    for (unsigned int m=0; m<complete.size(); ++m) {
+        if ( complete[m].z != startZ(s) )
+            ++lifted;
+    }
+    OCL_CHECK( lifted > complete.size()/2 );
+
+    // cancelled from the callback, part way
+    boost::shared_ptr<CancelToken> token( new CancelToken() );
+    {
+        BatchDropCutter bdc;
+        setup(bdc, s, &cutter, 0.3);
+        boost::shared_ptr<RecordProgress> p( new RecordProgress(token, 0.2) );
+        bdc.setProgressCallback(p);
+        bdc.setProgressInterval(0);
+        bdc.setCancelToken(token);
+        bdc.run();
+        OCL_CHECK( bdc.isStopped() );
+        OCL_CHECK( p->increasing() );
+        unsigned int left = notDropped(bdc, complete);
+        OCL_CHECK( left > 0 );
+        OCL_CHECK( left < bdc.getCLPoints().size() );
+
+        // a cancelled token stops the next run at once, and after reset() it runs to the end
+        BatchDropCutter again;
+        setup(again, s, &cutter, 0.3);
+        again.setCancelToken(token);
+        again.run();
+        OCL_CHECK( again.isStopped() );
+        OCL_CHECK( notDropped(again, complete) == lifted );
+        token->reset();
+        again.run();
+        OCL_CHECK( !again.isStopped() );
+        OCL_CHECK( notDropped(again, complete) == 0 );
+    }
+
+    // a push-cutter shares the token
+    {
+        BatchPushCutter bpc;
+        bpc.setXDirection();
+        bpc.setSTL(s);
+        bpc.setCutter(&cutter);
+        double z = 0.5*( s.bb.minpt.z + s.bb.maxpt.z );
+        for (double y = s.bb.minpt.y; y < s.bb.maxpt.y; y += 0.1) {
+            Fiber f( Point(s.bb.minpt.x - 5, y, z), Point(s.bb.maxpt.x + 5, y, z) );
+            bpc.appendFiber(f);
+        }
+        token->cancel();
+        bpc.setCancelToken(token);
+        bpc.run();
+        OCL_CHECK( bpc.isStopped() );
+        token->reset();
+        bpc.run();
+        OCL_CHECK( !bpc.isStopped() );
+    }
+
+    // time budgets
+    {
+        BatchDropCutter bdc;
+        setup(bdc, s, &cutter, 0.3);
+        bdc.setTimeBudget(1E-6);
+        bdc.run();
+        OCL_CHECK( bdc.isStopped() );
+        OCL_CHECK( notDropped(bdc, complete) > 0 );
+        bdc.setTimeBudget(1000);
+        bdc.run();
+        OCL_CHECK( !bdc.isStopped() );
+        OCL_CHECK( notDropped(bdc, complete) == 0 );
+        bdc.setTimeBudget(0);
+        OCL_CHECK( bdc.getTimeBudget() == 0 );
+    }
+
+    // a stopped waterline has no loops from incomplete fibers
+    {
+        Waterline wl;
+        wl.setSTL(s);
+        wl.setCutter(&cutter);
+        wl.setSampling(0.1);
+        wl.setZ( 0.5*( s.bb.minpt.z + s.bb.maxpt.z ) );
+        wl.setTimeBudget(1E-6);
+        wl.run();
+        OCL_CHECK( wl.isStopped() );
+        OCL_CHECK( wl.getLoops().empty() );
+        wl.setTimeBudget(0);
+        wl.run();
+        OCL_CHECK( !wl.isStopped() );
+        OCL_CHECK( !wl.getLoops().empty() );
+    }
+    return test::result("runcontrol_test");
+}
@@ -0,0 +1,133 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010-2011 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// the ASCII STL reader parses coordinates to the same floats as strtof()
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include "testutil.hpp"
+
+using namespace ocl;
+
+/// coordinates where rounding the nearest double to float is wrong, or which need many digits
+static const char* hardNumbers[] = {
+    "0", "-0", "1", "0.1", "-2.5", "+7.25", "1e3", "1.5E-3", "123456789", "0.000001",
+    "16777217",                             // 2^24+1, halfway between two floats
+    "16777219",                             // halfway, rounds up to even
+    "1.000000059604644775390625",           // 1+2^-24, halfway
+    "1.000000059604644775390626",           // just above halfway
+    "1.000000059604644775390624999999999",  // just below halfway, more digits than fit in the mantissa
+    "1.00000005960464477539062499",         // just below halfway
+    "7.038531e-26",
+    "8.589973e9",
+    "3.4028234e38",
+    "-3.4028234e38",
+    "1.17549435e-38",                       // the smallest normal float
+    "1e-40",                                // a denormal
+    "0.00000000000000000000000000000000000000001",
+    "12345678901234567890123456789",
+    "4.9406564584124654e-45"
+};
+
+/// a random decimal number with up to 12 significant digits and an exponent
+static std::string randomNumber() {
+    std::ostringstream o;
+    if ( std::rand() % 2 )
+        o << "-";
+    int digits = 1 + std::rand() % 12;
+    int point = std::rand() % (digits+1);
+    for (int n=0; n<digits; ++n) {
+        if ( n == point )
+            o << ( (n == 0) ? "0." : "." );
+        o << (char)( '0' + std::rand() % 10 );
+    }
+    if ( std::rand() % 3 == 0 )
+        o << "e" << ( std::rand() % 61 - 30 );
+    return o.str();
+}
+
+int main() {
+    std::vector<std::string> numbers( hardNumbers, hardNumbers + sizeof(hardNumbers)/sizeof(hardNumbers[0]) );
+    std::srand(1);
+    for (int n=0; n<30000; ++n)
+        numbers.push_back( randomNumber() );
+    while ( numbers.size() % 9 )
+        numbers.push_back( "1" );
+
+    const std::string name = "stlreader_test.stl";
+    {
+        std::ofstream out( name.c_str() );
+        out << "solid test\n";
+        for (unsigned int n=0; n<numbers.size(); n+=9) {
+            out << "  facet normal 0 0 1\n    outer loop\n";
+            for (int v=0; v<3; ++v)
+                out << "      vertex " << numbers[n+3*v] << " " << numbers[n+3*v+1] << " " << numbers[n+3*v+2] << "\n";
+            out << "    endloop\n  endfacet\n";
+        }
+        out << "endsolid test\n";
+    }
+    STLSurf s;
+    STLReader r( std::wstring( name.begin(), name.end() ), s );
+    std::remove( name.c_str() );
+
+    // the triangles are matched by the first coordinate, so their order does not matter
+    OCL_CHECK( s.size() == numbers.size()/9 );
+    // the bounding-box is found while converting, and the Morton order only when an index needs it
+    Bbox bb;
+    for (unsigned int m=0; m<s.size(); ++m)
+        bb.addTriangle( s.getTriangles()[m] );
+    OCL_CHECK( (bb.minpt == s.bb.minpt) && (bb.maxpt == s.bb.maxpt) );
+    OCL_CHECK( s.getMortonOrder() == NULL );
+    std::vector<bool> matched( numbers.size()/9, false );
+    int wrong = 0;
+    for (unsigned int n=0; n<numbers.size(); n+=9) {
+        float x[9];
+        for (int k=0; k<9; ++k)
+            x[k] = std::strtof( numbers[n+k].c_str(), NULL );
+        bool found = false;
+        for (unsigned int m=0; (m<s.size()) && !found; ++m) {
+            const Triangle& t = s.getTriangles()[m];
+            if ( matched[m] || (float)t.p[0].x != x[0] || (float)t.p[0].y != x[1] || (float)t.p[0].z != x[2] )
+                continue;
+            bool same = true;
+            for (int v=1; v<3; ++v) {
+                same = same && ( (float)t.p[v].x == x[3*v] ) && ( (float)t.p[v].y == x[3*v+1] ) &&
+                               ( (float)t.p[v].z == x[3*v+2] );
+            }
+            if (same)
+                matched[m] = found = true;
+        }
+        if ( !found ) {
+            if ( wrong < 10 ) {
+                std::cout << "facet not read as by strtof():";
+                for (int k=0; k<9; ++k)
+                    std::cout << " " << numbers[n+k];
+                std::cout << "\n";
+            }
+            ++wrong;
+        }
+    }
+    OCL_CHECK( wrong == 0 );
+    return test::result("stlreader_test");
+}
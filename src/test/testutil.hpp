@@ -0,0 +1,185 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010-2011 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstring>
+
+#include "stlsurf.hpp"
+#include "stlreader.hpp"
+#include "millingcutter.hpp"
+#include "cylcutter.hpp"
+#include "ballcutter.hpp"
+#include "bullcutter.hpp"
+#include "conecutter.hpp"
+#include "compositecutter.hpp"
+#include "spatialindex.hpp"
+
+// helpers shared by the test programs. Each test is a plain executable
+// which returns non-zero if a check failed, run by 'make test'
+
+#ifndef OCL_STL_DIR
+#define OCL_STL_DIR "../stl"
+#endif
+
+/// count a failure and print the failing expression if cond is false
+#define OCL_CHECK(cond) ocl::test::check( (cond), #cond, __FILE__, __LINE__ )
+
+namespace ocl
+{
+
+namespace test
+{
+
+/// the number of failed checks in this program
+inline int& failures() {
+    static int n = 0;
+    return n;
+}
+
+/// count a failure, and print where it happened, if cond is false
+inline bool check(bool cond, const char* expr, const char* file, int line) {
+    if (!cond) {
+        ++failures();
+        std::cout << file << ":" << line << ": check failed: " << expr << "\n";
+    }
+    return cond;
+}
+
+/// print a summary and return the exit status for ctest
+inline int result(const std::string& name) {
+    if ( failures() ) {
+        std::cout << name << ": " << failures() << " checks FAILED\n";
+        return 1;
+    }
+    std::cout << name << ": all checks passed\n";
+    return 0;
+}
+
+/// read the file name from the stl/ directory of the source tree into s
+inline void readSTL(const std::string& name, STLSurf& s) {
+    std::string path = std::string(OCL_STL_DIR) + "/" + name;
+    STLReader r( std::wstring( path.begin(), path.end() ), s );
+}
+
+/// true if a and b hold exactly the same triangles, normals and bounding-boxes, in the same order
+inline bool sameTriangles(const STLSurf& a, const STLSurf& b) {
+    if ( a.size() != b.size() )
+        return false;
+    for (unsigned int n=0; n<a.size(); ++n) {
+        const Triangle& ta = a.getTriangles()[n];
+        const Triangle& tb = b.getTriangles()[n];
+        for (int k=0; k<3; ++k) {
+            if ( !(ta.p[k] == tb.p[k]) )
+                return false;
+        }
+        if ( !(ta.n == tb.n) )
+            return false;
+        for (unsigned int k=0; k<6; ++k) {
+            if ( ta.bb[k] != tb.bb[k] )
+                return false;
+        }
+    }
+    return true;
+}
+
+/// true if a and b hold exactly the same packed and welded arrays
+inline bool sameArrays(const SurfaceArrays& a, const SurfaceArrays& b) {
+    std::vector<FileBlock> ba, bb;
+    a.save_blocks(ba);
+    b.save_blocks(bb);
+    for (unsigned int m=0; m<ba.size(); ++m) {
+        if ( ba[m].bytes != bb[m].bytes )
+            return false;
+        if ( (ba[m].bytes > 0) && (memcmp( ba[m].data, bb[m].data, ba[m].bytes ) != 0) )
+            return false;
+    }
+    return true;
+}
+
+/// \brief a BallCutter that ignores the edges of triangles.
+///
+/// A class derived from a cutter of the library, which overrides the virtual Triangle functions.
+/// The operations must call them, and give the same results as dropCutter(cl, t) and pushCutter(f, i, t).
+class NoEdgeBallCutter : public BallCutter {
+    public:
+        NoEdgeBallCutter(double d, double l) : BallCutter(d, l) {}
+        bool edgeDrop(CLPoint& cl, const Triangle& t) const {return false;}
+        std::string str() const {return "NoEdgeBallCutter";}
+    protected:
+        bool edgePush(const Fiber& f, Interval& i, const Triangle& t) const {return false;}
+};
+
+/// the cutters every test is run with, deleted by freeCutters()
+inline std::vector<MillingCutter*> makeCutters() {
+    std::vector<MillingCutter*> c;
+    c.push_back( new CylCutter(4, 20) );
+    c.push_back( new BallCutter(4, 20) );
+    c.push_back( new BullCutter(4, 1, 20) );
+    c.push_back( new ConeCutter(4, 0.7, 20) );
+    c.push_back( new CompCylCutter(4, 20) );
+    c.push_back( new CompBallCutter(4, 20) );
+    c.push_back( new CylConeCutter(2, 6, 0.7) );
+    c.push_back( new BallConeCutter(2, 6, 0.7) );
+    c.push_back( new BullConeCutter(2, 0.5, 6, 0.7) );
+    c.push_back( new ConeConeCutter(2, 0.4, 6, 0.7) );
+    c.push_back( new NoEdgeBallCutter(4, 20) );
+    return c;
+}
+
+/// delete the cutters of makeCutters()
+inline void freeCutters(std::vector<MillingCutter*>& c) {
+    for (unsigned int n=0; n<c.size(); ++n)
+        delete c[n];
+    c.clear();
+}
+
+/// the index types every test is run with
+inline std::vector<SpatialIndexType> indexTypes() {
+    std::vector<SpatialIndexType> t;
+    t.push_back( KDTreeIndexType );
+    t.push_back( BVHIndexType );
+    t.push_back( GridIndexType );
+    t.push_back( FiberIndexType );
+    return t;
+}
+
+/// a name for index type t, for messages
+inline const char* indexName(SpatialIndexType t) {
+    switch (t) {
+        case KDTreeIndexType: return "KDTree";
+        case BVHIndexType:    return "BVH";
+        case GridIndexType:   return "Grid";
+        case FiberIndexType:  return "Fiber";
+    }
+    return "?";
+}
+
+} // end namespace test
+
+} // end namespace ocl
+
+#endif
+// end file testutil.hpp
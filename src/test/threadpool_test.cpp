@@ -0,0 +1,118 @@
+/*  $Id$
+ *
+ *  Copyright (c) 2010-2011 Anders Wallin (anders.e.e.wallin "at" gmail.com).
+ *
+ *  This file is part of OpenCAMlib
+ *  (see https://github.com/aewallin/opencamlib).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// ThreadPool runs every part once, also for nested runs, and for runs
+// from several threads while the pool is resized
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include "testutil.hpp"
+#include "threadpool.hpp"
+
+using namespace ocl;
+
+/// counts the parts run. part k of an outer task runs an inner task of inner parts.
+class CountTask : public ParallelTask {
+    public:
+        CountTask(unsigned int n, unsigned int in) : count(n, 0), nestedOnce(n, 1), inner(in) {}
+        void run(unsigned int k) {
+            // each part has its own elements
+            if ( inner > 0 ) {
+                CountTask nested(inner, 0);
+                ThreadPool::instance().run( nested, inner );
+                nestedOnce[k] = nested.once();
+            }
+            ++count[k];
+        }
+        /// true if each part, and each part of the nested tasks, ran once
+        bool once() const {
+            for (unsigned int k=0; k<count.size(); ++k) {
+                if ( (count[k] != 1) || !nestedOnce[k] )
+                    return false;
+            }
+            return true;
+        }
+        std::vector<int> count;
+        std::vector<int> nestedOnce;
+        unsigned int inner;
+};
+
+/// a flag set by one thread and read by others
+class Flag {
+    public:
+        Flag() : value(false) {}
+        void set() {
+            boost::mutex::scoped_lock lock(mutex);
+            value = true;
+        }
+        bool get() const {
+            boost::mutex::scoped_lock lock(mutex);
+            return value;
+        }
+    private:
+        mutable boost::mutex mutex;
+        bool value;
+};
+
+/// runs nested tasks until done is set, and counts the runs that went wrong
+static void runLoop(const Flag* done, int* failed) {
+    while ( !done->get() ) {
+        CountTask task(8, 3);
+        ThreadPool::instance().run( task, 8 );
+        if ( !task.once() )
+            ++*failed;
+    }
+}
+
+int main() {
+    ThreadPool& pool = ThreadPool::instance();
+    pool.setSize(4);
+    OCL_CHECK( pool.size() == 4 );
+    {
+        CountTask task(100, 0);
+        pool.run( task, 100 );
+        OCL_CHECK( task.once() );
+    }
+    {
+        CountTask task(16, 16);
+        pool.run( task, 16 );
+        OCL_CHECK( task.once() );
+    }
+
+    // resized while three other threads run nested tasks
+    Flag done;
+    int failed[3] = {0, 0, 0};
+    boost::thread_group threads;
+    for (int t=0; t<3; ++t)
+        threads.create_thread( boost::bind( runLoop, &done, &failed[t] ) );
+    for (unsigned int n=0; n<200; ++n) {
+        pool.setSize( 1 + n%5 );
+        OCL_CHECK( pool.size() == 1 + n%5 );
+    }
+    done.set();
+    threads.join_all();
+    OCL_CHECK( failed[0] == 0 && failed[1] == 0 && failed[2] == 0 );
+
+    pool.setSize(0);
+    OCL_CHECK( pool.size() == ThreadPool::cores() );
+    return test::result("threadpool_test");
+}